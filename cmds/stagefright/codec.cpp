@@ -47,7 +47,8 @@ static void usage(const char *me) {
                     "\t\t[-p] playback\n"
                     "\t\t[-S] allocate buffers from a surface\n"
                     "\t\t[-R] render output to surface (enables -S)\n"
-                    "\t\t[-T] use render timestamps (enables -R)\n",
+                    "\t\t[-T] use render timestamps (enables -R)\n"
+                    "\t\t[-b <n>] queue and dequeue up to n buffers per call\n",
                     me);
     exit(1);
 }
@@ -63,8 +64,65 @@ struct CodecState {
     int64_t mNumBuffersDecoded;
     int64_t mNumBytesDecoded;
     bool mIsAudio;
+    int64_t mNumBuffersQueued;
+    int64_t mQueueTimeUs;       // spent in the calls queueing input and dequeueing output
 };
 
+// Queues the next samples of |trackIndex|, up to |batchSize| of them, with one
+// queueInputBuffers() call. Returns false once the extractor has no more samples.
+static bool queueInputBatch(
+        const sp<NuMediaExtractor> &extractor, size_t trackIndex, CodecState *state,
+        size_t batchSize, int64_t timeoutUs) {
+    std::vector<MediaCodec::BatchBuffer> batch;
+    bool more = true;
+    while (batch.size() < batchSize) {
+        size_t sampleTrackIndex;
+        if (extractor->getSampleTrackIndex(&sampleTrackIndex) != OK) {
+            more = false;
+            break;
+        } else if (sampleTrackIndex != trackIndex) {
+            break;
+        }
+
+        size_t index;
+        status_t err = state->mCodec->dequeueInputBuffer(
+                &index, batch.empty() ? timeoutUs : 0ll);
+        if (err != OK) {
+            CHECK_EQ(err, -EAGAIN);
+            break;
+        }
+
+        const sp<MediaCodecBuffer> &buffer = state->mInBuffers.itemAt(index);
+        sp<ABuffer> abuffer = new ABuffer(buffer->base(), buffer->capacity());
+
+        err = extractor->readSampleData(abuffer);
+        CHECK_EQ(err, (status_t)OK);
+
+        MediaCodec::BatchBuffer input;
+        input.index = index;
+        input.offset = abuffer->offset();
+        input.size = abuffer->size();
+        input.flags = 0;
+        err = extractor->getSampleTime(&input.presentationTimeUs);
+        CHECK_EQ(err, (status_t)OK);
+        batch.push_back(input);
+
+        extractor->advance();
+    }
+
+    if (!batch.empty()) {
+        int64_t startUs = ALooper::GetNowUs();
+        size_t numQueued;
+        status_t err = state->mCodec->queueInputBuffers(batch, &numQueued);
+        state->mQueueTimeUs += ALooper::GetNowUs() - startUs;
+
+        CHECK_EQ(err, (status_t)OK);
+        CHECK_EQ(numQueued, batch.size());
+        state->mNumBuffersQueued += numQueued;
+    }
+    return more;
+}
+
 }  // namespace android
 
 static int decode(
@@ -74,7 +132,8 @@ static int decode(
         bool useVideo,
         const android::sp<android::Surface> &surface,
         bool renderSurface,
-        bool useTimestamp) {
+        bool useTimestamp,
+        size_t batchSize) {
     using namespace android;
 
     static int64_t kTimeout = 500ll;
@@ -119,6 +178,8 @@ static int decode(
         state->mNumBytesDecoded = 0;
         state->mNumBuffersDecoded = 0;
         state->mIsAudio = isAudio;
+        state->mNumBuffersQueued = 0;
+        state->mQueueTimeUs = 0;
 
         state->mCodec = MediaCodec::CreateByType(
                 looper, mime.c_str(), false /* encoder */);
@@ -158,7 +219,17 @@ static int decode(
     bool sawInputEOS = false;
 
     for (;;) {
-        if (!sawInputEOS) {
+        if (!sawInputEOS && batchSize > 0) {
+            size_t trackIndex;
+            if (extractor->getSampleTrackIndex(&trackIndex) != OK) {
+                ALOGV("saw input eos");
+                sawInputEOS = true;
+            } else if (!queueInputBatch(extractor, trackIndex,
+                    &stateByTrack.editValueFor(trackIndex), batchSize, kTimeout)) {
+                ALOGV("saw input eos");
+                sawInputEOS = true;
+            }
+        } else if (!sawInputEOS) {
             size_t trackIndex;
             status_t err = extractor->getSampleTrackIndex(&trackIndex);
 
@@ -187,14 +258,17 @@ static int decode(
 
                     uint32_t bufferFlags = 0;
 
+                    int64_t startUs = ALooper::GetNowUs();
                     err = state->mCodec->queueInputBuffer(
                             index,
                             0 /* offset */,
                             buffer->size(),
                             timeUs,
                             bufferFlags);
+                    state->mQueueTimeUs += ALooper::GetNowUs() - startUs;
 
                     CHECK_EQ(err, (status_t)OK);
+                    ++state->mNumBuffersQueued;
 
                     extractor->advance();
                 } else {
@@ -250,16 +324,26 @@ static int decode(
                 continue;
             }
 
-            size_t index;
-            size_t offset;
-            size_t size;
-            int64_t presentationTimeUs;
-            uint32_t flags;
-            status_t err = state->mCodec->dequeueOutputBuffer(
-                    &index, &offset, &size, &presentationTimeUs, &flags,
-                    kTimeout);
+            std::vector<MediaCodec::BatchBuffer> outputs(1);
+            int64_t startUs = ALooper::GetNowUs();
+            status_t err;
+            if (batchSize > 0) {
+                err = state->mCodec->dequeueOutputBuffers(&outputs, batchSize, kTimeout);
+            } else {
+                MediaCodec::BatchBuffer *output = &outputs.front();
+                err = state->mCodec->dequeueOutputBuffer(
+                        &output->index, &output->offset, &output->size,
+                        &output->presentationTimeUs, &output->flags,
+                        kTimeout);
+            }
+            state->mQueueTimeUs += ALooper::GetNowUs() - startUs;
+
+            for (size_t j = 0; err == OK && j < outputs.size(); ++j) {
+                size_t index = outputs[j].index;
+                size_t size = outputs[j].size;
+                int64_t presentationTimeUs = outputs[j].presentationTimeUs;
+                uint32_t flags = outputs[j].flags;
 
-            if (err == OK) {
                 ALOGV("draining output buffer %zu, time = %lld us",
                       index, (long long)presentationTimeUs);
 
@@ -290,6 +374,10 @@ static int decode(
 
                     state->mSawOutputEOS = true;
                 }
+            }
+
+            if (err == OK) {
+                continue;
             } else if (err == INFO_OUTPUT_BUFFERS_CHANGED) {
                 ALOGV("INFO_OUTPUT_BUFFERS_CHANGED");
                 CHECK_EQ((status_t)OK,
@@ -328,6 +416,13 @@ static int decode(
                    (long long)state->mNumBytesDecoded,
                    state->mNumBytesDecoded * 1E6 / 1024 / elapsedTimeUs);
         }
+
+        if (state->mNumBuffersQueued + state->mNumBuffersDecoded > 0) {
+            printf("track %zu: %.2f us per buffer queued or dequeued\n",
+                   i,
+                   (double)state->mQueueTimeUs
+                        / (state->mNumBuffersQueued + state->mNumBuffersDecoded));
+        }
     }
 
     return 0;
@@ -344,9 +439,10 @@ int main(int argc, char **argv) {
     bool useSurface = false;
     bool renderSurface = false;
     bool useTimestamp = false;
+    size_t batchSize = 0;
 
     int res;
-    while ((res = getopt(argc, argv, "havpSDRT")) >= 0) {
+    while ((res = getopt(argc, argv, "havpSDRTb:")) >= 0) {
         switch (res) {
             case 'a':
             {
@@ -378,6 +474,11 @@ int main(int argc, char **argv) {
                 useSurface = true;
                 break;
             }
+            case 'b':
+            {
+                batchSize = strtoul(optarg, NULL, 10);
+                break;
+            }
             case '?':
             case 'h':
             default:
@@ -453,7 +554,7 @@ int main(int argc, char **argv) {
         player->reset();
     } else {
         decode(looper, argv[0], useAudio, useVideo, surface, renderSurface,
-                useTimestamp);
+                useTimestamp, batchSize);
     }
 
     if (playback || (useSurface && useVideo)) {
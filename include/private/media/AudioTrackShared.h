@@ -163,6 +163,19 @@ private:
                 // force to 32-bit.  The client and server may have different typedefs for size_t.
                 uint32_t    mMinimum;       // server wakes up client if available >= mMinimum
 
+                // client write-only, server read-only
+    volatile    uint32_t    mWakeTarget;    // frames a waiting client would like to have
+                                            // available when woken, or 0 for any.
+                                            // Server wakes up client if available >= mWakeTarget,
+                                            // but never waits for more than half the buffer.
+
+                // server write-only, client read-write
+    volatile    uint32_t    mWakeTimeUs;    // low 32 bits of CLOCK_MONOTONIC in microseconds
+                                            // at the last wake of the client, 0 when consumed
+
+                // client write-only, server read-only, "for entertainment purposes only"
+    volatile    uint32_t    mWakeLatencyUs; // smoothed delay from server wake to client running
+
                 // Stereo gains for AudioTrack only, not used by AudioRecord.
                 gain_minifloat_packed_t mVolumeLR;
 
@@ -350,6 +363,8 @@ private:
     // is initialized by the client constructor.
     ExtendedTimestampQueue::Observer mTimestampObserver;
     ExtendedTimestamp mTimestamp; // initialized by constructor
+
+    uint32_t   mWakeLatencyUs;       // smoothed wake latency, copied to mCblk->mWakeLatencyUs
 };
 
 // ----------------------------------------------------------------------------
@@ -563,12 +578,29 @@ public:
         return android_atomic_acquire_load((int32_t *)&mCblk->mBufferSizeInFrames);
     }
 
+    // Total count of the futex wake syscalls issued to the client.
+    int64_t             getWakeCount() const { return mWakeCount; }
+
+    // Futex wake syscalls per second, measured over the last complete window.
+    double              getWakesPerSecond() const { return mWakesPerSecond; }
+
+    // Smoothed delay from a wake to the client running, as measured by the client.
+    uint32_t            getWakeLatencyUs() const { return mCblk->mWakeLatencyUs; }
+
 protected:
+    // Wake the client if it is waiting, or leave a pending wake for it.
+    void                wakeClient();
+
     size_t      mAvailToClient; // estimated frames available to client prior to releaseBuffer()
     int32_t     mFlush;         // our copy of cblk->u.mStreaming.mFlush, for streaming output only
     int64_t     mReleased;      // our copy of cblk->mServer, at 64 bit resolution
     int64_t     mFlushed;       // flushed frames to account for client-server discrepancy
     ExtendedTimestampQueue::Mutator mTimestampMutator;
+
+    int64_t     mWakeCount;             // futex wake syscalls issued
+    int64_t     mWakeWindowCount;       // mWakeCount at mWakeWindowStartNs
+    int64_t     mWakeWindowStartNs;     // CLOCK_MONOTONIC start of the rate window, 0 if none
+    double      mWakesPerSecond;        // wake rate over the last complete window
 };
 
 // Proxy used by AudioFlinger for servicing AudioTrack
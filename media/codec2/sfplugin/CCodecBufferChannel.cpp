@@ -343,9 +343,12 @@ status_t CCodecBufferChannel::queueInputBufferInternal(sp<MediaCodecBuffer> buff
             queuedFrameIndex,
             std::move(queuedBuffers),
             PipelineWatcher::Clock::now());
+    const nsecs_t submittedNs = systemTime(SYSTEM_TIME_MONOTONIC);
     c2_status_t err = mComponent->queue(&items);
     if (err != C2_OK) {
         mPipelineWatcher.lock()->onWorkDone(queuedFrameIndex);
+    } else if (mFrameTrace != nullptr) {
+        mFrameTrace->record(FrameTrace::SUBMITTED, timeUs, submittedNs);
     }
 
     if (err == C2_OK && eos && buffer->size() > 0u) {
@@ -1538,6 +1541,10 @@ bool CCodecBufferChannel::handleWork(
         }
     }
 
+    if (buffer && mFrameTrace != nullptr) {
+        mFrameTrace->record(FrameTrace::DONE, timestamp.peek());
+    }
+
     {
         Mutexed<ReorderStash>::Locked reorder(mReorderStash);
         reorder->emplace(buffer, timestamp.peek(), flags, worklet->output.ordinal);
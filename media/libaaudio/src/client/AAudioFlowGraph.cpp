@@ -23,6 +23,7 @@
 #include <flowgraph/ClipToRange.h>
 #include <flowgraph/MonoToMultiConverter.h>
 #include <flowgraph/RampLinear.h>
+#include <flowgraph/SampleRateConverter.h>
 #include <flowgraph/SinkFloat.h>
 #include <flowgraph/SinkI16.h>
 #include <flowgraph/SinkI24.h>
@@ -34,12 +35,16 @@ using namespace flowgraph;
 
 aaudio_result_t AAudioFlowGraph::configure(audio_format_t sourceFormat,
                           int32_t sourceChannelCount,
+                          int32_t sourceSampleRate,
                           audio_format_t sinkFormat,
-                          int32_t sinkChannelCount) {
+                          int32_t sinkChannelCount,
+                          int32_t sinkSampleRate) {
     AudioFloatOutputPort *lastOutput = nullptr;
 
-    ALOGV("%s() source format = 0x%08x, channels = %d, sink format = 0x%08x, channels = %d",
-          __func__, sourceFormat, sourceChannelCount, sinkFormat, sinkChannelCount);
+    ALOGV("%s() source format = 0x%08x, channels = %d, rate = %d, "
+          "sink format = 0x%08x, channels = %d, rate = %d",
+          __func__, sourceFormat, sourceChannelCount, sourceSampleRate,
+          sinkFormat, sinkChannelCount, sinkSampleRate);
 
     switch (sourceFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
@@ -70,6 +75,19 @@ aaudio_result_t AAudioFlowGraph::configure(audio_format_t sourceFormat,
         lastOutput = &mClipper->output;
     }
 
+    // Convert the rate before expanding the channels, so there are fewer to convert.
+    if (sourceSampleRate != sinkSampleRate) {
+        mRateConverter = std::make_unique<SampleRateConverter>(sourceChannelCount,
+                sourceSampleRate, sinkSampleRate);
+        if (!mRateConverter->isValid()) {
+            ALOGE("%s() Sample rate conversion %d to %d not supported.",
+                  __func__, sourceSampleRate, sinkSampleRate);
+            return AAUDIO_ERROR_UNIMPLEMENTED;
+        }
+        lastOutput->connect(&mRateConverter->input);
+        lastOutput = &mRateConverter->output;
+    }
+
     // Expand the number of channels if required.
     if (sourceChannelCount == 1 && sinkChannelCount > 1) {
         mChannelConverter = std::make_unique<MonoToMultiConverter>(sinkChannelCount);
@@ -104,6 +122,12 @@ void AAudioFlowGraph::process(const void *source, void *destination, int32_t num
     mSink->read(destination, numFrames);
 }
 
+int32_t AAudioFlowGraph::process(const void *source, int32_t numSourceFrames,
+                                 void *destination, int32_t numSinkFrames) {
+    mSource->setData(source, numSourceFrames);
+    return mSink->read(destination, numSinkFrames);
+}
+
 /**
  * @param volume between 0.0 and 1.0
  */
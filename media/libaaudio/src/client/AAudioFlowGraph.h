@@ -26,6 +26,7 @@
 #include <flowgraph/ClipToRange.h>
 #include <flowgraph/MonoToMultiConverter.h>
 #include <flowgraph/RampLinear.h>
+#include <flowgraph/SampleRateConverter.h>
 
 class AAudioFlowGraph {
 public:
@@ -34,17 +35,36 @@ public:
      *
      * @param sourceFormat
      * @param sourceChannelCount
+     * @param sourceSampleRate
      * @param sinkFormat
      * @param sinkChannelCount
+     * @param sinkSampleRate a SampleRateConverter is added if different from sourceSampleRate
      * @return
      */
     aaudio_result_t configure(audio_format_t sourceFormat,
                               int32_t sourceChannelCount,
+                              int32_t sourceSampleRate,
                               audio_format_t sinkFormat,
-                              int32_t sinkChannelCount);
+                              int32_t sinkChannelCount,
+                              int32_t sinkSampleRate);
 
+    /**
+     * Convert numFrames from source to destination, at the same sample rate.
+     */
     void process(const void *source, void *destination, int32_t numFrames);
 
+    /**
+     * Convert numSourceFrames from source into up to numSinkFrames at destination.
+     *
+     * The converter keeps the source frames that it has already read but not yet used,
+     * for the next call. The source frames that it has not read are dropped, so
+     * numSinkFrames should be more than numSourceFrames converts to.
+     *
+     * @return number of frames written to destination
+     */
+    int32_t process(const void *source, int32_t numSourceFrames,
+                    void *destination, int32_t numSinkFrames);
+
     /**
      * @param volume between 0.0 and 1.0
      */
@@ -56,6 +76,7 @@ private:
     std::unique_ptr<flowgraph::AudioSource>          mSource;
     std::unique_ptr<flowgraph::RampLinear>           mVolumeRamp;
     std::unique_ptr<flowgraph::ClipToRange>          mClipper;
+    std::unique_ptr<flowgraph::SampleRateConverter>  mRateConverter;
     std::unique_ptr<flowgraph::MonoToMultiConverter> mChannelConverter;
     std::unique_ptr<flowgraph::AudioSink>            mSink;
 };
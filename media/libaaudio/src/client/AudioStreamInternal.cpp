@@ -98,8 +98,11 @@ aaudio_result_t AudioStreamInternal::open(const AudioStreamBuilder &builder) {
     if (getFormat() == AUDIO_FORMAT_DEFAULT) {
         setFormat(AUDIO_FORMAT_PCM_FLOAT);
     }
-    // Request FLOAT for the shared mixer.
-    request.getConfiguration().setFormat(AUDIO_FORMAT_PCM_FLOAT);
+    // Request FLOAT for the shared mixer, unless the mixer can read 16-bit output directly.
+    // The MMAP endpoint uses 16-bit for both, so an EXCLUSIVE stream gets the same format.
+    request.getConfiguration().setFormat(
+            (getDirection() == AAUDIO_DIRECTION_OUTPUT && getFormat() == AUDIO_FORMAT_PCM_16_BIT)
+            ? AUDIO_FORMAT_PCM_16_BIT : AUDIO_FORMAT_PCM_FLOAT);
 
     // Build the request to send to the server.
     request.setUserId(getuid());
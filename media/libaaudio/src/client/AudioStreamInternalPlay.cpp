@@ -43,10 +43,13 @@ constexpr int kRampMSec = 10; // time to apply a change in volume
 aaudio_result_t AudioStreamInternalPlay::open(const AudioStreamBuilder &builder) {
     aaudio_result_t result = AudioStreamInternal::open(builder);
     if (result == AAUDIO_OK) {
+        // The MMAP stream is opened at the rate of the app, so there is no rate conversion.
         result = mFlowGraph.configure(getFormat(),
                              getSamplesPerFrame(),
+                             getSampleRate(),
                              getDeviceFormat(),
-                             getDeviceChannelCount());
+                             getDeviceChannelCount(),
+                             getSampleRate());
 
         if (result != AAUDIO_OK) {
             close();
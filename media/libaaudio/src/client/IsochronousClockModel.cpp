@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
 
 #include "utility/AudioClock.h"
 #include "IsochronousClockModel.h"
@@ -49,12 +50,16 @@ void IsochronousClockModel::start(int64_t nanoTime) {
     ALOGV("start(nanos = %lld)\n", (long long) nanoTime);
     mMarkerNanoTime = nanoTime;
     mState = STATE_STARTING;
+    mLatenessCount = 0;
+    mLatenessMeanNanos = 0.0;
+    mLatenessVarianceNanos2 = 0.0;
 }
 
 void IsochronousClockModel::stop(int64_t nanoTime) {
-    ALOGD("stop(nanos = %lld) max lateness = %d micros\n",
+    ALOGD("stop(nanos = %lld) max lateness = %d micros, bound = %d micros\n",
         (long long) nanoTime,
-        (int) (mMaxMeasuredLatenessNanos / 1000));
+        (int) (mMaxMeasuredLatenessNanos / 1000),
+        (int) (getLatenessBoundNanos() / 1000));
     setPositionAndTime(convertTimeToPosition(nanoTime), nanoTime);
     // TODO should we set position?
     mState = STATE_STOPPED;
@@ -117,6 +122,8 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
                 //__func__, mTimestampCount, expectedMicrosDelta - microsDelta);
 
             setPositionAndTime(framePosition, nanoTime);
+            // The new marker makes this timestamp exactly on time.
+            updateLatenessStatistics(0);
         } else if (nanosDelta > (expectedNanosDelta + (2 * mBurstPeriodNanos))) {
             // In this case we do not update mMaxMeasuredLatenessNanos because it
             // would force it too high.
@@ -133,6 +140,7 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
             // This typically happens when we are modelling a service instead of a DSP.
             setPositionAndTime(framePosition,  nanoTime - (2 * mBurstPeriodNanos));
         } else if (nanosDelta > (expectedNanosDelta + mMaxMeasuredLatenessNanos)) {
+            updateLatenessStatistics(nanosDelta - expectedNanosDelta);
             //int32_t previousLatenessNanos = mMaxMeasuredLatenessNanos;
             mMaxMeasuredLatenessNanos = (int32_t)(nanosDelta - expectedNanosDelta);
 
@@ -159,6 +167,8 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
                   //__func__,
                   //mTimestampCount,
                   //(int) (mMaxMeasuredLatenessNanos / 1000));
+        } else {
+            updateLatenessStatistics(nanosDelta - expectedNanosDelta);
         }
         break;
     default:
@@ -226,10 +236,31 @@ int64_t IsochronousClockModel::convertTimeToPosition(int64_t nanoTime) const {
     return position;
 }
 
+// Exponentially weighted mean and variance of the lateness.
+// The first timestamps are weighted equally so the statistics settle quickly.
+void IsochronousClockModel::updateLatenessStatistics(int64_t latenessNanos) {
+    mLatenessCount++;
+    const double weight = std::max(1.0 / mLatenessCount, kLatenessSmoothing);
+    const double deviation = latenessNanos - mLatenessMeanNanos;
+    mLatenessMeanNanos += weight * deviation;
+    mLatenessVarianceNanos2 = (1.0 - weight)
+            * (mLatenessVarianceNanos2 + weight * deviation * deviation);
+}
+
+int32_t IsochronousClockModel::getLatenessBoundNanos() const {
+    if (mLatenessCount < kMinLatenessCount) {
+        return mMaxMeasuredLatenessNanos;
+    }
+    const double boundNanos = mLatenessMeanNanos
+            + kLatenessDeviations * std::sqrt(mLatenessVarianceNanos2);
+    // The maximum lateness is a bound that we have already measured.
+    return std::min((int32_t) boundNanos, mMaxMeasuredLatenessNanos);
+}
+
 int32_t IsochronousClockModel::getLateTimeOffsetNanos() const {
-    // This will never be < 0 because mMaxLatenessNanos starts at
-    // mBurstPeriodNanos and only gets bigger.
-    return (mMaxMeasuredLatenessNanos - mBurstPeriodNanos) + kExtraLatenessNanos;
+    // Timestamps may be late by up to a burst without any extra latency,
+    // so only the lateness beyond a burst is added.
+    return std::max(0, getLatenessBoundNanos() - mBurstPeriodNanos) + kExtraLatenessNanos;
 }
 
 int64_t IsochronousClockModel::convertPositionToLatestTime(int64_t framePosition) const {
@@ -246,5 +277,8 @@ void IsochronousClockModel::dump() const {
     ALOGD("mSampleRate          = %6d", mSampleRate);
     ALOGD("mFramesPerBurst      = %6d", mFramesPerBurst);
     ALOGD("mMaxMeasuredLatenessNanos = %6d", mMaxMeasuredLatenessNanos);
+    ALOGD("mLatenessMeanNanos   = %6d", (int) mLatenessMeanNanos);
+    ALOGD("lateness deviation   = %6d", (int) std::sqrt(mLatenessVarianceNanos2));
+    ALOGD("getLatenessBoundNanos() = %6d", getLatenessBoundNanos());
     ALOGD("mState               = %6d", mState);
 }
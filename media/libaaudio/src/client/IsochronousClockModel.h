@@ -120,11 +120,22 @@ public:
      */
     int64_t convertDeltaTimeToPosition(int64_t nanosDelta) const;
 
+    /**
+     * Upper bound of the lateness of a timestamp, relative to the model.
+     * Once enough timestamps have been received this is a statistical bound, from the mean
+     * and the deviation of the recent lateness. It is never more than the maximum lateness,
+     * which one late timestamp can push up for the rest of the stream.
+     *
+     * @return lateness in nanoseconds
+     */
+    int32_t getLatenessBoundNanos() const;
+
     void dump() const;
 
 private:
 
     int32_t getLateTimeOffsetNanos() const;
+    void updateLatenessStatistics(int64_t latenessNanos);
 
     enum clock_model_state_t {
         STATE_STOPPED,
@@ -138,6 +149,12 @@ private:
     static constexpr int32_t   kDriftNanos         =  10 * 1000;
     // TODO review value of kExtraLatenessNanos
     static constexpr int32_t   kExtraLatenessNanos = 100 * 1000;
+    // Timestamps needed before the lateness statistics are used.
+    static constexpr int32_t   kMinLatenessCount   = 32;
+    // Weight of a new timestamp in the lateness statistics, after the first ones.
+    static constexpr double    kLatenessSmoothing  = 1.0 / 128;
+    // Width of the lateness bound, in standard deviations.
+    static constexpr double    kLatenessDeviations = 3.0;
 
     int64_t             mMarkerFramePosition;
     int64_t             mMarkerNanoTime;
@@ -150,6 +167,11 @@ private:
 
     int32_t             mTimestampCount = 0;
 
+    // Exponentially weighted statistics of the timestamp lateness while running.
+    int32_t             mLatenessCount = 0;
+    double              mLatenessMeanNanos = 0.0;
+    double              mLatenessVarianceNanos2 = 0.0; // in nanoseconds squared
+
     void update();
 };
 
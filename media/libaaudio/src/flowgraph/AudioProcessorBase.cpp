@@ -77,6 +77,9 @@ float *AudioFloatInputPort::getBlock() {
 /***************************************************************************/
 int32_t AudioSink::pull(int32_t numFrames) {
     int32_t actualFrames = input.pullData(mFramePosition, numFrames);
-    mFramePosition += actualFrames;
+    // Always move forward, even if nothing was read, otherwise the next pull would be
+    // ignored by the upstream nodes. That happens with a SampleRateConverter that has
+    // consumed all of its input.
+    mFramePosition += std::max(actualFrames, 1);
     return actualFrames;
 }
\ No newline at end of file
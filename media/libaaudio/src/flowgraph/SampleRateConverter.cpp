@@ -0,0 +1,229 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SampleRateConverter"
+//#define LOG_NDEBUG 0
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <math.h>
+#include <unistd.h>
+#include "AudioProcessorBase.h"
+#include "SampleRateConverter.h"
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON (true)
+#else
+#define USE_NEON (false)
+#endif
+
+using namespace flowgraph;
+
+namespace {
+
+struct QualityParameters {
+    int32_t numTaps;     // must be a multiple of 8 for the SIMD loop
+    float   cutoffScale; // fraction of the lower Nyquist frequency kept in the passband
+    float   kaiserBeta;
+};
+
+QualityParameters getQualityParameters(SampleRateConverter::Quality quality) {
+    switch (quality) {
+        case SampleRateConverter::Quality::Low:
+            return {8, 0.80f, 4.0f};
+        case SampleRateConverter::Quality::High:
+            return {32, 0.92f, 8.0f};
+        case SampleRateConverter::Quality::Medium:
+        default:
+            return {16, 0.88f, 6.0f};
+    }
+}
+
+int32_t greatestCommonDivisor(int32_t a, int32_t b) {
+    while (b != 0) {
+        int32_t remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+// Zeroth order modified Bessel function of the first kind, used by the Kaiser window.
+double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    const double halfXSquared = x * x / 4.0;
+    for (int k = 1; k < 32; k++) {
+        term *= halfXSquared / (k * k);
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// numSamples must be a multiple of 8.
+inline float dotProduct(const float *signal, const float *coefficients, int32_t numSamples) {
+#if USE_NEON
+    float32x4_t accumulator0 = vdupq_n_f32(0.0f);
+    float32x4_t accumulator1 = vdupq_n_f32(0.0f);
+    for (int32_t i = 0; i < numSamples; i += 8) {
+        accumulator0 = vmlaq_f32(accumulator0, vld1q_f32(signal + i),
+                                 vld1q_f32(coefficients + i));
+        accumulator1 = vmlaq_f32(accumulator1, vld1q_f32(signal + i + 4),
+                                 vld1q_f32(coefficients + i + 4));
+    }
+    float32x4_t sum4 = vaddq_f32(accumulator0, accumulator1);
+    float32x2_t sum2 = vadd_f32(vget_low_f32(sum4), vget_high_f32(sum4));
+    return vget_lane_f32(vpadd_f32(sum2, sum2), 0);
+#else
+    // Independent accumulators let the compiler vectorize the loop.
+    float sum[4] = {};
+    for (int32_t i = 0; i < numSamples; i += 4) {
+        sum[0] += signal[i] * coefficients[i];
+        sum[1] += signal[i + 1] * coefficients[i + 1];
+        sum[2] += signal[i + 2] * coefficients[i + 2];
+        sum[3] += signal[i + 3] * coefficients[i + 3];
+    }
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+#endif
+}
+
+} // namespace
+
+SampleRateConverter::SampleRateConverter(int32_t channelCount,
+                                         int32_t inputSampleRate,
+                                         int32_t outputSampleRate,
+                                         Quality quality)
+        : input(*this, channelCount)
+        , output(*this, channelCount)
+        , mChannelCount(channelCount)
+        , mNumTaps(getQualityParameters(quality).numTaps)
+        , mHistory(2 * channelCount * getQualityParameters(quality).numTaps, 0.0f) {
+    if (inputSampleRate <= 0 || outputSampleRate <= 0) {
+        ALOGE("%s() invalid rates %d => %d", __func__, inputSampleRate, outputSampleRate);
+        return;
+    }
+    const int32_t divisor = greatestCommonDivisor(inputSampleRate, outputSampleRate);
+    mNumPhases = outputSampleRate / divisor;
+    mPhaseIncrement = inputSampleRate / divisor;
+    if (mNumPhases > kMaxPhases) {
+        ALOGE("%s() ratio %d/%d needs too many phases", __func__,
+              outputSampleRate, inputSampleRate);
+        return;
+    }
+    // The first output frame needs the first input frame.
+    mFramesToAdvance = 1;
+
+    // Attenuate above the lower of the two Nyquist frequencies to prevent aliasing.
+    const QualityParameters parameters = getQualityParameters(quality);
+    const float ratio = std::min(1.0f, (float) mNumPhases / mPhaseIncrement);
+    generateCoefficients(0.5f * ratio * parameters.cutoffScale, parameters.kaiserBeta);
+    ALOGV("%s() %d => %d Hz, %d phases, %d taps", __func__,
+          inputSampleRate, outputSampleRate, mNumPhases, mNumTaps);
+}
+
+void SampleRateConverter::generateCoefficients(float cutoff, float beta) {
+    mCoefficients.resize(mNumPhases * mNumTaps);
+    const int32_t halfTaps = mNumTaps / 2;
+    const double besselBeta = besselI0(beta);
+    for (int32_t phase = 0; phase < mNumPhases; phase++) {
+        const double fraction = (double) phase / mNumPhases;
+        float *coefficients = &mCoefficients[phase * mNumTaps];
+        double sum = 0.0;
+        for (int32_t tap = 0; tap < mNumTaps; tap++) {
+            // Distance, in input frames, between this tap and the output frame.
+            const double x = tap - halfTaps + 1 - fraction;
+            const double sinc = (x == 0.0)
+                    ? 2.0 * cutoff
+                    : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+            const double windowPosition = x / halfTaps;
+            const double window = (fabs(windowPosition) >= 1.0)
+                    ? 0.0
+                    : besselI0(beta * sqrt(1.0 - windowPosition * windowPosition)) / besselBeta;
+            const double coefficient = sinc * window;
+            coefficients[tap] = (float) coefficient;
+            sum += coefficient;
+        }
+        // Normalize each phase for unity gain at DC.
+        for (int32_t tap = 0; tap < mNumTaps; tap++) {
+            coefficients[tap] = (float) (coefficients[tap] / sum);
+        }
+    }
+}
+
+bool SampleRateConverter::readNextInputFrame() {
+    if (mInputCursor >= mInputFramesValid) {
+        mInputFramesValid = input.pullData(mInputFramePosition, input.getFramesPerBlock());
+        // Always move forward so that the next pull is not ignored,
+        // even if no frames were available this time.
+        mInputFramePosition += std::max(mInputFramesValid, 1);
+        mInputCursor = 0;
+        if (mInputFramesValid <= 0) {
+            mInputFramesValid = 0;
+            return false;
+        }
+    }
+    const float *frame = input.getBlock() + mInputCursor * mChannelCount;
+    mInputCursor++;
+
+    float *history = mHistory.data();
+    for (int32_t channel = 0; channel < mChannelCount; channel++) {
+        history[mHistoryCursor] = frame[channel];
+        history[mHistoryCursor + mNumTaps] = frame[channel];
+        history += 2 * mNumTaps;
+    }
+    if (++mHistoryCursor >= mNumTaps) {
+        mHistoryCursor = 0;
+    }
+    return true;
+}
+
+int32_t SampleRateConverter::onProcess(int64_t framePosition, int32_t numFrames) {
+    float *outputBuffer = output.getBlock();
+    numFrames = std::min(numFrames, output.getFramesPerBlock());
+
+    if (!isValid()) {
+        memset(outputBuffer, 0, numFrames * mChannelCount * sizeof(float));
+        return numFrames;
+    }
+
+    int32_t framesProcessed = 0;
+    while (framesProcessed < numFrames) {
+        // Consume the input frames that precede the next output frame.
+        while (mFramesToAdvance > 0 && readNextInputFrame()) {
+            mFramesToAdvance--;
+        }
+        if (mFramesToAdvance > 0) {
+            break; // wait for more input
+        }
+
+        const float *coefficients = &mCoefficients[mPhase * mNumTaps];
+        const float *history = &mHistory[mHistoryCursor];
+        for (int32_t channel = 0; channel < mChannelCount; channel++) {
+            *outputBuffer++ = dotProduct(history, coefficients, mNumTaps);
+            history += 2 * mNumTaps;
+        }
+
+        mPhase += mPhaseIncrement;
+        mFramesToAdvance = mPhase / mNumPhases;
+        mPhase -= mFramesToAdvance * mNumPhases;
+        framesProcessed++;
+    }
+    return framesProcessed;
+}
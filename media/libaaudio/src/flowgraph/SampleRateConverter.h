@@ -0,0 +1,102 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FLOWGRAPH_SAMPLE_RATE_CONVERTER_H
+#define FLOWGRAPH_SAMPLE_RATE_CONVERTER_H
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <vector>
+
+#include "AudioProcessorBase.h"
+
+namespace flowgraph {
+
+/**
+ * Convert the sample rate using a polyphase windowed sinc filter.
+ *
+ * The ratio between the two rates is reduced to a fraction L/M and one set of
+ * filter coefficients is precomputed for each of the L phases.
+ * So the conversion is exact and no coefficient is interpolated at run time.
+ *
+ * The filter is short so that the added latency stays low.
+ * It is half the number of taps, at the input rate.
+ */
+class SampleRateConverter : public AudioProcessorBase {
+public:
+    enum class Quality {
+        Low,    // 8 taps
+        Medium, // 16 taps
+        High,   // 32 taps
+    };
+
+    /** Highest number of phases L, which bounds the memory used by the coefficients. */
+    static constexpr int32_t kMaxPhases = 1024;
+
+    SampleRateConverter(int32_t channelCount,
+                        int32_t inputSampleRate,
+                        int32_t outputSampleRate,
+                        Quality quality = Quality::Medium);
+
+    virtual ~SampleRateConverter() = default;
+
+    /**
+     * @return false if the ratio between the rates needs more than kMaxPhases phases,
+     *         in which case the converter outputs silence.
+     */
+    bool isValid() const {
+        return !mCoefficients.empty();
+    }
+
+    int32_t getNumTaps() const {
+        return mNumTaps;
+    }
+
+    int32_t onProcess(int64_t framePosition, int32_t numFrames) override;
+
+    AudioFloatInputPort input;
+    AudioFloatOutputPort output;
+
+private:
+    void generateCoefficients(float cutoff, float beta);
+
+    /** Read the next input frame into the history.
+     * @return false if no more input is available for now
+     */
+    bool readNextInputFrame();
+
+    const int32_t       mChannelCount;
+    const int32_t       mNumTaps;
+
+    int32_t             mNumPhases = 0;    // L, the output rate in units of the common divisor
+    int32_t             mPhaseIncrement = 0; // M, the input rate in units of the common divisor
+    int32_t             mPhase = 0;        // in [0, L)
+    int32_t             mFramesToAdvance = 0; // input frames to read before the next output
+
+    std::vector<float>  mCoefficients;     // mNumTaps coefficients per phase
+    // Per channel history of the last mNumTaps input frames, stored twice so that
+    // the window of mNumTaps samples is always contiguous.
+    std::vector<float>  mHistory;
+    int32_t             mHistoryCursor = 0;
+
+    int64_t             mInputFramePosition = 0;
+    int32_t             mInputFramesValid = 0;
+    int32_t             mInputCursor = 0;
+};
+
+} /* namespace flowgraph */
+
+#endif //FLOWGRAPH_SAMPLE_RATE_CONVERTER_H
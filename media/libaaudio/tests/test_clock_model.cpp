@@ -163,4 +163,47 @@ TEST_F(ClockModelTestFixture, clock_slow_drift) {
 
 TEST_F(ClockModelTestFixture, clock_fast_drift) {
     checkDriftingClock(1.002 * SAMPLE_RATE, NUM_LOOPS_DRIFT);
-}
\ No newline at end of file
+}
+// A single late timestamp, e.g. from preemption, should not widen the lateness bound
+// for the rest of the stream, but the bound should still cover the normal jitter.
+TEST_F(ClockModelTestFixture, clock_lateness_bound) {
+    const int64_t startTimeNanos = 500000000; // arbitrary
+    model.start(startTimeNanos);
+    EXPECT_EQ(NANOS_PER_BURST, model.getLatenessBoundNanos());
+
+    int64_t position = HW_FRAMES_PER_BURST;
+    int64_t burstTimeNanos = startTimeNanos + NANOS_PER_MILLISECOND;
+    model.processTimestamp(position, burstTimeNanos);
+
+    // The timestamp is read at a random time after the DSP position was updated.
+    auto sendTimestamps = [&](int numTimestamps, int64_t extraLatenessNanos) {
+        int numCovered = 0;
+        for (int i = 0; i < numTimestamps; i++) {
+            position += HW_FRAMES_PER_BURST;
+            burstTimeNanos += NANOS_PER_BURST;
+            const int64_t latenessNanos = (int64_t)(drand48() * NANOS_PER_BURST)
+                    + extraLatenessNanos;
+            if (latenessNanos <= model.getLatenessBoundNanos()) {
+                numCovered++;
+            }
+            model.processTimestamp(position, burstTimeNanos + latenessNanos);
+        }
+        return numCovered;
+    };
+
+    sendTimestamps(1000, 0);
+    const int32_t jitterBoundNanos = model.getLatenessBoundNanos();
+    EXPECT_LE(jitterBoundNanos, NANOS_PER_BURST);
+    EXPECT_GT(jitterBoundNanos, NANOS_PER_BURST / 2);
+
+    // One preempted timestamp.
+    sendTimestamps(1, NANOS_PER_BURST * 8 / 10);
+    const int32_t boundAfterPreemption = model.getLatenessBoundNanos();
+    EXPECT_LT(boundAfterPreemption, NANOS_PER_BURST * 15 / 10);
+
+    // The bound still holds for almost every timestamp that follows.
+    const int numTimestamps = 10000;
+    const int numCovered = sendTimestamps(numTimestamps, 0);
+    EXPECT_GE(numCovered, numTimestamps * 99 / 100);
+    EXPECT_LT(model.getLatenessBoundNanos(), NANOS_PER_BURST * 15 / 10);
+}
@@ -18,14 +18,19 @@
  * Test FlowGraph
  */
 
+#include <chrono>
 #include <iostream>
+#include <math.h>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#include "client/AAudioFlowGraph.h"
 #include "flowgraph/ClipToRange.h"
 #include "flowgraph/MonoToMultiConverter.h"
 #include "flowgraph/SourceFloat.h"
 #include "flowgraph/RampLinear.h"
+#include "flowgraph/SampleRateConverter.h"
 #include "flowgraph/SinkFloat.h"
 #include "flowgraph/SinkI16.h"
 #include "flowgraph/SinkI24.h"
@@ -155,3 +160,148 @@ TEST(test_flowgraph, module_clip_to_range) {
         EXPECT_NEAR(expected[i], output[i], tolerance);
     }
 }
+
+TEST(test_flowgraph, module_sample_rate_converter_dc) {
+    constexpr int inputRate = 44100;
+    constexpr int outputRate = 48000;
+    constexpr int numInputFrames = 1000;
+    constexpr float value = 0.5f;
+    std::vector<float> input(numInputFrames, value);
+    std::vector<float> output(numInputFrames * 2);
+    SourceFloat sourceFloat{1};
+    SampleRateConverter converter{1, inputRate, outputRate};
+    SinkFloat sinkFloat{1};
+    ASSERT_TRUE(converter.isValid());
+
+    sourceFloat.setData(input.data(), numInputFrames);
+    sourceFloat.output.connect(&converter.input);
+    converter.output.connect(&sinkFloat.input);
+
+    int32_t numRead = sinkFloat.read(output.data(), output.size());
+    const int expectedFrames = (int64_t) numInputFrames * outputRate / inputRate;
+    EXPECT_NEAR(expectedFrames, numRead, 1);
+
+    // Skip the filter startup, the gain is one at DC.
+    constexpr float tolerance = 0.001f; // arbitrary
+    for (int i = converter.getNumTaps() * 2; i < numRead; i++) {
+        EXPECT_NEAR(value, output[i], tolerance);
+    }
+}
+
+TEST(test_flowgraph, module_sample_rate_converter_sine) {
+    constexpr int inputRate = 48000;
+    constexpr int outputRate = 44100;
+    constexpr int numInputFrames = inputRate / 10;
+    constexpr float frequency = 1000.0f;
+    constexpr float amplitude = 0.5f;
+    std::vector<float> input(numInputFrames * 2);
+    for (int i = 0; i < numInputFrames; i++) {
+        float sample = amplitude * sinf(2.0f * M_PI * frequency * i / inputRate);
+        input[2 * i] = sample;
+        input[2 * i + 1] = -sample;
+    }
+    std::vector<float> output(numInputFrames * 2);
+    SourceFloat sourceFloat{2};
+    SampleRateConverter converter{2, inputRate, outputRate,
+                                  SampleRateConverter::Quality::High};
+    SinkFloat sinkFloat{2};
+
+    sourceFloat.setData(input.data(), numInputFrames);
+    sourceFloat.output.connect(&converter.input);
+    converter.output.connect(&sinkFloat.input);
+
+    int32_t numRead = sinkFloat.read(output.data(), numInputFrames);
+    ASSERT_GT(numRead, converter.getNumTaps() * 2);
+
+    // The tone must keep its level and its frequency at the new rate.
+    int crossings = 0;
+    double sumSquares = 0.0;
+    const int first = converter.getNumTaps() * 2;
+    for (int i = first; i < numRead; i++) {
+        float left = output[2 * i];
+        EXPECT_NEAR(-left, output[2 * i + 1], 0.000001f);
+        sumSquares += left * left;
+        if (i > first && (left >= 0.0f) != (output[2 * (i - 1)] >= 0.0f)) {
+            crossings++;
+        }
+    }
+    const int numFrames = numRead - first;
+    EXPECT_NEAR(amplitude / sqrt(2.0), sqrt(sumSquares / numFrames), 0.01);
+    const float expectedCrossings = 2.0f * frequency * numFrames / outputRate;
+    EXPECT_NEAR(expectedCrossings, crossings, 2);
+}
+
+TEST(test_flowgraph, module_sample_rate_converter_invalid_ratio) {
+    SampleRateConverter converter{1, 48000, 47999};
+    EXPECT_FALSE(converter.isValid());
+}
+
+// The AAudio graph converts the rate in blocks, carrying the filter state across them.
+TEST(test_flowgraph, flowgraph_sample_rate_conversion) {
+    constexpr int inputRate = 44100;
+    constexpr int outputRate = 48000;
+    constexpr int framesPerBlock = inputRate / 100; // 10 msec
+    constexpr int numBlocks = 10;
+    constexpr int16_t value = 16384; // 0.5
+    AAudioFlowGraph flowGraph;
+    ASSERT_EQ(AAUDIO_OK, flowGraph.configure(AUDIO_FORMAT_PCM_16_BIT, 1, inputRate,
+                                             AUDIO_FORMAT_PCM_FLOAT, 2, outputRate));
+    flowGraph.setRampLengthInFrames(1);
+
+    std::vector<int16_t> input(framesPerBlock, value);
+    std::vector<float> output;
+    for (int block = 0; block < numBlocks; block++) {
+        // room for more than the block converts to, so all of it is used
+        std::vector<float> buffer(framesPerBlock * 2 * 2);
+        int32_t numWritten = flowGraph.process(input.data(), framesPerBlock,
+                                               buffer.data(), framesPerBlock * 2);
+        ASSERT_GT(numWritten, 0);
+        output.insert(output.end(), buffer.begin(), buffer.begin() + numWritten * 2);
+    }
+    const int numFrames = output.size() / 2;
+    EXPECT_NEAR(numBlocks * framesPerBlock * outputRate / inputRate, numFrames, 1);
+
+    constexpr float tolerance = 0.001f; // arbitrary
+    for (int i = 64; i < numFrames; i++) { // after the ramp and the filter startup
+        EXPECT_NEAR(0.5f, output[2 * i], tolerance);
+        EXPECT_EQ(output[2 * i], output[2 * i + 1]);
+    }
+}
+
+TEST(test_flowgraph, flowgraph_invalid_sample_rate_conversion) {
+    AAudioFlowGraph flowGraph;
+    EXPECT_EQ(AAUDIO_ERROR_UNIMPLEMENTED,
+              flowGraph.configure(AUDIO_FORMAT_PCM_FLOAT, 2, 48000,
+                                  AUDIO_FORMAT_PCM_FLOAT, 2, 47999));
+}
+
+// Measure the CPU cost per output frame for each quality.
+TEST(test_flowgraph, module_sample_rate_converter_benchmark) {
+    constexpr int channelCount = 2;
+    constexpr int inputRate = 44100;
+    constexpr int outputRate = 48000;
+    constexpr int numInputFrames = inputRate; // one second
+    std::vector<float> input(numInputFrames * channelCount, 0.25f);
+    std::vector<float> output(numInputFrames * channelCount * 2);
+
+    for (auto quality : {SampleRateConverter::Quality::Low,
+                         SampleRateConverter::Quality::Medium,
+                         SampleRateConverter::Quality::High}) {
+        SourceFloat sourceFloat{channelCount};
+        SampleRateConverter converter{channelCount, inputRate, outputRate, quality};
+        SinkFloat sinkFloat{channelCount};
+        sourceFloat.output.connect(&converter.input);
+        converter.output.connect(&sinkFloat.input);
+        sourceFloat.setData(input.data(), numInputFrames);
+
+        auto start = std::chrono::steady_clock::now();
+        int32_t numRead = sinkFloat.read(output.data(), output.size() / channelCount);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        ASSERT_GT(numRead, 0);
+        const double nanosPerFrame =
+                std::chrono::duration<double, std::nano>(elapsed).count() / numRead;
+        std::cout << "SampleRateConverter " << converter.getNumTaps() << " taps, "
+                  << channelCount << " channels: " << nanosPerFrame << " ns per frame"
+                  << std::endl;
+    }
+}
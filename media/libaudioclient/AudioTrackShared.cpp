@@ -22,8 +22,11 @@
 #include <utils/Log.h>
 #include <audio_utils/safe_math.h>
 
+#include <algorithm>
+
 #include <linux/futex.h>
 #include <sys/syscall.h>
+#include <time.h>
 
 namespace android {
 
@@ -33,6 +36,15 @@ size_t clampToSize(T x) {
     return sizeof(T) > sizeof(size_t) && x > (T) SIZE_MAX ? SIZE_MAX : x < 0 ? 0 : (size_t) x;
 }
 
+// Low 32 bits of CLOCK_MONOTONIC in microseconds, for the wake latency shared by
+// client and server.  Differences are valid for about an hour.
+static uint32_t monotonicMicros()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) ((int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
 // incrementSequence is used to determine the next sequence value
 // for the loop and position sequence counters.  It should return
 // a value between "other" + 1 and "other" + INT32_MAX, the choice of
@@ -49,6 +61,7 @@ static uint32_t incrementSequence(uint32_t self, uint32_t other) {
 
 audio_track_cblk_t::audio_track_cblk_t()
     : mServer(0), mFutex(0), mMinimum(0)
+    , mWakeTarget(0), mWakeTimeUs(0), mWakeLatencyUs(0)
     , mVolumeLR(GAIN_MINIFLOAT_PACKED_UNITY), mSampleRate(0), mSendLevel(0)
     , mBufferSizeInFrames(0)
     , mFlags(0)
@@ -73,6 +86,7 @@ ClientProxy::ClientProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCo
     : Proxy(cblk, buffers, frameCount, frameSize, isOut, clientInServer)
     , mEpoch(0)
     , mTimestampObserver(&cblk->mExtendedTimestampQueue)
+    , mWakeLatencyUs(0)
 {
     setBufferSizeInFrames(frameCount);
 }
@@ -273,6 +287,9 @@ status_t ClientProxy::obtainBuffer(Buffer* buffer, const struct timespec *reques
             ts = NULL;
             break;
         }
+        // Let the server skip wakes that would not give us the frames we asked for.
+        // The store is ordered before the clearing of CBLK_FUTEX_WAKE.
+        cblk->mWakeTarget = (uint32_t) std::min(buffer->mFrameCount, (size_t) UINT32_MAX);
         int32_t old = android_atomic_and(~CBLK_FUTEX_WAKE, &cblk->mFutex);
         if (!(old & CBLK_FUTEX_WAKE)) {
             if (measure && !beforeIsValid) {
@@ -301,6 +318,19 @@ status_t ClientProxy::obtainBuffer(Buffer* buffer, const struct timespec *reques
                 before = after;
                 beforeIsValid = true;
             }
+            // binderDied() and interrupt() do not set a wake time,
+            // and a wake that raced with our wait is not a latency sample
+            const uint32_t wakeTimeUs = cblk->mWakeTimeUs;
+            if (wakeTimeUs != 0) {
+                cblk->mWakeTimeUs = 0;
+                if (error == 0) {
+                    const uint32_t latencyUs = monotonicMicros() - wakeTimeUs;
+                    if (latencyUs < 1000000) {
+                        mWakeLatencyUs = (mWakeLatencyUs * 7 + latencyUs) / 8;
+                        cblk->mWakeLatencyUs = mWakeLatencyUs;
+                    }
+                }
+            }
             switch (error) {
             case 0:            // normal wakeup by server, or by binderDied()
             case EWOULDBLOCK:  // benign race condition with server
@@ -661,6 +691,7 @@ ServerProxy::ServerProxy(audio_track_cblk_t* cblk, void *buffers, size_t frameCo
     : Proxy(cblk, buffers, frameCount, frameSize, isOut, clientInServer),
       mAvailToClient(0), mFlush(0), mReleased(0), mFlushed(0)
     , mTimestampMutator(&cblk->mExtendedTimestampQueue)
+    , mWakeCount(0), mWakeWindowCount(0), mWakeWindowStartNs(0), mWakesPerSecond(0.)
 {
     cblk->mBufferSizeInFrames = frameCount;
 }
@@ -706,11 +737,7 @@ void ServerProxy::flushBufferIfNeeded()
         android_atomic_release_store(newFront, &cblk->u.mStreaming.mFront);
         // There is no danger from a false positive, so err on the side of caution
         if (true /*front != newFront*/) {
-            int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
-            if (!(old & CBLK_FUTEX_WAKE)) {
-                (void) syscall(__NR_futex, &cblk->mFutex,
-                        mClientInServer ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE, 1);
-            }
+            wakeClient();
         }
         mFlushed += (newFront - front) & mask;
     }
@@ -867,20 +894,26 @@ void ServerProxy::releaseBuffer(Buffer* buffer)
     if (half == 0) {
         half = 1;
     }
-    size_t minimum = (size_t) cblk->mMinimum;
-    if (minimum == 0) {
-        minimum = mIsOut ? half : 1;
-    } else if (minimum > half) {
-        minimum = half;
+    // AudioRecord does not use the notification threshold, only the wake target below
+    size_t minimum = 1;
+    if (mIsOut) {
+        minimum = (size_t) cblk->mMinimum;
+        if (minimum == 0) {
+            minimum = half;
+        } else if (minimum > half) {
+            minimum = half;
+        }
+    }
+    // A waiting client that asked for more frames would only take them and wait again,
+    // so defer the wake until its target is reached.  A stale target from a previous wait
+    // only delays the wake until half the buffer is available.
+    const size_t target = std::min((size_t) cblk->mWakeTarget, half);
+    if (target > minimum) {
+        minimum = target;
     }
-    // FIXME AudioRecord wakeup needs to be optimized; it currently wakes up client every time
-    if (!mIsOut || (mAvailToClient + stepCount >= minimum)) {
+    if (mAvailToClient + stepCount >= minimum) {
         ALOGV("mAvailToClient=%zu stepCount=%zu minimum=%zu", mAvailToClient, stepCount, minimum);
-        int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
-        if (!(old & CBLK_FUTEX_WAKE)) {
-            (void) syscall(__NR_futex, &cblk->mFutex,
-                    mClientInServer ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE, 1);
-        }
+        wakeClient();
     }
 
     buffer->mFrameCount = 0;
@@ -888,6 +921,33 @@ void ServerProxy::releaseBuffer(Buffer* buffer)
     buffer->mNonContig = 0;
 }
 
+void ServerProxy::wakeClient()
+{
+    audio_track_cblk_t* cblk = mCblk;
+    int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
+    if (!(old & CBLK_FUTEX_WAKE)) {
+        // the client measures its wake latency from here
+        cblk->mWakeTimeUs = monotonicMicros();
+        (void) syscall(__NR_futex, &cblk->mFutex,
+                mClientInServer ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE, 1);
+
+        static constexpr int64_t kWakeRateWindowNs = 1000000000;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        const int64_t nowNs = (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+        mWakeCount++;
+        if (mWakeWindowStartNs == 0) {
+            mWakeWindowStartNs = nowNs;
+            mWakeWindowCount = mWakeCount;
+        } else if (nowNs - mWakeWindowStartNs >= kWakeRateWindowNs) {
+            mWakesPerSecond = (mWakeCount - mWakeWindowCount) * 1e9
+                    / (nowNs - mWakeWindowStartNs);
+            mWakeWindowStartNs = nowNs;
+            mWakeWindowCount = mWakeCount;
+        }
+    }
+}
+
 // ---------------------------------------------------------------------------
 
 __attribute__((no_sanitize("integer")))
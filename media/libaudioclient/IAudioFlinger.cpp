@@ -999,7 +999,7 @@ status_t BnAudioFlinger::onTransact(
     }
 
     std::string tag("IAudioFlinger command " + std::to_string(code));
-    TimeCheck check(tag.c_str());
+    TimeCheck check(tag.c_str(), "IAudioFlinger", code);
 
     switch (code) {
         case CREATE_TRACK: {
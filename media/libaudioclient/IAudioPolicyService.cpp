@@ -1384,7 +1384,7 @@ status_t BnAudioPolicyService::onTransact(
     }
 
     std::string tag("IAudioPolicyService command " + std::to_string(code));
-    TimeCheck check(tag.c_str());
+    TimeCheck check(tag.c_str(), "IAudioPolicyService", code);
 
     switch (code) {
         case SET_DEVICE_CONNECTION_STATE: {
@@ -26,9 +26,18 @@
 
 #include "EffectDownmix.h"
 
-// Do not submit with DOWNMIX_TEST_CHANNEL_INDEX defined, strictly for testing
-//#define DOWNMIX_TEST_CHANNEL_INDEX 0
-// Do not submit with DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER defined, strictly for testing
+#ifdef BUILD_FLOAT
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE
+#endif
+#endif
+
+// Do not submit with DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER defined, strictly for testing,
+// it uses the matrix downmix for the common formats instead of their optimized folds
 //#define DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER 0
 
 #ifdef BUILD_FLOAT
@@ -101,95 +110,20 @@ static LVM_FLOAT clamp_float(LVM_FLOAT a) {
     }
 }
 #endif
-/*----------------------------------------------------------------------------
- * Test code
- *--------------------------------------------------------------------------*/
-#ifdef DOWNMIX_TEST_CHANNEL_INDEX
-// strictly for testing, logs the indices of the channels for a given mask,
-// uses the same code as Downmix_foldGeneric()
-void Downmix_testIndexComputation(uint32_t mask) {
-    ALOGI("Testing index computation for 0x%" PRIx32 ":", mask);
-    // check against unsupported channels
-    if (mask & kUnsupported) {
-        ALOGE("Unsupported channels (top or front left/right of center)");
-        return;
-    }
-    // verify has FL/FR
-    if ((mask & AUDIO_CHANNEL_OUT_STEREO) != AUDIO_CHANNEL_OUT_STEREO) {
-        ALOGE("Front channels must be present");
-        return;
-    }
-    // verify uses SIDE as a pair (ok if not using SIDE at all)
-    bool hasSides = false;
-    if ((mask & kSides) != 0) {
-        if ((mask & kSides) != kSides) {
-            ALOGE("Side channels must be used as a pair");
-            return;
-        }
-        hasSides = true;
-    }
-    // verify uses BACK as a pair (ok if not using BACK at all)
-    bool hasBacks = false;
-    if ((mask & kBacks) != 0) {
-        if ((mask & kBacks) != kBacks) {
-            ALOGE("Back channels must be used as a pair");
-            return;
-        }
-        hasBacks = true;
-    }
-
-    const int numChan = audio_channel_count_from_out_mask(mask);
-    const bool hasFC = ((mask & AUDIO_CHANNEL_OUT_FRONT_CENTER) == AUDIO_CHANNEL_OUT_FRONT_CENTER);
-    const bool hasLFE =
-            ((mask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY) == AUDIO_CHANNEL_OUT_LOW_FREQUENCY);
-    const bool hasBC = ((mask & AUDIO_CHANNEL_OUT_BACK_CENTER) == AUDIO_CHANNEL_OUT_BACK_CENTER);
-    // compute at what index each channel is: samples will be in the following order:
-    //   FL FR FC LFE BL BR BC SL SR
-    // when a channel is not present, its index is set to the same as the index of the preceding
-    // channel
-    const int indexFC  = hasFC    ? 2            : 1;        // front center
-    const int indexLFE = hasLFE   ? indexFC + 1  : indexFC;  // low frequency
-    const int indexBL  = hasBacks ? indexLFE + 1 : indexLFE; // back left
-    const int indexBR  = hasBacks ? indexBL + 1  : indexBL;  // back right
-    const int indexBC  = hasBC    ? indexBR + 1  : indexBR;  // back center
-    const int indexSL  = hasSides ? indexBC + 1  : indexBC;  // side left
-    const int indexSR  = hasSides ? indexSL + 1  : indexSL;  // side right
-
-    ALOGI("  FL FR FC LFE BL BR BC SL SR");
-    ALOGI("   %d  %d  %d   %d  %d  %d  %d  %d  %d",
-            0, 1, indexFC, indexLFE, indexBL, indexBR, indexBC, indexSL, indexSR);
-}
-#endif
-
 static bool Downmix_validChannelMask(uint32_t mask)
 {
     if (!mask) {
         return false;
     }
-    // check against unsupported channels
-    if (mask & kUnsupported) {
-        ALOGE("Unsupported channels (top or front left/right of center)");
+    // check against channels without a downmix coefficient
+    if (mask & ~kSupported) {
+        ALOGE("Unsupported channels 0x%" PRIx32, mask & ~kSupported);
         return false;
     }
-    // verify has FL/FR
-    if ((mask & AUDIO_CHANNEL_OUT_STEREO) != AUDIO_CHANNEL_OUT_STEREO) {
-        ALOGE("Front channels must be present");
+    if (audio_channel_count_from_out_mask(mask) > DOWNMIX_MAX_CHANNELS) {
+        ALOGE("Too many channels in mask 0x%" PRIx32, mask);
         return false;
     }
-    // verify uses SIDE as a pair (ok if not using SIDE at all)
-    if ((mask & kSides) != 0) {
-        if ((mask & kSides) != kSides) {
-            ALOGE("Side channels must be used as a pair");
-            return false;
-        }
-    }
-    // verify uses BACK as a pair (ok if not using BACK at all)
-    if ((mask & kBacks) != 0) {
-        if ((mask & kBacks) != kBacks) {
-            ALOGE("Back channels must be used as a pair");
-            return false;
-        }
-    }
     return true;
 }
 
@@ -210,25 +144,6 @@ int32_t DownmixLib_Create(const effect_uuid_t *uuid,
 
     ALOGV("DownmixLib_Create()");
 
-#ifdef DOWNMIX_TEST_CHANNEL_INDEX
-    // should work (won't log an error)
-    ALOGI("DOWNMIX_TEST_CHANNEL_INDEX: should work:");
-    Downmix_testIndexComputation(AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_FRONT_RIGHT |
-                    AUDIO_CHANNEL_OUT_LOW_FREQUENCY | AUDIO_CHANNEL_OUT_BACK_CENTER);
-    Downmix_testIndexComputation(CHANNEL_MASK_QUAD_SIDE | CHANNEL_MASK_QUAD_BACK);
-    Downmix_testIndexComputation(CHANNEL_MASK_5POINT1_SIDE | AUDIO_CHANNEL_OUT_BACK_CENTER);
-    Downmix_testIndexComputation(CHANNEL_MASK_5POINT1_BACK | AUDIO_CHANNEL_OUT_BACK_CENTER);
-    // shouldn't work (will log an error, won't display channel indices)
-    ALOGI("DOWNMIX_TEST_CHANNEL_INDEX: should NOT work:");
-    Downmix_testIndexComputation(AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_FRONT_RIGHT |
-                        AUDIO_CHANNEL_OUT_LOW_FREQUENCY | AUDIO_CHANNEL_OUT_BACK_LEFT);
-    Downmix_testIndexComputation(AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_FRONT_RIGHT |
-                            AUDIO_CHANNEL_OUT_LOW_FREQUENCY | AUDIO_CHANNEL_OUT_SIDE_LEFT);
-    Downmix_testIndexComputation(AUDIO_CHANNEL_OUT_FRONT_LEFT |
-                        AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT);
-    Downmix_testIndexComputation(AUDIO_CHANNEL_OUT_FRONT_LEFT |
-                            AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT);
-#endif
 
     if (pHandle == NULL || uuid == NULL) {
         return -EINVAL;
@@ -366,11 +281,7 @@ static int Downmix_Process(effect_handle_t self,
       case DOWNMIX_TYPE_FOLD:
 #ifdef DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER
           // bypass the optimized downmix routines for the common formats
-          if (!Downmix_foldGeneric(
-                  downmixInputChannelMask, pSrc, pDst, numFrames, accumulate)) {
-              ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported", downmixInputChannelMask);
-              return -EINVAL;
-          }
+          Downmix_foldFromMatrix(pDownmixer, pSrc, pDst, numFrames, accumulate);
           break;
 #endif
         // optimize for the common formats
@@ -387,11 +298,8 @@ static int Downmix_Process(effect_handle_t self,
             Downmix_foldFrom7Point1(pSrc, pDst, numFrames, accumulate);
             break;
         default:
-            if (!Downmix_foldGeneric(
-                    downmixInputChannelMask, pSrc, pDst, numFrames, accumulate)) {
-                ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported", downmixInputChannelMask);
-                return -EINVAL;
-            }
+            // any other mask uses the coefficients computed when configuring
+            Downmix_foldFromMatrix(pDownmixer, pSrc, pDst, numFrames, accumulate);
             break;
         }
         break;
@@ -465,12 +373,7 @@ static int Downmix_Process(effect_handle_t self,
       case DOWNMIX_TYPE_FOLD:
 #ifdef DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER
           // bypass the optimized downmix routines for the common formats
-          if (!Downmix_foldGeneric(
-                  downmixInputChannelMask, pSrc, pDst, numFrames, accumulate)) {
-              ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported",
-                    downmixInputChannelMask);
-              return -EINVAL;
-          }
+          Downmix_foldFromMatrix(pDownmixer, pSrc, pDst, numFrames, accumulate);
           break;
 #endif
         // optimize for the common formats
@@ -487,12 +390,8 @@ static int Downmix_Process(effect_handle_t self,
             Downmix_foldFrom7Point1(pSrc, pDst, numFrames, accumulate);
             break;
         default:
-            if (!Downmix_foldGeneric(
-                    downmixInputChannelMask, pSrc, pDst, numFrames, accumulate)) {
-                ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported",
-                      downmixInputChannelMask);
-                return -EINVAL;
-            }
+            // any other mask uses the coefficients computed when configuring
+            Downmix_foldFromMatrix(pDownmixer, pSrc, pDst, numFrames, accumulate);
             break;
         }
         break;
@@ -770,6 +669,14 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
         return -EINVAL;
     }
 
+    // when configuring the effect, do not allow a blank or unsupported channel mask;
+    // checked before anything changes, so a rejected config leaves the effect as it was.
+    if (!init && !Downmix_validChannelMask(pConfig->inputCfg.channels)) {
+        ALOGE("Downmix_Configure error: input channel mask(0x%x) not supported",
+                                                    pConfig->inputCfg.channels);
+        return -EINVAL;
+    }
+
     if (&pDwmModule->config != pConfig) {
         memcpy(&pDwmModule->config, pConfig, sizeof(effect_config_t));
     }
@@ -779,15 +686,10 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
         pDownmixer->apply_volume_correction = false;
         pDownmixer->input_channel_count = 8; // matches default input of AUDIO_CHANNEL_OUT_7POINT1
     } else {
-        // when configuring the effect, do not allow a blank or unsupported channel mask
-        if (!Downmix_validChannelMask(pConfig->inputCfg.channels)) {
-            ALOGE("Downmix_Configure error: input channel mask(0x%x) not supported",
-                                                        pConfig->inputCfg.channels);
-            return -EINVAL;
-        }
         pDownmixer->input_channel_count =
                 audio_channel_count_from_out_mask(pConfig->inputCfg.channels);
     }
+    Downmix_computeMatrix(pConfig->inputCfg.channels, pDownmixer->matrix);
 
     Downmix_Reset(pDownmixer, init);
 
@@ -1220,19 +1122,96 @@ void Downmix_foldFrom7Point1(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames,
 }
 #endif
 /*----------------------------------------------------------------------------
- * Downmix_foldGeneric()
+ * Downmix_computeMatrix()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * compute the left and right gains of each channel of an input channel mask,
+ * ordered as the channels of the mask. The gains include the -6dB headroom
+ * applied by all folds, so the quad, 5.1 and 7.1 folds are special cases
+ * of the matrix for their mask.
+ *
+ * Inputs:
+ *  mask       the channel mask of the input, validated by Downmix_validChannelMask()
+ *
+ * Outputs:
+ *  matrix     interleaved left and right gains, 2 per input channel
+ *
+ *----------------------------------------------------------------------------
+ */
+#ifdef BUILD_FLOAT
+void Downmix_computeMatrix(uint32_t mask, LVM_FLOAT *matrix) {
+    const LVM_FLOAT kUnity = 0.5f;
+    const LVM_FLOAT kMinus3dB = MINUS_3_DB_IN_FLOAT * 0.5f;
+    const LVM_FLOAT kMinus6dB = 0.25f;
+#else
+void Downmix_computeMatrix(uint32_t mask, int32_t *matrix) {
+    // in Q19.12 with the extra shift of the folds: result is (sum >> 13)
+    const int32_t kUnity = 1 << 12;
+    const int32_t kMinus3dB = MINUS_3_DB_IN_Q19_12;
+    const int32_t kMinus6dB = 1 << 11;
+#endif
+    int index = 0;
+    for (uint32_t bit = 1; bit <= mask && bit != 0; bit <<= 1) {
+        if ((mask & bit) == 0) {
+            continue;
+        }
+        switch (bit) {
+        // front and surround channels keep their side, centers and LFE are split at -3dB
+        case AUDIO_CHANNEL_OUT_FRONT_LEFT:
+        case AUDIO_CHANNEL_OUT_BACK_LEFT:
+        case AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER:
+        case AUDIO_CHANNEL_OUT_SIDE_LEFT:
+            matrix[2 * index] = kUnity;
+            matrix[2 * index + 1] = 0;
+            break;
+        case AUDIO_CHANNEL_OUT_FRONT_RIGHT:
+        case AUDIO_CHANNEL_OUT_BACK_RIGHT:
+        case AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER:
+        case AUDIO_CHANNEL_OUT_SIDE_RIGHT:
+            matrix[2 * index] = 0;
+            matrix[2 * index + 1] = kUnity;
+            break;
+        case AUDIO_CHANNEL_OUT_FRONT_CENTER:
+        case AUDIO_CHANNEL_OUT_LOW_FREQUENCY:
+        case AUDIO_CHANNEL_OUT_BACK_CENTER:
+            matrix[2 * index] = kMinus3dB;
+            matrix[2 * index + 1] = kMinus3dB;
+            break;
+        // top channels are attenuated by a further 3dB
+        case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
+        case AUDIO_CHANNEL_OUT_TOP_BACK_LEFT:
+            matrix[2 * index] = kMinus3dB;
+            matrix[2 * index + 1] = 0;
+            break;
+        case AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT:
+        case AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT:
+            matrix[2 * index] = 0;
+            matrix[2 * index + 1] = kMinus3dB;
+            break;
+        case AUDIO_CHANNEL_OUT_TOP_CENTER:
+        case AUDIO_CHANNEL_OUT_TOP_FRONT_CENTER:
+        case AUDIO_CHANNEL_OUT_TOP_BACK_CENTER:
+            matrix[2 * index] = kMinus6dB;
+            matrix[2 * index + 1] = kMinus6dB;
+            break;
+        default: // rejected by Downmix_validChannelMask()
+            matrix[2 * index] = 0;
+            matrix[2 * index + 1] = 0;
+            break;
+        }
+        index++;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * Downmix_foldFromMatrix()
  *----------------------------------------------------------------------------
  * Purpose:
- * downmix to stereo a multichannel signal whose format is:
- *  - has FL/FR
- *  - if using AUDIO_CHANNEL_OUT_SIDE*, it contains both left and right
- *  - if using AUDIO_CHANNEL_OUT_BACK*, it contains both left and right
- *  - doesn't use any of the AUDIO_CHANNEL_OUT_TOP* channels
- *  - doesn't use any of the AUDIO_CHANNEL_OUT_FRONT_*_OF_CENTER channels
- * Only handles channel masks not enumerated in downmix_input_channel_mask_t
+ * downmix to stereo a multichannel signal of any supported channel mask,
+ * using the gains computed by Downmix_computeMatrix() when the effect was configured
  *
  * Inputs:
- *  mask       the channel mask of pSrc
+ *  pDownmixer the downmix context holding the matrix and the input channel count
  *  pSrc       multichannel audio buffer to downmix
  *  numFrames  the number of multichannel frames to downmix
  *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
@@ -1241,192 +1220,109 @@ void Downmix_foldFrom7Point1(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames,
  * Outputs:
  *  pDst       downmixed stereo audio samples
  *
- * Returns: false if multichannel format is not supported
- *
  *----------------------------------------------------------------------------
  */
 #ifndef BUILD_FLOAT
-bool Downmix_foldGeneric(
-        uint32_t mask, int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate) {
-
-    if (!Downmix_validChannelMask(mask)) {
-        return false;
-    }
-
-    const bool hasSides = (mask & kSides) != 0;
-    const bool hasBacks = (mask & kBacks) != 0;
-
-    const int numChan = audio_channel_count_from_out_mask(mask);
-    const bool hasFC = ((mask & AUDIO_CHANNEL_OUT_FRONT_CENTER) == AUDIO_CHANNEL_OUT_FRONT_CENTER);
-    const bool hasLFE =
-            ((mask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY) == AUDIO_CHANNEL_OUT_LOW_FREQUENCY);
-    const bool hasBC = ((mask & AUDIO_CHANNEL_OUT_BACK_CENTER) == AUDIO_CHANNEL_OUT_BACK_CENTER);
-    // compute at what index each channel is: samples will be in the following order:
-    //   FL FR FC LFE BL BR BC SL SR
-    // when a channel is not present, its index is set to the same as the index of the preceding
-    // channel
-    const int indexFC  = hasFC    ? 2            : 1;        // front center
-    const int indexLFE = hasLFE   ? indexFC + 1  : indexFC;  // low frequency
-    const int indexBL  = hasBacks ? indexLFE + 1 : indexLFE; // back left
-    const int indexBR  = hasBacks ? indexBL + 1  : indexBL;  // back right
-    const int indexBC  = hasBC    ? indexBR + 1  : indexBR;  // back center
-    const int indexSL  = hasSides ? indexBC + 1  : indexBC;  // side left
-    const int indexSR  = hasSides ? indexSL + 1  : indexSL;  // side right
-
-    int32_t lt, rt, centersLfeContrib; // samples in Q19.12 format
-    // code is mostly duplicated between the two values of accumulate to avoid repeating the test
-    // for every sample
-    if (accumulate) {
-        while (numFrames) {
-            // compute contribution of FC, BC and LFE
-            centersLfeContrib = 0;
-            if (hasFC)  { centersLfeContrib += pSrc[indexFC]; }
-            if (hasLFE) { centersLfeContrib += pSrc[indexLFE]; }
-            if (hasBC)  { centersLfeContrib += pSrc[indexBC]; }
-            centersLfeContrib *= MINUS_3_DB_IN_Q19_12;
-            // always has FL/FR
-            lt = (pSrc[0] << 12);
-            rt = (pSrc[1] << 12);
-            // mix in sides and backs
-            if (hasSides) {
-                lt += pSrc[indexSL] << 12;
-                rt += pSrc[indexSR] << 12;
-            }
-            if (hasBacks) {
-                lt += pSrc[indexBL] << 12;
-                rt += pSrc[indexBR] << 12;
-            }
-            lt += centersLfeContrib;
-            rt += centersLfeContrib;
-            // accumulate in destination
+void Downmix_foldFromMatrix(const downmix_object_t *pDownmixer,
+        int16_t *pSrc, int16_t *pDst, size_t numFrames, bool accumulate) {
+    const int32_t *matrix = pDownmixer->matrix;
+    const int numChan = pDownmixer->input_channel_count;
+    int32_t lt, rt; // samples in Q19.12 format
+    while (numFrames) {
+        lt = 0;
+        rt = 0;
+        for (int i = 0; i < numChan; i++) {
+            lt += pSrc[i] * matrix[2 * i];
+            rt += pSrc[i] * matrix[2 * i + 1];
+        }
+        if (accumulate) {
             pDst[0] = clamp16(pDst[0] + (lt >> 13));
             pDst[1] = clamp16(pDst[1] + (rt >> 13));
-            pSrc += numChan;
-            pDst += 2;
-            numFrames--;
-        }
-    } else {
-        while (numFrames) {
-            // compute contribution of FC, BC and LFE
-            centersLfeContrib = 0;
-            if (hasFC)  { centersLfeContrib += pSrc[indexFC]; }
-            if (hasLFE) { centersLfeContrib += pSrc[indexLFE]; }
-            if (hasBC)  { centersLfeContrib += pSrc[indexBC]; }
-            centersLfeContrib *= MINUS_3_DB_IN_Q19_12;
-            // always has FL/FR
-            lt = (pSrc[0] << 12);
-            rt = (pSrc[1] << 12);
-            // mix in sides and backs
-            if (hasSides) {
-                lt += pSrc[indexSL] << 12;
-                rt += pSrc[indexSR] << 12;
-            }
-            if (hasBacks) {
-                lt += pSrc[indexBL] << 12;
-                rt += pSrc[indexBR] << 12;
-            }
-            lt += centersLfeContrib;
-            rt += centersLfeContrib;
-            // store in destination
-            pDst[0] = clamp16(lt >> 13); // differs from when accumulate is true above
-            pDst[1] = clamp16(rt >> 13); // differs from when accumulate is true above
-            pSrc += numChan;
-            pDst += 2;
-            numFrames--;
+        } else {
+            pDst[0] = clamp16(lt >> 13);
+            pDst[1] = clamp16(rt >> 13);
         }
+        pSrc += numChan;
+        pDst += 2;
+        numFrames--;
     }
-    return true;
 }
 #else
-bool Downmix_foldGeneric(
-        uint32_t mask, LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate) {
-
-    if (!Downmix_validChannelMask(mask)) {
-        return false;
+void Downmix_foldFromMatrix(const downmix_object_t *pDownmixer,
+        LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate) {
+    const LVM_FLOAT *matrix = pDownmixer->matrix;
+    const int numChan = pDownmixer->input_channel_count;
+#if defined(USE_NEON)
+    const float32x2_t minimum = vdup_n_f32(-1.0f);
+    const float32x2_t maximum = vdup_n_f32(1.0f);
+    while (numFrames) {
+        // two input channels per step: (c0 c0 c1 c1) * (L0 R0 L1 R1)
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        int i = 0;
+        for (; i + 1 < numChan; i += 2) {
+            const float32x2_t samples = vld1_f32(pSrc + i);
+            sum = vmlaq_f32(sum,
+                    vcombine_f32(vdup_lane_f32(samples, 0), vdup_lane_f32(samples, 1)),
+                    vld1q_f32(matrix + 2 * i));
+        }
+        float32x2_t lr = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+        if (i < numChan) {
+            lr = vmla_n_f32(lr, vld1_f32(matrix + 2 * i), pSrc[i]);
+        }
+        if (accumulate) {
+            lr = vadd_f32(lr, vld1_f32(pDst));
+        }
+        vst1_f32(pDst, vmin_f32(vmax_f32(lr, minimum), maximum));
+        pSrc += numChan;
+        pDst += 2;
+        numFrames--;
     }
-
-    const bool hasSides = (mask & kSides) != 0;
-    const bool hasBacks = (mask & kBacks) != 0;
-
-    const int numChan = audio_channel_count_from_out_mask(mask);
-    const bool hasFC = ((mask & AUDIO_CHANNEL_OUT_FRONT_CENTER) == AUDIO_CHANNEL_OUT_FRONT_CENTER);
-    const bool hasLFE =
-            ((mask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY) == AUDIO_CHANNEL_OUT_LOW_FREQUENCY);
-    const bool hasBC = ((mask & AUDIO_CHANNEL_OUT_BACK_CENTER) == AUDIO_CHANNEL_OUT_BACK_CENTER);
-    // compute at what index each channel is: samples will be in the following order:
-    //   FL FR FC LFE BL BR BC SL SR
-    // when a channel is not present, its index is set to the same as the index of the preceding
-    // channel
-    const int indexFC  = hasFC    ? 2            : 1;        // front center
-    const int indexLFE = hasLFE   ? indexFC + 1  : indexFC;  // low frequency
-    const int indexBL  = hasBacks ? indexLFE + 1 : indexLFE; // back left
-    const int indexBR  = hasBacks ? indexBL + 1  : indexBL;  // back right
-    const int indexBC  = hasBC    ? indexBR + 1  : indexBR;  // back center
-    const int indexSL  = hasSides ? indexBC + 1  : indexBC;  // side left
-    const int indexSR  = hasSides ? indexSL + 1  : indexSL;  // side right
-
-    LVM_FLOAT lt, rt, centersLfeContrib;
-    // code is mostly duplicated between the two values of accumulate to avoid repeating the test
-    // for every sample
-    if (accumulate) {
-        while (numFrames) {
-            // compute contribution of FC, BC and LFE
-            centersLfeContrib = 0;
-            if (hasFC)  { centersLfeContrib += pSrc[indexFC]; }
-            if (hasLFE) { centersLfeContrib += pSrc[indexLFE]; }
-            if (hasBC)  { centersLfeContrib += pSrc[indexBC]; }
-            centersLfeContrib *= MINUS_3_DB_IN_FLOAT;
-            // always has FL/FR
-            lt = pSrc[0];
-            rt = pSrc[1];
-            // mix in sides and backs
-            if (hasSides) {
-                lt += pSrc[indexSL];
-                rt += pSrc[indexSR];
-            }
-            if (hasBacks) {
-                lt += pSrc[indexBL];
-                rt += pSrc[indexBR];
-            }
-            lt += centersLfeContrib;
-            rt += centersLfeContrib;
-            // accumulate in destination
-            pDst[0] = clamp_float(pDst[0] + (lt / 2.0f));
-            pDst[1] = clamp_float(pDst[1] + (rt / 2.0f));
-            pSrc += numChan;
-            pDst += 2;
-            numFrames--;
+#elif defined(USE_SSE)
+    const __m128 minimum = _mm_set1_ps(-1.0f);
+    const __m128 maximum = _mm_set1_ps(1.0f);
+    while (numFrames) {
+        // two input channels per step: (c0 c0 c1 c1) * (L0 R0 L1 R1)
+        __m128 sum = _mm_setzero_ps();
+        int i = 0;
+        for (; i + 1 < numChan; i += 2) {
+            const __m128 samples = _mm_castpd_ps(_mm_load_sd((const double *)(pSrc + i)));
+            sum = _mm_add_ps(sum,
+                    _mm_mul_ps(_mm_unpacklo_ps(samples, samples), _mm_loadu_ps(matrix + 2 * i)));
         }
-    } else {
-        while (numFrames) {
-            // compute contribution of FC, BC and LFE
-            centersLfeContrib = 0;
-            if (hasFC)  { centersLfeContrib += pSrc[indexFC]; }
-            if (hasLFE) { centersLfeContrib += pSrc[indexLFE]; }
-            if (hasBC)  { centersLfeContrib += pSrc[indexBC]; }
-            centersLfeContrib *= MINUS_3_DB_IN_FLOAT;
-            // always has FL/FR
-            lt = pSrc[0];
-            rt = pSrc[1];
-            // mix in sides and backs
-            if (hasSides) {
-                lt += pSrc[indexSL];
-                rt += pSrc[indexSR];
-            }
-            if (hasBacks) {
-                lt += pSrc[indexBL];
-                rt += pSrc[indexBR];
-            }
-            lt += centersLfeContrib;
-            rt += centersLfeContrib;
-            // store in destination
-            pDst[0] = clamp_float(lt / 2.0f); // differs from when accumulate is true above
-            pDst[1] = clamp_float(rt / 2.0f); // differs from when accumulate is true above
-            pSrc += numChan;
-            pDst += 2;
-            numFrames--;
+        __m128 lr = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        if (i < numChan) {
+            const __m128 gains = _mm_castpd_ps(_mm_load_sd((const double *)(matrix + 2 * i)));
+            lr = _mm_add_ps(lr, _mm_mul_ps(_mm_set1_ps(pSrc[i]), gains));
+        }
+        if (accumulate) {
+            lr = _mm_add_ps(lr, _mm_castpd_ps(_mm_load_sd((const double *)pDst)));
         }
+        lr = _mm_min_ps(_mm_max_ps(lr, minimum), maximum);
+        _mm_store_sd((double *)pDst, _mm_castps_pd(lr));
+        pSrc += numChan;
+        pDst += 2;
+        numFrames--;
     }
-    return true;
+#else
+    LVM_FLOAT lt, rt;
+    while (numFrames) {
+        lt = 0;
+        rt = 0;
+        for (int i = 0; i < numChan; i++) {
+            lt += pSrc[i] * matrix[2 * i];
+            rt += pSrc[i] * matrix[2 * i + 1];
+        }
+        if (accumulate) {
+            pDst[0] = clamp_float(pDst[0] + lt);
+            pDst[1] = clamp_float(pDst[1] + rt);
+        } else {
+            pDst[0] = clamp_float(lt);
+            pDst[1] = clamp_float(rt);
+        }
+        pSrc += numChan;
+        pDst += 2;
+        numFrames--;
+    }
+#endif
 }
 #endif
@@ -27,6 +27,8 @@
 */
 
 #define DOWNMIX_OUTPUT_CHANNELS AUDIO_CHANNEL_OUT_STEREO
+// maximum number of input channels of the matrix downmix
+#define DOWNMIX_MAX_CHANNELS 24
 #ifdef BUILD_FLOAT
 #define LVM_FLOAT float
 #endif
@@ -42,6 +44,12 @@ typedef struct {
     downmix_type_t type;
     bool apply_volume_correction;
     uint8_t input_channel_count;
+    // left and right gains of each input channel, see Downmix_computeMatrix()
+#ifdef BUILD_FLOAT
+    LVM_FLOAT matrix[DOWNMIX_MAX_CHANNELS * 2];
+#else
+    int32_t matrix[DOWNMIX_MAX_CHANNELS * 2]; // Q19.12
+#endif
 } downmix_object_t;
 
 
@@ -51,10 +59,14 @@ typedef struct downmix_module_s {
     downmix_object_t context;
 } downmix_module_t;
 
-const uint32_t kSides = AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT;
-const uint32_t kBacks = AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT;
-const uint32_t kUnsupported =
+// channels with a downmix coefficient
+const uint32_t kSupported =
+        AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_FRONT_RIGHT |
+        AUDIO_CHANNEL_OUT_FRONT_CENTER | AUDIO_CHANNEL_OUT_LOW_FREQUENCY |
+        AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT |
         AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER | AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER |
+        AUDIO_CHANNEL_OUT_BACK_CENTER |
+        AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT |
         AUDIO_CHANNEL_OUT_TOP_CENTER |
         AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT |
         AUDIO_CHANNEL_OUT_TOP_FRONT_CENTER |
@@ -101,14 +113,16 @@ int Downmix_getParameter(downmix_object_t *pDownmixer, int32_t param, uint32_t *
 void Downmix_foldFromQuad(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
 void Downmix_foldFrom5Point1(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
 void Downmix_foldFrom7Point1(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
-bool Downmix_foldGeneric(
-        uint32_t mask, LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
+void Downmix_computeMatrix(uint32_t mask, LVM_FLOAT *matrix);
+void Downmix_foldFromMatrix(const downmix_object_t *pDownmixer,
+        LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
 #else
 void Downmix_foldFromQuad(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
 void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
 void Downmix_foldFrom7Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
-bool Downmix_foldGeneric(
-        uint32_t mask, int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
+void Downmix_computeMatrix(uint32_t mask, int32_t *matrix);
+void Downmix_foldFromMatrix(const downmix_object_t *pDownmixer,
+        int16_t *pSrc, int16_t *pDst, size_t numFrames, bool accumulate);
 #endif
 
 #endif /*ANDROID_EFFECTDOWNMIX_H_*/
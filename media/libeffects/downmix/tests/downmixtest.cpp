@@ -13,6 +13,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <chrono>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,7 +27,8 @@
 
 #include "EffectDownmix.h"
 #define FRAME_LENGTH 256
-#define MAX_NUM_CHANNELS 8
+#define MAX_NUM_CHANNELS 12
+#define BENCHMARK_FRAMES (48000 * 60)
 
 struct downmix_cntxt_s {
   effect_descriptor_t desc;
@@ -57,9 +59,14 @@ void printUsage() {
   printf("\n         2:AUDIO_CHANNEL_OUT_5POINT1_BACK");
   printf("\n         3:AUDIO_CHANNEL_OUT_QUAD_SIDE");
   printf("\n         4:AUDIO_CHANNEL_OUT_QUAD_BACK");
+  printf("\n         5:AUDIO_CHANNEL_OUT_5POINT1POINT2");
+  printf("\n         6:AUDIO_CHANNEL_OUT_7POINT1POINT4");
   printf("\n");
   printf("\n     -fch:<file_channels> (1 through 8)");
   printf("\n");
+  printf("\n     -bench");
+  printf("\n           Measures the throughput for each input channel mask, no file needed");
+  printf("\n");
 }
 
 int32_t DownmixDefaultConfig(effect_config_t *pConfig) {
@@ -202,6 +209,66 @@ int32_t DowmixMainProcess(downmix_cntxt_s *pDescriptor, FILE *finp,
   return 0;
 }
 
+// Processes BENCHMARK_FRAMES frames for each channel mask and prints the throughput.
+int32_t DownmixBenchmark(const effect_config_t &config) {
+  static const struct {
+    const char *name;
+    uint32_t mask;
+  } kMasks[] = {
+      {"quad", AUDIO_CHANNEL_OUT_QUAD_BACK},
+      {"5.1", AUDIO_CHANNEL_OUT_5POINT1_BACK},
+      {"7.1", AUDIO_CHANNEL_OUT_7POINT1},
+      {"5.1.2", AUDIO_CHANNEL_OUT_5POINT1POINT2},
+      {"7.1.4", AUDIO_CHANNEL_OUT_7POINT1POINT4},
+  };
+  const effect_uuid_t downmix_uuid = {
+      0x93f04452, 0xe4fe, 0x41cc, 0x91f9, {0xe4, 0x75, 0xb6, 0xd1, 0xd6, 0x9f}};
+
+  std::vector<float> inFloat(FRAME_LENGTH * MAX_NUM_CHANNELS);
+  std::vector<float> outFloat(FRAME_LENGTH * 2);
+  for (size_t i = 0; i < inFloat.size(); i++) {
+    inFloat[i] = ((float)(i % 97) / 97.0f - 0.5f) * 0.5f;
+  }
+
+  for (const auto &entry : kMasks) {
+    downmix_cntxt_s descriptor = {};
+    descriptor.config = config;
+    descriptor.config.inputCfg.channels = entry.mask;
+    int32_t err = AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(
+        &downmix_uuid, 0 /* sessionId */, 0 /* ioId */, &descriptor.handle);
+    if (err != 0) {
+      ALOGE("DownmixLib_Create returned an error %d", err);
+      return -1;
+    }
+    err = DownmixConfiureAndEnable(&descriptor);
+    if (err != 0) {
+      ALOGE("DownmixConfigureAndEnable returned an error %d for %s", err, entry.name);
+      AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(descriptor.handle);
+      return -1;
+    }
+    const struct effect_interface_s *Downmix_api =
+        ((downmix_module_t *)descriptor.handle)->itfe;
+
+    audio_buffer_t inbuffer, outbuffer;
+    inbuffer.f32 = inFloat.data();
+    outbuffer.f32 = outFloat.data();
+    inbuffer.frameCount = FRAME_LENGTH;
+    outbuffer.frameCount = FRAME_LENGTH;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int frames = 0; frames < BENCHMARK_FRAMES; frames += FRAME_LENGTH) {
+      (Downmix_api->process)(descriptor.handle, &inbuffer, &outbuffer);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%-6s %2u channels: %7.1f Mframes/s\n", entry.name,
+           audio_channel_count_from_out_mask(entry.mask),
+           BENCHMARK_FRAMES / elapsed.count() / 1e6);
+
+    AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(descriptor.handle);
+  }
+  return 0;
+}
+
 int main(int argc, const char *argv[]) {
   int numFileChannels = 1, numProcessChannels = 8;
   downmix_cntxt_s descriptor = {};
@@ -256,6 +323,12 @@ int main(int argc, const char *argv[]) {
         case 4:
           *audioType = AUDIO_CHANNEL_OUT_QUAD_BACK;
           break;
+        case 5:
+          *audioType = AUDIO_CHANNEL_OUT_5POINT1POINT2;
+          break;
+        case 6:
+          *audioType = AUDIO_CHANNEL_OUT_7POINT1POINT4;
+          break;
         default:
           *audioType = AUDIO_CHANNEL_OUT_7POINT1;
           break;
@@ -271,6 +344,8 @@ int main(int argc, const char *argv[]) {
       }
       descriptor.numFileChannels = fChannels;
 
+    } else if (!strncmp(argv[i], "-bench", 6)) {
+      return DownmixBenchmark(descriptor.config);
     } else if (!strncmp(argv[i], "-h", 2)) {
       printUsage();
       return 0;
@@ -213,8 +213,10 @@ int DP_init(DynamicsProcessingContext *pContext)
 void DP_changeVariant(DynamicsProcessingContext *pContext, int newVariant) {
     ALOGV("DP_changeVariant from %d to %d", pContext->mCurrentVariant, newVariant);
     switch(newVariant) {
-    case VARIANT_FAVOR_FREQUENCY_RESOLUTION: {
-        pContext->mCurrentVariant = VARIANT_FAVOR_FREQUENCY_RESOLUTION;
+    case VARIANT_FAVOR_FREQUENCY_RESOLUTION:
+    case VARIANT_FAVOR_TIME_RESOLUTION: {
+        //both variants use the frequency domain engine, configured differently
+        pContext->mCurrentVariant = newVariant;
         delete pContext->mPDynamics;
         pContext->mPDynamics = new dp_fx::DPFrequency();
         break;
@@ -229,7 +231,8 @@ void DP_changeVariant(DynamicsProcessingContext *pContext, int newVariant) {
 void DP_configureVariant(DynamicsProcessingContext *pContext, int newVariant) {
     ALOGV("DP_configureVariant %d", newVariant);
     switch(newVariant) {
-    case VARIANT_FAVOR_FREQUENCY_RESOLUTION: {
+    case VARIANT_FAVOR_FREQUENCY_RESOLUTION:
+    case VARIANT_FAVOR_TIME_RESOLUTION: {
         int32_t minBlockSize = (int32_t)dp_fx::DPFrequency::getMinBockSize();
         int32_t desiredBlock = pContext->mPreferredFrameDuration *
                 pContext->mConfig.inputCfg.samplingRate / 1000.0f;
@@ -243,9 +246,16 @@ void DP_configureVariant(DynamicsProcessingContext *pContext, int newVariant) {
             //find next highest power of 2.
             currentBlock = 1 << (32 - __builtin_clz(desiredBlock));
         }
-        ((dp_fx::DPFrequency*)pContext->mPDynamics)->configure(currentBlock,
-                currentBlock/2,
-                pContext->mConfig.inputCfg.samplingRate);
+        if (newVariant == VARIANT_FAVOR_TIME_RESOLUTION) {
+            //same frequency resolution, with a hop and latency of a quarter block
+            ((dp_fx::DPFrequency*)pContext->mPDynamics)->configure(currentBlock,
+                    currentBlock - currentBlock/4,
+                    pContext->mConfig.inputCfg.samplingRate, true /*lowLatency*/);
+        } else {
+            ((dp_fx::DPFrequency*)pContext->mPDynamics)->configure(currentBlock,
+                    currentBlock/2,
+                    pContext->mConfig.inputCfg.samplingRate, false /*lowLatency*/);
+        }
         break;
     }
     default: {
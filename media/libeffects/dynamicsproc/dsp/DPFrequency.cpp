@@ -51,10 +51,10 @@ template <> bool compareEquality<float>(float a, float b) {
     (a) = (b); }
 
 //ChannelBuffers helper
-void ChannelBuffer::initBuffers(unsigned int blockSize, unsigned int overlapSize,
+void ChannelBuffer::initBuffers(unsigned int blockSize, unsigned int tailSize,
         unsigned int halfFftSize, unsigned int samplingRate, DPBase &dpBase) {
-    ALOGV("ChannelBuffer::initBuffers blockSize %d, overlap %d, halfFft %d",
-            blockSize, overlapSize, halfFftSize);
+    ALOGV("ChannelBuffer::initBuffers blockSize %d, tail %d, halfFft %d",
+            blockSize, tailSize, halfFftSize);
 
     mSamplingRate = samplingRate;
     mBlockSize = blockSize;
@@ -65,7 +65,9 @@ void ChannelBuffer::initBuffers(unsigned int blockSize, unsigned int overlapSize
     //temp vectors
     input.resize(mBlockSize);
     output.resize(mBlockSize);
-    outTail.resize(overlapSize);
+    outTail.resize(tailSize);
+    windowedInput.resize(mBlockSize);
+    complexTemp.resize(halfFftSize);
 
     //module vectors
     mPreEqFactorVector.resize(halfFftSize, 1.0);
@@ -135,8 +137,8 @@ size_t DPFrequency::getMaxBockSize() {
 }
 
 void DPFrequency::configure(size_t blockSize, size_t overlapSize,
-        size_t samplingRate) {
-    ALOGV("configure");
+        size_t samplingRate, bool lowLatency) {
+    ALOGV("configure lowLatency %d", lowLatency);
     mBlockSize = blockSize;
     if (mBlockSize > MAX_BLOCKSIZE) {
         mBlockSize = MAX_BLOCKSIZE;
@@ -150,25 +152,49 @@ void DPFrequency::configure(size_t blockSize, size_t overlapSize,
     }
 
     mHalfFFTSize = 1 + mBlockSize / 2; //including Nyquist bin
-    mOverlapSize = std::min(overlapSize, mBlockSize/2);
+    mLowLatency = lowLatency;
+    if (mLowLatency) {
+        //the two hops that are synthesized must fit in the block
+        mOverlapSize = std::min(std::max(overlapSize, mBlockSize/2), mBlockSize - 1);
+        mHopSize = mBlockSize - mOverlapSize;
+        mTailSize = mHopSize;
+        mOutputOffset = mBlockSize - 2 * mHopSize;
+    } else {
+        mOverlapSize = std::min(overlapSize, mBlockSize/2);
+        mHopSize = mBlockSize - mOverlapSize;
+        mTailSize = mOverlapSize;
+        mOutputOffset = 0;
+    }
+    ALOGV("configure block %zu, hop %zu, latency %zu samples", mBlockSize, mHopSize,
+            mLowLatency ? mHopSize : mOverlapSize);
 
     int channelcount = getChannelCount();
     mSamplingRate = samplingRate;
     mChannelBuffers.resize(channelcount);
     for (int ch = 0; ch < channelcount; ch++) {
-        mChannelBuffers[ch].initBuffers(mBlockSize, mOverlapSize, mHalfFFTSize,
+        mChannelBuffers[ch].initBuffers(mBlockSize, mTailSize, mHalfFFTSize,
                 mSamplingRate, *this);
     }
 
     //effective number of frames processed per second
-    mBlocksPerSecond = (float)mSamplingRate / (mBlockSize - mOverlapSize);
+    mBlocksPerSecond = (float)mSamplingRate / mHopSize;
 
-    fill_window(mVWindow, RDSP_WINDOW_HANNING_FLAT_TOP, mBlockSize, mOverlapSize);
+    if (mLowLatency) {
+        fillLowLatencyWindows();
+    } else {
+        fill_window(mVWindow, RDSP_WINDOW_HANNING_FLAT_TOP, mBlockSize, mOverlapSize);
 
-    //split window into analysis and synthesis. Both are the sqrt() of original
-    //window
-    Eigen::Map<Eigen::VectorXf> eWindow(&mVWindow[0], mVWindow.size());
-    eWindow = eWindow.array().sqrt();
+        //split window into analysis and synthesis. Both are the sqrt() of original
+        //window
+        Eigen::Map<Eigen::VectorXf> eWindow(&mVWindow[0], mVWindow.size());
+        eWindow = eWindow.array().sqrt();
+        mVSynthesisWindow = mVWindow;
+    }
+
+    //the ifft is unscaled, fold its 1/N scaling into the synthesis window
+    for (size_t i = 0; i < mVSynthesisWindow.size(); i++) {
+        mVSynthesisWindow[i] /= mBlockSize;
+    }
 
     //compute window rms for energy compensation
     mWindowRms = 0;
@@ -178,6 +204,40 @@ void DPFrequency::configure(size_t blockSize, size_t overlapSize,
 
     //Making sure window rms is not zero.
     mWindowRms = std::max(sqrt(mWindowRms / mVWindow.size()), MIN_ENVELOPE);
+
+    //Only the half spectrum is needed for real data. Create the fft plans and temp
+    //buffers now, so that the audio thread does not allocate.
+    mFftServer.SetFlag(Eigen::FFT<float>::HalfSpectrum);
+    mFftServer.SetFlag(Eigen::FFT<float>::Unscaled);
+    Eigen::VectorXf timeTemp = Eigen::VectorXf::Zero(mBlockSize);
+    Eigen::VectorXcf complexTemp(mHalfFFTSize);
+    mFftServer.fwd(complexTemp, timeTemp);
+    mFftServer.inv(timeTemp, complexTemp);
+}
+
+void DPFrequency::fillLowLatencyWindows() {
+    //Asymmetric windows. The analysis window is a long sqrt hanning ramp up, over all but
+    //the last hop, followed by a short sqrt hanning ramp down over the last hop.
+    //The synthesis window is only non zero over the last two hops, where the product of
+    //both windows is a hanning window two hops long. These add up to 1 with a one hop
+    //advance, so only one hop of tail is kept and the latency is one hop.
+    const size_t rampUpSize = mBlockSize - mHopSize;
+    const size_t shortSize = 2 * mHopSize;
+
+    mVWindow.resize(mBlockSize);
+    mVSynthesisWindow.assign(mBlockSize, 0);
+    for (size_t i = 0; i < rampUpSize; i++) {
+        mVWindow[i] = sqrt(0.5 * (1.0 - cos(M_PI * i / rampUpSize)));
+    }
+    for (size_t i = rampUpSize; i < mBlockSize; i++) {
+        size_t k = i - mOutputOffset;
+        mVWindow[i] = sqrt(0.5 * (1.0 - cos(TWOPI * k / shortSize)));
+    }
+    for (size_t i = mOutputOffset; i < mBlockSize; i++) {
+        size_t k = i - mOutputOffset;
+        float product = 0.5 * (1.0 - cos(TWOPI * k / shortSize));
+        mVSynthesisWindow[i] = mVWindow[i] > EPSILON ? product / mVWindow[i] : 0;
+    }
 }
 
 void DPFrequency::updateParameters(ChannelBuffer &cb, int channelIndex) {
@@ -425,7 +485,7 @@ size_t DPFrequency::processSamples(const float *in, float *out, size_t samples)
 size_t DPFrequency::processChannelBuffers(CBufferVector &channelBuffers) {
     const int channelCount = channelBuffers.size();
     size_t processedSamples = 0;
-    size_t processFrames = mBlockSize - mOverlapSize;
+    size_t processFrames = mHopSize;
 
     size_t available = channelBuffers[0].cBInput.availableToRead();
     for (int ch = 1; ch < channelCount; ch++) {
@@ -460,14 +520,15 @@ size_t DPFrequency::processChannelBuffers(CBufferVector &channelBuffers) {
             processLastStages(*pCb);
 
             //mix tail (and capture new tail
-            for (unsigned int k = 0; k < mOverlapSize; k++) {
-                pCb->output[k] += pCb->outTail[k];
-                pCb->outTail[k] = pCb->output[processFrames + k]; //new tail
+            float *pOutput = &pCb->output[mOutputOffset];
+            for (unsigned int k = 0; k < mTailSize; k++) {
+                pOutput[k] += pCb->outTail[k];
+                pCb->outTail[k] = pOutput[processFrames + k]; //new tail
             }
 
             //output data
             for (unsigned int k = 0; k < processFrames; k++) {
-                pCb->cBOutput.write(pCb->output[k]);
+                pCb->cBOutput.write(pOutput[k]);
             }
         }
         available -= processFrames;
@@ -480,37 +541,37 @@ size_t DPFrequency::processFirstStages(ChannelBuffer &cb) {
     Eigen::Map<Eigen::VectorXf> eWindow(&mVWindow[0], mVWindow.size());
     Eigen::Map<Eigen::VectorXf> eInput(&cb.input[0], cb.input.size());
 
-    Eigen::VectorXf eWin = eInput.cwiseProduct(eWindow); //apply window
+    cb.windowedInput = eInput.cwiseProduct(eWindow); //apply window
 
     //##fft
-    //Note: we are using eigen with the default scaling, which ensures that
-    //  IFFT( FFT(x) ) = x.
-    // TODO: optimize by using the noscale option, and compensate with dB scale offsets
-    mFftServer.fwd(cb.complexTemp, eWin);
+    //Note: the ifft is unscaled, and its 1/N scaling is part of the synthesis window.
+    mFftServer.fwd(cb.complexTemp, cb.windowedInput);
 
+    //Nyquist bin is left untouched
     size_t cSize = cb.complexTemp.size();
-    size_t maxBin = std::min(cSize/2, mHalfFFTSize);
+    size_t maxBin = mHalfFFTSize - 1;
 
     //== EqPre (always runs)
-    for (size_t k = 0; k < maxBin; k++) {
-        cb.complexTemp[k] *= cb.mPreEqFactorVector[k];
-    }
+    Eigen::Map<Eigen::ArrayXf> ePreEq(&cb.mPreEqFactorVector[0], maxBin);
+    cb.complexTemp.head(maxBin).array() *= ePreEq;
 
     //== MBC
     if (cb.mMbcInUse && cb.mMbcEnabled) {
         for (size_t band = 0; band < cb.mMbcBands.size(); band++) {
             ChannelBuffer::MbcBandParams *pMbcBandParams = &cb.mMbcBands[band];
-            float fEnergySum = 0;
 
             //apply pre gain.
             float preGainFactor = dBtoLinear(pMbcBandParams->gainPreDb);
             float preGainSquared = preGainFactor * preGainFactor;
 
-            for (size_t k = pMbcBandParams->binStart; k <= pMbcBandParams->binStop; k++) {
-                fEnergySum += std::norm(cb.complexTemp[k]) * preGainSquared; //mag squared
-            }
+            //band limited to the half spectrum
+            size_t binStart = std::min(pMbcBandParams->binStart, cSize);
+            size_t binStop = std::min(pMbcBandParams->binStop + 1, cSize);
+            size_t binCount = binStop > binStart ? binStop - binStart : 0;
+            float fEnergySum = cb.complexTemp.segment(binStart, binCount).squaredNorm() *
+                    preGainSquared; //mag squared
 
-            //Eigen FFT is full spectrum, even if the source was real data.
+            //Only the half spectrum is computed, as the source is real data.
             // Each half spectrum has half the energy. This is taken into account with the * 2
             // factor in the energy computations.
             // energy = sqrt(sum_components_squared) number_points
@@ -567,9 +628,7 @@ size_t DPFrequency::processFirstStages(ChannelBuffer &cb) {
             newFactor *= dBtoLinear(pMbcBandParams->gainPostDb);
 
             //apply to this band
-            for (size_t k = pMbcBandParams->binStart; k <= pMbcBandParams->binStop; k++) {
-                cb.complexTemp[k] *= newFactor;
-            }
+            cb.complexTemp.segment(binStart, binCount) *= newFactor;
 
         } //end per band process
 
@@ -577,17 +636,13 @@ size_t DPFrequency::processFirstStages(ChannelBuffer &cb) {
 
     //== EqPost
     if (cb.mPostEqInUse && cb.mPostEqEnabled) {
-        for (size_t k = 0; k < maxBin; k++) {
-            cb.complexTemp[k] *= cb.mPostEqFactorVector[k];
-        }
+        Eigen::Map<Eigen::ArrayXf> ePostEq(&cb.mPostEqFactorVector[0], maxBin);
+        cb.complexTemp.head(maxBin).array() *= ePostEq;
     }
 
     //== Limiter. First Pass
     if (cb.mLimiterInUse && cb.mLimiterEnabled) {
-        float fEnergySum = 0;
-        for (size_t k = 0; k < maxBin; k++) {
-            fEnergySum += std::norm(cb.complexTemp[k]);
-        }
+        float fEnergySum = cb.complexTemp.head(maxBin).squaredNorm();
 
         //see explanation above for energy computation logic
         fEnergySum = sqrt(fEnergySum * 2) / (mBlockSize * mWindowRms);
@@ -656,20 +711,17 @@ size_t DPFrequency::processLastStages(ChannelBuffer &cb) {
 
     //apply to all if != 1.0
     if (!compareEquality(outputGainFactor, 1.0f)) {
-        size_t cSize = cb.complexTemp.size();
-        size_t maxBin = std::min(cSize/2, mHalfFFTSize);
-        for (size_t k = 0; k < maxBin; k++) {
-            cb.complexTemp[k] *= outputGainFactor;
-        }
+        cb.complexTemp.head(mHalfFFTSize - 1) *= outputGainFactor;
     }
 
     //##ifft directly to output.
     Eigen::Map<Eigen::VectorXf> eOutput(&cb.output[0], cb.output.size());
     mFftServer.inv(eOutput, cb.complexTemp);
 
-    //apply rest of window for resynthesis
-    Eigen::Map<Eigen::VectorXf> eWindow(&mVWindow[0], mVWindow.size());
-    eOutput = eOutput.cwiseProduct(eWindow);
+    //apply rest of window for resynthesis. Only the synthesized part of the block.
+    const size_t synthesisSize = mBlockSize - mOutputOffset;
+    Eigen::Map<Eigen::VectorXf> eWindow(&mVSynthesisWindow[mOutputOffset], synthesisSize);
+    eOutput.tail(synthesisSize) = eOutput.tail(synthesisSize).cwiseProduct(eWindow);
 
     return mBlockSize;
 }
@@ -39,7 +39,8 @@ public:
     FloatVec output;    // time domain temp vector for output
     FloatVec outTail;   // time domain temp vector for output tail (for overlap-add method)
 
-    Eigen::VectorXcf complexTemp; // complex temp vector for frequency domain operations
+    Eigen::VectorXf windowedInput; // time domain temp vector for the windowed input
+    Eigen::VectorXcf complexTemp; // complex temp vector for frequency domain operations (half)
 
     //Current parameters
     float inputGainDb;
@@ -99,7 +100,7 @@ public:
     FloatVec mPreEqFactorVector; // temp pre-computed vector to shape spectrum at preEQ stage
     FloatVec mPostEqFactorVector; // temp pre-computed vector to shape spectrum at postEQ stage
 
-    void initBuffers(unsigned int blockSize, unsigned int overlapSize, unsigned int halfFftSize,
+    void initBuffers(unsigned int blockSize, unsigned int tailSize, unsigned int halfFftSize,
             unsigned int samplingRate, DPBase &dpBase);
     void computeBinStartStop(BandParams &bp, size_t binStart);
 private:
@@ -124,7 +125,9 @@ class DPFrequency : public DPBase {
 public:
     virtual size_t processSamples(const float *in, float *out, size_t samples);
     virtual void reset();
-    void configure(size_t blockSize, size_t overlapSize, size_t samplingRate);
+    // lowLatency: use an asymmetric analysis window and synthesize only the last two hops
+    // of each block, so the latency is one hop instead of the overlap.
+    void configure(size_t blockSize, size_t overlapSize, size_t samplingRate, bool lowLatency);
     static size_t getMinBockSize();
     static size_t getMaxBockSize();
 
@@ -137,11 +140,16 @@ private:
     size_t processFirstStages(ChannelBuffer &cb);
     size_t processLastStages(ChannelBuffer &cb);
     void processLinkedLimiters(CBufferVector &channelBuffers);
+    void fillLowLatencyWindows();
 
     size_t mBlockSize;
     size_t mHalfFFTSize;
     size_t mOverlapSize;
+    size_t mHopSize;      // new samples per block
+    size_t mTailSize;     // samples carried over to the next block by the overlap-add
+    size_t mOutputOffset; // first output sample of the block that is synthesized
     size_t mSamplingRate;
+    bool mLowLatency;
 
     float mBlocksPerSecond;
 
@@ -150,7 +158,8 @@ private:
     LinkedLimiters mLinkedLimiters;
 
     //dsp
-    FloatVec mVWindow;  //window class.
+    FloatVec mVWindow;  //window class. Analysis window
+    FloatVec mVSynthesisWindow; //synthesis window, including the ifft scaling
     float mWindowRms;
     Eigen::FFT<float> mFftServer;
 };
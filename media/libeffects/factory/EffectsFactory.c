@@ -19,6 +19,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <cutils/properties.h>
@@ -42,6 +43,7 @@ static uint32_t gCurEffectIdx;       // current effect index in enumeration proc
  *  -2 if config load was skipped
  */
 static ssize_t gConfigNbElemSkipped = -2;
+static int64_t gConfigLoadTimeUs; // time spent loading the effect configuration
 
 static int gInitDone; // true is global initialization has been preformed
 static int gCanQueryEffect; // indicates that call to EffectQueryEffect() is valid, i.e. that the list of effects
@@ -57,6 +59,8 @@ static uint32_t updateNumEffects();
 static int findSubEffect(const effect_uuid_t *uuid,
                lib_entry_t **lib,
                effect_descriptor_t **desc);
+// Opens the library of an effect and of its sub effects if not done yet
+static int loadEffectLibraries(lib_entry_t *lib, const effect_uuid_t *uuid);
 
 /////////////////////////////////////////////////
 //      Effect Control Interface functions
@@ -291,6 +295,13 @@ int EffectCreate(const effect_uuid_t *uuid, int32_t sessionId, int32_t ioId, eff
         }
     }
 
+    // libraries registered from the descriptor cache are opened on first use
+    ret = loadEffectLibraries(l, uuid);
+    if (ret < 0) {
+        ALOGW("EffectCreate() could not load library %s for fx %s", l->name, d->name);
+        goto exit;
+    }
+
     // create effect in library
     ret = l->desc->create_effect(uuid, sessionId, ioId, &itfe);
     if (ret != 0) {
@@ -436,6 +447,9 @@ int init() {
 
     pthread_mutex_init(&gLibLock, NULL);
 
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
     if (ignoreFxConfFiles) {
         ALOGI("Audio effects in configuration files will be ignored");
     } else {
@@ -448,6 +462,12 @@ int init() {
         }
     }
 
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    gConfigLoadTimeUs = (end.tv_sec - start.tv_sec) * 1000000LL +
+            (end.tv_nsec - start.tv_nsec) / 1000;
+    ALOGI("Effect configuration loaded in %lld us", (long long)gConfigLoadTimeUs);
+
     updateNumEffects();
     gInitDone = 1;
     ALOGV("init() done");
@@ -500,6 +520,32 @@ int findSubEffect(const effect_uuid_t *uuid,
     return ret;
 }
 
+int loadEffectLibraries(lib_entry_t *lib, const effect_uuid_t *uuid)
+{
+    int ret = EffectLoadLibrary(lib);
+    if (ret < 0) {
+        return ret;
+    }
+    // a proxy effect creates its sub effects directly from their libraries
+    list_sub_elem_t *e = gSubEffectList;
+    while (e != NULL) {
+        effect_descriptor_t *d = (effect_descriptor_t *)e->object;
+        if (memcmp(uuid, &d->uuid, sizeof(effect_uuid_t)) == 0) {
+            list_elem_t *subefx = e->sub_elem;
+            while (subefx != NULL) {
+                ret = EffectLoadLibrary(((sub_effect_entry_t *)subefx->object)->lib);
+                if (ret < 0) {
+                    return ret;
+                }
+                subefx = subefx->next;
+            }
+            break;
+        }
+        e = e->next;
+    }
+    return 0;
+}
+
 void resetEffectEnumeration()
 {
     gCurLib = gLibraryList;
@@ -557,6 +603,9 @@ int EffectDumpEffects(int fd) {
         list_elem_t *efx = l->effects;
         dprintf(fd, " Library %s\n", l->name);
         dprintf(fd, "  path: %s\n", l->path);
+        if (l->handle == NULL) {
+            dprintf(fd, "  (not opened yet)\n");
+        }
         if (!efx) {
             dprintf(fd, "  (no effects)\n");
         }
@@ -593,6 +642,7 @@ int EffectDumpEffects(int fd) {
         dprintf(fd, "XML effect configuration partially loaded, skipped %zd elements.\n",
                 gConfigNbElemSkipped);
     }
+    dprintf(fd, "Effect configuration load time: %lld us\n", (long long)gConfigLoadTimeUs);
     return ret;
 }
 
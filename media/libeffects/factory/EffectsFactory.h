@@ -28,6 +28,9 @@ extern "C" {
 #endif
 
 #define PROPERTY_IGNORE_EFFECTS "ro.audio.ignore_effects"
+// When set, effect libraries whose descriptors are found in the descriptor cache
+// are only dlopen()ed on their first EffectCreate().
+#define PROPERTY_LAZY_LOAD_EFFECTS "ro.audio.lazy_load_effects"
 
 typedef struct list_elem_s {
     void *object;
@@ -43,6 +46,8 @@ typedef struct list_sub_elem_s {
     struct list_sub_elem_s *next;
 } list_sub_elem_t;
 
+// desc and handle are NULL until the library is opened if it was registered
+// from the descriptor cache, see EffectLoadLibrary().
 typedef struct lib_entry_s {
     audio_effect_library_t *desc;
     char *name;
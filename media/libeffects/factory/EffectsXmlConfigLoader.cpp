@@ -18,10 +18,16 @@
 //#define LOG_NDEBUG 0
 
 #include <dlfcn.h>
+#include <errno.h>
+#include <map>
 #include <set>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <sys/stat.h>
+#include <vector>
 
+#include <cutils/properties.h>
 #include <log/log.h>
 
 #include <media/EffectsConfig.h>
@@ -40,6 +46,9 @@ using namespace effectsConfig;
 
 namespace {
 
+/** Location of the effect descriptors cached from the previous run, see DescriptorCache. */
+#define EFFECT_DESCRIPTOR_CACHE_PATH "/data/vendor/audio/effect_descriptors.cache"
+
 /** Similarly to dlopen, looks for the provided path in LD_EFFECT_LIBRARY_PATH.
  * @return true if the library is found and set resolvedPath to its absolute path.
  *         false if not found
@@ -55,21 +64,11 @@ bool resolveLibrary(const std::string& path, std::string* resolvedPath) {
     return false;
 }
 
-/** Loads a library given its relative path and stores the result in libEntry.
- * @return true on success with libEntry's path, handle and desc filled
- *         false on success with libEntry's path filled with the path of the failed lib
- * The caller MUST free the resources path (free) and handle (dlclose) if filled.
+/** Opens the library at the given absolute path and checks its description.
+ * @return true on success with libEntry's handle and desc filled
+ *         false on failure, libEntry is left untouched.
  */
-bool loadLibrary(const char* relativePath, lib_entry_t* libEntry) noexcept {
-
-    std::string absolutePath;
-    if (!resolveLibrary(relativePath, &absolutePath)) {
-        ALOGE("Could not find library in effect directories: %s", relativePath);
-        libEntry->path = strdup(relativePath);
-        return false;
-    }
-    const char* path = absolutePath.c_str();
-    libEntry->path = strdup(path);
+bool openLibrary(const char* path, lib_entry_t* libEntry) noexcept {
 
     // Make sure the lib is closed on early return
     std::unique_ptr<void, decltype(dlclose)*> libHandle(dlopen(path, RTLD_NOW),
@@ -106,6 +105,214 @@ bool loadLibrary(const char* relativePath, lib_entry_t* libEntry) noexcept {
     return true;
 }
 
+/** Effect descriptors queried from the libraries during a previous run, keyed on library path.
+ * The descriptors of a library are only trusted if the library file still has the modification
+ * time and size recorded with them. This allows to register a library and its effects
+ * without opening it, deferring the dlopen to its first EffectCreate().
+ */
+class DescriptorCache {
+public:
+    /** Reads the cache file. On any error the cache is left empty. */
+    void read(const char* cachePath);
+    /** Writes the descriptors used by the current configuration if they changed since read(). */
+    void writeIfChanged(const char* cachePath) const;
+
+    /** @return true if the descriptors cached for the library at libPath can be used. */
+    bool isUpToDate(const char* libPath);
+    /** @return the cached descriptor of an effect of an up to date library, nullptr if none. */
+    const effect_descriptor_t* find(const char* libPath, const effect_uuid_t& uuid);
+    /** Records the descriptor of an effect queried from the library at libPath. */
+    void add(const char* libPath, const effect_descriptor_t& desc);
+
+private:
+    static constexpr uint32_t kMagic = 0x43444645; // "EFDC"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kMaxDescriptorsPerLibrary = 256; // sanity limit when reading
+
+    struct Stamp {
+        int64_t mtimeSec;
+        int64_t mtimeNsec;
+        int64_t size;
+        bool operator==(const Stamp& o) const {
+            return mtimeSec == o.mtimeSec && mtimeNsec == o.mtimeNsec && size == o.size;
+        }
+    };
+    struct Library {
+        Stamp stamp;
+        std::vector<effect_descriptor_t> descriptors;
+        bool operator==(const Library& o) const {
+            return stamp == o.stamp && descriptors.size() == o.descriptors.size() &&
+                   memcmp(descriptors.data(), o.descriptors.data(),
+                          descriptors.size() * sizeof(effect_descriptor_t)) == 0;
+        }
+    };
+    using Libraries = std::map<std::string, Library>;
+
+    static bool getStamp(const char* path, Stamp* stamp);
+    static const effect_descriptor_t* findIn(const Library& library, const effect_uuid_t& uuid);
+
+    Libraries mPrevious; // as read from the cache file
+    Libraries mCurrent;  // libraries and descriptors used by the current configuration
+};
+
+bool DescriptorCache::getStamp(const char* path, Stamp* stamp) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+    stamp->mtimeSec = st.st_mtim.tv_sec;
+    stamp->mtimeNsec = st.st_mtim.tv_nsec;
+    stamp->size = st.st_size;
+    return true;
+}
+
+const effect_descriptor_t* DescriptorCache::findIn(const Library& library,
+                                                   const effect_uuid_t& uuid) {
+    for (auto& desc : library.descriptors) {
+        if (memcmp(&desc.uuid, &uuid, sizeof(effect_uuid_t)) == 0) {
+            return &desc;
+        }
+    }
+    return nullptr;
+}
+
+void DescriptorCache::read(const char* cachePath) {
+    std::unique_ptr<FILE, decltype(fclose)*> file(fopen(cachePath, "rb"), fclose);
+    if (file == nullptr) {
+        ALOGV("No effect descriptor cache %s", cachePath);
+        return;
+    }
+    auto readValue = [&file](auto* value) {
+        return fread(value, sizeof(*value), 1, file.get()) == 1;
+    };
+    uint32_t magic, version, descriptorSize, numLibraries;
+    if (!readValue(&magic) || magic != kMagic || !readValue(&version) || version != kVersion ||
+        !readValue(&descriptorSize) || descriptorSize != sizeof(effect_descriptor_t) ||
+        !readValue(&numLibraries)) {
+        ALOGW("Ignoring invalid effect descriptor cache %s", cachePath);
+        return;
+    }
+    Libraries libraries;
+    for (uint32_t i = 0; i < numLibraries; ++i) {
+        uint32_t pathLength, numDescriptors;
+        if (!readValue(&pathLength) || pathLength > PATH_MAX) {
+            ALOGW("Ignoring corrupted effect descriptor cache %s", cachePath);
+            return;
+        }
+        std::string path(pathLength, '\0');
+        Library library;
+        if (fread(&path[0], 1, pathLength, file.get()) != pathLength ||
+            !readValue(&library.stamp) || !readValue(&numDescriptors) ||
+            numDescriptors > kMaxDescriptorsPerLibrary) {
+            ALOGW("Ignoring corrupted effect descriptor cache %s", cachePath);
+            return;
+        }
+        library.descriptors.resize(numDescriptors);
+        if (fread(library.descriptors.data(), sizeof(effect_descriptor_t), numDescriptors,
+                  file.get()) != numDescriptors) {
+            ALOGW("Ignoring corrupted effect descriptor cache %s", cachePath);
+            return;
+        }
+        libraries.emplace(std::move(path), std::move(library));
+    }
+    mPrevious = std::move(libraries);
+}
+
+void DescriptorCache::writeIfChanged(const char* cachePath) const {
+    if (mCurrent == mPrevious) {
+        return;
+    }
+    // Write to a temporary file and rename it so that a crash never leaves a truncated cache.
+    std::string tmpPath = std::string(cachePath) + ".tmp";
+    std::unique_ptr<FILE, decltype(fclose)*> file(fopen(tmpPath.c_str(), "wb"), fclose);
+    if (file == nullptr) {
+        ALOGW("Could not create effect descriptor cache %s: %s", tmpPath.c_str(), strerror(errno));
+        return;
+    }
+    bool success = true;
+    auto writeValue = [&file, &success](const auto& value) {
+        success = success && fwrite(&value, sizeof(value), 1, file.get()) == 1;
+    };
+    writeValue(kMagic);
+    writeValue(kVersion);
+    writeValue(static_cast<uint32_t>(sizeof(effect_descriptor_t)));
+    writeValue(static_cast<uint32_t>(mCurrent.size()));
+    for (auto& [path, library] : mCurrent) {
+        writeValue(static_cast<uint32_t>(path.size()));
+        success = success && fwrite(path.data(), 1, path.size(), file.get()) == path.size();
+        writeValue(library.stamp);
+        writeValue(static_cast<uint32_t>(library.descriptors.size()));
+        success = success && fwrite(library.descriptors.data(), sizeof(effect_descriptor_t),
+                                    library.descriptors.size(), file.get()) ==
+                             library.descriptors.size();
+    }
+    success = fclose(file.release()) == 0 && success;
+    if (!success || rename(tmpPath.c_str(), cachePath) != 0) {
+        ALOGW("Could not write effect descriptor cache %s: %s", cachePath, strerror(errno));
+        unlink(tmpPath.c_str());
+        return;
+    }
+    ALOGV("Wrote effect descriptor cache %s with %zu libraries", cachePath, mCurrent.size());
+}
+
+bool DescriptorCache::isUpToDate(const char* libPath) {
+    Stamp stamp;
+    if (!getStamp(libPath, &stamp)) {
+        return false;
+    }
+    mCurrent[libPath] = Library{stamp, {}};
+    auto previous = mPrevious.find(libPath);
+    return previous != mPrevious.end() && previous->second.stamp == stamp;
+}
+
+const effect_descriptor_t* DescriptorCache::find(const char* libPath,
+                                                 const effect_uuid_t& uuid) {
+    auto previous = mPrevious.find(libPath);
+    if (previous == mPrevious.end()) {
+        return nullptr;
+    }
+    auto* desc = findIn(previous->second, uuid);
+    if (desc != nullptr) {
+        add(libPath, *desc);
+    }
+    return desc;
+}
+
+void DescriptorCache::add(const char* libPath, const effect_descriptor_t& desc) {
+    auto current = mCurrent.find(libPath);
+    if (current == mCurrent.end() || findIn(current->second, desc.uuid) != nullptr) {
+        return;
+    }
+    current->second.descriptors.push_back(desc);
+}
+
+/** Loads a library given its relative path and stores the result in libEntry.
+ * If a cache is provided and holds up to date descriptors for the library,
+ * the library is registered without being opened.
+ * @return true on success with libEntry's path filled,
+ *              and handle and desc filled if the library was opened
+ *         false on success with libEntry's path filled with the path of the failed lib
+ * The caller MUST free the resources path (free) and handle (dlclose) if filled.
+ */
+bool loadLibrary(const char* relativePath, lib_entry_t* libEntry,
+                 DescriptorCache* cache) noexcept {
+
+    std::string absolutePath;
+    if (!resolveLibrary(relativePath, &absolutePath)) {
+        ALOGE("Could not find library in effect directories: %s", relativePath);
+        libEntry->path = strdup(relativePath);
+        return false;
+    }
+    const char* path = absolutePath.c_str();
+    libEntry->path = strdup(path);
+
+    if (cache != nullptr && cache->isUpToDate(path)) {
+        ALOGV("Deferring load of library %s to its first effect creation", path);
+        return true;
+    }
+    return openLibrary(path, libEntry);
+}
+
 /** Because the structures will be destroyed by c code, using new to allocate shared structure
  * is not possible. Provide a equivalent of unique_ptr for malloc/freed structure to make sure
  * they are not leaked in the c++ code.
@@ -151,7 +358,7 @@ void listPush(UniqueCPtr<T>&& object, ListElem** list, pthread_mutex_t* mutex =
 
 size_t loadLibraries(const effectsConfig::Libraries& libs,
                      list_elem_t** libList, pthread_mutex_t* libListLock,
-                     list_elem_t** libFailedList)
+                     list_elem_t** libFailedList, DescriptorCache* cache)
 {
     size_t nbSkippedElement = 0;
     for (auto& library : libs) {
@@ -162,7 +369,7 @@ size_t loadLibraries(const effectsConfig::Libraries& libs,
         libEntry->effects = nullptr;
         pthread_mutex_init(&libEntry->lock, nullptr);
 
-        if (!loadLibrary(library.path.c_str(), libEntry.get())) {
+        if (!loadLibrary(library.path.c_str(), libEntry.get(), cache)) {
             // Register library load failure
             listPush(std::move(libEntry), libFailedList);
             ++nbSkippedElement;
@@ -210,7 +417,7 @@ struct LoadEffectResult {
 };
 
 LoadEffectResult loadEffect(const EffectImpl& effect, const std::string& name,
-                            list_elem_t* libList) {
+                            list_elem_t* libList, DescriptorCache* cache) {
     LoadEffectResult result;
 
     // Find the effect library
@@ -223,12 +430,25 @@ LoadEffectResult loadEffect(const EffectImpl& effect, const std::string& name,
 
     result.effectDesc = makeUniqueC<effect_descriptor_t>();
 
-    // Get the effect descriptor
-    if (result.lib->desc->get_descriptor(&effect.uuid, result.effectDesc.get()) != 0) {
+    // Get the effect descriptor, from the cache if the library was not opened
+    const effect_descriptor_t* cachedDesc = nullptr;
+    if (result.lib->handle == nullptr) {
+        cachedDesc = cache->find(result.lib->path, effect.uuid);
+        if (cachedDesc == nullptr && EffectLoadLibrary(result.lib) != 0) {
+            result.lib = nullptr;
+            result.effectDesc.reset();
+            return result;
+        }
+    }
+    if (cachedDesc != nullptr) {
+        *result.effectDesc = *cachedDesc;
+    } else if (result.lib->desc->get_descriptor(&effect.uuid, result.effectDesc.get()) != 0) {
         ALOGE("Error querying effect %s on lib %s",
               uuidToString(effect.uuid), result.lib->name);
         result.effectDesc.reset();
         return result;
+    } else if (cache != nullptr) {
+        cache->add(result.lib->path, *result.effectDesc);
     }
 
     // Dump effect for debug
@@ -257,12 +477,12 @@ LoadEffectResult loadEffect(const EffectImpl& effect, const std::string& name,
 }
 
 size_t loadEffects(const Effects& effects, list_elem_t* libList, list_elem_t** skippedEffects,
-                   list_sub_elem_t** subEffectList) {
+                   list_sub_elem_t** subEffectList, DescriptorCache* cache) {
     size_t nbSkippedElement = 0;
 
     for (auto& effect : effects) {
 
-        auto effectLoadResult = loadEffect(effect, effect.name, libList);
+        auto effectLoadResult = loadEffect(effect, effect.name, libList, cache);
         if (!effectLoadResult.success) {
             if (effectLoadResult.effectDesc != nullptr) {
                 listPush(std::move(effectLoadResult.effectDesc), skippedEffects);
@@ -272,8 +492,10 @@ size_t loadEffects(const Effects& effects, list_elem_t* libList, list_elem_t** s
         }
 
         if (effect.isProxy) {
-            auto swEffectLoadResult = loadEffect(effect.libSw, effect.name + " libsw", libList);
-            auto hwEffectLoadResult = loadEffect(effect.libHw, effect.name + " libhw", libList);
+            auto swEffectLoadResult = loadEffect(effect.libSw, effect.name + " libsw", libList,
+                                                 cache);
+            auto hwEffectLoadResult = loadEffect(effect.libHw, effect.name + " libhw", libList,
+                                                 cache);
             if (!swEffectLoadResult.success || !hwEffectLoadResult.success) {
                 // Push the main effect in the skipped list even if only a subeffect is invalid
                 // as the main effect is not usable without its subeffects.
@@ -321,10 +543,21 @@ extern "C" ssize_t EffectLoadXmlEffectConfig(const char* path)
         ALOGE("Failed to parse XML configuration file");
         return -1;
     }
+
+    // The descriptor cache is only used for the platform configuration.
+    std::unique_ptr<DescriptorCache> cache;
+    if (path == nullptr && property_get_bool(PROPERTY_LAZY_LOAD_EFFECTS, false)) {
+        cache = std::make_unique<DescriptorCache>();
+        cache->read(EFFECT_DESCRIPTOR_CACHE_PATH);
+    }
     result.nbSkippedElement += loadLibraries(result.parsedConfig->libraries,
-                                             &gLibraryList, &gLibLock, &gLibraryFailedList) +
+                                             &gLibraryList, &gLibLock, &gLibraryFailedList,
+                                             cache.get()) +
                                loadEffects(result.parsedConfig->effects, gLibraryList,
-                                           &gSkippedEffects, &gSubEffectList);
+                                           &gSkippedEffects, &gSubEffectList, cache.get());
+    if (cache != nullptr) {
+        cache->writeIfChanged(EFFECT_DESCRIPTOR_CACHE_PATH);
+    }
 
     ALOGE_IF(result.nbSkippedElement != 0, "%zu errors during loading of configuration: %s",
              result.nbSkippedElement,
@@ -333,4 +566,13 @@ extern "C" ssize_t EffectLoadXmlEffectConfig(const char* path)
     return result.nbSkippedElement;
 }
 
+extern "C" int EffectLoadLibrary(lib_entry_t* lib)
+{
+    if (lib->handle != nullptr) {
+        return 0;
+    }
+    ALOGV("Loading library %s on first use", lib->path);
+    return openLibrary(lib->path, lib) ? 0 : -ENODEV;
+}
+
 } // namespace android
@@ -37,6 +37,12 @@ extern "C" {
 ANDROID_API
 ssize_t EffectLoadXmlEffectConfig(const char* path);
 
+/** Opens a library registered lazily from the descriptor cache.
+ * Does nothing if the library is already opened. Must be called with gLibLock held.
+ * @return 0 on success, -ENODEV if the library could not be opened.
+ */
+int EffectLoadLibrary(lib_entry_t* lib);
+
 #if __cplusplus
 } // extern "C"
 #endif
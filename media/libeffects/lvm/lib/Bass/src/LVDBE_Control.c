@@ -140,9 +140,9 @@ void    LVDBE_SetFilters(LVDBE_Instance_t     *pInstance,
                                     &pInstance->pData->HPFTaps,
                                     (BQ_C32_Coefs_t *)&LVDBE_HPF_Table[Offset]);
 #else
-    BQ_2I_D32F32Cll_TRC_WRA_01_Init(&pInstance->pCoef->HPFInstance,    /* Initialise the filter */
-                                    &pInstance->pData->HPFTaps,
-                                    (BQ_FLOAT_Coefs_t *)&LVDBE_HPF_Table[Offset]);
+    BQ_Mc_D32F32_TDF2_BQ_Init(&pInstance->pCoef->HPFSection,       /* Initialise the filter */
+                              &pInstance->pData->HPFTaps,
+                              (BQ_FLOAT_Coefs_t *)&LVDBE_HPF_Table[Offset]);
 #endif
 
 
@@ -165,9 +165,9 @@ void    LVDBE_SetFilters(LVDBE_Instance_t     *pInstance,
                                     &pInstance->pData->BPFTaps,
                                     (BP_C32_Coefs_t *)&LVDBE_BPF_Table[Offset]);
 #else
-    BP_1I_D32F32Cll_TRC_WRA_02_Init(&pInstance->pCoef->BPFInstance,    /* Initialise the filter */
-                                    &pInstance->pData->BPFTaps,
-                                    (BP_FLOAT_Coefs_t *)&LVDBE_BPF_Table[Offset]);
+    BQ_Mc_D32F32_TDF2_BP_Init(&pInstance->pCoef->BPFSection,       /* Initialise the filter */
+                              &pInstance->pData->BPFTaps,
+                              (BP_FLOAT_Coefs_t *)&LVDBE_BPF_Table[Offset]);
 #endif
 }
 
@@ -123,8 +123,8 @@ typedef struct
 typedef struct
 {
     /* Process variables */
-    Biquad_FLOAT_Instance_t           HPFInstance;        /* High pass filter instance */
-    Biquad_FLOAT_Instance_t           BPFInstance;        /* Band pass filter instance */
+    BQ_TDF2_FLOAT_Section_t           HPFSection;         /* High pass filter section */
+    BQ_TDF2_FLOAT_Section_t           BPFSection;         /* Band pass filter section */
 } LVDBE_Coef_FLOAT_t;
 #endif
 /* Instance structure */
@@ -249,18 +249,12 @@ LVDBE_ReturnStatus_en LVDBE_Process(LVDBE_Handle_t hInstance,
      */
     if (pInstance->Params.HPFSelect == LVDBE_HPF_ON)
     {
-#ifdef SUPPORT_MC
-      BQ_MC_D32F32C30_TRC_WRA_01(&pInstance->pCoef->HPFInstance, /* Filter instance      */
+      BQ_Mc_D32F32_TDF2_Cascade(&pInstance->pCoef->HPFSection, /* Filter section       */
+          1, /* One section          */
           pScratch, /* Source               */
           pScratch, /* Destination          */
           (LVM_INT16)NrFrames,
           (LVM_INT16)NrChannels);
-#else
-      BQ_2I_D32F32C30_TRC_WRA_01(&pInstance->pCoef->HPFInstance,/* Filter instance      */
-          pScratch, /* Source               */
-          pScratch, /* Destination          */
-          (LVM_INT16)NrFrames);
-#endif
     }
 
     /*
@@ -280,10 +274,12 @@ LVDBE_ReturnStatus_en LVDBE_Process(LVDBE_Handle_t hInstance,
     /*
      * Apply the band pass filter
      */
-    BP_1I_D32F32C30_TRC_WRA_02(&pInstance->pCoef->BPFInstance, /* Filter instance       */
+    BQ_Mc_D32F32_TDF2_Cascade(&pInstance->pCoef->BPFSection, /* Filter section        */
+        1, /* One section           */
         pMono, /* Source                */
         pMono, /* Destination           */
-        (LVM_INT16)NrFrames);
+        (LVM_INT16)NrFrames,
+        1); /* Mono                  */
 
     /*
      * Apply the AGC and mix
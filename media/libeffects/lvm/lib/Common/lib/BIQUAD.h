@@ -175,6 +175,21 @@ typedef struct
 } PK_C32_Coefs_t;
 #endif
 
+/*** Transposed direct form II cascade section ************************************/
+#ifdef BUILD_FLOAT
+typedef struct
+{
+    LVM_FLOAT *pStates;  /* s1 then s2 for each channel, in the section taps */
+    LVM_FLOAT A0;   /*  a0  */
+    LVM_FLOAT A1;   /*  a1  */
+    LVM_FLOAT A2;   /*  a2  */
+    LVM_FLOAT B1;   /* -b1! */
+    LVM_FLOAT B2;   /* -b2! */
+    LVM_FLOAT G;    /* Gain of the filtered path */
+    LVM_FLOAT D;    /* Gain of the direct path, added to the output */
+} BQ_TDF2_FLOAT_Section_t;
+#endif
+
 /**********************************************************************************
    TAPS TYPE DEFINITIONS
 ***********************************************************************************/
@@ -574,6 +589,31 @@ void PK_2I_D32F32C14G11_TRC_WRA_01 (        Biquad_Instance_t       *pInstance,
                                             LVM_INT16                    NrSamples);
 #endif
 
+/**********************************************************************************
+   FUNCTION PROTOTYPES: TRANSPOSED DIRECT FORM II CASCADE
+***********************************************************************************/
+
+/*** 32 bit data path MULTI-CHANNEL ***********************************************/
+#ifdef BUILD_FLOAT
+/* The taps hold two states per channel, half of the direct form I taps */
+void BQ_Mc_D32F32_TDF2_BQ_Init(     BQ_TDF2_FLOAT_Section_t       *pSection,
+                                    void                          *pTaps,
+                                    const BQ_FLOAT_Coefs_t        *pCoef);
+void BQ_Mc_D32F32_TDF2_BP_Init(     BQ_TDF2_FLOAT_Section_t       *pSection,
+                                    void                          *pTaps,
+                                    const BP_FLOAT_Coefs_t        *pCoef);
+void BQ_Mc_D32F32_TDF2_PK_Init(     BQ_TDF2_FLOAT_Section_t       *pSection,
+                                    void                          *pTaps,
+                                    const PK_FLOAT_Coefs_t        *pCoef);
+
+void BQ_Mc_D32F32_TDF2_Cascade(     const BQ_TDF2_FLOAT_Section_t *pSections,
+                                    LVM_INT16                     NrSections,
+                                    const LVM_FLOAT               *pDataIn,
+                                    LVM_FLOAT                     *pDataOut,
+                                    LVM_INT16                     NrFrames,
+                                    LVM_INT16                     NrChannels);
+#endif
+
 /**********************************************************************************
    FUNCTION PROTOTYPES: DC REMOVAL FILTERS
 ***********************************************************************************/
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BIQUAD.h"
+#include "VectorArithmetic.h"
+
+#ifdef BUILD_FLOAT
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE
+#endif
+
+/**************************************************************************
+ ASSUMPTIONS:
+ COEFS-
+ pSections[k] holds A0, A1, A2, -B1, -B2 and the gains G and D of section k
+
+ STATES-
+ pSections[k].pStates[0] to
+ pSections[k].pStates[NrChannels - 1] is s1 for all NrChannels
+
+ pSections[k].pStates[NrChannels] to
+ pSections[k].pStates[2*NrChannels - 1] is s2 for all NrChannels
+
+ Each section computes, in transposed direct form II,
+     y(n)  = A0 * x(n) + s1
+     s1    = (A1 * x(n) + (-B1) * y(n)) + s2
+     s2    = A2 * x(n) + (-B2) * y(n)
+     out   = D * x(n) + G * y(n)
+
+ The sections are run one after the other over the whole block, so the
+ states and coefficients of a section stay in registers. Four channels are
+ processed at a time in the SIMD lanes, then pairs, then single channels.
+ Every path rounds in the same order and without fused multiply-add, so a
+ channel gives the same output whatever the channel count.
+***************************************************************************/
+
+static void BQ_TDF2_Section(const BQ_TDF2_FLOAT_Section_t *pCoef,
+                            const LVM_FLOAT               *pDataIn,
+                            LVM_FLOAT                     *pDataOut,
+                            LVM_INT16                     NrFrames,
+                            LVM_INT16                     NrChannels)
+{
+    LVM_FLOAT * const pState = pCoef->pStates;
+    LVM_INT16 ii, jj = 0;
+
+#if defined(USE_NEON)
+    const float32x4_t A0 = vdupq_n_f32(pCoef->A0);
+    const float32x4_t A1 = vdupq_n_f32(pCoef->A1);
+    const float32x4_t A2 = vdupq_n_f32(pCoef->A2);
+    const float32x4_t B1 = vdupq_n_f32(pCoef->B1);
+    const float32x4_t B2 = vdupq_n_f32(pCoef->B2);
+    const float32x4_t G  = vdupq_n_f32(pCoef->G);
+    const float32x4_t D  = vdupq_n_f32(pCoef->D);
+
+    for (; jj + 4 <= NrChannels; jj += 4)
+    {
+        float32x4_t s1 = vld1q_f32(pState + jj);
+        float32x4_t s2 = vld1q_f32(pState + NrChannels + jj);
+        const LVM_FLOAT *pIn = pDataIn + jj;
+        LVM_FLOAT *pOut = pDataOut + jj;
+
+        for (ii = NrFrames; ii != 0; ii--)
+        {
+            const float32x4_t xn = vld1q_f32(pIn);
+            const float32x4_t yn = vaddq_f32(vmulq_f32(A0, xn), s1);
+            s1 = vaddq_f32(vaddq_f32(vmulq_f32(A1, xn), vmulq_f32(B1, yn)), s2);
+            s2 = vaddq_f32(vmulq_f32(A2, xn), vmulq_f32(B2, yn));
+            vst1q_f32(pOut, vaddq_f32(vmulq_f32(D, xn), vmulq_f32(G, yn)));
+            pIn += NrChannels;
+            pOut += NrChannels;
+        }
+        vst1q_f32(pState + jj, s1);
+        vst1q_f32(pState + NrChannels + jj, s2);
+    }
+
+    /* Two channels at a time, the common stereo case */
+    for (; jj + 2 <= NrChannels; jj += 2)
+    {
+        float32x2_t s1 = vld1_f32(pState + jj);
+        float32x2_t s2 = vld1_f32(pState + NrChannels + jj);
+        const LVM_FLOAT *pIn = pDataIn + jj;
+        LVM_FLOAT *pOut = pDataOut + jj;
+
+        for (ii = NrFrames; ii != 0; ii--)
+        {
+            const float32x2_t xn = vld1_f32(pIn);
+            const float32x2_t yn = vadd_f32(vmul_f32(vget_low_f32(A0), xn), s1);
+            s1 = vadd_f32(vadd_f32(vmul_f32(vget_low_f32(A1), xn),
+                                   vmul_f32(vget_low_f32(B1), yn)), s2);
+            s2 = vadd_f32(vmul_f32(vget_low_f32(A2), xn), vmul_f32(vget_low_f32(B2), yn));
+            vst1_f32(pOut, vadd_f32(vmul_f32(vget_low_f32(D), xn),
+                                    vmul_f32(vget_low_f32(G), yn)));
+            pIn += NrChannels;
+            pOut += NrChannels;
+        }
+        vst1_f32(pState + jj, s1);
+        vst1_f32(pState + NrChannels + jj, s2);
+    }
+#elif defined(USE_SSE)
+    const __m128 A0 = _mm_set1_ps(pCoef->A0);
+    const __m128 A1 = _mm_set1_ps(pCoef->A1);
+    const __m128 A2 = _mm_set1_ps(pCoef->A2);
+    const __m128 B1 = _mm_set1_ps(pCoef->B1);
+    const __m128 B2 = _mm_set1_ps(pCoef->B2);
+    const __m128 G  = _mm_set1_ps(pCoef->G);
+    const __m128 D  = _mm_set1_ps(pCoef->D);
+
+    for (; jj + 4 <= NrChannels; jj += 4)
+    {
+        __m128 s1 = _mm_loadu_ps(pState + jj);
+        __m128 s2 = _mm_loadu_ps(pState + NrChannels + jj);
+        const LVM_FLOAT *pIn = pDataIn + jj;
+        LVM_FLOAT *pOut = pDataOut + jj;
+
+        for (ii = NrFrames; ii != 0; ii--)
+        {
+            const __m128 xn = _mm_loadu_ps(pIn);
+            const __m128 yn = _mm_add_ps(_mm_mul_ps(A0, xn), s1);
+            s1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(A1, xn), _mm_mul_ps(B1, yn)), s2);
+            s2 = _mm_add_ps(_mm_mul_ps(A2, xn), _mm_mul_ps(B2, yn));
+            _mm_storeu_ps(pOut, _mm_add_ps(_mm_mul_ps(D, xn), _mm_mul_ps(G, yn)));
+            pIn += NrChannels;
+            pOut += NrChannels;
+        }
+        _mm_storeu_ps(pState + jj, s1);
+        _mm_storeu_ps(pState + NrChannels + jj, s2);
+    }
+
+    /* Two channels at a time in the low half, the common stereo case */
+    for (; jj + 2 <= NrChannels; jj += 2)
+    {
+        __m128 s1 = _mm_castpd_ps(_mm_load_sd((const double *)(pState + jj)));
+        __m128 s2 = _mm_castpd_ps(_mm_load_sd((const double *)(pState + NrChannels + jj)));
+        const LVM_FLOAT *pIn = pDataIn + jj;
+        LVM_FLOAT *pOut = pDataOut + jj;
+
+        for (ii = NrFrames; ii != 0; ii--)
+        {
+            const __m128 xn = _mm_castpd_ps(_mm_load_sd((const double *)pIn));
+            const __m128 yn = _mm_add_ps(_mm_mul_ps(A0, xn), s1);
+            s1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(A1, xn), _mm_mul_ps(B1, yn)), s2);
+            s2 = _mm_add_ps(_mm_mul_ps(A2, xn), _mm_mul_ps(B2, yn));
+            _mm_store_sd((double *)pOut,
+                         _mm_castps_pd(_mm_add_ps(_mm_mul_ps(D, xn), _mm_mul_ps(G, yn))));
+            pIn += NrChannels;
+            pOut += NrChannels;
+        }
+        _mm_store_sd((double *)(pState + jj), _mm_castps_pd(s1));
+        _mm_store_sd((double *)(pState + NrChannels + jj), _mm_castps_pd(s2));
+    }
+#endif
+
+    for (; jj < NrChannels; jj++)
+    {
+        LVM_FLOAT s1 = pState[jj];
+        LVM_FLOAT s2 = pState[NrChannels + jj];
+        LVM_FLOAT xn, yn, temp;
+        const LVM_FLOAT *pIn = pDataIn + jj;
+        LVM_FLOAT *pOut = pDataOut + jj;
+
+        /* One operation per statement so that nothing is contracted */
+        for (ii = NrFrames; ii != 0; ii--)
+        {
+            xn = *pIn;
+
+            /* yn = A0 * x(n) + s1 */
+            yn = pCoef->A0 * xn;
+            yn += s1;
+
+            /* s1 = (A1 * x(n) + (-B1) * yn) + s2 */
+            s1 = pCoef->A1 * xn;
+            temp = pCoef->B1 * yn;
+            s1 += temp;
+            s1 += s2;
+
+            /* s2 = A2 * x(n) + (-B2) * yn */
+            s2 = pCoef->A2 * xn;
+            temp = pCoef->B2 * yn;
+            s2 += temp;
+
+            /* out = D * x(n) + G * yn */
+            temp = pCoef->D * xn;
+            yn = pCoef->G * yn;
+            temp += yn;
+
+            *pOut = temp;
+            pIn += NrChannels;
+            pOut += NrChannels;
+        }
+        pState[jj] = s1;
+        pState[NrChannels + jj] = s2;
+    }
+}
+
+void BQ_Mc_D32F32_TDF2_Cascade(const BQ_TDF2_FLOAT_Section_t *pSections,
+                               LVM_INT16                     NrSections,
+                               const LVM_FLOAT               *pDataIn,
+                               LVM_FLOAT                     *pDataOut,
+                               LVM_INT16                     NrFrames,
+                               LVM_INT16                     NrChannels)
+{
+    LVM_INT16 kk;
+
+    if (NrSections == 0)
+    {
+        if (pDataIn != pDataOut)
+        {
+            Copy_Float(pDataIn, pDataOut, (LVM_INT16)(NrFrames * NrChannels));
+        }
+        return;
+    }
+
+    /* The first section reads the input, the others work in place on the output */
+    for (kk = 0; kk < NrSections; kk++)
+    {
+        BQ_TDF2_Section(&pSections[kk],
+                        (kk == 0) ? pDataIn : pDataOut,
+                        pDataOut,
+                        NrFrames,
+                        NrChannels);
+    }
+}
+#endif
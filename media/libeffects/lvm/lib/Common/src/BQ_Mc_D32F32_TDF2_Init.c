@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BIQUAD.h"
+
+#ifdef BUILD_FLOAT
+/**************************************************************************
+ Conversion of the existing coefficient types to one section of the
+ transposed direct form II cascade. The denominators keep the negated
+ -B1 and -B2 of the original tables. The taps are not cleared, so the
+ coefficients can be changed while the filter is running.
+***************************************************************************/
+
+/* H(z) = (A0 + A1 z^-1 + A2 z^-2) / (1 - (-B1) z^-1 - (-B2) z^-2) */
+void BQ_Mc_D32F32_TDF2_BQ_Init(BQ_TDF2_FLOAT_Section_t   *pSection,
+                               void                      *pTaps,
+                               const BQ_FLOAT_Coefs_t    *pCoef)
+{
+    pSection->pStates = (LVM_FLOAT *)pTaps;
+    pSection->A0 = pCoef->A0;
+    pSection->A1 = pCoef->A1;
+    pSection->A2 = pCoef->A2;
+    pSection->B1 = pCoef->B1;
+    pSection->B2 = pCoef->B2;
+    pSection->G  = 1.0f;
+    pSection->D  = 0.0f;
+}
+
+/* H(z) = A0 (1 - z^-2) / (1 - (-B1) z^-1 - (-B2) z^-2) */
+void BQ_Mc_D32F32_TDF2_BP_Init(BQ_TDF2_FLOAT_Section_t   *pSection,
+                               void                      *pTaps,
+                               const BP_FLOAT_Coefs_t    *pCoef)
+{
+    pSection->pStates = (LVM_FLOAT *)pTaps;
+    pSection->A0 = pCoef->A0;
+    pSection->A1 = 0.0f;
+    pSection->A2 = -pCoef->A0;
+    pSection->B1 = pCoef->B1;
+    pSection->B2 = pCoef->B2;
+    pSection->G  = 1.0f;
+    pSection->D  = 0.0f;
+}
+
+/*
+ * H(z) = 1 + G * A0 (1 - z^-2) / (1 - (-B1) z^-1 - (-B2) z^-2)
+ *
+ * The unity path and the gain are kept outside the recursion. Folding them into
+ * the numerator costs about 20 dB of precision for the low frequency bands, and
+ * the states would no longer carry over when only the gain changes.
+ */
+void BQ_Mc_D32F32_TDF2_PK_Init(BQ_TDF2_FLOAT_Section_t   *pSection,
+                               void                      *pTaps,
+                               const PK_FLOAT_Coefs_t    *pCoef)
+{
+    pSection->pStates = (LVM_FLOAT *)pTaps;
+    pSection->A0 = pCoef->A0;
+    pSection->A1 = 0.0f;
+    pSection->A2 = -pCoef->A0;
+    pSection->B1 = pCoef->B1;
+    pSection->B2 = pCoef->B2;
+    pSection->G  = pCoef->G;
+    pSection->D  = 1.0f;
+}
+#endif
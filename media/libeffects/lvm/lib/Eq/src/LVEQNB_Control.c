@@ -219,6 +219,43 @@ void    LVEQNB_SetFilters(LVEQNB_Instance_t     *pInstance,
 /*                                                                                  */
 /************************************************************************************/
 
+#ifdef BUILD_FLOAT
+void    LVEQNB_SetCoefficients(LVEQNB_Instance_t     *pInstance)
+{
+
+    LVM_UINT16              i;                          /* Filter band index */
+    LVM_UINT16              NSections = 0;              /* Number of cascade sections */
+
+
+    /*
+     * Only the bands with a non-zero gain are added to the cascade, the others
+     * are transparent. Each band keeps its own taps, so its history is preserved
+     * when other bands are switched on or off.
+     */
+    for (i=0; i<pInstance->Params.NBands; i++)
+    {
+        if ((pInstance->pBiquadType[i] == LVEQNB_SinglePrecision_Float) &&
+            (pInstance->pBandDefinitions[i].Gain != 0))
+        {
+            PK_FLOAT_Coefs_t      Coefficients;
+            /*
+             * Calculate the single precision coefficients
+             */
+            LVEQNB_SinglePrecCoefs((LVM_UINT16)pInstance->Params.SampleRate,
+                                   &pInstance->pBandDefinitions[i],
+                                   &Coefficients);
+            /*
+             * Set the coefficients
+             */
+            BQ_Mc_D32F32_TDF2_PK_Init(&pInstance->pEQNB_Sections_Float[NSections],
+                                      &pInstance->pEQNB_Taps_Float[i],
+                                      &Coefficients);
+            NSections++;
+        }
+    }
+    pInstance->NSections = NSections;
+}
+#else
 void    LVEQNB_SetCoefficients(LVEQNB_Instance_t     *pInstance)
 {
 
@@ -238,25 +275,6 @@ void    LVEQNB_SetCoefficients(LVEQNB_Instance_t     *pInstance)
         BiquadType = pInstance->pBiquadType[i];
         switch  (BiquadType)
         {
-#ifdef BUILD_FLOAT
-            case    LVEQNB_SinglePrecision_Float:
-            {
-                PK_FLOAT_Coefs_t      Coefficients;
-                /*
-                 * Calculate the single precision coefficients
-                 */
-                LVEQNB_SinglePrecCoefs((LVM_UINT16)pInstance->Params.SampleRate,
-                                       &pInstance->pBandDefinitions[i],
-                                       &Coefficients);
-                /*
-                 * Set the coefficients
-                 */
-                PK_2I_D32F32CssGss_TRC_WRA_01_Init(&pInstance->pEQNB_FilterState_Float[i],
-                                                   &pInstance->pEQNB_Taps_Float[i],
-                                                   &Coefficients);
-                break;
-            }
-#else
             case    LVEQNB_DoublePrecision:
             {
                 PK_C32_Coefs_t      Coefficients;
@@ -296,13 +314,13 @@ void    LVEQNB_SetCoefficients(LVEQNB_Instance_t     *pInstance)
                                                    &Coefficients);
                 break;
             }
-#endif
             default:
                 break;
         }
     }
 
 }
+#endif
 
 
 /************************************************************************************/
@@ -138,9 +138,9 @@ LVEQNB_ReturnStatus_en LVEQNB_Memory(LVEQNB_Handle_t            hInstance,
                             sizeof(Biquad_FLOAT_Instance_t));
         InstAlloc_AddMember(&AllocMem,                              /* High pass filter */
                             sizeof(Biquad_FLOAT_Instance_t));
-        /* Equaliser Biquad Instance */
+        /* Equaliser cascade sections */
         InstAlloc_AddMember(&AllocMem,
-                            pCapabilities->MaxBands * sizeof(Biquad_FLOAT_Instance_t));
+                            pCapabilities->MaxBands * sizeof(BQ_TDF2_FLOAT_Section_t));
 #else
         InstAlloc_AddMember(&AllocMem,                              /* Low pass filter */
                             sizeof(Biquad_Instance_t));
@@ -281,10 +281,10 @@ LVEQNB_ReturnStatus_en LVEQNB_Init(LVEQNB_Handle_t          *phInstance,
                    pMemoryTable->Region[LVEQNB_MEMREGION_PERSISTENT_COEF].pBaseAddress);
 
 #ifdef BUILD_FLOAT
-    /* Equaliser Biquad Instance */
-    pInstance->pEQNB_FilterState_Float = InstAlloc_AddMember(&AllocMem,
-                                                             pCapabilities->MaxBands * \
-                                                             sizeof(Biquad_FLOAT_Instance_t));
+    /* Equaliser cascade sections */
+    pInstance->pEQNB_Sections_Float = InstAlloc_AddMember(&AllocMem,
+                                                          pCapabilities->MaxBands * \
+                                                          sizeof(BQ_TDF2_FLOAT_Section_t));
 #else
     pInstance->pEQNB_FilterState = InstAlloc_AddMember(&AllocMem,
                                                        pCapabilities->MaxBands * sizeof(Biquad_Instance_t)); /* Equaliser Biquad Instance */
@@ -100,7 +100,8 @@ typedef struct
 
 #ifdef BUILD_FLOAT
     Biquad_2I_Order2_FLOAT_Taps_t   *pEQNB_Taps_Float;        /* Equaliser Taps */
-    Biquad_FLOAT_Instance_t         *pEQNB_FilterState_Float; /* State for each filter band */
+    BQ_TDF2_FLOAT_Section_t         *pEQNB_Sections_Float;    /* Cascade of the active bands */
+    LVM_UINT16                      NSections;                /* Number of cascade sections */
 #else
     /* Process variables */
     Biquad_2I_Order2_Taps_t         *pEQNB_Taps;        /* Equaliser Taps */
@@ -100,57 +100,15 @@ LVEQNB_ReturnStatus_en LVEQNB_Process(LVEQNB_Handle_t       hInstance,
     if (pInstance->Params.OperatingMode == LVEQNB_ON)
     {
         /*
-         * Copy input data in to scratch buffer
+         * Filter the input into the scratch buffer through the cascade of
+         * the bands with a non-zero gain, this copies if there are none
          */
-        Copy_Float(pInData,     /* Source */
-                   pScratch,    /* Destination */
-                   (LVM_INT16)NrSamples);
-
-        /*
-         * For each section execte the filter unless the gain is 0dB
-         */
-        if (pInstance->NBands != 0)
-        {
-            for (LVM_UINT16 i = 0; i < pInstance->NBands; i++)
-            {
-                /*
-                 * Check if band is non-zero dB gain
-                 */
-                if (pInstance->pBandDefinitions[i].Gain != 0)
-                {
-                    /*
-                     * Get the address of the biquad instance
-                     */
-                    Biquad_FLOAT_Instance_t *pBiquad = &pInstance->pEQNB_FilterState_Float[i];
-
-
-                    /*
-                     * Select single or double precision as required
-                     */
-                    switch (pInstance->pBiquadType[i])
-                    {
-                        case LVEQNB_SinglePrecision_Float:
-                        {
-#ifdef SUPPORT_MC
-                            PK_Mc_D32F32C14G11_TRC_WRA_01(pBiquad,
-                                                          pScratch,
-                                                          pScratch,
-                                                          (LVM_INT16)NrFrames,
-                                                          (LVM_INT16)NrChannels);
-#else
-                            PK_2I_D32F32C14G11_TRC_WRA_01(pBiquad,
-                                                          pScratch,
-                                                          pScratch,
-                                                          (LVM_INT16)NrFrames);
-#endif
-                            break;
-                        }
-                        default:
-                            break;
-                    }
-                }
-            }
-        }
+        BQ_Mc_D32F32_TDF2_Cascade(pInstance->pEQNB_Sections_Float,
+                                  (LVM_INT16)pInstance->NSections,
+                                  pInData,
+                                  pScratch,
+                                  (LVM_INT16)NrFrames,
+                                  (LVM_INT16)NrChannels);
 
 
         if(pInstance->bInOperatingModeTransition == LVM_TRUE){
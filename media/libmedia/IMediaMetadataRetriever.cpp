@@ -74,6 +74,7 @@ enum {
     GET_FRAME_AT_INDEX,
     EXTRACT_ALBUM_ART,
     EXTRACT_METADATA,
+    GET_FRAMES_AT_TIMES,
 };
 
 class BpMediaMetadataRetriever: public BpInterface<IMediaMetadataRetriever>
@@ -242,6 +243,37 @@ public:
         return OK;
     }
 
+    status_t getFramesAtTimes(std::vector<sp<IMemory> > *frames,
+            const std::vector<int64_t> &timesUs, int option, int colorFormat,
+            int maxWidth, int maxHeight)
+    {
+        ALOGV("getFramesAtTimes: %zu times, option(%d), colorFormat(%d), max size(%dx%d)",
+                timesUs.size(), option, colorFormat, maxWidth, maxHeight);
+        Parcel data, reply;
+        data.writeInterfaceToken(IMediaMetadataRetriever::getInterfaceDescriptor());
+        data.writeInt64Vector(timesUs);
+        data.writeInt32(option);
+        data.writeInt32(colorFormat);
+        data.writeInt32(maxWidth);
+        data.writeInt32(maxHeight);
+#ifndef DISABLE_GROUP_SCHEDULE_HACK
+        sendSchedPolicy(data);
+#endif
+        remote()->transact(GET_FRAMES_AT_TIMES, data, &reply);
+        status_t ret = reply.readInt32();
+        if (ret != NO_ERROR) {
+            return ret;
+        }
+        int numFrames = reply.readInt32();
+        if (numFrames < 0 || (size_t)numFrames > timesUs.size()) {
+            return UNKNOWN_ERROR;
+        }
+        for (int i = 0; i < numFrames; i++) {
+            frames->push_back(interface_cast<IMemory>(reply.readStrongBinder()));
+        }
+        return OK;
+    }
+
     sp<IMemory> extractAlbumArt()
     {
         Parcel data, reply;
@@ -452,6 +484,38 @@ status_t BnMediaMetadataRetriever::onTransact(
             }
 #ifndef DISABLE_GROUP_SCHEDULE_HACK
             restoreSchedPolicy();
+#endif
+            return NO_ERROR;
+        } break;
+        case GET_FRAMES_AT_TIMES: {
+            CHECK_INTERFACE(IMediaMetadataRetriever, data, reply);
+            std::vector<int64_t> timesUs;
+            status_t err = data.readInt64Vector(&timesUs);
+            int option = data.readInt32();
+            int colorFormat = data.readInt32();
+            int maxWidth = data.readInt32();
+            int maxHeight = data.readInt32();
+            if (err != OK) {
+                reply->writeInt32(err);
+                return NO_ERROR;
+            }
+            ALOGV("getFramesAtTimes: %zu times, option(%d), colorFormat(%d), max size(%dx%d)",
+                    timesUs.size(), option, colorFormat, maxWidth, maxHeight);
+#ifndef DISABLE_GROUP_SCHEDULE_HACK
+            setSchedPolicy(data);
+#endif
+            std::vector<sp<IMemory> > frames;
+            err = getFramesAtTimes(
+                    &frames, timesUs, option, colorFormat, maxWidth, maxHeight);
+            reply->writeInt32(err);
+            if (OK == err) {
+                reply->writeInt32(frames.size());
+                for (size_t i = 0; i < frames.size(); i++) {
+                    reply->writeStrongBinder(IInterface::asBinder(frames[i]));
+                }
+            }
+#ifndef DISABLE_GROUP_SCHEDULE_HACK
+            restoreSchedPolicy();
 #endif
             return NO_ERROR;
         } break;
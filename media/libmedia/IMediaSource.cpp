@@ -18,8 +18,10 @@
 #define LOG_TAG "BpMediaSource"
 #include <utils/Log.h>
 
+#include <algorithm>
 #include <inttypes.h>
 #include <stdint.h>
+#include <strings.h>
 #include <sys/types.h>
 
 #include <binder/Parcel.h>
@@ -40,6 +42,7 @@ enum {
     READMULTIPLE,
     RELEASE_BUFFER,
     SUPPORT_NONBLOCKING_READ,
+    READ_RING,
 };
 
 enum {
@@ -72,6 +75,10 @@ public:
     {
     }
 
+    virtual ~BpMediaSource() {
+        flushRing();
+    }
+
     virtual status_t start(MetaData *params) {
         ALOGV("start");
         Parcel data, reply;
@@ -95,6 +102,8 @@ public:
         ALOGV("stop");
         Parcel data, reply;
         data.writeInterfaceToken(BpMediaSource::getInterfaceDescriptor());
+        flushRing();
+        mRing.clear();
         status_t status = remote()->transact(STOP, data, &reply);
         mMemoryCache.reset();
         mBuffersSinceStop = 0;
@@ -131,6 +140,13 @@ public:
         if (buffers == NULL || !buffers->isEmpty()) {
             return BAD_VALUE;
         }
+        if (!mRingUnsupported) {
+            status_t ret = readMultipleFromRing(buffers, maxNumBuffers, options);
+            if (!mRingUnsupported) {
+                return ret;
+            }
+            // the source has no ring, read the usual way
+        }
         Parcel data, reply;
         data.writeInterfaceToken(BpMediaSource::getInterfaceDescriptor());
         data.writeUint32(maxNumBuffers);
@@ -149,38 +165,7 @@ public:
             LOG_ALWAYS_FATAL_IF(bufferCount >= maxNumBuffers,
                     "Received %u+ buffers and requested %u buffers",
                     bufferCount + 1, maxNumBuffers);
-            MediaBuffer *buf;
-            if (buftype == SHARED_BUFFER || buftype == SHARED_BUFFER_INDEX) {
-                uint64_t index = reply.readUint64();
-                ALOGV("Received %s index %llu",
-                        buftype == SHARED_BUFFER ? "SHARED_BUFFER" : "SHARED_BUFFER_INDEX",
-                        (unsigned long long) index);
-                sp<IMemory> mem;
-                if (buftype == SHARED_BUFFER) {
-                    sp<IBinder> binder = reply.readStrongBinder();
-                    mem = interface_cast<IMemory>(binder);
-                    LOG_ALWAYS_FATAL_IF(mem.get() == nullptr,
-                            "Received NULL IMemory for shared buffer");
-                    mMemoryCache.insert(index, mem);
-                } else {
-                    mem = mMemoryCache.lookup(index);
-                    LOG_ALWAYS_FATAL_IF(mem.get() == nullptr,
-                            "Received invalid IMemory index for shared buffer: %llu",
-                            (unsigned long long)index);
-                }
-                size_t offset = reply.readInt32();
-                size_t length = reply.readInt32();
-                buf = new RemoteMediaBufferWrapper(mem);
-                buf->set_range(offset, length);
-                buf->meta_data().updateFromParcel(reply);
-            } else { // INLINE_BUFFER
-                int32_t len = reply.readInt32();
-                ALOGV("INLINE_BUFFER status %d and len %d", ret, len);
-                buf = new MediaBuffer(len);
-                reply.read(buf->data(), len);
-                buf->meta_data().updateFromParcel(reply);
-            }
-            buffers->push_back(buf);
+            buffers->push_back(readBuffer(reply, buftype));
             ++bufferCount;
             ++mBuffersSinceStop;
         }
@@ -218,8 +203,141 @@ public:
 
 private:
 
+    // Reads one buffer of a readMultiple reply.
+    MediaBufferBase *readBuffer(const Parcel &reply, int32_t buftype) {
+        MediaBuffer *buf;
+        if (buftype == SHARED_BUFFER || buftype == SHARED_BUFFER_INDEX) {
+            uint64_t index = reply.readUint64();
+            ALOGV("Received %s index %llu",
+                    buftype == SHARED_BUFFER ? "SHARED_BUFFER" : "SHARED_BUFFER_INDEX",
+                    (unsigned long long) index);
+            sp<IMemory> mem;
+            if (buftype == SHARED_BUFFER) {
+                sp<IBinder> binder = reply.readStrongBinder();
+                mem = interface_cast<IMemory>(binder);
+                LOG_ALWAYS_FATAL_IF(mem.get() == nullptr,
+                        "Received NULL IMemory for shared buffer");
+                mMemoryCache.insert(index, mem);
+            } else {
+                mem = mMemoryCache.lookup(index);
+                LOG_ALWAYS_FATAL_IF(mem.get() == nullptr,
+                        "Received invalid IMemory index for shared buffer: %llu",
+                        (unsigned long long)index);
+            }
+            size_t offset = reply.readInt32();
+            size_t length = reply.readInt32();
+            buf = new RemoteMediaBufferWrapper(mem);
+            buf->set_range(offset, length);
+            buf->meta_data().updateFromParcel(reply);
+        } else { // INLINE_BUFFER
+            int32_t len = reply.readInt32();
+            ALOGV("INLINE_BUFFER len %d", len);
+            buf = new MediaBuffer(len);
+            reply.read(buf->data(), len);
+            buf->meta_data().updateFromParcel(reply);
+        }
+        return buf;
+    }
+
+    // Returns the buffers read ahead into the ring first, then the status that ended
+    // the fill, on the next call. Sets mRingUnsupported if the source has no ring.
+    status_t readMultipleFromRing(
+            Vector<MediaBufferBase *> *buffers, uint32_t maxNumBuffers,
+            const MediaSource::ReadOptions *options) {
+        int64_t seekTimeUs;
+        MediaSource::ReadOptions::SeekMode mode;
+        if (options != nullptr && options->getSeekTo(&seekTimeUs, &mode)) {
+            flushRing(); // read ahead of the old position
+        }
+        if (mRingBuffers.empty() && mRingStatus == OK) {
+            status_t ret = fillRing(maxNumBuffers, options);
+            if (ret != OK) {
+                return ret;
+            }
+        }
+        while (!mRingBuffers.empty() && buffers->size() < maxNumBuffers) {
+            buffers->push_back(mRingBuffers.front());
+            mRingBuffers.pop_front();
+            ++mBuffersSinceStop;
+        }
+        // Buffers always come with OK, as callers may drop a buffer returned with an
+        // error. The status that ended the fill is reported once they are all returned.
+        if (buffers->size() > 0) {
+            if (mRingBuffers.empty() && mRingStatus == WOULD_BLOCK) {
+                mRingStatus = OK;
+            }
+            return OK;
+        }
+        status_t ret = mRingStatus;
+        mRingStatus = OK;
+        ALOGV("readMultipleFromRing status %d, sinceStop %u", ret, mBuffersSinceStop);
+        return ret;
+    }
+
+    status_t fillRing(uint32_t maxNumBuffers, const MediaSource::ReadOptions *options) {
+        Parcel data, reply;
+        data.writeInterfaceToken(BpMediaSource::getInterfaceDescriptor());
+        data.writeUint32(maxNumBuffers);
+        if (options != nullptr) {
+            data.writeByteArray(sizeof(*options), (uint8_t*) options);
+        }
+        status_t ret = remote()->transact(READ_RING, data, &reply);
+        mMemoryCache.gc();
+        if (ret != NO_ERROR) {
+            if (mRing == nullptr && ret != DEAD_OBJECT) {
+                ALOGV("no sample ring (%d)", ret);
+                mRingUnsupported = true;
+            }
+            return ret;
+        }
+        if (reply.readInt32() != 0) {
+            sp<IMemory> mem = interface_cast<IMemory>(reply.readStrongBinder());
+            mRing = MediaSampleRingReader::create(mem);
+        }
+        const uint32_t ringCount = reply.readUint32();
+        if (ringCount > kMaxNumReadMultiple || (ringCount > 0 && mRing == nullptr)) {
+            ALOGE("invalid sample ring fill of %u buffers", ringCount);
+            return ERROR_MALFORMED;
+        }
+        for (uint32_t i = 0; i < ringCount; ++i) {
+            MediaBufferBase *buf = mRing->read();
+            if (buf == nullptr) {
+                flushRing();
+                mRing.clear();
+                return ERROR_MALFORMED;
+            }
+            mRingBuffers.push_back(buf);
+        }
+        // a buffer that did not fit in the ring
+        int32_t buftype;
+        while ((buftype = reply.readInt32()) != NULL_BUFFER) {
+            LOG_ALWAYS_FATAL_IF(mRingBuffers.size() > kMaxNumReadMultiple,
+                    "Received %zu+ buffers", mRingBuffers.size());
+            mRingBuffers.push_back(readBuffer(reply, buftype));
+        }
+        mRingStatus = reply.readInt32();
+        ALOGV("fillRing status %d, ring %u, bufferCount %zu",
+                mRingStatus, ringCount, mRingBuffers.size());
+        return OK;
+    }
+
+    void flushRing() {
+        for (MediaBufferBase *buf : mRingBuffers) {
+            buf->release();
+        }
+        mRingBuffers.clear();
+        mRingStatus = OK;
+    }
+
     uint32_t mBuffersSinceStop; // Buffer tracking variable
 
+    // Samples are read from the source into a shared ring (see MediaSampleRing.h) ahead
+    // of the calls to readMultiple(), which return them in place.
+    sp<MediaSampleRingReader> mRing;
+    bool mRingUnsupported = false;
+    std::deque<MediaBufferBase *> mRingBuffers; // read ahead, not yet returned
+    status_t mRingStatus = OK;                  // that ended the last fill
+
     // NuPlayer passes pointers-to-metadata around, so we use this to keep the metadata alive
     // XXX: could we use this for caching, or does metadata change on the fly?
     sp<MetaData> mMetaData;
@@ -279,6 +397,109 @@ BnMediaSource::BnMediaSource()
 BnMediaSource::~BnMediaSource() {
 }
 
+status_t BnMediaSource::transferBuffer(
+        MediaBuffer *buf, Parcel *reply, size_t *inlineTransferSize, bool *stop) {
+    status_t ret = OK;
+    // Even if we're using shared memory, we might not want to use it, since for small
+    // sizes it's faster to copy data through the Binder transaction
+    // On the other hand, if the data size is large enough, it's better to use shared
+    // memory. When data is too large, binder can't handle it.
+    //
+    // TODO: reduce MediaBuffer::kSharedMemThreshold
+    MediaBuffer *transferBuf = nullptr;
+    const size_t length = buf->range_length();
+    size_t offset = buf->range_offset();
+    if (length >= (supportNonblockingRead() && buf->mMemory != nullptr ?
+            kTransferSharedAsSharedThreshold : kTransferInlineAsSharedThreshold)) {
+        if (buf->mMemory != nullptr) {
+            ALOGV("Use shared memory: %zu", length);
+            transferBuf = buf;
+        } else {
+            ALOGV("Large buffer %zu without IMemory!", length);
+            ret = mGroup->acquire_buffer(
+                    (MediaBufferBase **)&transferBuf, false /* nonBlocking */, length);
+            if (ret != OK
+                    || transferBuf == nullptr
+                    || transferBuf->mMemory == nullptr) {
+                ALOGV("Failed to acquire shared memory, size %zu, ret %d",
+                        length, ret);
+                if (transferBuf != nullptr) {
+                    transferBuf->release();
+                    transferBuf = nullptr;
+                }
+                // Current buffer transmit inline; no more additional buffers.
+                *stop = true;
+            } else {
+                memcpy(transferBuf->data(), (uint8_t*)buf->data() + offset, length);
+                offset = 0;
+                if (!mGroup->has_buffers()) {
+                    *stop = true; // No more MediaBuffers, stop readMultiple.
+                }
+            }
+        }
+    }
+    if (transferBuf != nullptr) { // Using shared buffers.
+        if (!transferBuf->isObserved() && transferBuf != buf) {
+            // Transfer buffer must be part of a MediaBufferGroup.
+            ALOGV("adding shared memory buffer %p to local group", transferBuf);
+            mGroup->add_buffer(transferBuf);
+            transferBuf->add_ref(); // We have already acquired buffer.
+        }
+        uint64_t index = mIndexCache.lookup(transferBuf->mMemory);
+        if (index == 0) {
+            index = mIndexCache.insert(transferBuf->mMemory);
+            reply->writeInt32(SHARED_BUFFER);
+            reply->writeUint64(index);
+            reply->writeStrongBinder(IInterface::asBinder(transferBuf->mMemory));
+            ALOGV("SHARED_BUFFER(%p) %llu",
+                    transferBuf, (unsigned long long)index);
+        } else {
+            reply->writeInt32(SHARED_BUFFER_INDEX);
+            reply->writeUint64(index);
+            ALOGV("SHARED_BUFFER_INDEX(%p) %llu",
+                    transferBuf, (unsigned long long)index);
+        }
+        reply->writeInt32(offset);
+        reply->writeInt32(length);
+        buf->meta_data().writeToParcel(*reply);
+        transferBuf->addRemoteRefcount(1);
+        if (transferBuf != buf) {
+            transferBuf->release(); // release local ref
+        } else if (!supportNonblockingRead()) {
+            *stop = true; // stop readMultiple with one shared buffer.
+        }
+    } else {
+        ALOGV_IF(buf->mMemory != nullptr,
+                "INLINE(%p) %zu shared mem available, but only %zu used",
+                buf, buf->mMemory->size(), length);
+        reply->writeInt32(INLINE_BUFFER);
+        reply->writeByteArray(length, (uint8_t*)buf->data() + offset);
+        buf->meta_data().writeToParcel(*reply);
+        *inlineTransferSize += length;
+        if (*inlineTransferSize > kInlineMaxTransfer) {
+            *stop = true; // stop readMultiple if inline transfer is too large.
+        }
+    }
+    return ret;
+}
+
+std::unique_ptr<MediaSampleRingWriter> BnMediaSource::createSampleRing() {
+    size_t size = kRingAudioSize;
+    sp<MetaData> meta = getFormat();
+    const char *mime;
+    if (meta != nullptr && meta->findCString(kKeyMIMEType, &mime)
+            && !strncasecmp(mime, "video/", 6)) {
+        size = kRingVideoSize;
+    }
+    int32_t maxInputSize;
+    if (meta != nullptr && meta->findInt32(kKeyMaxInputSize, &maxInputSize)
+            && maxInputSize > 0) {
+        size = std::min(size,
+                std::max((size_t)kRingMinSize, (size_t)maxInputSize * kRingMaxSamples));
+    }
+    return MediaSampleRingWriter::create(kRingSlots, size, "MediaSourceRing");
+}
+
 status_t BnMediaSource::onTransact(
     uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags)
 {
@@ -302,6 +523,7 @@ status_t BnMediaSource::onTransact(
             mGroup->signalBufferReturned(nullptr);
             status_t status = stop();
             mIndexCache.reset();
+            mRing.reset();
             mBuffersSinceStop = 0;
             return status;
         }
@@ -353,85 +575,13 @@ status_t BnMediaSource::onTransact(
                     break;
                 }
 
-                // Even if we're using shared memory, we might not want to use it, since for small
-                // sizes it's faster to copy data through the Binder transaction
-                // On the other hand, if the data size is large enough, it's better to use shared
-                // memory. When data is too large, binder can't handle it.
-                //
-                // TODO: reduce MediaBuffer::kSharedMemThreshold
-                MediaBuffer *transferBuf = nullptr;
-                const size_t length = buf->range_length();
-                size_t offset = buf->range_offset();
-                if (length >= (supportNonblockingRead() && buf->mMemory != nullptr ?
-                        kTransferSharedAsSharedThreshold : kTransferInlineAsSharedThreshold)) {
-                    if (buf->mMemory != nullptr) {
-                        ALOGV("Use shared memory: %zu", length);
-                        transferBuf = buf;
-                    } else {
-                        ALOGV("Large buffer %zu without IMemory!", length);
-                        ret = mGroup->acquire_buffer(
-                                (MediaBufferBase **)&transferBuf, false /* nonBlocking */, length);
-                        if (ret != OK
-                                || transferBuf == nullptr
-                                || transferBuf->mMemory == nullptr) {
-                            ALOGV("Failed to acquire shared memory, size %zu, ret %d",
-                                    length, ret);
-                            if (transferBuf != nullptr) {
-                                transferBuf->release();
-                                transferBuf = nullptr;
-                            }
-                            // Current buffer transmit inline; no more additional buffers.
-                            maxNumBuffers = 0;
-                        } else {
-                            memcpy(transferBuf->data(), (uint8_t*)buf->data() + offset, length);
-                            offset = 0;
-                            if (!mGroup->has_buffers()) {
-                                maxNumBuffers = 0; // No more MediaBuffers, stop readMultiple.
-                            }
-                        }
-                    }
+                bool stop = false;
+                status_t transferRet = transferBuffer(buf, reply, &inlineTransferSize, &stop);
+                if (transferRet != OK) {
+                    ret = transferRet;
                 }
-                if (transferBuf != nullptr) { // Using shared buffers.
-                    if (!transferBuf->isObserved() && transferBuf != buf) {
-                        // Transfer buffer must be part of a MediaBufferGroup.
-                        ALOGV("adding shared memory buffer %p to local group", transferBuf);
-                        mGroup->add_buffer(transferBuf);
-                        transferBuf->add_ref(); // We have already acquired buffer.
-                    }
-                    uint64_t index = mIndexCache.lookup(transferBuf->mMemory);
-                    if (index == 0) {
-                        index = mIndexCache.insert(transferBuf->mMemory);
-                        reply->writeInt32(SHARED_BUFFER);
-                        reply->writeUint64(index);
-                        reply->writeStrongBinder(IInterface::asBinder(transferBuf->mMemory));
-                        ALOGV("SHARED_BUFFER(%p) %llu",
-                                transferBuf, (unsigned long long)index);
-                    } else {
-                        reply->writeInt32(SHARED_BUFFER_INDEX);
-                        reply->writeUint64(index);
-                        ALOGV("SHARED_BUFFER_INDEX(%p) %llu",
-                                transferBuf, (unsigned long long)index);
-                    }
-                    reply->writeInt32(offset);
-                    reply->writeInt32(length);
-                    buf->meta_data().writeToParcel(*reply);
-                    transferBuf->addRemoteRefcount(1);
-                    if (transferBuf != buf) {
-                        transferBuf->release(); // release local ref
-                    } else if (!supportNonblockingRead()) {
-                        maxNumBuffers = 0; // stop readMultiple with one shared buffer.
-                    }
-                } else {
-                    ALOGV_IF(buf->mMemory != nullptr,
-                            "INLINE(%p) %zu shared mem available, but only %zu used",
-                            buf, buf->mMemory->size(), length);
-                    reply->writeInt32(INLINE_BUFFER);
-                    reply->writeByteArray(length, (uint8_t*)buf->data() + offset);
-                    buf->meta_data().writeToParcel(*reply);
-                    inlineTransferSize += length;
-                    if (inlineTransferSize > kInlineMaxTransfer) {
-                        maxNumBuffers = 0; // stop readMultiple if inline transfer is too large.
-                    }
+                if (stop) {
+                    maxNumBuffers = 0;
                 }
                 buf->release();
             }
@@ -441,6 +591,81 @@ status_t BnMediaSource::onTransact(
                     ret, bufferCount, mBuffersSinceStop);
             return NO_ERROR;
         }
+        case READ_RING: {
+            ALOGV("readRing");
+            CHECK_INTERFACE(IMediaSource, data, reply);
+
+            uint32_t maxNumBuffers;
+            data.readUint32(&maxNumBuffers);
+            if (maxNumBuffers > kMaxNumReadMultiple) {
+                maxNumBuffers = kMaxNumReadMultiple;
+            }
+            MediaSource::ReadOptions opts;
+            uint32_t len;
+            const bool useOptions =
+                    data.readUint32(&len) == NO_ERROR
+                    && len == sizeof(opts)
+                    && data.read((void *)&opts, len) == NO_ERROR;
+
+            const bool newRing = mRing == nullptr;
+            if (newRing) {
+                mRing = createSampleRing();
+                if (mRing == nullptr) {
+                    return INVALID_OPERATION; // the client reads with READMULTIPLE instead
+                }
+            }
+            reply->writeInt32(newRing);
+            if (newRing) {
+                reply->writeStrongBinder(IInterface::asBinder(mRing->memory()));
+            }
+
+            // Read ahead to save the client transactions, but not when seeking:
+            // the client is then likely to seek again. Read little ahead for a
+            // single buffer, as that may be all the client wants, e.g. for a thumbnail.
+            int64_t seekTimeUs;
+            MediaSource::ReadOptions::SeekMode mode;
+            uint32_t fillCount = maxNumBuffers;
+            if (!useOptions || !opts.getSeekTo(&seekTimeUs, &mode)) {
+                fillCount = std::max(maxNumBuffers, (uint32_t)(maxNumBuffers > 1
+                        ? kRingReadAhead : kRingSingleReadAhead));
+            }
+
+            mGroup->signalBufferReturned(nullptr);
+            mIndexCache.gc();
+            const uint64_t produced = mRing->produced();
+            MediaBuffer *unfit = nullptr;
+            status_t ret = NO_ERROR;
+            for (uint32_t i = 0; i < fillCount; ++i, ++mBuffersSinceStop) {
+                MediaBuffer *buf = nullptr;
+                ret = read((MediaBufferBase **)&buf, useOptions ? &opts : nullptr);
+                opts.clearNonPersistent(); // Remove options that only apply to first buffer.
+                if (ret != NO_ERROR || buf == nullptr) {
+                    break;
+                }
+                if (!mRing->write(buf)) {
+                    // too large, or the client still holds too much: send it the usual way
+                    unfit = buf;
+                    ++mBuffersSinceStop;
+                    break;
+                }
+                buf->release();
+            }
+            reply->writeUint32(mRing->produced() - produced);
+            if (unfit != nullptr) {
+                size_t inlineTransferSize = 0;
+                bool stop = false;
+                status_t transferRet = transferBuffer(unfit, reply, &inlineTransferSize, &stop);
+                if (transferRet != OK) {
+                    ret = transferRet;
+                }
+                unfit->release();
+            }
+            reply->writeInt32(NULL_BUFFER); // Indicate no more MediaBuffers.
+            reply->writeInt32(ret);
+            ALOGV("readRing status %d, bufferCount %llu, sinceStop %u",
+                    ret, (unsigned long long)(mRing->produced() - produced), mBuffersSinceStop);
+            return NO_ERROR;
+        }
         case SUPPORT_NONBLOCKING_READ: {
             ALOGV("supportNonblockingRead");
             CHECK_INTERFACE(IMediaSource, data, reply);
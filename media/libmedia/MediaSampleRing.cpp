@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaSampleRing"
+#include <utils/Log.h>
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include <binder/MemoryBase.h>
+#include <binder/MemoryHeapBase.h>
+#include <binder/Parcel.h>
+#include <media/MediaSampleRing.h>
+#include <media/stagefright/MediaBuffer.h>
+
+namespace android {
+
+static inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// metadata is padded so the sample data is 8-byte aligned
+static inline uint64_t metaSpan(uint32_t metaSize) {
+    return alignUp(metaSize, sizeof(uint64_t));
+}
+
+// static
+size_t MediaSampleRing::memorySize(uint32_t slotCount, uint32_t dataSize) {
+    size_t size;
+    if (__builtin_mul_overflow((size_t)slotCount, sizeof(Slot), &size)
+            || __builtin_add_overflow(size, sizeof(Control), &size)
+            || __builtin_add_overflow(size, (size_t)dataSize, &size)) {
+        return 0;
+    }
+    return size;
+}
+
+// ---------------------------------------------------------------------------
+
+// static
+std::unique_ptr<MediaSampleRingWriter> MediaSampleRingWriter::create(
+        uint32_t slotCount, uint32_t dataSize, const char *name) {
+    dataSize = alignUp(dataSize, MediaSampleRing::kRecordAlignment);
+    const size_t size = MediaSampleRing::memorySize(slotCount, dataSize);
+    if (slotCount == 0 || dataSize == 0 || size == 0) {
+        return nullptr;
+    }
+    sp<MemoryHeapBase> heap = new MemoryHeapBase(size, 0 /* flags */, name);
+    if (heap->getHeapID() < 0 || heap->getBase() == MAP_FAILED) {
+        ALOGW("cannot allocate a sample ring of %zu bytes", size);
+        return nullptr;
+    }
+    sp<IMemory> memory = new MemoryBase(heap, 0 /* offset */, size);
+    return std::unique_ptr<MediaSampleRingWriter>(
+            new MediaSampleRingWriter(memory, slotCount, dataSize));
+}
+
+MediaSampleRingWriter::MediaSampleRingWriter(
+        const sp<IMemory> &memory, uint32_t slotCount, uint32_t dataSize)
+    : mMemory(memory),
+      mControl(reinterpret_cast<MediaSampleRing::Control *>(memory->pointer())),
+      mSlots(reinterpret_cast<MediaSampleRing::Slot *>(
+              (uint8_t *)memory->pointer() + MediaSampleRing::slotsOffset())),
+      mData((uint8_t *)memory->pointer() + MediaSampleRing::dataOffset(slotCount)),
+      mSlotCount(slotCount),
+      mDataSize(dataSize),
+      mPositions(slotCount) {
+    mControl->version = MediaSampleRing::kVersion;
+    mControl->slotCount = slotCount;
+    mControl->dataSize = dataSize;
+    mControl->reserved = 0;
+    new (&mControl->consumed) std::atomic<uint64_t>(0);
+}
+
+bool MediaSampleRingWriter::allocate(uint32_t size, uint64_t *position) {
+    if (size > mDataSize) {
+        return false;
+    }
+    uint64_t tail;
+    if (mConsumed == mProduced) {
+        // empty: start at the beginning, for the most contiguous room
+        mHead = alignUp(mHead, mDataSize);
+        tail = mHead;
+    } else {
+        tail = mPositions[mConsumed % mSlotCount];
+    }
+    uint64_t start = mHead;
+    const uint64_t offset = start % mDataSize;
+    if (offset + size > mDataSize) {
+        start += mDataSize - offset;    // skip the end, the record must be contiguous
+    }
+    if (start + size - tail > mDataSize) {
+        return false;
+    }
+    *position = start;
+    mHead = start + size;
+    return true;
+}
+
+bool MediaSampleRingWriter::write(MediaBufferBase *buffer) {
+    // the client only moves 'consumed' forward, and not past what was produced
+    const uint64_t consumed = mControl->consumed.load(std::memory_order_acquire);
+    if (consumed > mConsumed && consumed <= mProduced) {
+        mConsumed = consumed;
+    }
+    if (mProduced - mConsumed >= mSlotCount) {
+        return false;
+    }
+
+    Parcel meta;
+    meta.setAllowFds(false); // keeps the blobs inline, so the Parcel can be copied as bytes
+    if (buffer->meta_data().writeToParcel(meta) != OK || meta.objectsCount() != 0) {
+        return false;
+    }
+    const size_t length = buffer->range_length();
+    const uint64_t recordSize = alignUp(metaSpan(meta.dataSize()) + length,
+            MediaSampleRing::kRecordAlignment);
+    uint64_t position;
+    if (meta.dataSize() > UINT32_MAX || recordSize > mDataSize
+            || !allocate(recordSize, &position)) {
+        return false;
+    }
+
+    const uint32_t offset = position % mDataSize;
+    memcpy(mData + offset, meta.data(), meta.dataSize());
+    memcpy(mData + offset + metaSpan(meta.dataSize()),
+            (const uint8_t *)buffer->data() + buffer->range_offset(), length);
+    MediaSampleRing::Slot &slot = mSlots[mProduced % mSlotCount];
+    slot.offset = offset;
+    slot.metaSize = meta.dataSize();
+    slot.dataSize = length;
+    slot.reserved = 0;
+    mPositions[mProduced % mSlotCount] = position;
+    ++mProduced;
+    ALOGV("sample %llu: %zu bytes at %u", (unsigned long long)mProduced, length, offset);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+// A sample read in place. The slot is handed back when the last reference goes.
+class MediaSampleRingReader::RingBuffer : public MediaBuffer {
+public:
+    RingBuffer(const sp<MediaSampleRingReader> &ring, uint64_t index, void *data, size_t size)
+        : MediaBuffer(data, size), mRing(ring), mIndex(index) {
+    }
+
+protected:
+    virtual ~RingBuffer() {
+        mRing->release(mIndex);
+    }
+
+private:
+    const sp<MediaSampleRingReader> mRing;
+    const uint64_t mIndex;
+};
+
+// static
+sp<MediaSampleRingReader> MediaSampleRingReader::create(const sp<IMemory> &memory) {
+    if (memory == nullptr || memory->pointer() == nullptr
+            || memory->size() < sizeof(MediaSampleRing::Control)) {
+        return nullptr;
+    }
+    // read once: the fields could change under us
+    const MediaSampleRing::Control *control =
+            reinterpret_cast<const MediaSampleRing::Control *>(memory->pointer());
+    const uint32_t version = control->version;
+    const uint32_t slotCount = control->slotCount;
+    const uint32_t dataSize = control->dataSize;
+    const size_t size = MediaSampleRing::memorySize(slotCount, dataSize);
+    if (version != MediaSampleRing::kVersion || slotCount == 0 || dataSize == 0
+            || size == 0 || size > memory->size()) {
+        ALOGE("invalid sample ring: version %u, %u slots, %u bytes in %zu",
+                version, slotCount, dataSize, memory->size());
+        return nullptr;
+    }
+    return new MediaSampleRingReader(memory, slotCount, dataSize);
+}
+
+MediaSampleRingReader::MediaSampleRingReader(
+        const sp<IMemory> &memory, uint32_t slotCount, uint32_t dataSize)
+    : mMemory(memory),
+      mControl(reinterpret_cast<MediaSampleRing::Control *>(memory->pointer())),
+      mSlots(reinterpret_cast<const MediaSampleRing::Slot *>(
+              (const uint8_t *)memory->pointer() + MediaSampleRing::slotsOffset())),
+      mData((const uint8_t *)memory->pointer() + MediaSampleRing::dataOffset(slotCount)),
+      mSlotCount(slotCount),
+      mDataSize(dataSize) {
+}
+
+MediaBufferBase *MediaSampleRingReader::read() {
+    MediaSampleRing::Slot slot;
+    memcpy(&slot, &mSlots[mRead % mSlotCount], sizeof(slot));
+    const uint64_t dataOffset = (uint64_t)slot.offset + metaSpan(slot.metaSize);
+    if (dataOffset + slot.dataSize > mDataSize) {
+        ALOGE("invalid sample %llu: %u + %u + %u bytes in %u",
+                (unsigned long long)mRead, slot.offset, slot.metaSize, slot.dataSize, mDataSize);
+        return nullptr;
+    }
+    {
+        Mutex::Autolock _l(mLock);
+        mReleased.push_back(false);
+    }
+    // the buffer is writable: the slot is ours until it is released
+    RingBuffer *buffer = new RingBuffer(this, mRead++,
+            const_cast<uint8_t *>(mData) + dataOffset, slot.dataSize);
+
+    Parcel meta;
+    if (meta.setData(mData + slot.offset, slot.metaSize) != OK
+            || buffer->meta_data().updateFromParcel(meta) != OK) {
+        ALOGW("sample %llu has no metadata", (unsigned long long)(mRead - 1));
+    }
+    return buffer;
+}
+
+void MediaSampleRingReader::release(uint64_t index) {
+    Mutex::Autolock _l(mLock);
+    if (index < mConsumed || index - mConsumed >= mReleased.size()) {
+        ALOGE("releasing unknown sample %llu", (unsigned long long)index);
+        return;
+    }
+    mReleased[index - mConsumed] = true;
+    const uint64_t consumed = mConsumed;
+    while (!mReleased.empty() && mReleased.front()) {
+        mReleased.pop_front();
+        ++mConsumed;
+    }
+    if (mConsumed != consumed) {
+        mControl->consumed.store(mConsumed, std::memory_order_release);
+    }
+}
+
+}  // namespace android
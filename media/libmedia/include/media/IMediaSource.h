@@ -22,6 +22,7 @@
 
 #include <binder/IInterface.h>
 #include <binder/IMemory.h>
+#include <media/MediaSampleRing.h>
 #include <media/MediaSource.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaErrors.h>
@@ -131,14 +132,35 @@ public:
     static const size_t kTransferInlineAsSharedThreshold = 8 * 1024; // if >= shared, else inline
     static const size_t kInlineMaxTransfer = 64 * 1024; // Binder size limited to BINDER_VM_SIZE.
 
+    // Shared sample ring, see MediaSampleRing.h.
+    // More slots than kMaxNumReadMultiple, so a fill has room next to what the client holds.
+    static const size_t kRingSlots = 256;
+    // The data area holds kRingMaxSamples of the largest samples of the track, within
+    // these bounds; or the upper bound if the track has no maximum sample size.
+    static const size_t kRingVideoSize = 8 * 1024 * 1024;   // over 0.5 s of 4K60 at 100 Mbit/s
+    static const size_t kRingAudioSize = 512 * 1024;
+    static const size_t kRingMinSize = 64 * 1024;
+    static const size_t kRingMaxSamples = 8;
+    static const size_t kRingReadAhead = 32; // buffers read ahead per fill, except when seeking
+    static const size_t kRingSingleReadAhead = 4; // the same, when one buffer is requested
+
 protected:
     virtual ~BnMediaSource();
 
 private:
+    // Writes one buffer to a readMultiple reply, inline or by shared memory.
+    // Sets |stop| if no more buffers should follow in this reply.
+    status_t transferBuffer(
+            MediaBuffer *buf, Parcel *reply, size_t *inlineTransferSize, bool *stop);
+
+    std::unique_ptr<MediaSampleRingWriter> createSampleRing();
+
     uint32_t mBuffersSinceStop; // Buffer tracking variable
 
     std::unique_ptr<MediaBufferGroup> mGroup;
 
+    std::unique_ptr<MediaSampleRingWriter> mRing; // created on the first ring read
+
     // To prevent marshalling IMemory with each read transaction, we cache the IMemory pointer
     // into a map.
     //
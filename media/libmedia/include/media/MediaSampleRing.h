@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_SAMPLE_RING_H_
+
+#define MEDIA_SAMPLE_RING_H_
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <binder/IMemory.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+class MediaBufferBase;
+
+// Shared memory ring of samples, from a BnMediaSource in the extractor process
+// to its BpMediaSource. The source writes each sample once, with its metadata, and
+// the client wraps it in place in a MediaBuffer. Binder only carries how many samples
+// were added, so one transaction can fill the ring for many reads.
+//
+// Memory layout: Control, Slot[slotCount], then the data area.
+// Slots are used in order, one per sample. A sample is one record in the data area:
+// its metadata as flattened by MetaDataBase::writeToParcel(), then the sample data.
+// Records are contiguous; one that would not fit before the end of the data area
+// starts over at the beginning.
+//
+// The client hands the slots back in order, as their MediaBuffers are released,
+// by advancing Control::consumed. Neither side trusts what the other one wrote:
+// the source clamps 'consumed', and the client checks each slot against the data area.
+struct MediaSampleRing {
+    static constexpr uint32_t kVersion = 1;
+
+    struct Control {
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t dataSize;
+        uint32_t reserved;
+        // on its own cache line, as it is the only field written by the client
+        alignas(64) std::atomic<uint64_t> consumed;
+    };
+
+    struct Slot {
+        uint32_t offset;        // of the record in the data area
+        uint32_t metaSize;
+        uint32_t dataSize;
+        uint32_t reserved;
+    };
+
+    static constexpr size_t kRecordAlignment = 64;
+
+    // total size of the shared memory, 0 on overflow
+    static size_t memorySize(uint32_t slotCount, uint32_t dataSize);
+    static size_t slotsOffset() { return sizeof(Control); }
+    static size_t dataOffset(uint32_t slotCount) {
+        return sizeof(Control) + slotCount * sizeof(Slot);
+    }
+};
+
+// Producer side, in the process of the source.
+class MediaSampleRingWriter {
+public:
+    // Returns nullptr if the shared memory cannot be allocated.
+    static std::unique_ptr<MediaSampleRingWriter> create(
+            uint32_t slotCount, uint32_t dataSize, const char *name);
+
+    // Appends a sample, and returns false if it does not fit now; the caller then
+    // transfers it the usual way.
+    bool write(MediaBufferBase *buffer);
+
+    // number of samples written so far
+    uint64_t produced() const { return mProduced; }
+
+    const sp<IMemory> &memory() const { return mMemory; }
+
+private:
+    MediaSampleRingWriter(const sp<IMemory> &memory, uint32_t slotCount, uint32_t dataSize);
+
+    // Picks the position of a record of 'size' bytes, or returns false if there is no room.
+    bool allocate(uint32_t size, uint64_t *position);
+
+    const sp<IMemory> mMemory;
+    MediaSampleRing::Control * const mControl;
+    MediaSampleRing::Slot * const mSlots;
+    uint8_t * const mData;
+    const uint32_t mSlotCount;
+    const uint32_t mDataSize;
+
+    // Our own copy of the state, as the shared one can be overwritten by the client.
+    uint64_t mProduced = 0;
+    uint64_t mConsumed = 0;
+    uint64_t mHead = 0;                 // next byte position, increasing over wraps
+    std::vector<uint64_t> mPositions;   // of the record of each slot in use
+};
+
+// Consumer side, in the process of the client.
+class MediaSampleRingReader : public RefBase {
+public:
+    // Returns nullptr if the memory does not hold a ring of a known version.
+    static sp<MediaSampleRingReader> create(const sp<IMemory> &memory);
+
+    // Wraps the next slot in a MediaBuffer, which hands the slot back when released.
+    // Returns nullptr if the slot does not describe a valid record; the ring should
+    // not be used any more.
+    MediaBufferBase *read();
+
+private:
+    class RingBuffer;
+
+    MediaSampleRingReader(const sp<IMemory> &memory, uint32_t slotCount, uint32_t dataSize);
+
+    void release(uint64_t index);
+
+    const sp<IMemory> mMemory;
+    MediaSampleRing::Control * const mControl;
+    const MediaSampleRing::Slot * const mSlots;
+    const uint8_t * const mData;
+    const uint32_t mSlotCount;
+    const uint32_t mDataSize;
+
+    uint64_t mRead = 0;                 // next slot to wrap
+
+    Mutex mLock;                        // buffers are released on any thread
+    uint64_t mConsumed = 0;             // GUARDED_BY(mLock)
+    std::deque<bool> mReleased;         // GUARDED_BY(mLock), from mConsumed to mRead
+};
+
+}  // namespace android
+
+#endif  // MEDIA_SAMPLE_RING_H_
@@ -101,6 +101,12 @@ public:
     status_t getFrameAtIndex(
             std::vector<sp<IMemory> > *frames, int frameIndex, int numFrames = 1,
             int colorFormat = HAL_PIXEL_FORMAT_RGB_565, bool metaOnly = false);
+    // Frames at several times, in increasing order, from one decoder. They are scaled
+    // down to fit in maxWidth x maxHeight, if these are positive.
+    status_t getFramesAtTimes(
+            std::vector<sp<IMemory> > *frames, const std::vector<int64_t> &timesUs,
+            int option, int colorFormat = HAL_PIXEL_FORMAT_RGB_565,
+            int maxWidth = 0, int maxHeight = 0);
     sp<IMemory> extractAlbumArt();
     const char* extractMetadata(int keyCode);
 
@@ -0,0 +1,333 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "MediaSampleRing_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <binder/Binder.h>
+#include <media/IMediaSource.h>
+#include <media/MediaSampleRing.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+
+namespace android {
+
+static const uint32_t kDataSize = 4096;
+
+class MediaSampleRingTest : public ::testing::Test {
+protected:
+    void createRing(uint32_t slotCount, uint32_t dataSize) {
+        mWriter = MediaSampleRingWriter::create(slotCount, dataSize, "MediaSampleRing_test");
+        ASSERT_TRUE(mWriter != nullptr);
+        mReader = MediaSampleRingReader::create(mWriter->memory());
+        ASSERT_TRUE(mReader != nullptr);
+    }
+
+    uint8_t *memory() {
+        return (uint8_t *)mWriter->memory()->pointer();
+    }
+
+    MediaSampleRing::Control *control() {
+        return reinterpret_cast<MediaSampleRing::Control *>(memory());
+    }
+
+    MediaSampleRing::Slot *slots() {
+        return reinterpret_cast<MediaSampleRing::Slot *>(
+                memory() + MediaSampleRing::slotsOffset());
+    }
+
+    uint64_t consumed() {
+        return control()->consumed.load();
+    }
+
+    // Writes a sample of |size| bytes, all |fill|.
+    bool writeSample(size_t size, uint8_t fill) {
+        MediaBuffer *buffer = new MediaBuffer(size);
+        memset(buffer->data(), fill, size);
+        buffer->meta_data().setInt64(kKeyTime, fill * 1000ll);
+        bool written = mWriter->write(buffer);
+        buffer->release();
+        return written;
+    }
+
+    // Reads the next sample, and checks that it is the one written with |size| and |fill|.
+    void readSample(size_t size, uint8_t fill, MediaBufferBase **buffer) {
+        *buffer = mReader->read();
+        ASSERT_TRUE(*buffer != nullptr);
+        ASSERT_EQ(size, (*buffer)->range_length());
+
+        // in place
+        const uint8_t *data = (const uint8_t *)(*buffer)->data() + (*buffer)->range_offset();
+        EXPECT_GE(data, memory());
+        EXPECT_LE(data + size, memory() + mWriter->memory()->size());
+
+        for (size_t i = 0; i < size; ++i) {
+            ASSERT_EQ(fill, data[i]) << "at " << i;
+        }
+        int64_t timeUs;
+        ASSERT_TRUE((*buffer)->meta_data().findInt64(kKeyTime, &timeUs));
+        EXPECT_EQ(fill * 1000ll, timeUs);
+    }
+
+    std::unique_ptr<MediaSampleRingWriter> mWriter;
+    sp<MediaSampleRingReader> mReader;
+};
+
+TEST_F(MediaSampleRingTest, WritesAndReadsInPlace) {
+    ASSERT_NO_FATAL_FAILURE(createRing(4, kDataSize));
+    EXPECT_EQ(MediaSampleRing::kVersion, control()->version);
+    EXPECT_EQ(4u, control()->slotCount);
+    EXPECT_EQ(kDataSize, control()->dataSize);
+
+    ASSERT_TRUE(writeSample(1000, 1));
+    EXPECT_EQ(1u, mWriter->produced());
+
+    MediaBufferBase *buffer;
+    ASSERT_NO_FATAL_FAILURE(readSample(1000, 1, &buffer));
+    EXPECT_EQ(0u, consumed());
+    buffer->release();
+    EXPECT_EQ(1u, consumed());
+}
+
+TEST_F(MediaSampleRingTest, WrapsAround) {
+    ASSERT_NO_FATAL_FAILURE(createRing(4, kDataSize));
+
+    // records of different sizes, so they end at different places before the end
+    // of the data area; two are held at a time
+    const uint8_t *lastData = nullptr;
+    size_t numWraps = 0;
+    MediaBufferBase *held = nullptr;
+    for (uint8_t i = 1; i <= 200; ++i) {
+        const size_t size = 100 + (i * 37) % 800;
+        ASSERT_TRUE(writeSample(size, i)) << "sample " << (int)i;
+
+        MediaBufferBase *buffer;
+        ASSERT_NO_FATAL_FAILURE(readSample(size, i, &buffer));
+        const uint8_t *data = (const uint8_t *)buffer->data();
+        if (lastData != nullptr && data < lastData) {
+            ++numWraps;
+        }
+        lastData = data;
+
+        if (held != nullptr) {
+            held->release();
+        }
+        held = buffer;
+    }
+    held->release();
+
+    EXPECT_GT(numWraps, 10u);
+    EXPECT_EQ(200u, mWriter->produced());
+    EXPECT_EQ(200u, consumed());
+}
+
+TEST_F(MediaSampleRingTest, RejectsSamplesThatDoNotFit) {
+    ASSERT_NO_FATAL_FAILURE(createRing(4, kDataSize));
+
+    // larger than the data area
+    EXPECT_FALSE(writeSample(kDataSize, 1));
+
+    // out of slots
+    for (uint8_t i = 1; i <= 4; ++i) {
+        ASSERT_TRUE(writeSample(10, i));
+    }
+    EXPECT_FALSE(writeSample(10, 5));
+
+    // the client cannot hand back what was not produced
+    control()->consumed.store(100);
+    EXPECT_FALSE(writeSample(10, 5));
+
+    // out of data, once slots are free
+    MediaBufferBase *buffers[4];
+    for (uint8_t i = 1; i <= 4; ++i) {
+        ASSERT_NO_FATAL_FAILURE(readSample(10, i, &buffers[i - 1]));
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        buffers[i]->release();
+    }
+    EXPECT_EQ(4u, consumed());
+
+    size_t numWritten = 0;
+    while (writeSample(1500, 6)) {
+        ++numWritten;
+    }
+    EXPECT_EQ(2u, numWritten);
+}
+
+TEST_F(MediaSampleRingTest, ChecksSlotBounds) {
+    ASSERT_NO_FATAL_FAILURE(createRing(4, kDataSize));
+
+    ASSERT_TRUE(writeSample(100, 1));
+    slots()[0].dataSize = kDataSize;
+    EXPECT_TRUE(mReader->read() == nullptr);
+    slots()[0].dataSize = 100;
+    slots()[0].offset = kDataSize - 8;
+    EXPECT_TRUE(mReader->read() == nullptr);
+
+    control()->version = MediaSampleRing::kVersion + 1;
+    EXPECT_TRUE(MediaSampleRingReader::create(mWriter->memory()) == nullptr);
+    control()->version = MediaSampleRing::kVersion;
+    control()->dataSize = mWriter->memory()->size();
+    EXPECT_TRUE(MediaSampleRingReader::create(mWriter->memory()) == nullptr);
+}
+
+TEST_F(MediaSampleRingTest, HandsBackSlotsInOrder) {
+    ASSERT_NO_FATAL_FAILURE(createRing(4, kDataSize));
+
+    MediaBufferBase *buffers[3];
+    for (uint8_t i = 1; i <= 3; ++i) {
+        ASSERT_TRUE(writeSample(100, i));
+        ASSERT_NO_FATAL_FAILURE(readSample(100, i, &buffers[i - 1]));
+    }
+
+    buffers[1]->release();
+    EXPECT_EQ(0u, consumed());
+    buffers[0]->release();
+    EXPECT_EQ(2u, consumed());
+    buffers[2]->release();
+    EXPECT_EQ(3u, consumed());
+}
+
+// ---------------------------------------------------------------------------
+
+// Produces |numBuffers| small buffers, then the end of the stream.
+struct FakeMediaSource : public BnMediaSource {
+    explicit FakeMediaSource(int32_t numBuffers) : mNumBuffers(numBuffers), mNumReads(0) {}
+
+    virtual status_t start(MetaData * /* params */) {
+        return OK;
+    }
+
+    virtual status_t stop() {
+        return OK;
+    }
+
+    virtual sp<MetaData> getFormat() {
+        sp<MetaData> format = new MetaData;
+        format->setCString(kKeyMIMEType, "audio/raw");
+        format->setInt32(kKeyMaxInputSize, 1024);
+        return format;
+    }
+
+    virtual status_t read(
+            MediaBufferBase **buffer, const MediaSource::ReadOptions * /* options */) {
+        *buffer = nullptr;
+        if (mNumReads++ >= mNumBuffers) {
+            return ERROR_END_OF_STREAM;
+        }
+        MediaBuffer *sample = new MediaBuffer(100);
+        memset(sample->data(), mNumReads, 100);
+        sample->meta_data().setInt64(kKeyTime, mNumReads * 1000ll);
+        *buffer = sample;
+        return OK;
+    }
+
+    int32_t mNumBuffers;
+    int32_t mNumReads;
+};
+
+// Makes the source look remote, so that it is used through BpMediaSource.
+struct ForwardingBinder : public BBinder {
+    explicit ForwardingBinder(const sp<IBinder> &target) : mTarget(target) {}
+
+protected:
+    virtual status_t onTransact(
+            uint32_t code, const Parcel &data, Parcel *reply, uint32_t flags) {
+        return mTarget->transact(code, data, reply, flags);
+    }
+
+private:
+    sp<IBinder> mTarget;
+};
+
+class MediaSourceRingTest : public ::testing::Test {
+protected:
+    void createSource(int32_t numBuffers) {
+        mSource = new FakeMediaSource(numBuffers);
+        mProxy = IMediaSource::asInterface(
+                new ForwardingBinder(IInterface::asBinder(mSource)));
+        ASSERT_TRUE(mProxy != nullptr);
+        ASSERT_NE(mProxy.get(), static_cast<IMediaSource *>(mSource.get()));
+        ASSERT_EQ(OK, mProxy->start());
+    }
+
+    virtual void TearDown() {
+        if (mProxy != nullptr) {
+            mProxy->stop();
+        }
+    }
+
+    sp<FakeMediaSource> mSource;
+    sp<IMediaSource> mProxy;
+};
+
+TEST_F(MediaSourceRingTest, ReadsLittleAheadForOneBuffer) {
+    ASSERT_NO_FATAL_FAILURE(createSource(100));
+
+    MediaBufferBase *buffer;
+    ASSERT_EQ(OK, mProxy->read(&buffer));
+    ASSERT_TRUE(buffer != nullptr);
+    buffer->release();
+    EXPECT_EQ((int32_t)BnMediaSource::kRingSingleReadAhead, mSource->mNumReads);
+}
+
+TEST_F(MediaSourceRingTest, ReturnsBuffersBeforeEndOfStream) {
+    // the end of the stream is reached by the first fill
+    ASSERT_NO_FATAL_FAILURE(createSource(BnMediaSource::kRingSingleReadAhead - 1));
+
+    for (int32_t i = 1; i < (int32_t)BnMediaSource::kRingSingleReadAhead; ++i) {
+        MediaBufferBase *buffer = nullptr;
+        ASSERT_EQ(OK, mProxy->read(&buffer)) << "buffer " << i;
+        ASSERT_TRUE(buffer != nullptr);
+        int64_t timeUs;
+        ASSERT_TRUE(buffer->meta_data().findInt64(kKeyTime, &timeUs));
+        EXPECT_EQ(i * 1000ll, timeUs);
+        buffer->release();
+    }
+    EXPECT_EQ((int32_t)BnMediaSource::kRingSingleReadAhead, mSource->mNumReads);
+
+    MediaBufferBase *buffer = nullptr;
+    EXPECT_EQ(ERROR_END_OF_STREAM, mProxy->read(&buffer));
+    EXPECT_TRUE(buffer == nullptr);
+}
+
+TEST_F(MediaSourceRingTest, ReturnsAllBuffersOfReadMultipleBeforeEndOfStream) {
+    ASSERT_NO_FATAL_FAILURE(createSource(10));
+
+    Vector<MediaBufferBase *> buffers;
+    ASSERT_EQ(OK, mProxy->readMultiple(&buffers, 6));
+    ASSERT_EQ(6u, buffers.size());
+    for (MediaBufferBase *buffer : buffers) {
+        buffer->release();
+    }
+
+    buffers.clear();
+    ASSERT_EQ(OK, mProxy->readMultiple(&buffers, 6));
+    ASSERT_EQ(4u, buffers.size());
+    for (MediaBufferBase *buffer : buffers) {
+        buffer->release();
+    }
+
+    buffers.clear();
+    EXPECT_EQ(ERROR_END_OF_STREAM, mProxy->readMultiple(&buffers, 6));
+    EXPECT_EQ(0u, buffers.size());
+}
+
+}  // namespace android
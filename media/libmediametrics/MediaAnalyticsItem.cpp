@@ -22,6 +22,10 @@
 #include <string.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <string_view>
+#include <unordered_set>
+
 #include <binder/Parcel.h>
 #include <utils/Errors.h>
 #include <utils/Log.h>
@@ -72,7 +76,8 @@ MediaAnalyticsItem::MediaAnalyticsItem()
       mSessionID(MediaAnalyticsItem::SessionIDNone),
       mTimestamp(0),
       mFinalized(1),
-      mPropCount(0), mPropSize(0), mProps(NULL)
+      mPropCount(0), mPropSize(0), mProps(NULL),
+      mArena(NULL), mArenaBytes(0), mArenaWaste(0)
 {
     mKey = MediaAnalyticsItem::kKeyNone;
 }
@@ -84,7 +89,8 @@ MediaAnalyticsItem::MediaAnalyticsItem(MediaAnalyticsItem::Key key)
       mSessionID(MediaAnalyticsItem::SessionIDNone),
       mTimestamp(0),
       mFinalized(1),
-      mPropCount(0), mPropSize(0), mProps(NULL)
+      mPropCount(0), mPropSize(0), mProps(NULL),
+      mArena(NULL), mArenaBytes(0), mArenaWaste(0)
 {
     if (DEBUG_ALLOCATIONS) {
         ALOGD("Allocate MediaAnalyticsItem @ %p", this);
@@ -119,6 +125,7 @@ void MediaAnalyticsItem::clear() {
     }
     mPropSize = 0;
     mPropCount = 0;
+    freeArena();
 
     return;
 }
@@ -140,7 +147,7 @@ MediaAnalyticsItem *MediaAnalyticsItem::dup() {
         // properties aka attributes
         dst->growProps(this->mPropCount);
         for(size_t i=0;i<mPropCount;i++) {
-            copyProp(&dst->mProps[i], &this->mProps[i]);
+            dst->copyProp(&dst->mProps[i], &this->mProps[i]);
         }
         dst->mPropCount = this->mPropCount;
     }
@@ -242,7 +249,8 @@ size_t MediaAnalyticsItem::findPropIndex(const char *name, size_t len)
         if (prop->mNameLen != len) {
             continue;
         }
-        if (memcmp(name, prop->mName, len) == 0) {
+        // interned names usually match by address
+        if (prop->mName == name || memcmp(name, prop->mName, len) == 0) {
             break;
         }
     }
@@ -258,20 +266,79 @@ MediaAnalyticsItem::Prop *MediaAnalyticsItem::findProp(const char *name) {
     return NULL;
 }
 
-void MediaAnalyticsItem::Prop::setName(const char *name, size_t len) {
-    free((void *)mName);
-    mName = (const char *) malloc(len+1);
-    LOG_ALWAYS_FATAL_IF(mName == NULL,
-                        "failed malloc() for property '%s' (len %zu)",
-                        name, len);
-    memcpy ((void *)mName, name, len+1);
-    mNameLen = len;
+// attribute names seen by this process.
+// Names are never removed, so the pointers handed out stay valid; the
+// service sees names from any client, so the table is bounded.
+static constexpr size_t kMaxInternedAttrs = 1024;
+static constexpr size_t kMaxInternedBytes = 32 * 1024;
+static Mutex sAttrMutex;
+
+// names recently interned by this thread, so most lookups take no lock.
+// Names mostly differ at the end ("android.media.mediacodec.width"),
+// so the slot is picked from the length and the last bytes.
+struct InternedAttr {
+    const char *attr;
+    size_t len;
+};
+static constexpr int kInternCacheBits = 6;
+static thread_local InternedAttr tInternCache[1 << kInternCacheBits];
+
+static InternedAttr *internCacheSlot(const char *name, size_t len) {
+    uint64_t tail = 0;
+    size_t tailLen = std::min(len, sizeof(tail));
+    memcpy(&tail, name + len - tailLen, tailLen);
+    return &tInternCache[((tail ^ len) * 0x9E3779B97F4A7C15ull) >> (64 - kInternCacheBits)];
+}
+
+const char *MediaAnalyticsItem::internAttr(const char *name, size_t len) {
+    static std::unordered_set<std::string_view> *sAttrs =
+            new std::unordered_set<std::string_view>();  // GUARDED_BY(sAttrMutex)
+    static size_t sAttrBytes = 0;                        // GUARDED_BY(sAttrMutex)
+
+    InternedAttr *cached = internCacheSlot(name, len);
+    if (cached->attr != NULL && cached->len == len && memcmp(cached->attr, name, len) == 0) {
+        return cached->attr;
+    }
+
+    std::string_view attr(name, len);
+    Mutex::Autolock _l(sAttrMutex);
+    auto it = sAttrs->find(attr);
+    if (it != sAttrs->end()) {
+        *cached = { it->data(), len };
+        return it->data();
+    }
+    if (sAttrs->size() >= kMaxInternedAttrs || sAttrBytes + len + 1 > kMaxInternedBytes) {
+        return NULL;
+    }
+    char *p = (char *) malloc(len + 1);
+    if (p == NULL) {
+        return NULL;
+    }
+    memcpy(p, name, len);
+    p[len] = '\0';
+    sAttrs->insert(std::string_view(p, len));
+    sAttrBytes += len + 1;
+    *cached = { p, len };
+    return p;
+}
+
+// the interned copy of a name, or our own when the table is full
+const char *MediaAnalyticsItem::storeAttr(const char *name, size_t len) {
+    const char *p = internAttr(name, len);
+    if (p == NULL) {
+        p = arenaDup(name, len);
+    }
+    return p;
 }
 
 // consider this "find-or-allocate".
 // caller validates type and uses clearPropValue() accordingly
 MediaAnalyticsItem::Prop *MediaAnalyticsItem::allocateProp(const char *name) {
-    size_t len = strlen(name);
+    return allocateProp(name, strlen(name));
+}
+
+// 'name' need not be null terminated
+MediaAnalyticsItem::Prop *MediaAnalyticsItem::allocateProp(const char *name, size_t len) {
     size_t i = findPropIndex(name, len);
     Prop *prop;
 
@@ -286,7 +353,8 @@ MediaAnalyticsItem::Prop *MediaAnalyticsItem::allocateProp(const char *name) {
         }
         i = mPropCount++;
         prop = &mProps[i];
-        prop->setName(name, len);
+        prop->mName = storeAttr(name, len);
+        prop->mNameLen = len;
     }
 
     return prop;
@@ -301,9 +369,9 @@ bool MediaAnalyticsItem::removeProp(const char *name) {
         clearProp(prop);
         if (i != mPropCount-1) {
             // in the middle, bring last one down to fill gap
-            copyProp(prop, &mProps[mPropCount-1]);
-            clearProp(&mProps[mPropCount-1]);
+            *prop = mProps[mPropCount-1];
         }
+        initProp(&mProps[mPropCount-1]);
         mPropCount--;
         return true;
     }
@@ -343,9 +411,22 @@ void MediaAnalyticsItem::setCString(MediaAnalyticsItem::Attr name, const char *v
     Prop *prop = allocateProp(name);
     // any old value will be gone
     if (prop != NULL) {
+        size_t len = strlen(value);
+        if (prop->mType == kTypeCString && prop->u.CStringValue != NULL) {
+            // overwrite in place when it fits, e.g. a state updated over and over
+            size_t oldLen = strlen(prop->u.CStringValue);
+            if (len <= oldLen) {
+                memmove(prop->u.CStringValue, value, len + 1);
+                mArenaWaste += oldLen - len;
+                return;
+            }
+        }
         clearPropValue(prop);
         prop->mType = kTypeCString;
-        prop->u.CStringValue = strdup(value);
+        prop->u.CStringValue = arenaDup(value, len);
+        if (mArenaWaste > kArenaBlockSize && mArenaWaste > mArenaBytes / 2) {
+            compactArena();
+        }
     }
 }
 
@@ -534,6 +615,7 @@ int32_t MediaAnalyticsItem::filter(int n, MediaAnalyticsItem::Attr attrs[]) {
             zapped++;
             clearProp(&mProps[j]);
             mProps[j] = mProps[mPropCount-1];
+            initProp(&mProps[mPropCount-1]);
             mPropCount--;
         }
     }
@@ -583,11 +665,11 @@ void MediaAnalyticsItem::initProp(Prop *prop) {
     }
 }
 
+// the name is left to the intern table or the arena
 void MediaAnalyticsItem::clearProp(Prop *prop)
 {
     if (prop != NULL) {
         if (prop->mName != NULL) {
-            free((void *)prop->mName);
             prop->mName = NULL;
             prop->mNameLen = 0;
         }
@@ -600,13 +682,14 @@ void MediaAnalyticsItem::clearPropValue(Prop *prop)
 {
     if (prop != NULL) {
         if (prop->mType == kTypeCString && prop->u.CStringValue != NULL) {
-            free(prop->u.CStringValue);
+            mArenaWaste += strlen(prop->u.CStringValue) + 1;
             prop->u.CStringValue = NULL;
         }
         prop->mType = kTypeNone;
     }
 }
 
+// dst belongs to this record, src may belong to another
 void MediaAnalyticsItem::copyProp(Prop *dst, const Prop *src)
 {
     // get rid of any pointers in the dst
@@ -616,15 +699,10 @@ void MediaAnalyticsItem::copyProp(Prop *dst, const Prop *src)
 
     // fix any pointers that we blindly copied, so we have our own copies
     if (dst->mName) {
-        void *p =  malloc(dst->mNameLen + 1);
-        LOG_ALWAYS_FATAL_IF(p == NULL,
-                            "failed malloc() duping property '%s' (len %zu)",
-                            dst->mName, dst->mNameLen);
-        memcpy (p, src->mName, dst->mNameLen + 1);
-        dst->mName = (const char *) p;
+        dst->mName = storeAttr(src->mName, src->mNameLen);
     }
     if (dst->mType == kTypeCString) {
-        dst->u.CStringValue = strdup(src->u.CStringValue);
+        dst->u.CStringValue = arenaDup(src->u.CStringValue, strlen(src->u.CStringValue));
     }
 }
 
@@ -649,6 +727,89 @@ bool MediaAnalyticsItem::growProps(int increment)
     }
 }
 
+// per record storage for strings
+//
+
+struct MediaAnalyticsItem::ArenaBlock {
+    ArenaBlock *next;
+    size_t size;        // bytes following this header
+    size_t used;
+
+    // whether p is in this block or one of the older ones
+    bool holds(const char *p) const {
+        for (const ArenaBlock *block = this; block != NULL; block = block->next) {
+            const char *data = (const char *) (block + 1);
+            if (p >= data && p < data + block->used) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+char *MediaAnalyticsItem::arenaAlloc(size_t size)
+{
+    ArenaBlock *block = mArena;
+    if (block == NULL || block->size - block->used < size) {
+        size_t bytes = std::max(size, (size_t) kArenaBlockSize);
+        block = (ArenaBlock *) malloc(sizeof(ArenaBlock) + bytes);
+        LOG_ALWAYS_FATAL_IF(block == NULL,
+                            "failed malloc() for %zu bytes of properties", bytes);
+        block->next = mArena;
+        block->size = bytes;
+        block->used = 0;
+        mArena = block;
+        mArenaBytes += sizeof(ArenaBlock) + bytes;
+    }
+    char *p = (char *) (block + 1) + block->used;
+    block->used += size;
+    return p;
+}
+
+// 'value' need not be null terminated
+char *MediaAnalyticsItem::arenaDup(const char *value, size_t len)
+{
+    char *p = arenaAlloc(len + 1);
+    memcpy(p, value, len);
+    p[len] = '\0';
+    return p;
+}
+
+// moves the live strings to new blocks, dropping overwritten values
+void MediaAnalyticsItem::compactArena()
+{
+    ArenaBlock *old = mArena;
+    mArena = NULL;
+    mArenaBytes = 0;
+    mArenaWaste = 0;
+    for (size_t i = 0; i < mPropCount; i++) {
+        Prop *prop = &mProps[i];
+        if (prop->mName != NULL && old != NULL && old->holds(prop->mName)) {
+            prop->mName = arenaDup(prop->mName, prop->mNameLen);
+        }
+        if (prop->mType == kTypeCString && prop->u.CStringValue != NULL) {
+            prop->u.CStringValue = arenaDup(prop->u.CStringValue,
+                                            strlen(prop->u.CStringValue));
+        }
+    }
+    while (old != NULL) {
+        ArenaBlock *next = old->next;
+        free(old);
+        old = next;
+    }
+}
+
+void MediaAnalyticsItem::freeArena()
+{
+    while (mArena != NULL) {
+        ArenaBlock *next = mArena->next;
+        free(mArena);
+        mArena = next;
+    }
+    mArenaBytes = 0;
+    mArenaWaste = 0;
+}
+
 // Parcel / serialize things for binder calls
 //
 
@@ -659,6 +820,9 @@ int32_t MediaAnalyticsItem::readFromParcel(const Parcel& data) {
         case 0:
           return readFromParcel0(data);
           break;
+        case 1:
+          return readFromParcel1(data);
+          break;
         default:
           ALOGE("Unsupported MediaAnalyticsItem Parcel version: %d", version);
           return -1;
@@ -718,13 +882,16 @@ int32_t MediaAnalyticsItem::writeToParcel(Parcel *data) {
 
     if (data == NULL) return -1;
 
-    int32_t version = 0;
+    int32_t version = 1;
     data->writeInt32(version);
 
     switch(version) {
         case 0:
           return writeToParcel0(data);
           break;
+        case 1:
+          return writeToParcel1(data);
+          break;
         default:
           ALOGE("Unsupported MediaAnalyticsItem Parcel version: %d", version);
           return -1;
@@ -776,6 +943,266 @@ int32_t MediaAnalyticsItem::writeToParcel0(Parcel *data) {
     return 0;
 }
 
+// Parcel version 1: the record as one length-prefixed blob, written and
+// parsed in place in the Parcel's buffer. Fields are in host order, unaligned.
+//   key, package name              uint32 length, bytes (no terminator)
+//   pid, uid                       int32
+//   package version code           int64
+//   session id, timestamp          int64
+//   count of attributes            uint32
+//   count times:
+//     name                         uint16 length, bytes (no terminator)
+//     type                         uint8
+//     value                        int32, int64, double: 4, 8, 8 bytes
+//                                  rate: count and duration, int64 each
+//                                  cstring: uint32 length, bytes (no terminator)
+
+namespace {
+
+class WireWriter {
+public:
+    explicit WireWriter(uint8_t *p) : mNext(p) {}
+
+    template <typename T>
+    void write(T value) {
+        memcpy(mNext, &value, sizeof(value));
+        mNext += sizeof(value);
+    }
+
+    template <typename L>
+    void writeString(const char *value, size_t len) {
+        write((L) len);
+        memcpy(mNext, value, len);
+        mNext += len;
+    }
+
+private:
+    uint8_t *mNext;
+};
+
+// every read is checked against the end of the blob
+class WireReader {
+public:
+    WireReader(const uint8_t *p, size_t size) : mNext(p), mEnd(p + size) {}
+
+    template <typename T>
+    bool read(T *value) {
+        if ((size_t) (mEnd - mNext) < sizeof(*value)) {
+            return false;
+        }
+        memcpy(value, mNext, sizeof(*value));
+        mNext += sizeof(*value);
+        return true;
+    }
+
+    // points into the blob, without a terminator
+    template <typename L>
+    bool readString(const char **value, size_t *len) {
+        L length;
+        if (!read(&length) || (size_t) (mEnd - mNext) < length) {
+            return false;
+        }
+        *value = (const char *) mNext;
+        *len = length;
+        mNext += length;
+        return true;
+    }
+
+private:
+    const uint8_t *mNext;
+    const uint8_t *mEnd;
+};
+
+} // namespace
+
+int32_t MediaAnalyticsItem::writeToParcel1(Parcel *data) {
+
+    // size the blob, leaving out anything we cannot encode
+    size_t size = sizeof(uint32_t) + mKey.size() + sizeof(uint32_t) + mPkgName.size()
+            + 2 * sizeof(int32_t) + 3 * sizeof(int64_t) + sizeof(uint32_t);
+    uint32_t count = 0;
+    for (size_t i = 0 ; i < mPropCount; i++) {
+        Prop *prop = &mProps[i];
+        if (prop->mNameLen > UINT16_MAX) {
+            continue;
+        }
+        size_t valueSize;
+        switch (prop->mType) {
+            case MediaAnalyticsItem::kTypeInt32:
+                    valueSize = sizeof(int32_t);
+                    break;
+            case MediaAnalyticsItem::kTypeInt64:
+                    valueSize = sizeof(int64_t);
+                    break;
+            case MediaAnalyticsItem::kTypeDouble:
+                    valueSize = sizeof(double);
+                    break;
+            case MediaAnalyticsItem::kTypeRate:
+                    valueSize = 2 * sizeof(int64_t);
+                    break;
+            case MediaAnalyticsItem::kTypeCString:
+                    valueSize = sizeof(uint32_t) + strlen(prop->u.CStringValue);
+                    break;
+            default:
+                    ALOGE("found bad Prop type: %d, idx %zu, name %s",
+                          prop->mType, i, prop->mName);
+                    continue;
+        }
+        size += sizeof(uint16_t) + prop->mNameLen + sizeof(uint8_t) + valueSize;
+        count++;
+    }
+    if (size > INT32_MAX) {
+        ALOGE("MediaAnalyticsItem too large for a Parcel: %zu bytes", size);
+        return -1;
+    }
+
+    data->writeInt32((int32_t) size);
+    uint8_t *blob = (uint8_t *) data->writeInplace(size);
+    if (blob == NULL) {
+        return -1;
+    }
+
+    WireWriter out(blob);
+    out.writeString<uint32_t>(mKey.c_str(), mKey.size());
+    out.writeString<uint32_t>(mPkgName.c_str(), mPkgName.size());
+    out.write((int32_t) mPid);
+    out.write((int32_t) mUid);
+    out.write(mPkgVersionCode);
+    out.write(mSessionID);
+    out.write(mTimestamp);
+    out.write(count);
+    for (size_t i = 0 ; i < mPropCount; i++) {
+        Prop *prop = &mProps[i];
+        if (prop->mNameLen > UINT16_MAX) {
+            continue;
+        }
+        switch (prop->mType) {
+            case MediaAnalyticsItem::kTypeInt32:
+            case MediaAnalyticsItem::kTypeInt64:
+            case MediaAnalyticsItem::kTypeDouble:
+            case MediaAnalyticsItem::kTypeRate:
+            case MediaAnalyticsItem::kTypeCString:
+                    break;
+            default:
+                    continue;
+        }
+        out.writeString<uint16_t>(prop->mName, prop->mNameLen);
+        out.write((uint8_t) prop->mType);
+        switch (prop->mType) {
+            case MediaAnalyticsItem::kTypeInt32:
+                    out.write(prop->u.int32Value);
+                    break;
+            case MediaAnalyticsItem::kTypeInt64:
+                    out.write(prop->u.int64Value);
+                    break;
+            case MediaAnalyticsItem::kTypeDouble:
+                    out.write(prop->u.doubleValue);
+                    break;
+            case MediaAnalyticsItem::kTypeRate:
+                    out.write(prop->u.rate.count);
+                    out.write(prop->u.rate.duration);
+                    break;
+            case MediaAnalyticsItem::kTypeCString:
+                    out.writeString<uint32_t>(prop->u.CStringValue,
+                                              strlen(prop->u.CStringValue));
+                    break;
+            default:
+                    break;
+        }
+    }
+
+    return 0;
+}
+
+int32_t MediaAnalyticsItem::readFromParcel1(const Parcel& data) {
+    int32_t size = data.readInt32();
+    const void *blob = size > 0 ? data.readInplace(size) : NULL;
+    if (blob == NULL) {
+        ALOGE("bad MediaAnalyticsItem Parcel size: %d", size);
+        return -1;
+    }
+
+    // nothing is copied out of the blob but the strings we keep
+    WireReader in((const uint8_t *) blob, size);
+    const char *key, *pkgName;
+    size_t keyLen, pkgNameLen;
+    int32_t pid, uid;
+    uint32_t count;
+    if (!in.readString<uint32_t>(&key, &keyLen)
+            || !in.readString<uint32_t>(&pkgName, &pkgNameLen)
+            || !in.read(&pid) || !in.read(&uid)
+            || !in.read(&mPkgVersionCode) || !in.read(&mSessionID) || !in.read(&mTimestamp)
+            || !in.read(&count)) {
+        ALOGE("truncated MediaAnalyticsItem Parcel");
+        return -1;
+    }
+    mKey.assign(key, keyLen);
+    mPkgName.assign(pkgName, pkgNameLen);
+    mPid = pid;
+    mUid = uid;
+    mFinalized = 1;
+
+    // room for all the attributes at once; each takes at least 4 bytes
+    size_t wanted = std::min((size_t) count, (size_t) size / 4);
+    if (wanted > mPropSize - mPropCount) {
+        growProps(wanted - (mPropSize - mPropCount));
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const char *name;
+        size_t nameLen;
+        uint8_t ztype;
+        if (!in.readString<uint16_t>(&name, &nameLen) || !in.read(&ztype)) {
+            ALOGE("truncated MediaAnalyticsItem Parcel, idx %u", i);
+            return -1;
+        }
+        if (nameLen == 0 || memchr(name, '\0', nameLen) != NULL) {
+            ALOGE("reading bad item name, idx %u", i);
+            return -1;
+        }
+        Prop *prop = allocateProp(name, nameLen);
+        if (prop == NULL) {
+            return -1;
+        }
+        clearPropValue(prop);
+        bool ok;
+        switch (ztype) {
+            case MediaAnalyticsItem::kTypeInt32:
+                    ok = in.read(&prop->u.int32Value);
+                    break;
+            case MediaAnalyticsItem::kTypeInt64:
+                    ok = in.read(&prop->u.int64Value);
+                    break;
+            case MediaAnalyticsItem::kTypeDouble:
+                    ok = in.read(&prop->u.doubleValue);
+                    break;
+            case MediaAnalyticsItem::kTypeRate:
+                    ok = in.read(&prop->u.rate.count) && in.read(&prop->u.rate.duration);
+                    break;
+            case MediaAnalyticsItem::kTypeCString:
+                    {
+                        const char *value;
+                        size_t len;
+                        ok = in.readString<uint32_t>(&value, &len);
+                        if (ok) {
+                            prop->u.CStringValue = arenaDup(value, len);
+                        }
+                    }
+                    break;
+            default:
+                    ALOGE("reading bad item type: %d, idx %u", ztype, i);
+                    return -1;
+        }
+        if (!ok) {
+            ALOGE("truncated MediaAnalyticsItem Parcel, idx %u", i);
+            return -1;
+        }
+        prop->mType = (Type) ztype;
+    }
+
+    return 0;
+}
+
 const char *MediaAnalyticsItem::toCString() {
    return toCString(PROTO_LAST);
 }
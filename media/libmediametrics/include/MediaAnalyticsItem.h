@@ -42,6 +42,7 @@ class MediaAnalyticsItem {
     friend class MediaMetricsJNI;
     friend class MetricsSummarizer;
     friend class MediaMetricsDeathNotifier;
+    friend class MediaAnalyticsStore;
 
     public:
 
@@ -198,6 +199,9 @@ class MediaAnalyticsItem {
         // handle Parcel version 0
         int32_t writeToParcel0(Parcel *);
         int32_t readFromParcel0(const Parcel&);
+        // handle Parcel version 1, a compact blob parsed in place
+        int32_t writeToParcel1(Parcel *);
+        int32_t readFromParcel1(const Parcel&);
 
     protected:
 
@@ -234,6 +238,8 @@ class MediaAnalyticsItem {
 
         Key mKey;
 
+        // names are interned or in mArena, CString values are in mArena;
+        // neither is freed with the Prop.
         struct Prop {
 
             Type mType;
@@ -246,7 +252,6 @@ class MediaAnalyticsItem {
                     char *CStringValue;
                     struct { int64_t count, duration; } rate;
             } u;
-            void setName(const char *name, size_t len);
         };
 
         void initProp(Prop *item);
@@ -260,11 +265,32 @@ class MediaAnalyticsItem {
         size_t findPropIndex(const char *name, size_t len);
         Prop *findProp(const char *name);
         Prop *allocateProp(const char *name);
+        Prop *allocateProp(const char *name, size_t len);
         bool removeProp(const char *name);
 
         size_t mPropCount;
         size_t mPropSize;
         Prop *mProps;
+
+        // attribute names are interned in a process-wide table, so each
+        // name is stored once however many records use it.
+        // returns NULL once the table is full
+        static const char *internAttr(const char *name, size_t len);
+        const char *storeAttr(const char *name, size_t len);
+
+        // the strings of this record, freed all at once with the record
+        struct ArenaBlock;
+        enum {
+            kArenaBlockSize = 256,
+        };
+        char *arenaAlloc(size_t size);
+        char *arenaDup(const char *value, size_t len);
+        void compactArena();
+        void freeArena();
+
+        ArenaBlock *mArena;     // most recent block first
+        size_t mArenaBytes;     // allocated for the blocks
+        size_t mArenaWaste;     // no longer referenced
 };
 
 } // namespace android
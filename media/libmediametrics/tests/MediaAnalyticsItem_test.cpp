@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaAnalyticsItem_test"
+#include <utils/Log.h>
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <gtest/gtest.h>
+#include <media/MediaAnalyticsItem.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// the attributes of a typical codec record
+static MediaAnalyticsItem *newCodecItem(int i) {
+    MediaAnalyticsItem *item = MediaAnalyticsItem::create("codec");
+    item->setPkgName("com.example.player");
+    item->setPid(1000 + i);
+    item->setUid(10000 + i);
+    item->setCString("android.media.mediacodec.codec", "c2.android.avc.decoder");
+    item->setCString("android.media.mediacodec.mime", "video/avc");
+    item->setCString("android.media.mediacodec.mode", "video");
+    item->setInt32("android.media.mediacodec.encoder", 0);
+    item->setInt32("android.media.mediacodec.secure", 0);
+    item->setInt32("android.media.mediacodec.width", 1920);
+    item->setInt32("android.media.mediacodec.height", 1080);
+    item->setInt32("android.media.mediacodec.rotation-degrees", 0);
+    item->setInt32("android.media.mediacodec.crypto", 0);
+    item->setInt64("android.media.mediacodec.latency.max", 33000 + i);
+    item->setDouble("android.media.mediacodec.framerate", 29.97);
+    item->setRate("android.media.mediacodec.frames", 300 + i, 10000);
+    return item;
+}
+
+static void expectSameItems(MediaAnalyticsItem *expected, MediaAnalyticsItem *actual) {
+    EXPECT_EQ(expected->getKey(), actual->getKey());
+    EXPECT_EQ(expected->getPkgName(), actual->getPkgName());
+    EXPECT_EQ(expected->getPid(), actual->getPid());
+    EXPECT_EQ(expected->getUid(), actual->getUid());
+    EXPECT_EQ(expected->getSessionID(), actual->getSessionID());
+    EXPECT_EQ(expected->getTimestamp(), actual->getTimestamp());
+    EXPECT_EQ(expected->count(), actual->count());
+    EXPECT_EQ(expected->toString(), actual->toString());
+}
+
+TEST(MediaAnalyticsItemTest, parcelRoundTrip) {
+    std::unique_ptr<MediaAnalyticsItem> item(newCodecItem(1));
+    item->setSessionID(42);
+    item->setTimestamp(123456789);
+    item->setPkgVersionCode(7);
+
+    Parcel parcel;
+    ASSERT_EQ(0, item->writeToParcel(&parcel));
+    parcel.setDataPosition(0);
+    std::unique_ptr<MediaAnalyticsItem> copy(MediaAnalyticsItem::create());
+    ASSERT_EQ(0, copy->readFromParcel(parcel));
+    expectSameItems(item.get(), copy.get());
+
+    std::string mime;
+    EXPECT_TRUE(copy->getString("android.media.mediacodec.mime", &mime));
+    EXPECT_EQ("video/avc", mime);
+    int64_t count, duration;
+    EXPECT_TRUE(copy->getRate("android.media.mediacodec.frames", &count, &duration, NULL));
+    EXPECT_EQ(301, count);
+    EXPECT_EQ(10000, duration);
+}
+
+TEST(MediaAnalyticsItemTest, parcelVersion0) {
+    Parcel parcel;
+    parcel.writeInt32(0);           // version
+    parcel.writeCString("audiotrack");
+    parcel.writeInt32(1234);        // pid
+    parcel.writeInt32(10001);       // uid
+    parcel.writeCString("com.example.player");
+    parcel.writeInt64(7);           // package version code
+    parcel.writeInt64(42);          // session id
+    parcel.writeInt32(1);           // finalized
+    parcel.writeInt64(123456789);   // timestamp
+    parcel.writeInt32(2);
+    parcel.writeCString("android.media.audiotrack.channelMask");
+    parcel.writeInt32(MediaAnalyticsItem::kTypeInt32);
+    parcel.writeInt32(3);
+    parcel.writeCString("android.media.audiotrack.encoding");
+    parcel.writeInt32(MediaAnalyticsItem::kTypeCString);
+    parcel.writeCString("AUDIO_FORMAT_PCM_16_BIT");
+    parcel.setDataPosition(0);
+
+    std::unique_ptr<MediaAnalyticsItem> item(MediaAnalyticsItem::create());
+    ASSERT_EQ(0, item->readFromParcel(parcel));
+    EXPECT_EQ("audiotrack", item->getKey());
+    EXPECT_EQ(1234, item->getPid());
+    EXPECT_EQ(2, item->count());
+    std::string encoding;
+    EXPECT_TRUE(item->getString("android.media.audiotrack.encoding", &encoding));
+    EXPECT_EQ("AUDIO_FORMAT_PCM_16_BIT", encoding);
+}
+
+TEST(MediaAnalyticsItemTest, parcelTruncated) {
+    std::unique_ptr<MediaAnalyticsItem> item(newCodecItem(1));
+    Parcel parcel;
+    ASSERT_EQ(0, item->writeToParcel(&parcel));
+
+    // every shorter blob is rejected
+    const size_t size = parcel.dataSize();
+    for (size_t cut = 2 * sizeof(int32_t); cut < size; cut += sizeof(int32_t)) {
+        Parcel truncated;
+        truncated.writeInt32(1);    // version
+        truncated.writeInt32(cut - 2 * sizeof(int32_t));
+        void *blob = truncated.writeInplace(cut - 2 * sizeof(int32_t));
+        memcpy(blob, parcel.data() + 2 * sizeof(int32_t), cut - 2 * sizeof(int32_t));
+        truncated.setDataPosition(0);
+        std::unique_ptr<MediaAnalyticsItem> copy(MediaAnalyticsItem::create());
+        EXPECT_NE(0, copy->readFromParcel(truncated)) << "cut at " << cut;
+    }
+}
+
+TEST(MediaAnalyticsItemTest, strings) {
+    std::unique_ptr<MediaAnalyticsItem> item(MediaAnalyticsItem::create("nuplayer"));
+
+    // values overwritten many times, growing and shrinking
+    std::string value;
+    for (int i = 0; i < 1000; i++) {
+        value = std::string(i % 97, 'a' + i % 26);
+        item->setCString("android.media.mediaplayer.state", value.c_str());
+        item->setInt32("android.media.mediaplayer.errcode", i);
+    }
+    std::string state;
+    EXPECT_TRUE(item->getString("android.media.mediaplayer.state", &state));
+    EXPECT_EQ(value, state);
+
+    std::unique_ptr<MediaAnalyticsItem> copy(item->dup());
+    item.reset();
+    EXPECT_TRUE(copy->getString("android.media.mediaplayer.state", &state));
+    EXPECT_EQ(value, state);
+    int32_t errcode;
+    EXPECT_TRUE(copy->getInt32("android.media.mediaplayer.errcode", &errcode));
+    EXPECT_EQ(999, errcode);
+
+    EXPECT_EQ(1, copy->filter("android.media.mediaplayer.state"));
+    EXPECT_FALSE(copy->getString("android.media.mediaplayer.state", &state));
+    EXPECT_EQ(1, copy->count());
+}
+
+// submit cost: building, writing and (in the service) reading a record
+TEST(MediaAnalyticsItemTest, benchmark) {
+    static constexpr int kItems = 10000;
+
+    nsecs_t buildNs = 0, writeNs = 0, readNs = 0;
+    std::vector<std::unique_ptr<MediaAnalyticsItem>> received;
+    const size_t heapBefore = mallinfo().uordblks;
+    for (int i = 0; i < kItems; i++) {
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        std::unique_ptr<MediaAnalyticsItem> item(newCodecItem(i));
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        buildNs += now - start;
+
+        Parcel parcel;
+        start = now;
+        ASSERT_EQ(0, item->writeToParcel(&parcel));
+        now = systemTime(SYSTEM_TIME_MONOTONIC);
+        writeNs += now - start;
+
+        parcel.setDataPosition(0);
+        start = now;
+        received.emplace_back(MediaAnalyticsItem::create());
+        ASSERT_EQ(0, received.back()->readFromParcel(parcel));
+        readNs += systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    }
+    const size_t heapAfter = mallinfo().uordblks;
+
+    printf("%d records of %d attributes: build %.1f us, write %.1f us, read %.1f us,"
+            " %zu heap bytes retained per received record\n",
+            kItems, received.back()->count(),
+            buildNs * 1e-3 / kItems, writeNs * 1e-3 / kItems, readNs * 1e-3 / kItems,
+            (heapAfter - heapBefore) / kItems);
+}
+
+} // namespace android
@@ -268,6 +268,27 @@ status_t MetadataRetrieverClient::getFrameAtIndex(
     return OK;
 }
 
+status_t MetadataRetrieverClient::getFramesAtTimes(
+            std::vector<sp<IMemory> > *frames, const std::vector<int64_t> &timesUs,
+            int option, int colorFormat, int maxWidth, int maxHeight) {
+    ALOGV("getFramesAtTimes: %zu times, option(%d), colorFormat(%d), max size(%dx%d)",
+            timesUs.size(), option, colorFormat, maxWidth, maxHeight);
+    Mutex::Autolock lock(mLock);
+    Mutex::Autolock glock(sLock);
+    if (mRetriever == NULL) {
+        ALOGE("retriever is not initialized");
+        return INVALID_OPERATION;
+    }
+
+    status_t err = mRetriever->getFramesAtTimes(
+            frames, timesUs, option, colorFormat, maxWidth, maxHeight);
+    if (err != OK) {
+        frames->clear();
+        return err;
+    }
+    return OK;
+}
+
 sp<IMemory> MetadataRetrieverClient::extractAlbumArt()
 {
     ALOGV("extractAlbumArt");
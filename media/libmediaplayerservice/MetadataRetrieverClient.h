@@ -59,6 +59,9 @@ public:
     virtual status_t getFrameAtIndex(
                 std::vector<sp<IMemory> > *frames,
                 int frameIndex, int numFrames, int colorFormat, bool metaOnly);
+    virtual status_t getFramesAtTimes(
+                std::vector<sp<IMemory> > *frames, const std::vector<int64_t> &timesUs,
+                int option, int colorFormat, int maxWidth, int maxHeight);
     virtual sp<IMemory>             extractAlbumArt();
     virtual const char*             extractMetadata(int keyCode);
 
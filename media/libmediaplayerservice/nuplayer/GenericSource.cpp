@@ -472,6 +472,11 @@ void NuPlayer::GenericSource::onPrepareAsync() {
         return;
     }
 
+    // Lets the cache size its watermarks in seconds of playback.
+    if (mCachedSource != NULL && mBitrate > 0) {
+        mCachedSource->setBitrate(mBitrate);
+    }
+
     if (mVideoTrack.mSource != NULL) {
         sp<MetaData> meta = getFormatMeta_l(false /* audio */);
         sp<AMessage> msg = new AMessage;
@@ -35,6 +35,7 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/avc_utils.h>
+#include <media/stagefright/FrameTrace.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaCodec.h>
 #include <media/stagefright/MediaDefs.h>
@@ -369,6 +370,7 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
 
     mStats->setString("mime", mime.c_str());
     mStats->setString("component-name", mComponentName.c_str());
+    mStats->setObject("frame-trace", mCodec->getFrameTrace());
 
     if (!mIsAudio) {
         int32_t width, height;
@@ -30,6 +30,7 @@
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AUtils.h>
 #include <media/stagefright/foundation/ByteUtils.h>
+#include <media/stagefright/FrameTrace.h>
 #include <media/stagefright/MediaClock.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
@@ -886,12 +887,20 @@ void NuPlayerDriver::notifySeekComplete_l() {
 }
 
 status_t NuPlayerDriver::dump(
-        int fd, const Vector<String16> & /* args */) const {
+        int fd, const Vector<String16> &args) const {
+    // with --frame-trace, the latency of each frame still traced by the decoders
+    bool dumpFrames = false;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == String16("--frame-trace")) {
+            dumpFrames = true;
+        }
+    }
 
     Vector<sp<AMessage> > trackStats;
     mPlayer->getStats(&trackStats);
 
     AString logString(" NuPlayer\n");
+    AString frameLog;
     char buf[256] = {0};
 
     bool locked = false;
@@ -948,6 +957,18 @@ status_t NuPlayerDriver::dump(
                             ? 0.0 : (double)(numFramesDropped * 100) / numFramesTotal);
             logString.append(buf);
         }
+
+        sp<RefBase> obj;
+        if (stats->findObject("frame-trace", &obj) && obj != NULL) {
+            const FrameTrace *frameTrace = static_cast<FrameTrace *>(obj.get());
+            frameTrace->dump(&logString, "    ");
+            if (dumpFrames) {
+                // too long for the log
+                snprintf(buf, sizeof(buf), "  track(%zu) mime(%s)\n", i, mime.c_str());
+                frameLog.append(buf);
+                frameTrace->dumpFrames(&frameLog, "    ");
+            }
+        }
     }
 
     ALOGI("%s", logString.c_str());
@@ -955,6 +976,7 @@ status_t NuPlayerDriver::dump(
     if (fd >= 0) {
         FILE *out = fdopen(dup(fd), "w");
         fprintf(out, "%s", logString.c_str());
+        fprintf(out, "%s", frameLog.c_str());
         fclose(out);
         out = NULL;
     }
@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "NBLog"
+//#define LOG_NDEBUG 0
+
+#include <algorithm>
+#include <inttypes.h>
+#include <map>
+#include <math.h>
+#include <set>
+#include <stdio.h>
+#include <utility>
+
+#include <media/nblog/TraceAnalysis.h>
+#include <utils/Log.h>
+
+namespace android {
+namespace NBLog {
+
+namespace {
+
+constexpr double kNsPerMs = 1e6;
+constexpr size_t kMinJitterSamples = 16;
+
+// cycle times of a thread, with the time each one ended
+struct Cycles {
+    std::vector<int64_t> ts;
+    std::vector<double> ms;
+};
+
+const char *eventToString(Event event)
+{
+    switch (event) {
+    case EVENT_STRING:              return "STRING";
+    case EVENT_TIMESTAMP:           return "TIMESTAMP";
+    case EVENT_FMT_START:           return "FMT";
+    case EVENT_AUDIO_STATE:         return "AUDIO_STATE";
+    case EVENT_HISTOGRAM_ENTRY_TS:  return "HISTOGRAM_ENTRY_TS";
+    case EVENT_LATENCY:             return "LATENCY";
+    case EVENT_OVERRUN:             return "OVERRUN";
+    case EVENT_THREAD_INFO:         return "THREAD_INFO";
+    case EVENT_UNDERRUN:            return "UNDERRUN";
+    case EVENT_WARMUP_TIME:         return "WARMUP_TIME";
+    case EVENT_WORK_TIME:           return "WORK_TIME";
+    case EVENT_THREAD_PARAMS:       return "THREAD_PARAMS";
+    default:                        return "?";
+    }
+}
+
+// Amplitude spectrum of the deviation of the cycle times from their mean, sampled once
+// per cycle. A peak at f Hz means the cycle time varies periodically every 1/f seconds,
+// e.g. by contention with another periodic thread.
+std::vector<JitterPeak> jitterPeaks(const std::vector<double> &cyclesMs, size_t maxSamples,
+        size_t maxPeaks)
+{
+    const size_t n = std::min(cyclesMs.size(), maxSamples);
+    if (n < kMinJitterSamples || maxPeaks == 0) {
+        return {};
+    }
+    std::vector<double> x(cyclesMs.end() - n, cyclesMs.end());
+    double mean = 0;
+    for (double v : x) {
+        mean += v;
+    }
+    mean /= n;
+    if (mean <= 0) {
+        return {};
+    }
+    for (double &v : x) {
+        v -= mean;
+    }
+
+    std::vector<double> cosTable(n), sinTable(n);
+    for (size_t i = 0; i < n; i++) {
+        cosTable[i] = cos(2 * M_PI * i / n);
+        sinTable[i] = sin(2 * M_PI * i / n);
+    }
+    std::vector<double> amplitude(n / 2 + 1);
+    for (size_t k = 1; k <= n / 2; k++) {
+        double re = 0, im = 0;
+        size_t phase = 0;
+        for (size_t i = 0; i < n; i++) {
+            re += x[i] * cosTable[phase];
+            im -= x[i] * sinTable[phase];
+            phase += k;
+            if (phase >= n) {
+                phase -= n;
+            }
+        }
+        amplitude[k] = 2 * sqrt(re * re + im * im) / n;
+    }
+
+    const double sampleRateHz = 1000. / mean;
+    std::vector<JitterPeak> peaks;
+    for (size_t k = 1; k <= n / 2; k++) {
+        const double a = amplitude[k];
+        if (a > 1e-6 && a >= amplitude[k - 1] && (k == n / 2 || a > amplitude[k + 1])) {
+            peaks.push_back({k * sampleRateHz / n, a});
+        }
+    }
+    std::sort(peaks.begin(), peaks.end(), [](const JitterPeak &a, const JitterPeak &b) {
+        return a.amplitudeMs > b.amplitudeMs;
+    });
+    if (peaks.size() > maxPeaks) {
+        peaks.resize(maxPeaks);
+    }
+    return peaks;
+}
+
+void dumpPercentiles(int fd, const char *name, const Percentiles &p)
+{
+    if (p.count == 0) {
+        return;
+    }
+    dprintf(fd, "  %-12s n=%-7zu mean=%8.3f min=%8.3f p50=%8.3f p90=%8.3f p99=%8.3f max=%8.3f\n",
+            name, p.count, p.mean, p.min, p.p50, p.p90, p.p99, p.max);
+}
+
+}   // namespace
+
+Percentiles computePercentiles(std::vector<double> *values)
+{
+    Percentiles p;
+    p.count = values->size();
+    if (p.count == 0) {
+        return p;
+    }
+    std::sort(values->begin(), values->end());
+    double sum = 0;
+    for (double v : *values) {
+        sum += v;
+    }
+    // nearest rank
+    auto rank = [values](double fraction) {
+        const size_t index = (size_t) ceil(fraction * values->size());
+        return (*values)[index > 0 ? index - 1 : 0];
+    };
+    p.mean = sum / p.count;
+    p.min = values->front();
+    p.p50 = rank(0.5);
+    p.p90 = rank(0.9);
+    p.p99 = rank(0.99);
+    p.max = values->back();
+    return p;
+}
+
+TraceReport analyze(const TraceFile &trace, const AnalysisOptions &options)
+{
+    const std::vector<TraceThread> &threads = trace.threads();
+    const size_t threadCount = threads.size();
+
+    std::vector<Cycles> workCycles(threadCount);
+    std::vector<std::vector<double>> latencyMs(threadCount), warmupMs(threadCount);
+    std::vector<std::vector<int64_t>> underruns(threadCount), overruns(threadCount);
+    // by thread and log site: intervals, and the time of the last occurrence
+    std::map<std::pair<size_t, log_hash_t>, Cycles> sites;
+    std::map<std::pair<size_t, log_hash_t>, int64_t> lastSeen;
+    std::set<std::pair<size_t, log_hash_t>> histogramSites;
+
+    for (const TraceEvent &event : trace.events()) {
+        const size_t t = event.thread;
+        switch (event.type) {
+        case EVENT_WORK_TIME:
+            workCycles[t].ts.push_back(event.ts);
+            workCycles[t].ms.push_back(event.value / kNsPerMs);
+            break;
+        case EVENT_LATENCY:
+            latencyMs[t].push_back(event.valueMs);
+            break;
+        case EVENT_WARMUP_TIME:
+            warmupMs[t].push_back(event.valueMs);
+            break;
+        case EVENT_UNDERRUN:
+            underruns[t].push_back(event.ts);
+            break;
+        case EVENT_OVERRUN:
+            overruns[t].push_back(event.ts);
+            break;
+        case EVENT_AUDIO_STATE:
+            // the thread went idle: the next interval is not a cycle, as in PerformanceAnalysis
+            for (auto it = lastSeen.lower_bound({t, 0});
+                    it != lastSeen.end() && it->first.first == t; ) {
+                it = lastSeen.erase(it);
+            }
+            break;
+        case EVENT_FMT_START:
+        case EVENT_HISTOGRAM_ENTRY_TS: {
+            const auto key = std::make_pair(t, event.hash);
+            if (event.type == EVENT_HISTOGRAM_ENTRY_TS) {
+                histogramSites.insert(key);
+            }
+            auto last = lastSeen.find(key);
+            if (last != lastSeen.end()) {
+                Cycles &site = sites[key];
+                site.ts.push_back(event.ts);
+                site.ms.push_back((event.ts - last->second) / kNsPerMs);
+                last->second = event.ts;
+            } else {
+                lastSeen.emplace(key, event.ts);
+            }
+        } break;
+        default:
+            break;
+        }
+    }
+
+    TraceReport report;
+    report.windowNs = options.windowNs;
+    std::vector<std::vector<int64_t>> trouble(threadCount);
+    for (size_t t = 0; t < threadCount; t++) {
+        ThreadReport r;
+        r.thread = t;
+
+        // A fast thread logs each cycle time, other threads a histogram timestamp per cycle.
+        const Cycles *cycles = &workCycles[t];
+        if (cycles->ms.empty()) {
+            size_t most = 0;
+            for (const auto &site : sites) {
+                if (site.first.first == t && site.second.ms.size() > most
+                        && histogramSites.count(site.first) > 0) {
+                    most = site.second.ms.size();
+                    cycles = &site.second;
+                }
+            }
+        }
+        std::vector<double> cycleMs = cycles->ms;
+        r.cycleMs = computePercentiles(&cycleMs);
+        r.latencyMs = computePercentiles(&latencyMs[t]);
+        r.warmupMs = computePercentiles(&warmupMs[t]);
+        r.underruns = underruns[t].size();
+        r.overruns = overruns[t].size();
+
+        const thread_params_t &params = threads[t].params;
+        r.periodMs = params.sampleRate > 0 && params.frameCount > 0
+                ? params.frameCount * 1000. / params.sampleRate : r.cycleMs.p50;
+        std::vector<int64_t> &troubleTs = trouble[t];
+        troubleTs.insert(troubleTs.end(), underruns[t].begin(), underruns[t].end());
+        troubleTs.insert(troubleTs.end(), overruns[t].begin(), overruns[t].end());
+        if (r.periodMs > 0) {
+            for (size_t i = 0; i < cycles->ms.size(); i++) {
+                if (cycles->ms[i] > kLateCycleRatio * r.periodMs) {
+                    r.lateCycles++;
+                    troubleTs.push_back(cycles->ts[i]);
+                }
+            }
+        }
+        std::sort(troubleTs.begin(), troubleTs.end());
+
+        r.jitter = jitterPeaks(cycles->ms, options.jitterSamples, options.jitterPeaks);
+        report.threads.push_back(std::move(r));
+    }
+
+    for (auto &site : sites) {
+        EventReport e;
+        e.thread = site.first.first;
+        e.hash = site.first.second;
+        e.intervalMs = computePercentiles(&site.second.ms);
+        report.events.push_back(e);
+    }
+
+    for (size_t t = 0; t < threadCount; t++) {
+        if (underruns[t].empty()) {
+            continue;
+        }
+        for (size_t other = 0; other < threadCount; other++) {
+            if (other == t || trouble[other].empty()) {
+                continue;
+            }
+            UnderrunCorrelation c = {t, other, underruns[t].size(), 0};
+            for (int64_t ts : underruns[t]) {
+                auto it = std::lower_bound(trouble[other].begin(), trouble[other].end(),
+                        ts - options.windowNs);
+                if (it != trouble[other].end() && *it <= ts + options.windowNs) {
+                    c.coincident++;
+                }
+            }
+            report.correlations.push_back(c);
+        }
+    }
+    return report;
+}
+
+void dumpReport(int fd, const TraceFile &trace, const TraceReport &report)
+{
+    if (fd < 0) {
+        return;
+    }
+    const std::vector<TraceThread> &threads = trace.threads();
+    dprintf(fd, "NBLog trace: %zu threads, %zu events, captured at monotonic %" PRId64 " ns%s\n",
+            threads.size(), trace.events().size(), trace.capturedMonotonicNs(),
+            trace.truncated() ? " (truncated)" : "");
+    if (!trace.events().empty()) {
+        // cannot overflow, TraceFile::decode() rejects longer timelines
+        dprintf(fd, "Timeline: %.3f s\n",
+                (trace.events().back().ts - trace.events().front().ts) * 1e-9);
+    }
+
+    for (const ThreadReport &r : report.threads) {
+        const TraceThread &thread = threads[r.thread];
+        dprintf(fd, "\n%zu: %s type=%s handle=%d sampleRate=%u frameCount=%zu\n",
+                r.thread, thread.name.c_str(), threadTypeToString(thread.info.type),
+                (int) thread.info.id, thread.params.sampleRate, thread.params.frameCount);
+        dprintf(fd, "  snapshots=%zu lostBytes=%" PRIu64 " badEntries=%zu\n",
+                thread.snapshots, thread.lostBytes, thread.badEntries);
+        dprintf(fd, "  period=%.3f ms underruns=%zu overruns=%zu lateCycles=%zu\n",
+                r.periodMs, r.underruns, r.overruns, r.lateCycles);
+        dumpPercentiles(fd, "cycle ms", r.cycleMs);
+        dumpPercentiles(fd, "latency ms", r.latencyMs);
+        dumpPercentiles(fd, "warmup ms", r.warmupMs);
+        if (!r.jitter.empty()) {
+            dprintf(fd, "  jitter      ");
+            for (const JitterPeak &peak : r.jitter) {
+                dprintf(fd, " %.2f Hz: %.3f ms", peak.frequencyHz, peak.amplitudeMs);
+            }
+            dprintf(fd, "\n");
+        }
+    }
+
+    if (!report.events.empty()) {
+        dprintf(fd, "\nLog sites, interval between occurrences in ms:\n");
+        for (const EventReport &e : report.events) {
+            const Percentiles &p = e.intervalMs;
+            // lower 16 bits of the hash as hex and the line, as DumpReader prints them
+            dprintf(fd, "  %zu %.4X-%-5d n=%-7zu mean=%8.3f p50=%8.3f p90=%8.3f p99=%8.3f"
+                    " max=%8.3f",
+                    e.thread, (int) (e.hash >> 16) & 0xFFFF, (int) e.hash & 0xFFFF,
+                    p.count, p.mean, p.p50, p.p90, p.p99, p.max);
+            const auto &formats = threads[e.thread].formats;
+            auto format = formats.find(e.hash);
+            if (format != formats.end()) {
+                dprintf(fd, " \"%s\"", format->second.c_str());
+            }
+            dprintf(fd, "\n");
+        }
+    }
+
+    if (!report.correlations.empty()) {
+        dprintf(fd, "\nUnderruns coinciding with an underrun, overrun or late cycle"
+                " of another thread within %.1f ms:\n", report.windowNs / kNsPerMs);
+        for (const UnderrunCorrelation &c : report.correlations) {
+            dprintf(fd, "  %zu with %zu: %zu of %zu (%.0f%%)\n", c.thread, c.other,
+                    c.coincident, c.underruns, 100. * c.coincident / c.underruns);
+        }
+    }
+}
+
+void dumpTimeline(int fd, const TraceFile &trace)
+{
+    if (fd < 0) {
+        return;
+    }
+    dprintf(fd, "ts_ns,thread,event,value,estimated\n");
+    for (const TraceEvent &event : trace.events()) {
+        dprintf(fd, "%" PRId64 ",%u,%s,", event.ts, event.thread, eventToString(event.type));
+        switch (event.type) {
+        case EVENT_WORK_TIME:
+            dprintf(fd, "%" PRId64, event.value);
+            break;
+        case EVENT_LATENCY:
+        case EVENT_WARMUP_TIME:
+            dprintf(fd, "%.3f", event.valueMs);
+            break;
+        case EVENT_FMT_START:
+        case EVENT_HISTOGRAM_ENTRY_TS:
+        case EVENT_AUDIO_STATE:
+            dprintf(fd, "%.4X-%d", (int) (event.hash >> 16) & 0xFFFF, (int) event.hash & 0xFFFF);
+            break;
+        default:
+            break;
+        }
+        dprintf(fd, ",%d\n", event.estimated ? 1 : 0);
+    }
+}
+
+}   // namespace NBLog
+}   // namespace android
@@ -0,0 +1,455 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "NBLog"
+//#define LOG_NDEBUG 0
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <media/nblog/TraceFile.h>
+#include <utils/Log.h>
+
+namespace android {
+namespace NBLog {
+
+namespace {
+
+// Both ends of the format are little endian; memcpy keeps unaligned reads safe.
+template <typename T>
+void appendValue(std::string *out, T value)
+{
+    out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T readValue(const uint8_t *p)
+{
+    T value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+int64_t clockNs(clockid_t clock)
+{
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+constexpr size_t kHeaderSize = 24;
+constexpr size_t kRecordHeaderSize = 8;
+constexpr size_t kSnapshotHeaderSize = 20;
+
+// offsets in a log entry, see Entry.h
+constexpr size_t kEntryTypeOffset = 0;
+constexpr size_t kEntryLengthOffset = 1;
+constexpr size_t kEntryDataOffset = 2;
+constexpr size_t kEntryOverhead = 3;
+
+}   // namespace
+
+// ---------------------------------------------------------------------------
+
+TraceWriter::TraceWriter(int fd)
+    : mFd(fd)
+{
+    std::string header;
+    appendValue<uint32_t>(&header, kTraceMagic);
+    appendValue<uint16_t>(&header, kTraceVersion);
+    appendValue<uint16_t>(&header, kHeaderSize);
+    appendValue<int64_t>(&header, clockNs(CLOCK_MONOTONIC));
+    appendValue<int64_t>(&header, clockNs(CLOCK_REALTIME));
+    writeRecord(TraceRecord(0), header, nullptr, 0);
+}
+
+uint32_t TraceWriter::addThread(const std::string &name)
+{
+    const uint32_t thread = mThreads++;
+    std::string header;
+    appendValue<uint32_t>(&header, thread);
+    writeRecord(TRACE_RECORD_THREAD, header,
+            reinterpret_cast<const uint8_t *>(name.data()), name.size());
+    return thread;
+}
+
+void TraceWriter::addSnapshot(uint32_t thread, const uint8_t *data, size_t size, uint64_t lost,
+        int64_t takenNs)
+{
+    std::string header;
+    appendValue<uint32_t>(&header, thread);
+    appendValue<uint64_t>(&header, lost);
+    appendValue<int64_t>(&header, takenNs);
+    writeRecord(TRACE_RECORD_SNAPSHOT, header, data, size);
+}
+
+// type 0 writes the header alone, which is how the file header goes out
+void TraceWriter::writeRecord(TraceRecord type, const std::string &header,
+        const uint8_t *data, size_t size)
+{
+    if (mStatus != OK) {
+        return;
+    }
+    std::string buffer;
+    if (type != 0) {
+        if (header.size() + size > UINT32_MAX) {
+            mStatus = BAD_VALUE;
+            return;
+        }
+        appendValue<uint32_t>(&buffer, type);
+        appendValue<uint32_t>(&buffer, header.size() + size);
+    }
+    buffer.append(header);
+    buffer.append(reinterpret_cast<const char *>(data), size);
+
+    const char *p = buffer.data();
+    size_t remaining = buffer.size();
+    while (remaining > 0) {
+        const ssize_t written = write(mFd, p, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            mStatus = -errno;
+            ALOGW("%s: write failed: %s", __func__, strerror(errno));
+            return;
+        }
+        p += written;
+        remaining -= written;
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+status_t TraceFile::readFrom(int fd)
+{
+    std::vector<uint8_t> data;
+    uint8_t buffer[64 * 1024];
+    for (;;) {
+        const ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (n == 0) {
+            break;
+        }
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    return decode(data.data(), data.size());
+}
+
+status_t TraceFile::decode(const uint8_t *data, size_t size)
+{
+    reset();
+    if (size < kHeaderSize || readValue<uint32_t>(data) != kTraceMagic) {
+        return BAD_VALUE;
+    }
+    const uint16_t version = readValue<uint16_t>(data + 4);
+    const uint16_t headerSize = readValue<uint16_t>(data + 6);
+    if (version != kTraceVersion || headerSize < kHeaderSize || headerSize > size) {
+        ALOGW("%s: unsupported trace version %u", __func__, version);
+        return BAD_VALUE;
+    }
+    mCapturedMonotonicNs = readValue<int64_t>(data + 8);
+    mCapturedRealtimeNs = readValue<int64_t>(data + 16);
+
+    size_t offset = headerSize;
+    while (offset < size) {
+        if (size - offset < kRecordHeaderSize) {
+            mTruncated = true;
+            break;
+        }
+        const uint32_t type = readValue<uint32_t>(data + offset);
+        const uint32_t length = readValue<uint32_t>(data + offset + 4);
+        offset += kRecordHeaderSize;
+        if (length > size - offset) {
+            mTruncated = true;
+            break;
+        }
+        const uint8_t *payload = data + offset;
+        offset += length;
+
+        switch (type) {
+        case TRACE_RECORD_THREAD:
+            if (length < sizeof(uint32_t)) {
+                mTruncated = true;
+                break;
+            }
+            mThreads[threadIndex(readValue<uint32_t>(payload))].name.assign(
+                    reinterpret_cast<const char *>(payload) + sizeof(uint32_t),
+                    length - sizeof(uint32_t));
+            break;
+        case TRACE_RECORD_SNAPSHOT: {
+            if (length < kSnapshotHeaderSize) {
+                mTruncated = true;
+                break;
+            }
+            const size_t thread = threadIndex(readValue<uint32_t>(payload));
+            if (__builtin_add_overflow(mThreads[thread].lostBytes,
+                    readValue<uint64_t>(payload + 4), &mThreads[thread].lostBytes)
+                    || !decodeSnapshot(thread, payload + kSnapshotHeaderSize,
+                            length - kSnapshotHeaderSize, readValue<int64_t>(payload + 12))) {
+                ALOGW("%s: values out of range in a snapshot of thread %zu", __func__, thread);
+                reset();
+                return BAD_VALUE;
+            }
+            mThreads[thread].snapshots++;
+        } break;
+        default:
+            ALOGV("%s: skipping record type %u", __func__, type);
+            break;
+        }
+        if (mTruncated) {
+            break;
+        }
+    }
+
+    std::stable_sort(mEvents.begin(), mEvents.end(),
+            [](const TraceEvent &a, const TraceEvent &b) {
+                return a.ts < b.ts || (a.ts == b.ts && a.thread < b.thread);
+            });
+    // so that the time between any two events fits
+    int64_t spanNs;
+    if (!mEvents.empty()
+            && __builtin_sub_overflow(mEvents.back().ts, mEvents.front().ts, &spanNs)) {
+        ALOGW("%s: timeline too long", __func__);
+        reset();
+        return BAD_VALUE;
+    }
+    return OK;
+}
+
+void TraceFile::reset()
+{
+    mThreads.clear();
+    mEvents.clear();
+    mThreadIndex.clear();
+    mThreadEndNs.clear();
+    mTruncated = false;
+}
+
+size_t TraceFile::threadIndex(uint32_t id)
+{
+    auto it = mThreadIndex.find(id);
+    if (it != mThreadIndex.end()) {
+        return it->second;
+    }
+    const size_t index = mThreads.size();
+    mThreads.emplace_back();
+    mThreads.back().name = "thread " + std::to_string(id);
+    mThreadEndNs.push_back(INT64_MIN);
+    mThreadIndex.emplace(id, index);
+    return index;
+}
+
+bool TraceFile::decodeSnapshot(size_t thread, const uint8_t *data, size_t size, int64_t takenNs)
+{
+    TraceThread &traceThread = mThreads[thread];
+
+    // First pass: events on a relative clock advanced by the cycle times,
+    // with the absolute time of the entries that have one.
+    struct Pending {
+        TraceEvent event;
+        int64_t rel;
+        bool anchor;
+    };
+    std::vector<Pending> pending;
+    int64_t rel = 0;
+    bool cycleAnchored = false;     // the next cycle time ends at the last underrun/overrun
+    size_t formatArg = 0;           // position in the current format entry, 0 if none
+    const char *format = nullptr;
+    size_t formatLength = 0;
+
+    size_t offset = 0;
+    while (offset < size) {
+        if (size - offset < kEntryOverhead) {
+            traceThread.badEntries++;
+            break;
+        }
+        const uint8_t type = data[offset + kEntryTypeOffset];
+        const uint8_t length = data[offset + kEntryLengthOffset];
+        if (size - offset - kEntryOverhead < length
+                || data[offset + kEntryDataOffset + length] != length
+                || type == EVENT_RESERVED || type >= EVENT_UPPER_BOUND) {
+            traceThread.badEntries++;
+            break;
+        }
+        const uint8_t *payload = data + offset + kEntryDataOffset;
+        offset += kEntryOverhead + length;
+
+        TraceEvent event = {};
+        event.thread = thread;
+        event.type = static_cast<Event>(type);
+        bool emit = false;
+        bool anchor = false;
+        if (formatArg > 0) {
+            // format arguments: timestamp, hash, then whatever was logged until EVENT_FMT_END
+            if (type == EVENT_FMT_END) {
+                formatArg = 0;
+                continue;
+            }
+            if (formatArg == 1 && type == EVENT_FMT_TIMESTAMP && length == sizeof(int64_t)) {
+                // kept in the event of the start entry
+                pending.back().event.ts = readValue<int64_t>(payload);
+                formatArg++;
+                continue;
+            }
+            if (formatArg == 2 && type == EVENT_FMT_HASH && length == sizeof(log_hash_t)) {
+                const log_hash_t hash = readValue<log_hash_t>(payload);
+                if (traceThread.formats.find(hash) == traceThread.formats.end()) {
+                    traceThread.formats.emplace(hash, std::string(format, formatLength));
+                }
+                pending.back().event.hash = hash;
+                formatArg++;
+                continue;
+            }
+            if (formatArg >= 3 && type >= EVENT_FMT_AUTHOR && type <= EVENT_FMT_TIMESTAMP) {
+                continue;
+            }
+            // not a well formed format entry: drop it and decode this entry on its own
+            if (formatArg < 3) {
+                pending.pop_back();
+            }
+            formatArg = 0;
+        }
+
+        switch (type) {
+        case EVENT_FMT_START:
+            format = reinterpret_cast<const char *>(payload);
+            formatLength = length;
+            formatArg = 1;
+            emit = anchor = true;
+            break;
+        case EVENT_TIMESTAMP:
+            if (length == sizeof(int64_t)) {
+                event.ts = readValue<int64_t>(payload);
+                emit = anchor = true;
+            }
+            break;
+        case EVENT_HISTOGRAM_ENTRY_TS:
+        case EVENT_AUDIO_STATE:
+            if (length >= sizeof(HistTsEntry)) {
+                const HistTsEntry entry = readValue<HistTsEntry>(payload);
+                event.hash = entry.hash;
+                event.ts = entry.ts;
+                emit = anchor = true;
+            }
+            break;
+        case EVENT_UNDERRUN:
+        case EVENT_OVERRUN:
+            if (length == sizeof(int64_t)) {
+                event.ts = readValue<int64_t>(payload);
+                emit = anchor = true;
+                cycleAnchored = true;
+            }
+            break;
+        case EVENT_WORK_TIME:
+            if (length == sizeof(int64_t)) {
+                event.value = readValue<int64_t>(payload);
+                if (cycleAnchored) {
+                    cycleAnchored = false;
+                } else if (__builtin_add_overflow(rel, event.value, &rel)) {
+                    return false;
+                }
+                emit = true;
+            }
+            break;
+        case EVENT_LATENCY:
+        case EVENT_WARMUP_TIME:
+            if (length == sizeof(double)) {
+                event.valueMs = readValue<double>(payload);
+                emit = true;
+            }
+            break;
+        case EVENT_THREAD_INFO:
+            if (length == 2 * sizeof(int32_t)) {
+                const int32_t threadType = readValue<int32_t>(payload + 4);
+                traceThread.info.id = readValue<int32_t>(payload);
+                traceThread.info.type = threadType >= UNKNOWN && threadType <= FASTCAPTURE
+                        ? static_cast<ThreadType>(threadType) : UNKNOWN;
+                emit = true;
+            }
+            break;
+        case EVENT_THREAD_PARAMS:
+            // size_t frameCount, unsigned sampleRate, on a 32 or 64-bit writer
+            if (length == 2 * sizeof(uint32_t)) {
+                traceThread.params.frameCount = readValue<uint32_t>(payload);
+                traceThread.params.sampleRate = readValue<uint32_t>(payload + 4);
+                emit = true;
+            } else if (length == 2 * sizeof(uint64_t)) {
+                traceThread.params.frameCount = readValue<uint64_t>(payload);
+                traceThread.params.sampleRate = readValue<uint32_t>(payload + 8);
+                emit = true;
+            }
+            break;
+        default:
+            break;
+        }
+        if (emit) {
+            pending.push_back({event, rel, anchor});
+        }
+    }
+    if (formatArg > 0 && formatArg < 3) {
+        pending.pop_back();     // format entry cut before its hash
+    }
+
+    // Second pass: anchor the relative clock to the nearest preceding entry with a time,
+    // or to the first one, or else the last entry to when the snapshot was taken.
+    int64_t offsetNs;
+    if (__builtin_sub_overflow(takenNs, rel, &offsetNs)) {
+        return false;
+    }
+    for (const Pending &p : pending) {
+        if (p.anchor) {
+            if (__builtin_sub_overflow(p.event.ts, p.rel, &offsetNs)) {
+                return false;
+            }
+            break;
+        }
+    }
+    int64_t &endNs = mThreadEndNs[thread];
+    const int64_t previousEndNs = endNs;
+    for (Pending &p : pending) {
+        TraceEvent &event = p.event;
+        if (p.anchor) {
+            if (__builtin_sub_overflow(event.ts, p.rel, &offsetNs)) {
+                return false;
+            }
+        } else {
+            if (__builtin_add_overflow(p.rel, offsetNs, &event.ts)) {
+                return false;
+            }
+            event.estimated = true;
+        }
+        if (event.ts <= previousEndNs) {
+            continue;   // already in an earlier snapshot
+        }
+        endNs = std::max(endNs, event.ts);
+        mEvents.push_back(event);
+    }
+    return true;
+}
+
+}   // namespace NBLog
+}   // namespace android
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_MEDIA_NBLOG_TRACE_ANALYSIS_H
+#define ANDROID_MEDIA_NBLOG_TRACE_ANALYSIS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <media/nblog/TraceFile.h>
+
+namespace android {
+namespace NBLog {
+
+// Offline analysis of a TraceFile. Unlike PerformanceAnalysis, which keeps fixed
+// histograms while the threads run, this has all the samples and reports exact percentiles.
+
+struct Percentiles {
+    size_t count = 0;
+    double mean = 0;
+    double min = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+// values are reordered
+Percentiles computePercentiles(std::vector<double> *values);
+
+struct JitterPeak {
+    double frequencyHz;
+    double amplitudeMs;     // of the sinusoid in the cycle times
+};
+
+struct ThreadReport {
+    size_t thread;                  // index in TraceFile::threads()
+    double periodMs = 0;            // frameCount / sampleRate, else the median cycle
+    Percentiles cycleMs;            // time between cycles: EVENT_WORK_TIME, else the
+                                    // EVENT_HISTOGRAM_ENTRY_TS deltas
+    Percentiles latencyMs;          // EVENT_LATENCY
+    Percentiles warmupMs;           // EVENT_WARMUP_TIME
+    size_t underruns = 0;
+    size_t overruns = 0;
+    size_t lateCycles = 0;          // longer than kLateCycleRatio periods
+    std::vector<JitterPeak> jitter; // strongest periodic components, strongest first
+};
+
+// Interval between two successive occurrences of the same log site.
+struct EventReport {
+    size_t thread;
+    log_hash_t hash;
+    Percentiles intervalMs;
+};
+
+// How often the underruns of a thread coincide with trouble in another thread.
+struct UnderrunCorrelation {
+    size_t thread;
+    size_t other;
+    size_t underruns;               // of 'thread'
+    size_t coincident;              // of those, with an underrun, overrun or late cycle
+                                    // of 'other' within the window
+};
+
+struct TraceReport {
+    std::vector<ThreadReport> threads;
+    std::vector<EventReport> events;
+    std::vector<UnderrunCorrelation> correlations;
+    int64_t windowNs = 0;
+};
+
+struct AnalysisOptions {
+    int64_t windowNs = 10000000;    // for the underrun correlation
+    size_t jitterSamples = 4096;    // most recent cycles in the jitter spectrum
+    size_t jitterPeaks = 3;
+};
+
+// A cycle is late when it is longer than this many periods.
+constexpr double kLateCycleRatio = 1.5;
+
+TraceReport analyze(const TraceFile &trace, const AnalysisOptions &options = AnalysisOptions());
+
+// Writes a text report.
+void dumpReport(int fd, const TraceFile &trace, const TraceReport &report);
+
+// Writes the merged timeline as CSV: time in ns, thread, event, value.
+void dumpTimeline(int fd, const TraceFile &trace);
+
+}   // namespace NBLog
+}   // namespace android
+
+#endif  // ANDROID_MEDIA_NBLOG_TRACE_ANALYSIS_H
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_MEDIA_NBLOG_TRACE_FILE_H
+#define ANDROID_MEDIA_NBLOG_TRACE_FILE_H
+
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <media/nblog/Events.h>
+#include <utils/Errors.h>
+
+namespace android {
+namespace NBLog {
+
+// NBLog trace file, used to take the raw log buffers off the device.
+// All integers are little endian.
+//
+//  header      uint32 kTraceMagic ("NBLT")
+//              uint16 kTraceVersion
+//              uint16 size of the header in bytes (readers skip what they don't know)
+//              int64  CLOCK_MONOTONIC at capture, ns
+//              int64  CLOCK_REALTIME at capture, ns
+//  records     uint32 type (TraceRecord), uint32 length of the payload, payload
+//
+//  TRACE_RECORD_THREAD     uint32 thread id, name of the log (not NUL-terminated)
+//  TRACE_RECORD_SNAPSHOT   uint32 thread id, uint64 bytes lost by the reader,
+//                          int64 CLOCK_MONOTONIC when taken,
+//                          then the entries as they are in shared memory
+//
+// Entries are copied verbatim, so the Event values are part of the format (see Events.h).
+// Payloads of the mapped types have the layout of the writer's ABI and are decoded by length.
+// Unknown record types are skipped, so new ones can be added without a version change.
+
+constexpr uint32_t kTraceMagic = 0x544c424e;   // "NBLT"
+constexpr uint16_t kTraceVersion = 1;
+
+enum TraceRecord : uint32_t {
+    TRACE_RECORD_THREAD = 1,
+    TRACE_RECORD_SNAPSHOT = 2,
+};
+
+// Writes a trace to a file descriptor, e.g. the one of "dumpsys media.log --trace".
+class TraceWriter {
+public:
+    // Writes the header; check status() before going on.
+    explicit TraceWriter(int fd);
+
+    // Returns the id to pass to addSnapshot().
+    uint32_t addThread(const std::string &name);
+
+    // data is [begin, end) of a Snapshot: entry-aligned, whole entries only.
+    void addSnapshot(uint32_t thread, const uint8_t *data, size_t size, uint64_t lost,
+            int64_t takenNs);
+
+    // OK, or the error of the first write that failed; later writes are dropped.
+    status_t status() const { return mStatus; }
+
+private:
+    void writeRecord(TraceRecord type, const std::string &header,
+            const uint8_t *data, size_t size);
+
+    const int mFd;
+    status_t mStatus = OK;
+    uint32_t mThreads = 0;
+};
+
+// One decoded log entry. Timestamps are CLOCK_MONOTONIC ns.
+struct TraceEvent {
+    int64_t ts;         // time of the entry, see 'estimated'
+    uint32_t thread;    // index in TraceFile::threads()
+    Event type;         // EVENT_FMT_START stands for the whole format entry
+    bool estimated;     // ts was reconstructed from the cycle times, see TraceFile
+    log_hash_t hash;    // EVENT_FMT_START, EVENT_HISTOGRAM_ENTRY_TS and EVENT_AUDIO_STATE
+    int64_t value;      // EVENT_WORK_TIME: cycle time in ns
+    double valueMs;     // EVENT_LATENCY, EVENT_WARMUP_TIME
+};
+
+struct TraceThread {
+    std::string name;
+    thread_info_t info;             // from the last EVENT_THREAD_INFO
+    thread_params_t params;         // from the last EVENT_THREAD_PARAMS
+    uint64_t lostBytes = 0;         // lost by the reader before the snapshots
+    size_t snapshots = 0;
+    size_t badEntries = 0;          // entries that did not decode; the rest of the snapshot
+                                    // is dropped, as the next entry cannot be found
+    std::map<log_hash_t, std::string> formats;  // format strings seen, by hash
+};
+
+// A trace file decoded into one timeline, merged over all threads.
+//
+// Only the format entries, histogram entries, underruns and overruns carry a timestamp.
+// Between them, e.g. in a fast thread which only logs its cycle times, the time is advanced
+// by the cycle time (EVENT_WORK_TIME, which is the time since the previous cycle), and
+// anchored to the next entry with a timestamp, or to the time the snapshot was taken.
+// Such timestamps are marked as estimated.
+//
+// Snapshots of a thread may overlap, e.g. when periodic captures are concatenated;
+// entries no later than the end of the previous snapshot of the thread are dropped.
+class TraceFile {
+public:
+    // Decodes a whole file. The data is untrusted: every read is bounds checked, every
+    // time computed from it is overflow checked, and enums are range checked.
+    // Returns BAD_VALUE, and keeps nothing, if it is not a trace of a known version or
+    // its times do not fit in 64 bits; otherwise the time between any two events fits.
+    // A damaged record ends the decoding, and what was decoded until then is kept
+    // (see truncated()).
+    status_t decode(const uint8_t *data, size_t size);
+
+    // Reads fd until EOF, then decode().
+    status_t readFrom(int fd);
+
+    const std::vector<TraceThread> &threads() const { return mThreads; }
+    // ordered by ts, then by thread, then in log order
+    const std::vector<TraceEvent> &events() const { return mEvents; }
+    int64_t capturedMonotonicNs() const { return mCapturedMonotonicNs; }
+    int64_t capturedRealtimeNs() const { return mCapturedRealtimeNs; }
+    bool truncated() const { return mTruncated; }
+
+private:
+    size_t threadIndex(uint32_t id);
+    // false if a time overflows
+    bool decodeSnapshot(size_t thread, const uint8_t *data, size_t size, int64_t takenNs);
+    void reset();
+
+    std::vector<TraceThread> mThreads;
+    std::vector<TraceEvent> mEvents;
+    std::map<uint32_t, size_t> mThreadIndex;    // by thread id in the file
+    std::vector<int64_t> mThreadEndNs;          // end of the last snapshot, by index
+    int64_t mCapturedMonotonicNs = 0;
+    int64_t mCapturedRealtimeNs = 0;
+    bool mTruncated = false;
+};
+
+}   // namespace NBLog
+}   // namespace android
+
+#endif  // ANDROID_MEDIA_NBLOG_TRACE_FILE_H
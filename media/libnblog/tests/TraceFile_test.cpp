@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TraceFile_test"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <media/nblog/TraceAnalysis.h>
+#include <media/nblog/TraceFile.h>
+
+using namespace android;
+using namespace android::NBLog;
+
+namespace {
+
+constexpr int64_t kMs = 1000000;
+
+// builds the entries of a log buffer the way Writer lays them out
+class LogBuilder {
+public:
+    void entry(Event event, const void *data, size_t length) {
+        mData.push_back(event);
+        mData.push_back(length);
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        mData.insert(mData.end(), p, p + length);
+        mData.push_back(length);
+    }
+    template <typename T>
+    void entry(Event event, T value) {
+        entry(event, &value, sizeof(value));
+    }
+    void format(const char *fmt, int64_t ts, log_hash_t hash, int arg) {
+        entry(EVENT_FMT_START, fmt, strlen(fmt));
+        entry(EVENT_FMT_TIMESTAMP, ts);
+        entry(EVENT_FMT_HASH, hash);
+        entry(EVENT_FMT_INTEGER, arg);
+        entry(EVENT_FMT_END, nullptr, 0);
+    }
+    const std::vector<uint8_t> &data() const { return mData; }
+    std::vector<uint8_t> &data() { return mData; }
+
+private:
+    std::vector<uint8_t> mData;
+};
+
+struct Thread {
+    std::string name;
+    std::vector<LogBuilder> snapshots;
+};
+
+std::vector<uint8_t> writeTrace(const std::vector<Thread> &threads, int64_t takenNs)
+{
+    FILE *file = tmpfile();
+    EXPECT_NE(nullptr, file);
+    const int fd = fileno(file);
+    TraceWriter writer(fd);
+    for (const Thread &thread : threads) {
+        const uint32_t id = writer.addThread(thread.name);
+        for (const LogBuilder &log : thread.snapshots) {
+            writer.addSnapshot(id, log.data().data(), log.data().size(), 0 /*lost*/, takenNs);
+        }
+    }
+    EXPECT_EQ(OK, writer.status());
+
+    std::vector<uint8_t> data(lseek(fd, 0, SEEK_END));
+    EXPECT_EQ((ssize_t) data.size(), pread(fd, data.data(), data.size(), 0));
+    fclose(file);
+    return data;
+}
+
+// a fast thread of 192 frames at 48 kHz, with one late cycle logged as an underrun
+LogBuilder fastThread(size_t cycles, int64_t underrunNs, size_t underrunCycle)
+{
+    LogBuilder log;
+    thread_params_t params;
+    params.frameCount = 192;
+    params.sampleRate = 48000;
+    log.entry(EVENT_THREAD_PARAMS, params);
+    for (size_t i = 0; i < cycles; i++) {
+        if (i == underrunCycle) {
+            log.entry(EVENT_UNDERRUN, underrunNs);
+            log.entry(EVENT_WORK_TIME, (int64_t) (12 * kMs));
+        } else {
+            log.entry(EVENT_WORK_TIME, (int64_t) (4 * kMs));
+        }
+    }
+    return log;
+}
+
+}   // namespace
+
+TEST(TraceFile, RoundTrip) {
+    const int64_t underrunNs = 1000 * kMs;
+    Thread thread{"FastMixer", {fastThread(100, underrunNs, 50)}};
+    const std::vector<uint8_t> data = writeTrace({thread}, 5000 * kMs);
+
+    TraceFile trace;
+    ASSERT_EQ(OK, trace.decode(data.data(), data.size()));
+    EXPECT_FALSE(trace.truncated());
+    ASSERT_EQ(1u, trace.threads().size());
+    EXPECT_EQ("FastMixer", trace.threads()[0].name);
+    EXPECT_EQ(192u, trace.threads()[0].params.frameCount);
+    EXPECT_EQ(48000u, trace.threads()[0].params.sampleRate);
+    EXPECT_EQ(0u, trace.threads()[0].badEntries);
+
+    // params, 100 cycles and the underrun
+    const std::vector<TraceEvent> &events = trace.events();
+    ASSERT_EQ(102u, events.size());
+    // the cycles are placed relative to the underrun, which ends the late cycle
+    int64_t last = INT64_MIN;
+    for (const TraceEvent &event : events) {
+        EXPECT_GE(event.ts, last);
+        last = event.ts;
+        if (event.type == EVENT_UNDERRUN) {
+            EXPECT_FALSE(event.estimated);
+            EXPECT_EQ(underrunNs, event.ts);
+        }
+    }
+    EXPECT_EQ(underrunNs - 50 * 4 * kMs, events.front().ts);
+    EXPECT_EQ(underrunNs + 49 * 4 * kMs, events.back().ts);
+
+    const TraceReport report = analyze(trace);
+    ASSERT_EQ(1u, report.threads.size());
+    const ThreadReport &r = report.threads[0];
+    EXPECT_DOUBLE_EQ(4., r.periodMs);
+    EXPECT_EQ(100u, r.cycleMs.count);
+    EXPECT_DOUBLE_EQ(4., r.cycleMs.p50);
+    EXPECT_DOUBLE_EQ(12., r.cycleMs.max);
+    EXPECT_EQ(1u, r.underruns);
+    EXPECT_EQ(1u, r.lateCycles);
+}
+
+TEST(TraceFile, NoAnchorUsesSnapshotTime) {
+    const int64_t takenNs = 7000 * kMs;
+    Thread thread{"FastCapture", {fastThread(10, 0, SIZE_MAX)}};
+    const std::vector<uint8_t> data = writeTrace({thread}, takenNs);
+
+    TraceFile trace;
+    ASSERT_EQ(OK, trace.decode(data.data(), data.size()));
+    ASSERT_EQ(11u, trace.events().size());
+    EXPECT_TRUE(trace.events().back().estimated);
+    EXPECT_EQ(takenNs, trace.events().back().ts);
+    EXPECT_EQ(takenNs - 40 * kMs, trace.events().front().ts);
+}
+
+TEST(TraceFile, FormatEntries) {
+    LogBuilder log;
+    for (int i = 0; i < 10; i++) {
+        log.format("count=%d", (100 + 20 * i) * kMs, 0x1234, i);
+    }
+    Thread thread{"AudioOut_D", {log}};
+    const std::vector<uint8_t> data = writeTrace({thread}, 0);
+
+    TraceFile trace;
+    ASSERT_EQ(OK, trace.decode(data.data(), data.size()));
+    ASSERT_EQ(10u, trace.events().size());
+    EXPECT_EQ(EVENT_FMT_START, trace.events()[3].type);
+    EXPECT_EQ(160 * kMs, trace.events()[3].ts);
+    EXPECT_EQ(0x1234u, trace.events()[3].hash);
+    EXPECT_EQ("count=%d", trace.threads()[0].formats.at(0x1234));
+
+    const TraceReport report = analyze(trace);
+    ASSERT_EQ(1u, report.events.size());
+    EXPECT_EQ(9u, report.events[0].intervalMs.count);
+    EXPECT_DOUBLE_EQ(20., report.events[0].intervalMs.p99);
+}
+
+TEST(TraceFile, OverlappingSnapshots) {
+    const int64_t underrunNs = 1000 * kMs;
+    const LogBuilder log = fastThread(20, underrunNs, 10);
+    Thread thread{"FastMixer", {log, log}};
+    const std::vector<uint8_t> data = writeTrace({thread}, 0);
+
+    TraceFile trace;
+    ASSERT_EQ(OK, trace.decode(data.data(), data.size()));
+    EXPECT_EQ(2u, trace.threads()[0].snapshots);
+    EXPECT_EQ(22u, trace.events().size());
+}
+
+TEST(TraceFile, UnderrunCorrelation) {
+    // the mixer underruns at 1 s and 2 s, the capture thread only at 1 s
+    LogBuilder mixer, capture;
+    for (int64_t ts : {1000 * kMs, 2000 * kMs}) {
+        mixer.entry(EVENT_UNDERRUN, ts);
+    }
+    capture.entry(EVENT_UNDERRUN, 1003 * kMs);
+    const std::vector<uint8_t> data = writeTrace(
+            {{"FastMixer", {mixer}}, {"FastCapture", {capture}}}, 0);
+
+    TraceFile trace;
+    ASSERT_EQ(OK, trace.decode(data.data(), data.size()));
+    ASSERT_EQ(3u, trace.events().size());
+    EXPECT_EQ(1u, trace.events()[1].thread);    // merged by time
+
+    const TraceReport report = analyze(trace);
+    ASSERT_EQ(2u, report.correlations.size());
+    for (const UnderrunCorrelation &c : report.correlations) {
+        if (c.thread == 0) {
+            EXPECT_EQ(2u, c.underruns);
+            EXPECT_EQ(1u, c.coincident);
+        } else {
+            EXPECT_EQ(1u, c.underruns);
+            EXPECT_EQ(1u, c.coincident);
+        }
+    }
+}
+
+TEST(TraceFile, JitterSpectrum) {
+    // the cycle time varies by 0.5 ms every 8 cycles: 250 Hz / 8
+    LogBuilder log;
+    for (int i = 0; i < 1024; i++) {
+        log.entry(EVENT_WORK_TIME, (int64_t) ((4 + 0.5 * sin(2 * M_PI * i / 8)) * kMs));
+    }
+    const std::vector<uint8_t> data = writeTrace({{"FastMixer", {log}}}, 0);
+
+    TraceFile trace;
+    ASSERT_EQ(OK, trace.decode(data.data(), data.size()));
+    const TraceReport report = analyze(trace);
+    ASSERT_FALSE(report.threads[0].jitter.empty());
+    EXPECT_NEAR(31.25, report.threads[0].jitter[0].frequencyHz, 0.5);
+    EXPECT_NEAR(0.5, report.threads[0].jitter[0].amplitudeMs, 0.01);
+}
+
+TEST(TraceFile, DamagedInput) {
+    TraceFile trace;
+    const uint8_t garbage[64] = {'N', 'B', 'L', 'X'};
+    EXPECT_EQ(BAD_VALUE, trace.decode(garbage, sizeof(garbage)));
+    EXPECT_EQ(BAD_VALUE, trace.decode(garbage, 3));
+
+    LogBuilder log = fastThread(10, 1000 * kMs, 5);
+    // break the trailing length of the last entry
+    log.data().back() ^= 0xFF;
+    std::vector<uint8_t> data = writeTrace({{"FastMixer", {log}}}, 0);
+    ASSERT_EQ(OK, trace.decode(data.data(), data.size()));
+    EXPECT_EQ(1u, trace.threads()[0].badEntries);
+    EXPECT_EQ(11u, trace.events().size());
+
+    // every prefix decodes, or is rejected, without reading out of bounds
+    for (size_t size = 0; size < data.size(); size++) {
+        std::vector<uint8_t> prefix(data.begin(), data.begin() + size);
+        if (trace.decode(prefix.data(), prefix.size()) == OK && size > 24) {
+            EXPECT_TRUE(trace.truncated() || trace.threads().size() == 1);
+        }
+    }
+}
+
+TEST(TraceFile, OutOfRangeValues) {
+    TraceFile trace;
+
+    // cycle times adding up past INT64_MAX
+    LogBuilder log;
+    log.entry(EVENT_WORK_TIME, INT64_MAX);
+    log.entry(EVENT_WORK_TIME, INT64_MAX);
+    std::vector<uint8_t> data = writeTrace({{"FastMixer", {log}}}, 0);
+    EXPECT_EQ(BAD_VALUE, trace.decode(data.data(), data.size()));
+    EXPECT_TRUE(trace.threads().empty());
+    EXPECT_TRUE(trace.events().empty());
+
+    // a cycle time before an anchor at the far end of the clock
+    log = LogBuilder();
+    log.entry(EVENT_WORK_TIME, (int64_t) (4 * kMs));
+    log.entry(EVENT_UNDERRUN, INT64_MIN);
+    data = writeTrace({{"FastMixer", {log}}}, 0);
+    EXPECT_EQ(BAD_VALUE, trace.decode(data.data(), data.size()));
+
+    // threads at both ends of the clock
+    LogBuilder early, late;
+    early.entry(EVENT_UNDERRUN, INT64_MIN + 1);
+    late.entry(EVENT_UNDERRUN, INT64_MAX);
+    data = writeTrace({{"FastMixer", {early}}, {"FastCapture", {late}}}, 0);
+    EXPECT_EQ(BAD_VALUE, trace.decode(data.data(), data.size()));
+
+    // an unknown thread type
+    log = LogBuilder();
+    const int32_t info[2] = {13, 1000};
+    log.entry(EVENT_THREAD_INFO, info, sizeof(info));
+    data = writeTrace({{"FastMixer", {log}}}, 0);
+    ASSERT_EQ(OK, trace.decode(data.data(), data.size()));
+    EXPECT_EQ(13, trace.threads()[0].info.id);
+    EXPECT_EQ(UNKNOWN, trace.threads()[0].info.type);
+}
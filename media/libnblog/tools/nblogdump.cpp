@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Decodes an NBLog trace taken with
+//     adb exec-out dumpsys media.log --trace > trace.nblog
+// and reports the cycle, latency and log site statistics of each thread.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/nblog/TraceAnalysis.h>
+#include <media/nblog/TraceFile.h>
+
+using namespace android;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-t] [-w <window ms>] [-n <samples>] <trace file>\n", me);
+    fprintf(stderr, "       -h help\n");
+    fprintf(stderr, "       -t print the merged timeline as CSV instead of the report\n");
+    fprintf(stderr, "       -w window of the underrun correlation in ms (default 10)\n");
+    fprintf(stderr, "       -n cycles in the jitter spectrum (default 4096)\n");
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+    bool timeline = false;
+    NBLog::AnalysisOptions options;
+
+    int res;
+    while ((res = getopt(argc, argv, "htw:n:")) >= 0) {
+        switch (res) {
+            case 't':
+                timeline = true;
+                break;
+            case 'w':
+                options.windowNs = (int64_t) (atof(optarg) * 1e6);
+                break;
+            case 'n':
+                options.jitterSamples = strtoul(optarg, nullptr, 10);
+                break;
+            case 'h':
+            default:
+                usage(me);
+                return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(me);
+        return 1;
+    }
+
+    const char *path = argv[optind];
+    const int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    NBLog::TraceFile trace;
+    const status_t status = trace.readFrom(fd);
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    if (status != OK) {
+        fprintf(stderr, "%s is not an NBLog trace (%d)\n", path, status);
+        return 1;
+    }
+
+    if (timeline) {
+        NBLog::dumpTimeline(STDOUT_FILENO, trace);
+    } else {
+        NBLog::dumpReport(STDOUT_FILENO, trace, NBLog::analyze(trace, options));
+    }
+    return 0;
+}
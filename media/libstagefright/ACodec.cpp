@@ -6172,6 +6172,7 @@ void ACodec::BaseState::onInputBufferFilled(const sp<AMessage> &msg) {
                 }
                 info->checkReadFence("onInputBufferFilled");
 
+                const nsecs_t submittedNs = systemTime(SYSTEM_TIME_MONOTONIC);
                 status_t err2 = OK;
                 switch (mCodec->mPortMode[kPortIndexInput]) {
                 case IOMX::kPortModePresetByteBuffer:
@@ -6220,6 +6221,11 @@ void ACodec::BaseState::onInputBufferFilled(const sp<AMessage> &msg) {
                 // Hold the reference while component is using the buffer.
                 info->mData = buffer;
 
+                const sp<FrameTrace> &frameTrace = mCodec->mBufferChannel->getFrameTrace();
+                if (frameTrace != NULL) {
+                    frameTrace->record(FrameTrace::SUBMITTED, timeUs, submittedNs);
+                }
+
                 if (!eos && err == OK) {
                     getMoreInputDataIfPossible();
                 } else {
@@ -6434,6 +6440,10 @@ bool ACodec::BaseState::onOMXFillBufferDone(
 
             info->mData.clear();
 
+            const sp<FrameTrace> &frameTrace = mCodec->mBufferChannel->getFrameTrace();
+            if (frameTrace != NULL) {
+                frameTrace->record(FrameTrace::DONE, timeUs);
+            }
             mCodec->mBufferChannel->drainThisBuffer(info->mBufferID, flags);
 
             info->mStatus = BufferInfo::OWNED_BY_DOWNSTREAM;
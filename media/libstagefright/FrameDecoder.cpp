@@ -22,6 +22,7 @@
 #include <binder/MemoryHeapBase.h>
 #include <gui/Surface.h>
 #include <inttypes.h>
+#include <algorithm>
 #include <media/ICrypto.h>
 #include <media/IMediaSource.h>
 #include <media/MediaCodecBuffer.h>
@@ -37,6 +38,9 @@
 #include <private/media/VideoFrame.h>
 #include <utils/Log.h>
 
+#include "libyuv/convert.h"
+#include "libyuv/scale.h"
+
 namespace android {
 
 static const int64_t kBufferTimeOutUs = 10000LL; // 10 msec
@@ -411,7 +415,11 @@ VideoFrameDecoder::VideoFrameDecoder(
       mSeekMode(MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC),
       mTargetTimeUs(-1LL),
       mNumFrames(0),
-      mNumFramesDecoded(0) {
+      mNumFramesDecoded(0),
+      mMaxWidth(0),
+      mMaxHeight(0),
+      mInputEos(false),
+      mSamplesQueued(0) {
 }
 
 sp<AMessage> VideoFrameDecoder::onGetFormatAndSeekOptions(
@@ -506,6 +514,190 @@ status_t VideoFrameDecoder::onOutputReceived(
 
     *done = (++mNumFramesDecoded >= mNumFrames);
 
+    sp<IMemory> frameMem;
+    status_t err = convertFrame(videoFrameBuffer, outputFormat, &frameMem);
+    if (frameMem != NULL) {
+        addFrame(frameMem);
+    }
+    return err;
+}
+
+status_t VideoFrameDecoder::extractFramesAtTimes(
+        const std::vector<int64_t> &timesUs, int32_t maxWidth, int32_t maxHeight,
+        const FrameCallback &onFrame) {
+    if (mSeekMode == MediaSource::ReadOptions::SEEK_FRAME_INDEX) {
+        return ERROR_UNSUPPORTED;
+    }
+    const bool syncOnly = (mSeekMode != MediaSource::ReadOptions::SEEK_CLOSEST);
+    mMaxWidth = maxWidth;
+    mMaxHeight = maxHeight;
+
+    sp<IMemory> frame;
+    int64_t frameTimeUs = -1LL;     // of |frame|
+    int64_t syncTimeUs = -1LL;      // of the sync sample |frame| was decoded from
+    for (size_t i = 0; i < timesUs.size(); ++i) {
+        if (!syncOnly && frame != NULL && timesUs[i] <= frameTimeUs) {
+            // the closest frame is still the last one
+            onFrame(i, frame);
+            continue;
+        }
+
+        MediaSource::ReadOptions options;
+        options.setSeekTo(timesUs[i], mSeekMode);
+        MediaBufferBase *sample = NULL;
+        status_t err = source()->read(&sample, &options);
+        if (err != OK) {
+            ALOGW("failed to seek to %" PRId64 " us: %d (%s)", timesUs[i], err, asString(err));
+            return err;
+        }
+        int64_t sampleTimeUs;
+        CHECK(sample->meta_data().findInt64(kKeyTime, &sampleTimeUs));
+        int64_t targetTimeUs = sampleTimeUs;
+        if (!syncOnly && !sample->meta_data().findInt64(kKeyTargetTime, &targetTimeUs)) {
+            targetTimeUs = timesUs[i];
+        }
+
+        if (frame != NULL && sampleTimeUs == syncTimeUs && syncOnly) {
+            ALOGV("%" PRId64 " us: same sync frame as before", timesUs[i]);
+            sample->release();
+            onFrame(i, frame);
+            continue;
+        } else if (frame != NULL && sampleTimeUs == syncTimeUs && !mInputEos) {
+            // Still in the group of pictures the decoder is in: skip the samples it has.
+            ALOGV("%" PRId64 " us: decoding on from %" PRId64 " us", timesUs[i], frameTimeUs);
+            sample->release();
+            sample = NULL;
+            for (size_t n = 1; n < mSamplesQueued; ++n) {
+                if (source()->read(&sample) != OK) {
+                    break;  // decodeFrame() will find the end of the stream again
+                }
+                sample->release();
+                sample = NULL;
+            }
+        } else {
+            if (mSamplesQueued > 0) {
+                err = decoder()->flush();
+                if (err != OK) {
+                    ALOGW("flush returned error %d (%s)", err, asString(err));
+                    sample->release();
+                    return err;
+                }
+            }
+            mInputEos = false;
+            mSamplesQueued = 0;
+            syncTimeUs = sampleTimeUs;
+        }
+
+        err = decodeFrame(sample, syncOnly, targetTimeUs, &frame, &frameTimeUs);
+        if (err != OK) {
+            return err;
+        }
+        onFrame(i, frame);
+    }
+    return OK;
+}
+
+status_t VideoFrameDecoder::decodeFrame(
+        MediaBufferBase *sample, bool syncOnly, int64_t targetTimeUs,
+        sp<IMemory> *frame, int64_t *frameTimeUs) {
+    sp<MediaCodec> codec = decoder();
+    status_t err = OK;
+    size_t retriesLeft = kRetryCount;
+    for (;;) {
+        // Queue as many inputs as we can, then wait for an output. With syncOnly, the
+        // sync sample is followed by the end of stream, so that it is output right away.
+        size_t index;
+        while (!mInputEos && codec->dequeueInputBuffer(&index, 0) == OK) {
+            if (sample == NULL && !(syncOnly && mSamplesQueued > 0)) {
+                err = source()->read(&sample);
+                if (err != OK && err != ERROR_END_OF_STREAM) {
+                    ALOGW("Input Error: err=%d", err);
+                    return err;
+                }
+            }
+            if (sample == NULL) {
+                err = codec->queueInputBuffer(index, 0, 0, 0, MediaCodec::BUFFER_FLAG_EOS);
+                mInputEos = true;
+            } else {
+                err = queueSample(index, sample);
+                sample->release();
+                sample = NULL;
+                ++mSamplesQueued;
+            }
+            if (err != OK) {
+                return err;
+            }
+        }
+
+        size_t offset, size;
+        int64_t ptsUs;
+        uint32_t flags;
+        err = codec->dequeueOutputBuffer(
+                &index, &offset, &size, &ptsUs, &flags, kBufferTimeOutUs);
+        if (err == INFO_FORMAT_CHANGED || err == INFO_OUTPUT_BUFFERS_CHANGED) {
+            continue;
+        } else if (err == -EAGAIN /* INFO_TRY_AGAIN_LATER */ && --retriesLeft > 0) {
+            continue;
+        } else if (err != OK) {
+            ALOGW("Received error %d (%s) instead of output", err, asString(err));
+            break;
+        }
+        retriesLeft = kRetryCount;
+
+        if (size > 0 && ptsUs >= targetTimeUs) {
+            ALOGV("Received the frame at %" PRId64 " us for %" PRId64 " us", ptsUs, targetTimeUs);
+            sp<MediaCodecBuffer> videoFrameBuffer;
+            sp<AMessage> outputFormat;
+            err = codec->getOutputBuffer(index, &videoFrameBuffer);
+            if (err == OK) {
+                err = codec->getOutputFormat(&outputFormat);
+            }
+            if (err == OK) {
+                err = convertFrame(videoFrameBuffer, outputFormat, frame);
+            }
+            codec->releaseOutputBuffer(index);
+            *frameTimeUs = ptsUs;
+            break;
+        }
+        codec->releaseOutputBuffer(index);
+        if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+            ALOGW("no frame at or after %" PRId64 " us", targetTimeUs);
+            err = ERROR_END_OF_STREAM;
+            break;
+        }
+    }
+    if (sample != NULL) {
+        sample->release();
+    }
+    return err;
+}
+
+status_t VideoFrameDecoder::queueSample(size_t index, MediaBufferBase *sample) {
+    sp<MediaCodecBuffer> codecBuffer;
+    status_t err = decoder()->getInputBuffer(index, &codecBuffer);
+    if (err != OK) {
+        ALOGE("failed to get input buffer %zu", index);
+        return err;
+    }
+    if (sample->range_length() > codecBuffer->capacity()) {
+        ALOGE("buffer size (%zu) too large for codec input size (%zu)",
+                sample->range_length(), codecBuffer->capacity());
+        return BAD_VALUE;
+    }
+    int64_t ptsUs;
+    CHECK(sample->meta_data().findInt64(kKeyTime, &ptsUs));
+    codecBuffer->setRange(0, sample->range_length());
+    memcpy(codecBuffer->data(),
+            (const uint8_t*)sample->data() + sample->range_offset(),
+            sample->range_length());
+    ALOGV("QueueInput: size=%zu ts=%" PRId64 " us", codecBuffer->size(), ptsUs);
+    return decoder()->queueInputBuffer(index, 0, codecBuffer->size(), ptsUs, 0 /* flags */);
+}
+
+status_t VideoFrameDecoder::convertFrame(
+        const sp<MediaCodecBuffer> &videoFrameBuffer,
+        const sp<AMessage> &outputFormat,
+        sp<IMemory> *frameMem) {
     if (outputFormat == NULL) {
         return ERROR_MALFORMED;
     }
@@ -528,18 +720,36 @@ status_t VideoFrameDecoder::onOutputReceived(
         crop_bottom = height - 1;
     }
 
-    sp<IMemory> frameMem = allocVideoFrame(
-            trackMeta(),
-            (crop_right - crop_left + 1),
-            (crop_bottom - crop_top + 1),
-            0,
-            0,
-            dstBpp());
-    addFrame(frameMem);
-    VideoFrame* frame = static_cast<VideoFrame*>(frameMem->pointer());
-
     int cropWidth = crop_right - crop_left + 1;
     int cropHeight = crop_bottom - crop_top + 1;
+
+    // Scale 8-bit YUV down before color conversion, which then has fewer pixels to do.
+    int32_t frameWidth = cropWidth;
+    int32_t frameHeight = cropHeight;
+    if ((srcFormat == OMX_COLOR_FormatYUV420Planar
+            || srcFormat == OMX_COLOR_FormatYUV420SemiPlanar)
+            && ((mMaxWidth > 0 && mMaxWidth < cropWidth)
+                    || (mMaxHeight > 0 && mMaxHeight < cropHeight))) {
+        const int64_t maxWidth = mMaxWidth > 0 ? mMaxWidth : cropWidth;
+        const int64_t maxHeight = mMaxHeight > 0 ? mMaxHeight : cropHeight;
+        if (cropWidth * maxHeight > cropHeight * maxWidth) {
+            frameWidth = maxWidth;
+            frameHeight = cropHeight * maxWidth / cropWidth;
+        } else {
+            frameWidth = cropWidth * maxHeight / cropHeight;
+            frameHeight = maxHeight;
+        }
+        // even, for the chroma planes
+        frameWidth = std::max(frameWidth & ~1, 2);
+        frameHeight = std::max(frameHeight & ~1, 2);
+    }
+
+    *frameMem = allocVideoFrame(trackMeta(), frameWidth, frameHeight, 0, 0, dstBpp());
+    if (*frameMem == NULL) {
+        return NO_MEMORY;
+    }
+    VideoFrame* frame = static_cast<VideoFrame*>((*frameMem)->pointer());
+
     uint8_t *dst = frame->getFlattenedData();
     uint8_t *src = videoFrameBuffer->data();
 
@@ -554,6 +764,26 @@ status_t VideoFrameDecoder::onOutputReceived(
         return OK;
     }
 
+    if (frameWidth != cropWidth || frameHeight != cropHeight) {
+        if (!scaleYUV420(srcFormat, src, stride, slice_height,
+                crop_left, crop_top, cropWidth, cropHeight, frameWidth, frameHeight)) {
+            ALOGE("Unable to scale %dx%d to %dx%d",
+                    cropWidth, cropHeight, frameWidth, frameHeight);
+            return ERROR_UNSUPPORTED;
+        }
+        frame->mDisplayWidth = (int64_t)frame->mDisplayWidth * frameWidth / cropWidth;
+        frame->mDisplayHeight = (int64_t)frame->mDisplayHeight * frameHeight / cropHeight;
+
+        // convert the scaled frame instead, as planar
+        src = mScaled.data();
+        srcFormat = OMX_COLOR_FormatYUV420Planar;
+        width = stride = frameWidth;
+        slice_height = frameHeight;
+        crop_left = crop_top = 0;
+        crop_right = frameWidth - 1;
+        crop_bottom = frameHeight - 1;
+    }
+
     ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, dstFormat());
 
     uint32_t standard, range, transfer;
@@ -570,7 +800,7 @@ status_t VideoFrameDecoder::onOutputReceived(
 
     if (converter.isValid()) {
         converter.convert(
-                (const uint8_t *)videoFrameBuffer->data(),
+                src,
                 width, slice_height, stride,
                 crop_left, crop_top, crop_right, crop_bottom,
                 frame->getFlattenedData(),
@@ -584,6 +814,51 @@ status_t VideoFrameDecoder::onOutputReceived(
     return ERROR_UNSUPPORTED;
 }
 
+bool VideoFrameDecoder::scaleYUV420(
+        int32_t srcFormat, const uint8_t *src, int32_t stride, int32_t sliceHeight,
+        int32_t cropLeft, int32_t cropTop, int32_t cropWidth, int32_t cropHeight,
+        int32_t dstWidth, int32_t dstHeight) {
+    // into planar YUV, with no padding
+    const size_t dstSize = dstWidth * dstHeight * 3 / 2;
+    const int32_t halfWidth = (cropWidth + 1) / 2;
+    const int32_t halfHeight = (cropHeight + 1) / 2;
+    const size_t planarSize = (srcFormat == OMX_COLOR_FormatYUV420SemiPlanar)
+            ? cropWidth * cropHeight + 2 * halfWidth * halfHeight : 0;
+    mScaled.resize(dstSize + planarSize);
+    uint8_t *dstY = mScaled.data();
+    uint8_t *dstU = dstY + dstWidth * dstHeight;
+    uint8_t *dstV = dstU + (dstWidth / 2) * (dstHeight / 2);
+
+    const uint8_t *srcY = src + cropTop * stride + cropLeft;
+    const uint8_t *srcU, *srcV;
+    int32_t strideY = stride, strideUV;
+    if (srcFormat == OMX_COLOR_FormatYUV420Planar) {
+        srcU = src + stride * sliceHeight + (cropTop / 2) * (stride / 2) + cropLeft / 2;
+        srcV = srcU + (stride / 2) * (sliceHeight / 2);
+        strideUV = stride / 2;
+    } else {
+        // separate the chroma planes first, as there is no scaler for semi-planar
+        uint8_t *planarY = mScaled.data() + dstSize;
+        uint8_t *planarU = planarY + cropWidth * cropHeight;
+        uint8_t *planarV = planarU + halfWidth * halfHeight;
+        const uint8_t *srcUV = src + stride * sliceHeight + (cropTop / 2) * stride + cropLeft;
+        if (libyuv::NV12ToI420(srcY, stride, srcUV, stride,
+                planarY, cropWidth, planarU, halfWidth, planarV, halfWidth,
+                cropWidth, cropHeight) != 0) {
+            return false;
+        }
+        srcY = planarY;
+        srcU = planarU;
+        srcV = planarV;
+        strideY = cropWidth;
+        strideUV = halfWidth;
+    }
+    return libyuv::I420Scale(
+            srcY, strideY, srcU, strideUV, srcV, strideUV, cropWidth, cropHeight,
+            dstY, dstWidth, dstU, dstWidth / 2, dstV, dstWidth / 2, dstWidth, dstHeight,
+            libyuv::kFilterBox) == 0;
+}
+
 ////////////////////////////////////////////////////////////////////////
 
 ImageDecoder::ImageDecoder(
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameTrace"
+#include <utils/Log.h>
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <map>
+
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/FrameTrace.h>
+
+namespace android {
+
+std::vector<FrameTrace::TraceEvent> FrameTrace::snapshot() const {
+    std::vector<TraceEvent> events;
+    const uint64_t last = mNext.load(std::memory_order_acquire);
+    const uint64_t first = last >= kCapacity ? last - kCapacity + 1 : 1;
+    events.reserve(last + 1 - first);
+    for (uint64_t seq = first; seq <= last; ++seq) {
+        const Event &event = mEvents[seq & (kCapacity - 1)];
+        if (event.seq.load(std::memory_order_acquire) != seq) {
+            continue;   // being written, or already written over
+        }
+        const uint64_t stageFrame = event.stageFrame.load(std::memory_order_relaxed);
+        TraceEvent copy;
+        copy.stage = (Stage)(stageFrame >> 32);
+        copy.frame = (uint32_t)stageFrame;
+        copy.timeUs = event.timeUs.load(std::memory_order_relaxed);
+        copy.nowNs = event.nowNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (event.seq.load(std::memory_order_relaxed) != seq || copy.stage >= STAGE_COUNT) {
+            continue;
+        }
+        events.push_back(copy);
+    }
+    return events;
+}
+
+std::vector<FrameTrace::Frame> FrameTrace::frames() const {
+    std::vector<Frame> frames;
+    std::map<int64_t, size_t> byTime;   // latest frame of each presentation time
+    for (const TraceEvent &event : snapshot()) {
+        auto it = byTime.find(event.timeUs);
+        // a stage reached again is the same time queued again, e.g. after a seek
+        if (it == byTime.end() || frames[it->second].stageNs[event.stage] >= 0) {
+            Frame frame;
+            frame.timeUs = event.timeUs;
+            frame.frame = event.frame;
+            std::fill(frame.stageNs, frame.stageNs + STAGE_COUNT, -1);
+            frames.push_back(frame);
+            it = byTime.insert_or_assign(event.timeUs, frames.size() - 1).first;
+        }
+        Frame &frame = frames[it->second];
+        frame.stageNs[event.stage] = event.nowNs;
+        if (event.stage == QUEUED) {
+            frame.frame = event.frame;
+        }
+    }
+    return frames;
+}
+
+int64_t FrameTrace::Frame::intervalUs(Interval interval) const {
+    Stage from, to;
+    switch (interval) {
+        case LOOPER: from = QUEUED;     to = SUBMITTED; break;
+        case CODEC:  from = SUBMITTED;  to = DONE;      break;
+        case OUTPUT: from = DONE;       to = DEQUEUED;  break;
+        case CLIENT:
+            from = DEQUEUED;
+            to = stageNs[RENDERED] >= 0 ? RENDERED : DROPPED;
+            break;
+        case TOTAL:  from = QUEUED;     to = DEQUEUED;  break;
+        default:
+            return -1;
+    }
+    if (stageNs[from] < 0 || stageNs[to] < stageNs[from]) {
+        return -1;
+    }
+    return (stageNs[to] - stageNs[from]) / 1000;
+}
+
+void FrameTrace::summarize(Percentiles percentiles[INTERVAL_COUNT]) const {
+    const std::vector<Frame> allFrames = frames();
+    std::vector<int64_t> samples;
+    samples.reserve(allFrames.size());
+    for (uint32_t i = 0; i < INTERVAL_COUNT; ++i) {
+        samples.clear();
+        for (const Frame &frame : allFrames) {
+            const int64_t us = frame.intervalUs((Interval)i);
+            if (us >= 0) {
+                samples.push_back(us);
+            }
+        }
+        Percentiles &p = percentiles[i];
+        p.count = samples.size();
+        if (samples.empty()) {
+            p.p50Us = p.p90Us = p.p99Us = p.maxUs = -1;
+            continue;
+        }
+        std::sort(samples.begin(), samples.end());
+        // nearest rank
+        auto rank = [&samples](size_t percent) {
+            const size_t n = samples.size();
+            return samples[std::min(n - 1, (percent * n + 99) / 100 - 1)];
+        };
+        p.p50Us = rank(50);
+        p.p90Us = rank(90);
+        p.p99Us = rank(99);
+        p.maxUs = samples.back();
+    }
+}
+
+// static
+const char *FrameTrace::intervalName(Interval interval) {
+    switch (interval) {
+        case LOOPER: return "looper";
+        case CODEC:  return "codec";
+        case OUTPUT: return "output";
+        case CLIENT: return "client";
+        case TOTAL:  return "total";
+        default:     return "unknown";
+    }
+}
+
+void FrameTrace::dump(AString *out, const char *prefix) const {
+    Percentiles percentiles[INTERVAL_COUNT];
+    summarize(percentiles);
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%sframe latency (us):\n", prefix);
+    out->append(buf);
+    snprintf(buf, sizeof(buf), "%s  %-8s %6s %8s %8s %8s %8s\n",
+            prefix, "interval", "n", "p50", "p90", "p99", "max");
+    out->append(buf);
+    for (uint32_t i = 0; i < INTERVAL_COUNT; ++i) {
+        const Percentiles &p = percentiles[i];
+        snprintf(buf, sizeof(buf), "%s  %-8s %6zu %8" PRId64 " %8" PRId64 " %8" PRId64
+                " %8" PRId64 "\n",
+                prefix, intervalName((Interval)i), p.count, p.p50Us, p.p90Us, p.p99Us, p.maxUs);
+        out->append(buf);
+    }
+}
+
+void FrameTrace::dumpFrames(AString *out, const char *prefix) const {
+    std::vector<Frame> allFrames = frames();
+    // in presentation order, which does not depend on the timing of the run
+    std::stable_sort(allFrames.begin(), allFrames.end(),
+            [](const Frame &a, const Frame &b) { return a.timeUs < b.timeUs; });
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%stimeUs,frame", prefix);
+    out->append(buf);
+    for (uint32_t i = 0; i < INTERVAL_COUNT; ++i) {
+        out->append(",");
+        out->append(intervalName((Interval)i));
+    }
+    out->append("\n");
+    for (const Frame &frame : allFrames) {
+        snprintf(buf, sizeof(buf), "%s%" PRId64 ",%u", prefix, frame.timeUs, frame.frame);
+        out->append(buf);
+        for (uint32_t i = 0; i < INTERVAL_COUNT; ++i) {
+            snprintf(buf, sizeof(buf), ",%" PRId64, frame.intervalUs((Interval)i));
+            out->append(buf);
+        }
+        out->append("\n");
+    }
+}
+
+}  // namespace android
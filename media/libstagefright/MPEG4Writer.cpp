@@ -26,6 +26,7 @@
 #include <sys/prctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <utils/Log.h>
@@ -494,6 +495,14 @@ void MPEG4Writer::initInternal(int fd, bool isFirstSession) {
     mPaused = false;
     mStarted = false;
     mWriterThreadStarted = false;
+    mWriteBehindThreadStarted = false;
+    mWriteBehindSize = 0;
+    mStagingBuffers[0] = NULL;
+    mStagingBuffers[1] = NULL;
+    mWriteStatsStartUs = -1;
+    mNumSampleWrites = 0;
+    mMaxWriteStallUs = 0;
+    mWriteError = OK;
     mSendNotify = false;
 
     // Reset following variables for all the sessions and they will be
@@ -551,6 +560,13 @@ status_t MPEG4Writer::dump(
     result.append(buffer);
     snprintf(buffer, SIZE, "     mStarted: %s\n", mStarted? "true": "false");
     result.append(buffer);
+    if (mWriteStatsStartUs >= 0) {
+        int64_t elapsedUs = ALooper::GetNowUs() - mWriteStatsStartUs;
+        snprintf(buffer, SIZE, "     sample writes: %.1f/s, longest stall: %" PRId64 " us%s\n",
+                elapsedUs > 0 ? mNumSampleWrites.load() * 1E6 / elapsedUs : 0.0,
+                mMaxWriteStallUs.load(), mWriteBehindSize > 0 ? " (write-behind)" : "");
+        result.append(buffer);
+    }
     ::write(fd, result.string(), result.size());
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
@@ -861,6 +877,15 @@ status_t MPEG4Writer::start(MetaData *param) {
         return OK;
     }
 
+    // Staging buffers of this size, twice, if asked for.
+    int32_t writeBehindSize;
+    if (param && param->findInt32(kKeyWriteBehindSize, &writeBehindSize)
+            && writeBehindSize > 0) {
+        mWriteBehindSize = writeBehindSize;
+    } else {
+        mWriteBehindSize = 0;
+    }
+
     if (!param ||
         !param->findInt32(kKeyTimeScale, &mTimeScale)) {
         mTimeScale = 1000;
@@ -995,6 +1020,8 @@ void MPEG4Writer::stopWriterThread() {
     pthread_join(mThread, &dummy);
     mWriterThreadStarted = false;
     ALOGD("Writer thread stopped");
+
+    stopWriteBehindThread();
 }
 
 /*
@@ -1091,11 +1118,13 @@ status_t MPEG4Writer::reset(bool stopSource) {
     } else {
         if (!mWriterThreadStarted ||
             !mStarted) {
+            status_t err = OK;
             if (mWriterThreadStarted) {
                 stopWriterThread();
+                err = mWriteError;
             }
             release();
-            return OK;
+            return err;
         }
     }
 
@@ -1130,6 +1159,9 @@ status_t MPEG4Writer::reset(bool stopSource) {
     }
 
     stopWriterThread();
+    if (err == OK) {
+        err = mWriteError;
+    }
 
     // Do not write out movie header on error.
     if (err != OK) {
@@ -1390,11 +1422,11 @@ off64_t MPEG4Writer::addSample_l(
     } else {
         if (tiffHdrOffset > 0) {
             tiffHdrOffset = htonl(tiffHdrOffset);
-            ::write(mFd, &tiffHdrOffset, 4); // exif_tiff_header_offset field
+            queuePrefix_l(&tiffHdrOffset, 4); // exif_tiff_header_offset field
             mOffset += 4;
         }
 
-        ::write(mFd,
+        queueWrite_l(
               (const uint8_t *)buffer->data() + buffer->range_offset(),
               buffer->range_length());
 
@@ -1447,16 +1479,14 @@ void MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
     size_t length = buffer->range_length();
 
     if (mUse4ByteNalLength) {
-        uint8_t x = length >> 24;
-        ::write(mFd, &x, 1);
-        x = (length >> 16) & 0xff;
-        ::write(mFd, &x, 1);
-        x = (length >> 8) & 0xff;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-
-        ::write(mFd,
+        uint8_t x[4];
+        x[0] = length >> 24;
+        x[1] = (length >> 16) & 0xff;
+        x[2] = (length >> 8) & 0xff;
+        x[3] = length & 0xff;
+        queuePrefix_l(x, 4);
+
+        queueWrite_l(
               (const uint8_t *)buffer->data() + buffer->range_offset(),
               length);
 
@@ -1464,15 +1494,147 @@ void MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
     } else {
         CHECK_LT(length, 65536u);
 
-        uint8_t x = length >> 8;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-        ::write(mFd, (const uint8_t *)buffer->data() + buffer->range_offset(), length);
+        uint8_t x[2];
+        x[0] = length >> 8;
+        x[1] = length & 0xff;
+        queuePrefix_l(x, 2);
+        queueWrite_l((const uint8_t *)buffer->data() + buffer->range_offset(), length);
         mOffset += length + 2;
     }
 }
 
+void MPEG4Writer::queueWrite_l(const void *data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (mWriteIovecs.size() == kMaxWriteIovecs) {
+        flushWrites_l();
+    }
+
+    struct iovec iov;
+    iov.iov_base = const_cast<void *>(data);
+    iov.iov_len = size;
+    mWriteIovecs.push_back(iov);
+    mWriteSize += size;
+}
+
+void MPEG4Writer::queuePrefix_l(const void *data, size_t size) {
+    if (mWritePrefixesSize + size > kMaxWritePrefixSize
+            || mWriteIovecs.size() == kMaxWriteIovecs) {
+        flushWrites_l();
+    }
+
+    uint8_t *prefix = mWritePrefixes + mWritePrefixesSize;
+    memcpy(prefix, data, size);
+    mWritePrefixesSize += size;
+    queueWrite_l(prefix, size);
+}
+
+// Writes out the queued sample data, which must stay valid until then.
+void MPEG4Writer::flushWrites_l() {
+    if (mWriteIovecs.empty()) {
+        return;
+    }
+
+    int64_t startUs = ALooper::GetNowUs();
+    if (mWriteBehindSize > 0) {
+        stageWrites_l();
+    } else {
+        setWriteError(writeFully(mWriteIovecs.editArray(), mWriteIovecs.size(), mWriteOffset));
+    }
+    int64_t stallUs = ALooper::GetNowUs() - startUs;
+    if (stallUs > mMaxWriteStallUs) {
+        mMaxWriteStallUs = stallUs;
+    }
+
+    mWriteOffset += mWriteSize;
+    mWriteSize = 0;
+    mWriteIovecs.clear();
+    mWritePrefixesSize = 0;
+}
+
+void MPEG4Writer::stageWrites_l() {
+    off64_t offset = mWriteOffset;
+    for (size_t i = 0; i < mWriteIovecs.size(); ++i) {
+        const uint8_t *data = (const uint8_t *)mWriteIovecs[i].iov_base;
+        size_t size = mWriteIovecs[i].iov_len;
+        while (size > 0) {
+            if (mStagingSize == 0) {
+                mStagingOffset = offset;
+            }
+            size_t copy = std::min(size, mWriteBehindSize - mStagingSize);
+            memcpy(mStagingBuffers[mStagingIndex] + mStagingSize, data, copy);
+            mStagingSize += copy;
+            data += copy;
+            size -= copy;
+            offset += copy;
+
+            if (mStagingSize == mWriteBehindSize) {
+                submitStagingBuffer();
+            }
+        }
+    }
+}
+
+// Hands the staging buffer being filled to the write-behind thread, once it
+// is done with the other one.
+void MPEG4Writer::submitStagingBuffer() {
+    if (mStagingSize == 0) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(mWriteBehindLock);
+    while (mWriteBehindBuffer != NULL) {
+        mWriteBehindCondition.wait(mWriteBehindLock);
+    }
+    mWriteBehindBuffer = mStagingBuffers[mStagingIndex];
+    mWriteBehindBufferSize = mStagingSize;
+    mWriteBehindOffset = mStagingOffset;
+    mWriteBehindCondition.broadcast();
+
+    mStagingIndex = 1 - mStagingIndex;
+    mStagingSize = 0;
+}
+
+// Keeps the first error, for reset() to return.
+void MPEG4Writer::setWriteError(status_t err) {
+    if (err == OK) {
+        return;
+    }
+    Mutex::Autolock autoLock(mWriteBehindLock);
+    if (mWriteError == OK) {
+        mWriteError = err;
+    }
+}
+
+status_t MPEG4Writer::writeFully(struct iovec *iov, int iovcnt, off64_t offset) {
+    while (iovcnt > 0) {
+        ssize_t n = pwritev64(mFd, iov, iovcnt, offset);
+        ++mNumSampleWrites;
+        if (n < 0) {
+            int err = errno;
+            if (err == EINTR) {
+                continue;
+            }
+            ALOGE("failed to write sample data at %lld: %s",
+                    (long long)offset, strerror(err));
+            return -err;
+        }
+
+        offset += n;
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return OK;
+}
+
 size_t MPEG4Writer::write(
         const void *ptr, size_t size, size_t nmemb) {
 
@@ -2331,9 +2493,8 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
         chunk->mTimeStampUs, chunk->mTrack->getTrackType());
 
     int32_t isFirstSample = true;
-    while (!chunk->mSamples.empty()) {
-        List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
-
+    for (List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+         it != chunk->mSamples.end(); ++it) {
         uint32_t tiffHdrOffset;
         if (!(*it)->meta_data().findInt32(
                 kKeyExifTiffOffset, (int32_t*)&tiffHdrOffset)) {
@@ -2351,7 +2512,18 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
             chunk->mTrack->addChunkOffset(offset);
             isFirstSample = false;
         }
+    }
+
+    // The samples are written out from their buffers.
+    flushWrites_l();
+    if (mWriteOffset != mOffset) {
+        ALOGE("sample data written up to %lld, but the chunk ends at %lld",
+                (long long)mWriteOffset, (long long)mOffset);
+        setWriteError(ERROR_MALFORMED);
+    }
 
+    while (!chunk->mSamples.empty()) {
+        List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
         (*it)->release();
         (*it) = NULL;
         chunk->mSamples.erase(it);
@@ -2457,6 +2629,20 @@ status_t MPEG4Writer::startWriterThread() {
     mDone = false;
     mIsFirstChunk = true;
     mDriftTimeUs = 0;
+
+    mWriteIovecs.clear();
+    mWritePrefixesSize = 0;
+    mWriteOffset = mOffset;
+    mWriteSize = 0;
+    mWriteStatsStartUs = ALooper::GetNowUs();
+    mNumSampleWrites = 0;
+    mMaxWriteStallUs = 0;
+    mWriteError = OK;
+    status_t err = startWriteBehindThread();
+    if (err != OK) {
+        return err;
+    }
+
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
         ChunkInfo info;
@@ -2475,6 +2661,94 @@ status_t MPEG4Writer::startWriterThread() {
     return OK;
 }
 
+status_t MPEG4Writer::startWriteBehindThread() {
+    if (mWriteBehindSize == 0) {
+        return OK;
+    }
+
+    const size_t kAlignment = 4096;
+    mWriteBehindSize = align(mWriteBehindSize, kAlignment);
+    for (size_t i = 0; i < 2; ++i) {
+        void *buffer;
+        if (posix_memalign(&buffer, kAlignment, mWriteBehindSize) != 0) {
+            ALOGE("cannot allocate %zu byte staging buffer", mWriteBehindSize);
+            free(mStagingBuffers[0]);
+            mStagingBuffers[0] = NULL;
+            mWriteBehindSize = 0;
+            return NO_MEMORY;
+        }
+        mStagingBuffers[i] = (uint8_t *)buffer;
+    }
+    mStagingIndex = 0;
+    mStagingSize = 0;
+    mStagingOffset = mOffset;
+    mWriteBehindBuffer = NULL;
+    mWriteBehindDone = false;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    pthread_create(&mWriteBehindThread, &attr, WriteBehindThreadWrapper, this);
+    pthread_attr_destroy(&attr);
+    mWriteBehindThreadStarted = true;
+    return OK;
+}
+
+// Writes out what is still staged, and waits until it is written.
+void MPEG4Writer::stopWriteBehindThread() {
+    if (!mWriteBehindThreadStarted) {
+        return;
+    }
+
+    submitStagingBuffer();
+    {
+        Mutex::Autolock autoLock(mWriteBehindLock);
+        mWriteBehindDone = true;
+        mWriteBehindCondition.broadcast();
+    }
+
+    void *dummy;
+    pthread_join(mWriteBehindThread, &dummy);
+    mWriteBehindThreadStarted = false;
+
+    for (size_t i = 0; i < 2; ++i) {
+        free(mStagingBuffers[i]);
+        mStagingBuffers[i] = NULL;
+    }
+}
+
+// static
+void *MPEG4Writer::WriteBehindThreadWrapper(void *me) {
+    static_cast<MPEG4Writer *>(me)->writeBehindThreadFunc();
+    return NULL;
+}
+
+void MPEG4Writer::writeBehindThreadFunc() {
+    prctl(PR_SET_NAME, (unsigned long)"MPEG4WriteBehind", 0, 0, 0);
+
+    Mutex::Autolock autoLock(mWriteBehindLock);
+    for (;;) {
+        while (mWriteBehindBuffer == NULL && !mWriteBehindDone) {
+            mWriteBehindCondition.wait(mWriteBehindLock);
+        }
+        if (mWriteBehindBuffer == NULL) {
+            break;
+        }
+
+        struct iovec iov;
+        iov.iov_base = mWriteBehindBuffer;
+        iov.iov_len = mWriteBehindBufferSize;
+        off64_t offset = mWriteBehindOffset;
+
+        mWriteBehindLock.unlock();
+        setWriteError(writeFully(&iov, 1, offset));
+        mWriteBehindLock.lock();
+
+        mWriteBehindBuffer = NULL;
+        mWriteBehindCondition.broadcast();
+    }
+}
+
 
 status_t MPEG4Writer::Track::start(MetaData *params) {
     if (!mDone && mPaused) {
@@ -3462,6 +3736,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             size_t bytesWritten;
             off64_t offset = mOwner->addSample_l(
                     copy, usePrefix, tiffHdrOffset, &bytesWritten);
+            mOwner->flushWrites_l();
 
             if (mIsHeic) {
                 addItemOffsetAndSize(offset, bytesWritten, isExif);
@@ -50,6 +50,7 @@
 #include <media/stagefright/ACodec.h>
 #include <media/stagefright/BatteryChecker.h>
 #include <media/stagefright/BufferProducerWrapper.h>
+#include <media/stagefright/FrameTrace.h>
 #include <media/stagefright/MediaCodec.h>
 #include <media/stagefright/MediaCodecList.h>
 #include <media/stagefright/MediaDefs.h>
@@ -95,6 +96,7 @@ static const char *kCodecLatencyAvg = "android.media.mediacodec.latency.avg";
 static const char *kCodecLatencyCount = "android.media.mediacodec.latency.n";
 static const char *kCodecLatencyHist = "android.media.mediacodec.latency.hist"; /* in us */
 static const char *kCodecLatencyUnknown = "android.media.mediacodec.latency.unknown";
+static const char *kCodecStageLatencyPrefix = "android.media.mediacodec.latency."; /* in us */
 
 // the kCodecRecent* fields appear only in getMetrics() results
 static const char *kCodecRecentLatencyMax = "android.media.mediacodec.recent.max";      /* in us */
@@ -537,10 +539,13 @@ MediaCodec::MediaCodec(const sp<ALooper> &looper, pid_t pid, uid_t uid)
       mDequeueInputReplyID(0),
       mDequeueOutputTimeoutGeneration(0),
       mDequeueOutputReplyID(0),
+      mDequeueOutputBuffers(NULL),
+      mDequeueOutputMaxBuffers(0),
       mHaveInputSurface(false),
       mHavePendingInputBuffers(false),
       mCpuBoostRequested(false),
-      mLatencyUnknown(0) {
+      mLatencyUnknown(0),
+      mFrameTrace(new FrameTrace) {
     if (uid == kNoUid) {
         mUid = IPCThreadState::self()->getCallingUid();
     } else {
@@ -597,6 +602,23 @@ void MediaCodec::updateAnalyticsItem() {
         mAnalyticsItem->setInt64(kCodecLatencyUnknown, mLatencyUnknown);
     }
 
+    // per-stage latency of the frames still in the frame trace
+    FrameTrace::Percentiles stages[FrameTrace::INTERVAL_COUNT];
+    mFrameTrace->summarize(stages);
+    for (uint32_t i = 0; i < FrameTrace::INTERVAL_COUNT; ++i) {
+        if (stages[i].count == 0) {
+            continue;
+        }
+        const char *name = FrameTrace::intervalName((FrameTrace::Interval)i);
+        const std::pair<const char *, int64_t> values[] = {
+            { "p50", stages[i].p50Us }, { "p90", stages[i].p90Us }, { "p99", stages[i].p99Us },
+        };
+        for (const auto &value : values) {
+            std::string key = std::string(kCodecStageLatencyPrefix) + name + "." + value.first;
+            mAnalyticsItem->setInt64(key.c_str(), value.second);
+        }
+    }
+
 #if 0
     // enable for short term, only while debugging
     updateEphemeralAnalytics(mAnalyticsItem);
@@ -778,6 +800,8 @@ void MediaCodec::statsBufferReceived(int64_t presentationUs) {
 
     CHECK_NE(mState, UNINITIALIZED);
 
+    mFrameTrace->record(FrameTrace::DEQUEUED, presentationUs);
+
     // mutex access to mBuffersInFlight and other stats
     Mutex::Autolock al(mLatencyLock);
 
@@ -989,6 +1013,7 @@ status_t MediaCodec::init(const AString &name, bool nameIsType) {
     mBufferChannel->setCallback(
             std::unique_ptr<CodecBase::BufferCallback>(
                     new BufferCallback(new AMessage(kWhatCodecNotify, this))));
+    mBufferChannel->setFrameTrace(mFrameTrace);
 
     sp<AMessage> msg = new AMessage(kWhatInit, this);
     msg->setObject("codecInfo", mCodecInfo);
@@ -1379,6 +1404,7 @@ status_t MediaCodec::reset() {
     mReplyID = 0;
     mDequeueInputReplyID = 0;
     mDequeueOutputReplyID = 0;
+    mDequeueOutputBuffers = NULL;
     mDequeueInputTimeoutGeneration = 0;
     mDequeueOutputTimeoutGeneration = 0;
     mHaveInputSurface = false;
@@ -1401,6 +1427,7 @@ status_t MediaCodec::queueInputBuffer(
     }
 
     sp<AMessage> msg = new AMessage(kWhatQueueInputBuffer, this);
+    msg->setInt64("queuedNs", systemTime(SYSTEM_TIME_MONOTONIC));
     msg->setSize("index", index);
     msg->setSize("offset", offset);
     msg->setSize("size", size);
@@ -1429,6 +1456,7 @@ status_t MediaCodec::queueSecureInputBuffer(
     }
 
     sp<AMessage> msg = new AMessage(kWhatQueueInputBuffer, this);
+    msg->setInt64("queuedNs", systemTime(SYSTEM_TIME_MONOTONIC));
     msg->setSize("index", index);
     msg->setSize("offset", offset);
     msg->setPointer("subSamples", (void *)subSamples);
@@ -1448,6 +1476,29 @@ status_t MediaCodec::queueSecureInputBuffer(
     return err;
 }
 
+status_t MediaCodec::queueInputBuffers(
+        const std::vector<BatchBuffer> &buffers,
+        size_t *numQueued,
+        AString *errorDetailMsg) {
+    if (errorDetailMsg != NULL) {
+        errorDetailMsg->clear();
+    }
+    *numQueued = 0;
+
+    sp<AMessage> msg = new AMessage(kWhatQueueInputBuffers, this);
+    msg->setInt64("queuedNs", systemTime(SYSTEM_TIME_MONOTONIC));
+    msg->setPointer("buffers", (void *)&buffers);
+    msg->setPointer("numQueued", numQueued);
+    msg->setPointer("errorDetailMsg", errorDetailMsg);
+
+    sp<AMessage> response;
+    return PostAndAwaitResponse(msg, &response);
+}
+
+sp<FrameTrace> MediaCodec::getFrameTrace() const {
+    return mFrameTrace;
+}
+
 status_t MediaCodec::dequeueInputBuffer(size_t *index, int64_t timeoutUs) {
     sp<AMessage> msg = new AMessage(kWhatDequeueInputBuffer, this);
     msg->setInt64("timeoutUs", timeoutUs);
@@ -1488,6 +1539,24 @@ status_t MediaCodec::dequeueOutputBuffer(
     return OK;
 }
 
+status_t MediaCodec::dequeueOutputBuffers(
+        std::vector<BatchBuffer> *buffers,
+        size_t maxBuffers,
+        int64_t timeoutUs) {
+    buffers->clear();
+    if (maxBuffers == 0) {
+        return -EINVAL;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatDequeueOutputBuffers, this);
+    msg->setPointer("buffers", buffers);
+    msg->setSize("maxBuffers", maxBuffers);
+    msg->setInt64("timeoutUs", timeoutUs);
+
+    sp<AMessage> response;
+    return PostAndAwaitResponse(msg, &response);
+}
+
 status_t MediaCodec::renderOutputBufferAndRelease(size_t index) {
     sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, this);
     msg->setSize("index", index);
@@ -1808,6 +1877,7 @@ void MediaCodec::cancelPendingDequeueOperations() {
 
         ++mDequeueOutputTimeoutGeneration;
         mDequeueOutputReplyID = 0;
+        mDequeueOutputBuffers = NULL;
         mFlags &= ~kFlagDequeueOutputPending;
     }
 }
@@ -1848,6 +1918,32 @@ bool MediaCodec::handleDequeueOutputBuffer(const sp<AReplyToken> &replyID, bool
     } else if (mFlags & kFlagOutputFormatChanged) {
         PostReplyWithError(replyID, INFO_FORMAT_CHANGED);
         mFlags &= ~kFlagOutputFormatChanged;
+    } else if (mDequeueOutputBuffers != NULL) {
+        // dequeueOutputBuffers(): take what is available, without waiting for more
+        ssize_t index;
+        while (mDequeueOutputBuffers->size() < mDequeueOutputMaxBuffers
+                && (index = dequeuePortBuffer(kPortIndexOutput)) >= 0) {
+            const sp<MediaCodecBuffer> &buffer =
+                mPortBuffers[kPortIndexOutput][index].mData;
+
+            BatchBuffer out;
+            out.index = index;
+            out.offset = buffer->offset();
+            out.size = buffer->size();
+            CHECK(buffer->meta()->findInt64("timeUs", &out.presentationTimeUs));
+
+            statsBufferReceived(out.presentationTimeUs);
+
+            CHECK(buffer->meta()->findInt32("flags", (int32_t *)&out.flags));
+            mDequeueOutputBuffers->push_back(out);
+        }
+
+        if (mDequeueOutputBuffers->empty()) {
+            return false;
+        }
+
+        sp<AMessage> response = new AMessage;
+        response->postReply(replyID);
     } else {
         sp<AMessage> response = new AMessage;
         ssize_t index = dequeuePortBuffer(kPortIndexOutput);
@@ -2393,6 +2489,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                         ++mDequeueOutputTimeoutGeneration;
                         mFlags &= ~kFlagDequeueOutputPending;
                         mDequeueOutputReplyID = 0;
+                        mDequeueOutputBuffers = NULL;
                     } else {
                         postActivityNotificationIfPossible();
                     }
@@ -2912,7 +3009,54 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatQueueInputBuffers:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            if (!isExecuting()) {
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagStickyError) {
+                PostReplyWithError(replyID, getStickyError());
+                break;
+            }
+
+            const std::vector<BatchBuffer> *buffers;
+            size_t *numQueued;
+            AString *errorDetailMsg;
+            CHECK(msg->findPointer("buffers", (void **)&buffers));
+            CHECK(msg->findPointer("numQueued", (void **)&numQueued));
+            CHECK(msg->findPointer("errorDetailMsg", (void **)&errorDetailMsg));
+
+            // each buffer is queued as a kWhatQueueInputBuffer message would be
+            sp<AMessage> item = new AMessage(kWhatQueueInputBuffer, this);
+            item->setPointer("errorDetailMsg", errorDetailMsg);
+            int64_t queuedNs;
+            CHECK(msg->findInt64("queuedNs", &queuedNs));
+            item->setInt64("queuedNs", queuedNs);
+
+            status_t err = OK;
+            for (const BatchBuffer &buffer : *buffers) {
+                item->setSize("index", buffer.index);
+                item->setSize("offset", buffer.offset);
+                item->setSize("size", buffer.size);
+                item->setInt64("timeUs", buffer.presentationTimeUs);
+                item->setInt32("flags", buffer.flags);
+
+                err = onQueueInputBuffer(item);
+                if (err != OK) {
+                    break;
+                }
+                ++*numQueued;
+            }
+
+            PostReplyWithError(replyID, err);
+            break;
+        }
+
         case kWhatDequeueOutputBuffer:
+        case kWhatDequeueOutputBuffers:
         {
             sp<AReplyToken> replyID;
             CHECK(msg->senderAwaitsResponse(&replyID));
@@ -2921,9 +3065,18 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
                 ALOGE("dequeueOutputBuffer can't be used in async mode");
                 PostReplyWithError(replyID, INVALID_OPERATION);
                 break;
+            } else if (mFlags & kFlagDequeueOutputPending) {
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            }
+
+            if (msg->what() == kWhatDequeueOutputBuffers) {
+                CHECK(msg->findPointer("buffers", (void **)&mDequeueOutputBuffers));
+                CHECK(msg->findSize("maxBuffers", &mDequeueOutputMaxBuffers));
             }
 
             if (handleDequeueOutputBuffer(replyID, true /* new request */)) {
+                mDequeueOutputBuffers = NULL;
                 break;
             }
 
@@ -2932,6 +3085,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
 
             if (timeoutUs == 0LL) {
                 PostReplyWithError(replyID, -EAGAIN);
+                mDequeueOutputBuffers = NULL;
                 break;
             }
 
@@ -2964,6 +3118,7 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
 
             mFlags &= ~kFlagDequeueOutputPending;
             mDequeueOutputReplyID = 0;
+            mDequeueOutputBuffers = NULL;
             break;
         }
 
@@ -3321,6 +3476,12 @@ status_t MediaCodec::onQueueInputBuffer(const sp<AMessage> &msg) {
     CHECK(msg->findInt64("timeUs", &timeUs));
     CHECK(msg->findInt32("flags", (int32_t *)&flags));
 
+    // when the client queued the buffer, to include the time spent in the looper
+    int64_t queuedNs;
+    if (!msg->findInt64("queuedNs", &queuedNs)) {
+        queuedNs = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+
     const CryptoPlugin::SubSample *subSamples;
     size_t numSubSamples;
     const uint8_t *key;
@@ -3425,6 +3586,7 @@ status_t MediaCodec::onQueueInputBuffer(const sp<AMessage> &msg) {
         info->mOwnedByClient = false;
         info->mData.clear();
 
+        mFrameTrace->record(FrameTrace::QUEUED, timeUs, queuedNs);
         statsBufferSent(timeUs);
     }
 
@@ -3480,6 +3642,12 @@ status_t MediaCodec::onReleaseOutputBuffer(const sp<AMessage> &msg) {
         info->mData.clear();
     }
 
+    int64_t timeUs;
+    if (buffer->meta()->findInt64("timeUs", &timeUs)) {
+        mFrameTrace->record(render && buffer->size() != 0
+                ? FrameTrace::RENDERED : FrameTrace::DROPPED, timeUs);
+    }
+
     if (render && buffer->size() != 0) {
         int64_t mediaTimeUs = -1;
         buffer->meta()->findInt64("timeUs", &mediaTimeUs);
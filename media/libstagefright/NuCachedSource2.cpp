@@ -14,7 +14,13 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
 #include <inttypes.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "NuCachedSource2"
@@ -30,6 +36,187 @@
 
 namespace android {
 
+// Second tier of the cache. Pages released from memory are written to a sparse
+// file at their offset in the source, and an index of the ranges on disk lets
+// later reads, e.g. after seeking back, be served without the network.
+// The file has no name, so it is private to us and goes away when closed.
+struct DiskCache {
+    static DiskCache *Create(const char *dir, size_t maxBytes);
+    ~DiskCache();
+
+    // Returns how many bytes from |offset| on, up to |size|, are on disk.
+    size_t available(off64_t offset, size_t size) const;
+
+    // May be called without the lock of the index; whatever is evicted in the
+    // meantime reads back as zeros, so callers check evictions() afterwards.
+    ssize_t read(off64_t offset, void *data, size_t size);
+
+    // Keeping |size| bytes at |offset| of the source takes three steps, so that
+    // the data can be written without holding the lock of the index:
+    // reserve() makes room for it, dropping the data farthest from |keepNear|
+    // first, and returns false if it need not or cannot be kept; write()
+    // writes it; and commit() adds what was written to the index. Only one
+    // write may be in progress at a time.
+    bool reserve(off64_t offset, size_t size, off64_t keepNear);
+    size_t write(off64_t offset, const void *data, size_t size);
+    void commit(off64_t offset, size_t size);
+
+    size_t totalSize() const {
+        return mTotalSize;
+    }
+
+    uint32_t evictions() const {
+        return mEvictions;
+    }
+
+private:
+    int mFd;
+    size_t mMaxBytes;
+    size_t mTotalSize;
+    uint32_t mEvictions;
+    std::map<off64_t, off64_t> mRanges;     // start -> end; disjoint, not adjacent
+
+    DiskCache(int fd, size_t maxBytes);
+
+    void addRange(off64_t start, off64_t end);
+    void evict(size_t bytes, off64_t keepNear);
+
+    DISALLOW_EVIL_CONSTRUCTORS(DiskCache);
+};
+
+// static
+DiskCache *DiskCache::Create(const char *dir, size_t maxBytes) {
+    int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        ALOGW("cannot create a cache file in %s: %s", dir, strerror(errno));
+        return NULL;
+    }
+    return new DiskCache(fd, maxBytes);
+}
+
+DiskCache::DiskCache(int fd, size_t maxBytes)
+    : mFd(fd),
+      mMaxBytes(maxBytes),
+      mTotalSize(0),
+      mEvictions(0) {
+}
+
+DiskCache::~DiskCache() {
+    close(mFd);
+    mFd = -1;
+}
+
+size_t DiskCache::available(off64_t offset, size_t size) const {
+    auto it = mRanges.upper_bound(offset);
+    if (it == mRanges.begin()) {
+        return 0;
+    }
+    --it;
+    if (it->second <= offset) {
+        return 0;
+    }
+    return std::min(size, (size_t)(it->second - offset));
+}
+
+ssize_t DiskCache::read(off64_t offset, void *data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread64(mFd, (uint8_t *)data + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            ALOGE("cannot read the cache file at %lld: %s",
+                    (long long)(offset + done), n < 0 ? strerror(errno) : "eof");
+            return n < 0 ? -errno : ERROR_IO;
+        }
+        done += n;
+    }
+    return done;
+}
+
+bool DiskCache::reserve(off64_t offset, size_t size, off64_t keepNear) {
+    if (size == 0 || size > mMaxBytes || available(offset, size) == size) {
+        return false;
+    }
+    if (mTotalSize + size > mMaxBytes) {
+        evict(mTotalSize + size - mMaxBytes, keepNear);
+    }
+    return true;
+}
+
+size_t DiskCache::write(off64_t offset, const void *data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pwrite64(mFd, (const uint8_t *)data + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            ALOGW("cannot write the cache file at %lld: %s",
+                    (long long)(offset + done), n < 0 ? strerror(errno) : "no space");
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+void DiskCache::commit(off64_t offset, size_t size) {
+    addRange(offset, offset + size);
+}
+
+void DiskCache::addRange(off64_t start, off64_t end) {
+    if (start >= end) {
+        return;
+    }
+    // merge with the ranges that overlap or touch it
+    auto it = mRanges.upper_bound(start);
+    if (it != mRanges.begin() && std::prev(it)->second >= start) {
+        --it;
+    }
+    while (it != mRanges.end() && it->first <= end) {
+        start = std::min(start, it->first);
+        end = std::max(end, it->second);
+        mTotalSize -= it->second - it->first;
+        it = mRanges.erase(it);
+    }
+    mRanges[start] = end;
+    mTotalSize += end - start;
+}
+
+void DiskCache::evict(size_t bytes, off64_t keepNear) {
+    ++mEvictions;
+    while (bytes > 0 && !mRanges.empty()) {
+        // trim the far end of whichever outer range is farther away
+        auto first = mRanges.begin();
+        auto last = std::prev(mRanges.end());
+        off64_t start, end;
+        if (keepNear - first->first > last->second - keepNear) {
+            start = first->first;
+            end = std::min(first->second, start + (off64_t)bytes);
+            if (end < first->second) {
+                mRanges[end] = first->second;
+            }
+            mRanges.erase(first);
+        } else {
+            end = last->second;
+            start = std::max(last->first, end - (off64_t)bytes);
+            if (start > last->first) {
+                last->second = start;
+            } else {
+                mRanges.erase(last);
+            }
+        }
+        if (fallocate(mFd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, start, end - start) < 0) {
+            ALOGW("cannot free cache file range %lld-%lld: %s",
+                    (long long)start, (long long)end, strerror(errno));
+        }
+        mTotalSize -= end - start;
+        bytes -= end - start;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 struct PageCache {
     explicit PageCache(size_t pageSize);
     ~PageCache();
@@ -37,13 +224,21 @@ struct PageCache {
     struct Page {
         void *mData;
         size_t mSize;
+        off64_t mOffset;    // in the source, while waiting to be spilled
     };
 
     Page *acquirePage();
     void releasePage(Page *page);
 
     void appendPage(Page *page);
-    size_t releaseFromStart(size_t maxBytes);
+
+    // Releases whole pages from the start. If |spill|, they are kept, at their
+    // offset in the source from |offset| on, until taken by takeSpillPage().
+    size_t releaseFromStart(size_t maxBytes, bool spill = false, off64_t offset = 0);
+
+    // Returns the oldest page released to be spilled, or NULL. It goes back with
+    // releasePage().
+    Page *takeSpillPage();
 
     size_t totalSize() const {
         return mTotalSize;
@@ -57,6 +252,7 @@ private:
 
     List<Page *> mActivePages;
     List<Page *> mFreePages;
+    List<Page *> mSpillPages;
 
     void freePages(List<Page *> *list);
 
@@ -71,6 +267,7 @@ PageCache::PageCache(size_t pageSize)
 PageCache::~PageCache() {
     freePages(&mActivePages);
     freePages(&mFreePages);
+    freePages(&mSpillPages);
 }
 
 void PageCache::freePages(List<Page *> *list) {
@@ -98,6 +295,7 @@ PageCache::Page *PageCache::acquirePage() {
     Page *page = new Page;
     page->mData = malloc(mPageSize);
     page->mSize = 0;
+    page->mOffset = 0;
 
     return page;
 }
@@ -112,7 +310,7 @@ void PageCache::appendPage(Page *page) {
     mActivePages.push_back(page);
 }
 
-size_t PageCache::releaseFromStart(size_t maxBytes) {
+size_t PageCache::releaseFromStart(size_t maxBytes, bool spill, off64_t offset) {
     size_t bytesReleased = 0;
 
     while (maxBytes > 0 && !mActivePages.empty()) {
@@ -127,15 +325,32 @@ size_t PageCache::releaseFromStart(size_t maxBytes) {
         mActivePages.erase(it);
 
         maxBytes -= page->mSize;
-        bytesReleased += page->mSize;
 
-        releasePage(page);
+        if (spill) {
+            page->mOffset = offset + bytesReleased;
+            bytesReleased += page->mSize;
+            mSpillPages.push_back(page);
+        } else {
+            bytesReleased += page->mSize;
+            releasePage(page);
+        }
     }
 
     mTotalSize -= bytesReleased;
     return bytesReleased;
 }
 
+PageCache::Page *PageCache::takeSpillPage() {
+    if (mSpillPages.empty()) {
+        return NULL;
+    }
+
+    List<Page *>::iterator it = mSpillPages.begin();
+    Page *page = *it;
+    mSpillPages.erase(it);
+    return page;
+}
+
 void PageCache::copy(size_t from, void *data, size_t size) {
     ALOGV("copy from %zu size %zu", from, size);
 
@@ -179,14 +394,18 @@ void PageCache::copy(size_t from, void *data, size_t size) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static const char *kDefaultSpillDir = "/data/misc/media";
+
 NuCachedSource2::NuCachedSource2(
         const sp<DataSource> &source,
         const char *cacheConfig,
-        bool disconnectAtHighwatermark)
+        bool disconnectAtHighwatermark,
+        const char *spillDir)
     : mSource(source),
       mReflector(new AHandlerReflector<NuCachedSource2>(this)),
       mLooper(new ALooper),
       mCache(new PageCache(kPageSize)),
+      mSpill(NULL),
       mCacheOffset(0),
       mFinalStatus(OK),
       mLastAccessPos(0),
@@ -196,6 +415,12 @@ NuCachedSource2::NuCachedSource2(
       mNumRetriesLeft(kMaxNumRetries),
       mHighwaterThresholdBytes(kDefaultHighWaterThreshold),
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
+      mMaxHighwaterThresholdBytes(kDefaultHighWaterThreshold),
+      mFixedThresholds(cacheConfig != NULL),
+      mBitrate(-1),
+      mLastThresholdUpdateUs(0),
+      mSpillBytes(0),
+      mSpillBytesRead(0),
       mKeepAliveIntervalUs(kDefaultKeepAliveIntervalUs),
       mDisconnectAtHighwatermark(disconnectAtHighwatermark) {
     // We are NOT going to support disconnect-at-highwatermark indefinitely
@@ -214,6 +439,11 @@ NuCachedSource2::NuCachedSource2(
         mKeepAliveIntervalUs = 0;
     }
 
+    if (mSpillBytes > 0) {
+        mSpill = DiskCache::Create(
+                spillDir != NULL ? spillDir : kDefaultSpillDir, mSpillBytes);
+    }
+
     mLooper->setName("NuCachedSource2");
     mLooper->registerHandler(mReflector);
 
@@ -234,20 +464,30 @@ NuCachedSource2::~NuCachedSource2() {
 
     delete mCache;
     mCache = NULL;
+
+    delete mSpill;
+    mSpill = NULL;
 }
 
 // static
 sp<NuCachedSource2> NuCachedSource2::Create(
         const sp<DataSource> &source,
         const char *cacheConfig,
-        bool disconnectAtHighwatermark) {
+        bool disconnectAtHighwatermark,
+        const char *spillDir) {
     sp<NuCachedSource2> instance = new NuCachedSource2(
-            source, cacheConfig, disconnectAtHighwatermark);
+            source, cacheConfig, disconnectAtHighwatermark, spillDir);
     Mutex::Autolock autoLock(instance->mLock);
     (new AMessage(kWhatFetchMore, instance->mReflector))->post();
     return instance;
 }
 
+void NuCachedSource2::setBitrate(int64_t bitrate) {
+    Mutex::Autolock autoLock(mLock);
+    mBitrate = bitrate;
+    mLastThresholdUpdateUs = 0;
+}
+
 status_t NuCachedSource2::getEstimatedBandwidthKbps(int32_t *kbps) {
     if (mSource->flags() & kIsHTTPBasedSource) {
         HTTPBase* source = static_cast<HTTPBase *>(mSource.get());
@@ -362,12 +602,30 @@ void NuCachedSource2::fetchInternal() {
     }
 
     PageCache::Page *page = mCache->acquirePage();
+    const off64_t fetchOffset = mCacheOffset + mCache->totalSize();
 
-    ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+    // What was already fetched once does not need the network again.
+    size_t onDisk = 0;
+    {
+        Mutex::Autolock autoLock(mLock);
+        onDisk = (mSpill != NULL) ? mSpill->available(fetchOffset, kPageSize) : 0;
+    }
+    ssize_t n = -1;
+    if (onDisk > 0) {
+        // Only the looper evicts from the disk cache, so it can be read unlocked.
+        n = mSpill->read(fetchOffset, page->mData, onDisk);
+    }
+    bool fromDisk = n > 0;
+    if (!fromDisk) {
+        n = mSource->readAt(fetchOffset, page->mData, kPageSize);
+    }
 
     Mutex::Autolock autoLock(mLock);
 
+    if (fromDisk) {
+        mSpillBytesRead += n;
+    }
+
     if (n == 0 || mDisconnecting) {
         ALOGI("caching reached eos.");
 
@@ -400,6 +658,8 @@ void NuCachedSource2::fetchInternal() {
 void NuCachedSource2::onFetch() {
     ALOGV("onFetch");
 
+    updateThresholdsFromBitrate();
+
     if (mFinalStatus != OK && mNumRetriesLeft == 0) {
         ALOGV("EOS reached, done prefetching for now");
         mFetching = false;
@@ -436,6 +696,10 @@ void NuCachedSource2::onFetch() {
         restartPrefetcherIfNecessary_l();
     }
 
+    // Pages released from the cache are written out between fetches, so that
+    // e.g. a seek away from the cache does not wait for all of it to be written.
+    spillReleasedPages(mFetching ? (size_t)kMaxSpillPagesPerFetch : SIZE_MAX);
+
     int64_t delayUs;
     if (mFetching) {
         if (mFinalStatus != OK && mNumRetriesLeft > 0) {
@@ -498,7 +762,8 @@ void NuCachedSource2::restartPrefetcherIfNecessary_l(
         return;
     }
 
-    size_t maxBytes = mLastAccessPos - mCacheOffset;
+    // The last access can be before the cache, if it was read from the disk cache.
+    size_t maxBytes = (mLastAccessPos > mCacheOffset) ? mLastAccessPos - mCacheOffset : 0;
 
     if (!force) {
         if (maxBytes < kGrayArea) {
@@ -508,8 +773,7 @@ void NuCachedSource2::restartPrefetcherIfNecessary_l(
         maxBytes -= kGrayArea;
     }
 
-    size_t actualBytes = mCache->releaseFromStart(maxBytes);
-    mCacheOffset += actualBytes;
+    releaseFromStart_l(maxBytes);
 
     ALOGI("restarting prefetcher, totalSize = %zu", mCache->totalSize());
     mFetching = true;
@@ -537,6 +801,12 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         return size;
     }
 
+    ssize_t n = readFromSpill_l(offset, data, size);
+    if (n >= 0) {
+        mLastAccessPos = offset + n;
+        return n;
+    }
+
     sp<AMessage> msg = new AMessage(kWhatRead, mReflector);
     msg->setInt64("offset", offset);
     msg->setPointer("data", data);
@@ -613,6 +883,8 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
         return ERROR_END_OF_STREAM;
     }
 
+    // readAt() already looked in the disk cache.
+
     if (!mFetching) {
         mLastAccessPos = offset;
         restartPrefetcherIfNecessary_l(
@@ -672,10 +944,10 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
 
     ALOGI("new range: offset= %lld", (long long)offset);
 
-    mCacheOffset = offset;
-
     size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
+    CHECK_EQ(releaseFromStart_l(totalSize), totalSize);
+
+    mCacheOffset = offset;
 
     mNumRetriesLeft = kMaxNumRetries;
     mFetching = true;
@@ -683,6 +955,123 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     return OK;
 }
 
+size_t NuCachedSource2::releaseFromStart_l(size_t maxBytes) {
+    size_t bytesReleased =
+        mCache->releaseFromStart(maxBytes, mSpill != NULL, mCacheOffset);
+    mCacheOffset += bytesReleased;
+    return bytesReleased;
+}
+
+// Writes up to |maxPages| of the pages released from the cache to the disk cache,
+// without holding mLock while writing. Called on the looper, the only writer.
+void NuCachedSource2::spillReleasedPages(size_t maxPages) {
+    for (size_t i = 0; i < maxPages; ++i) {
+        PageCache::Page *page;
+        {
+            Mutex::Autolock autoLock(mLock);
+            page = mCache->takeSpillPage();
+            if (page == NULL) {
+                return;
+            }
+            if (!mSpill->reserve(page->mOffset, page->mSize, mLastAccessPos)) {
+                mCache->releasePage(page);
+                continue;
+            }
+        }
+
+        size_t written = mSpill->write(page->mOffset, page->mData, page->mSize);
+
+        Mutex::Autolock autoLock(mLock);
+        mSpill->commit(page->mOffset, written);
+        mCache->releasePage(page);
+    }
+}
+
+// Called with mLock held, which is released while reading the disk; the looper
+// may evict from the disk cache or move the cache meanwhile.
+ssize_t NuCachedSource2::readFromSpill_l(off64_t offset, void *data, size_t size) {
+    if (mSpill == NULL || size == 0) {
+        return -EAGAIN;
+    }
+
+    // All of it on disk, or up to the start of the cache, with the rest cached.
+    size_t onDisk = mSpill->available(offset, size);
+    if (onDisk == 0 || (onDisk < size && !isCachedAt_l(offset + onDisk, size - onDisk))) {
+        return -EAGAIN;
+    }
+
+    ALOGV("reading %zu bytes at %lld from the disk cache", onDisk, (long long)offset);
+    uint32_t evictions = mSpill->evictions();
+    mLock.unlock();
+    ssize_t n = mSpill->read(offset, data, onDisk);
+    mLock.lock();
+
+    if (n != (ssize_t)onDisk || mSpill->evictions() != evictions) {
+        return -EAGAIN;
+    }
+    if (onDisk < size) {
+        if (!isCachedAt_l(offset + onDisk, size - onDisk)) {
+            return -EAGAIN;
+        }
+        mCache->copy(0, (uint8_t *)data + onDisk, size - onDisk);
+    }
+    mSpillBytesRead += size;
+    return size;
+}
+
+bool NuCachedSource2::isCachedAt_l(off64_t offset, size_t size) const {
+    return offset == mCacheOffset && size <= mCache->totalSize();
+}
+
+size_t NuCachedSource2::spillBytesRead() const {
+    Mutex::Autolock autoLock(mLock);
+    return mSpillBytesRead;
+}
+
+void NuCachedSource2::updateThresholdsFromBitrate() {
+    int64_t nowUs = ALooper::GetNowUs();
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mFixedThresholds || mBitrate <= 0
+                || nowUs < mLastThresholdUpdateUs + kBitrateUpdateIntervalUs) {
+            return;
+        }
+        mLastThresholdUpdateUs = nowUs;
+    }
+
+    int32_t kbps;
+    if (getEstimatedBandwidthKbps(&kbps) != OK || kbps <= 0) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    const int64_t bytesPerSec = mBitrate / 8;
+    const int64_t bandwidth = kbps * 1000LL / 8;
+
+    // The closer the bandwidth is to the bitrate, the longer the cache takes to
+    // fill up again, so the sooner fetching has to start again.
+    int64_t lowwaterDurationUs = kMaxLowWaterDurationUs;
+    if (bandwidth > bytesPerSec) {
+        lowwaterDurationUs = std::max((int64_t)kMinLowWaterDurationUs,
+                std::min((int64_t)kMaxLowWaterDurationUs,
+                        2 * kMinLowWaterDurationUs * bytesPerSec / (bandwidth - bytesPerSec)));
+    }
+
+    size_t highwater = std::min((int64_t)mMaxHighwaterThresholdBytes,
+            std::max((int64_t)kMinHighWaterThreshold,
+                    bytesPerSec * kHighWaterDurationUs / 1000000LL));
+    size_t lowwater = std::min((int64_t)highwater / 2,
+            std::max((int64_t)kMinLowWaterThreshold,
+                    bytesPerSec * lowwaterDurationUs / 1000000LL));
+
+    if (highwater != mHighwaterThresholdBytes || lowwater != mLowwaterThresholdBytes) {
+        ALOGV("bitrate %lld bps, bandwidth %d kbps: lowwater = %zu bytes, highwater = %zu bytes",
+                (long long)mBitrate, kbps, lowwater, highwater);
+        mHighwaterThresholdBytes = highwater;
+        mLowwaterThresholdBytes = lowwater;
+    }
+}
+
 void NuCachedSource2::resumeFetchingIfNecessary() {
     Mutex::Autolock autoLock(mLock);
 
@@ -711,11 +1100,13 @@ void NuCachedSource2::updateCacheParamsFromSystemProperty() {
 }
 
 void NuCachedSource2::updateCacheParamsFromString(const char *s) {
-    ssize_t lowwaterMarkKb, highwaterMarkKb;
+    ssize_t lowwaterMarkKb, highwaterMarkKb, spillKb;
     int keepAliveSecs;
 
-    if (sscanf(s, "%zd/%zd/%d",
-               &lowwaterMarkKb, &highwaterMarkKb, &keepAliveSecs) != 3) {
+    // The size of the disk cache is optional.
+    int numParams = sscanf(s, "%zd/%zd/%d/%zd",
+               &lowwaterMarkKb, &highwaterMarkKb, &keepAliveSecs, &spillKb);
+    if (numParams != 3 && numParams != 4) {
         ALOGE("Failed to parse cache parameters from '%s'.", s);
         return;
     }
@@ -738,6 +1129,7 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
         mLowwaterThresholdBytes = kDefaultLowWaterThreshold;
         mHighwaterThresholdBytes = kDefaultHighWaterThreshold;
     }
+    mMaxHighwaterThresholdBytes = mHighwaterThresholdBytes;
 
     if (keepAliveSecs >= 0) {
         mKeepAliveIntervalUs = keepAliveSecs * 1000000LL;
@@ -745,10 +1137,24 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
         mKeepAliveIntervalUs = kDefaultKeepAliveIntervalUs;
     }
 
-    ALOGV("lowwater = %zu bytes, highwater = %zu bytes, keepalive = %lld us",
+    if (numParams == 4) {
+        // The config may come from the app, so the disk it takes is bounded.
+        if (spillKb < 0) {
+            ALOGE("Illegal disk cache size specified, disabling it.");
+            mSpillBytes = 0;
+        } else if ((size_t)spillKb > (size_t)(kMaxSpillBytes / 1024)) {
+            ALOGW("Disk cache size of %zd KB limited to %d KB.", spillKb, kMaxSpillBytes / 1024);
+            mSpillBytes = kMaxSpillBytes;
+        } else {
+            mSpillBytes = spillKb * 1024;
+        }
+    }
+
+    ALOGV("lowwater = %zu bytes, highwater = %zu bytes, keepalive = %lld us, spill = %zu bytes",
          mLowwaterThresholdBytes,
          mHighwaterThresholdBytes,
-         (long long)mKeepAliveIntervalUs);
+         (long long)mKeepAliveIntervalUs,
+         mSpillBytes);
 }
 
 // static
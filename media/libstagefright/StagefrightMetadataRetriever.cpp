@@ -19,6 +19,8 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include <utils/Log.h>
 #include <cutils/properties.h>
 
@@ -270,9 +272,58 @@ status_t StagefrightMetadataRetriever::getFrameAtIndex(
             colorFormat, metaOnly, NULL /*outFrame*/, frames);
 }
 
-status_t StagefrightMetadataRetriever::getFrameInternal(
-        int64_t timeUs, int numFrames, int option, int colorFormat, bool metaOnly,
-        sp<IMemory>* outFrame, std::vector<sp<IMemory> >* outFrames) {
+status_t StagefrightMetadataRetriever::getFramesAtTimes(
+        std::vector<sp<IMemory> > *frames, const std::vector<int64_t> &timesUs,
+        int option, int colorFormat, int maxWidth, int maxHeight) {
+    ALOGV("getFramesAtTimes: %zu times, option: %d colorFormat: %d, max size: %dx%d",
+            timesUs.size(), option, colorFormat, maxWidth, maxHeight);
+
+    if (timesUs.empty() || !std::is_sorted(timesUs.begin(), timesUs.end())
+            || option < MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC
+            || option > MediaSource::ReadOptions::SEEK_CLOSEST) {
+        return BAD_VALUE;
+    }
+
+    size_t trackIndex;
+    sp<MetaData> trackMeta;
+    status_t err = findVideoTrack(&trackIndex, &trackMeta);
+    if (err != OK) {
+        return err;
+    }
+
+    sp<IMediaSource> source = mExtractor->getTrack(trackIndex);
+    if (source.get() == NULL) {
+        ALOGV("unable to instantiate video track.");
+        return UNKNOWN_ERROR;
+    }
+
+    Vector<AString> matchingCodecs;
+    findThumbnailCodecs(trackMeta, &matchingCodecs);
+
+    for (size_t i = 0; i < matchingCodecs.size(); ++i) {
+        const AString &componentName = matchingCodecs[i];
+        sp<VideoFrameDecoder> decoder = new VideoFrameDecoder(componentName, trackMeta, source);
+        if (decoder->init(timesUs[0], 1, option, colorFormat) == OK) {
+            frames->clear();
+            err = decoder->extractFramesAtTimes(timesUs, maxWidth, maxHeight,
+                    [frames](size_t /* index */, const sp<IMemory> &frame) {
+                        frames->push_back(frame);
+                    });
+            // times past the last frame are left out
+            if (err == OK || (err == ERROR_END_OF_STREAM && !frames->empty())) {
+                return OK;
+            }
+        }
+        ALOGV("%s failed to extract frames, trying next decoder.", componentName.c_str());
+    }
+
+    ALOGE("all codecs failed to extract frames.");
+    frames->clear();
+    return UNKNOWN_ERROR;
+}
+
+status_t StagefrightMetadataRetriever::findVideoTrack(
+        size_t *trackIndex, sp<MetaData> *trackMeta) {
     if (mExtractor.get() == NULL) {
         ALOGE("no extractor.");
         return NO_INIT;
@@ -305,11 +356,40 @@ status_t StagefrightMetadataRetriever::getFrameInternal(
         return INVALID_OPERATION;
     }
 
-    sp<MetaData> trackMeta = mExtractor->getTrackMetaData(
+    *trackMeta = mExtractor->getTrackMetaData(
             i, MediaExtractor::kIncludeExtensiveMetaData);
-    if (!trackMeta) {
+    if (!*trackMeta) {
         return UNKNOWN_ERROR;
     }
+    *trackIndex = i;
+    return OK;
+}
+
+// static
+void StagefrightMetadataRetriever::findThumbnailCodecs(
+        const sp<MetaData> &trackMeta, Vector<AString> *matchingCodecs) {
+    const char *mime;
+    CHECK(trackMeta->findCString(kKeyMIMEType, &mime));
+
+    bool preferhw = property_get_bool(
+            "media.stagefright.thumbnail.prefer_hw_codecs", false);
+    uint32_t flags = preferhw ? 0 : MediaCodecList::kPreferSoftwareCodecs;
+    MediaCodecList::findMatchingCodecs(
+            mime,
+            false, /* encoder */
+            flags,
+            matchingCodecs);
+}
+
+status_t StagefrightMetadataRetriever::getFrameInternal(
+        int64_t timeUs, int numFrames, int option, int colorFormat, bool metaOnly,
+        sp<IMemory>* outFrame, std::vector<sp<IMemory> >* outFrames) {
+    size_t i;
+    sp<MetaData> trackMeta;
+    status_t err = findVideoTrack(&i, &trackMeta);
+    if (err != OK) {
+        return err;
+    }
 
     if (metaOnly) {
         if (outFrame != NULL) {
@@ -331,23 +411,14 @@ status_t StagefrightMetadataRetriever::getFrameInternal(
     const void *data;
     uint32_t type;
     size_t dataSize;
+    sp<MetaData> fileMeta = mExtractor->getMetaData();
     if (fileMeta->findData(kKeyAlbumArt, &type, &data, &dataSize)
             && mAlbumArt == NULL) {
         mAlbumArt = MediaAlbumArt::fromData(dataSize, data);
     }
 
-    const char *mime;
-    CHECK(trackMeta->findCString(kKeyMIMEType, &mime));
-
-    bool preferhw = property_get_bool(
-            "media.stagefright.thumbnail.prefer_hw_codecs", false);
-    uint32_t flags = preferhw ? 0 : MediaCodecList::kPreferSoftwareCodecs;
     Vector<AString> matchingCodecs;
-    MediaCodecList::findMatchingCodecs(
-            mime,
-            false, /* encoder */
-            flags,
-            &matchingCodecs);
+    findThumbnailCodecs(trackMeta, &matchingCodecs);
 
     for (size_t i = 0; i < matchingCodecs.size(); ++i) {
         const AString &componentName = matchingCodecs[i];
@@ -43,6 +43,14 @@ HTTPDownloader::HTTPDownloader(
     mDisconnecting(false) {
 }
 
+HTTPDownloader::HTTPDownloader(
+        const sp<HTTPBase> &httpDataSource,
+        const KeyedVector<String8, String8> &headers) :
+    mHTTPDataSource(httpDataSource),
+    mExtraHeaders(headers),
+    mDisconnecting(false) {
+}
+
 void HTTPDownloader::reconnect() {
     AutoMutex _l(mLock);
     mDisconnecting = false;
@@ -218,8 +226,10 @@ ssize_t HTTPDownloader::fetchBlock(
 }
 
 ssize_t HTTPDownloader::fetchFile(
-        const char *url, sp<ABuffer> *out, String8 *actualUrl) {
-    ssize_t err = fetchBlock(url, out, 0, -1, 0, actualUrl, true /* reconnect */);
+        const char *url, sp<ABuffer> *out, String8 *actualUrl,
+        int64_t range_offset, int64_t range_length) {
+    ssize_t err = fetchBlock(
+            url, out, range_offset, range_length, 0, actualUrl, true /* reconnect */);
 
     // close off the connection after use
     mHTTPDataSource->disconnect();
@@ -228,7 +238,8 @@ ssize_t HTTPDownloader::fetchFile(
 }
 
 sp<M3UParser> HTTPDownloader::fetchPlaylist(
-        const char *url, uint8_t *curPlaylistHash, bool *unchanged) {
+        const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+        const sp<M3UParser> &previous) {
     ALOGV("fetchPlaylist '%s'", url);
 
     *unchanged = false;
@@ -264,8 +275,13 @@ sp<M3UParser> HTTPDownloader::fetchPlaylist(
     }
 #endif
 
-    sp<M3UParser> playlist =
-        new M3UParser(actualUrl.string(), buffer->data(), buffer->size());
+    sp<M3UParser> playlist;
+    if (previous != NULL
+            && previous->update(actualUrl.string(), buffer->data(), buffer->size()) == OK) {
+        playlist = previous;
+    } else {
+        playlist = new M3UParser(actualUrl.string(), buffer->data(), buffer->size());
+    }
 
     if (playlist->initCheck() != OK) {
         ALOGE("failed to parse .m3u8 playlist");
@@ -36,6 +36,11 @@ struct HTTPDownloader : public RefBase {
             const sp<MediaHTTPService> &httpService,
             const KeyedVector<String8, String8> &headers);
 
+    // downloads through the given source, e.g. a stand-in for tests
+    HTTPDownloader(
+            const sp<HTTPBase> &httpDataSource,
+            const KeyedVector<String8, String8> &headers);
+
     void reconnect();
     void disconnect();
     bool isDisconnecting();
@@ -60,15 +65,19 @@ struct HTTPDownloader : public RefBase {
             bool reconnect        /* force connect http */
             );
 
-    // simplified version to fetch a single file
+    // simplified version to fetch a single file, or a range of it
     ssize_t fetchFile(
             const char *url,
             sp<ABuffer> *out,
-            String8 *actualUrl = NULL);
+            String8 *actualUrl = NULL,
+            int64_t range_offset = 0,
+            int64_t range_length = -1);
 
-    // fetch a playlist file
+    // fetch a playlist file; if |previous| is the last version of a live
+    // playlist, it is updated with the new one and returned
     sp<M3UParser> fetchPlaylist(
-            const char *url, uint8_t *curPlaylistHash, bool *unchanged);
+            const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+            const sp<M3UParser> &previous = NULL);
 
 private:
     sp<HTTPBase> mHTTPDataSource;
@@ -278,6 +278,7 @@ LiveSession::LiveSession(
     : mNotify(notify),
       mFlags(flags),
       mHTTPService(httpService),
+      mPrefetchDepth(PlaylistFetcher::kDefaultPrefetchDepth),
       mBuffering(false),
       mInPreparationPhase(true),
       mPollBufferingGeneration(0),
@@ -501,6 +502,12 @@ void LiveSession::setBufferingSettings(
     msg->post();
 }
 
+void LiveSession::setPrefetchDepth(int32_t depth) {
+    sp<AMessage> msg = new AMessage(kWhatSetPrefetchDepth, this);
+    msg->setInt32("depth", depth);
+    msg->post();
+}
+
 void LiveSession::connectAsync(
         const char *url, const KeyedVector<String8, String8> *headers) {
     sp<AMessage> msg = new AMessage(kWhatConnect, this);
@@ -632,6 +639,12 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSetPrefetchDepth:
+        {
+            CHECK(msg->findInt32("depth", &mPrefetchDepth));
+            break;
+        }
+
         case kWhatConnect:
         {
             onConnect(msg);
@@ -1174,7 +1187,7 @@ sp<PlaylistFetcher> LiveSession::addFetcher(const char *uri) {
 
     FetcherInfo info;
     info.mFetcher = new PlaylistFetcher(
-            notify, this, uri, mCurBandwidthIndex, mSubtitleGeneration);
+            notify, this, uri, mCurBandwidthIndex, mSubtitleGeneration, mPrefetchDepth);
     info.mDurationUs = -1LL;
     info.mToBeRemoved = false;
     info.mToBeResumed = false;
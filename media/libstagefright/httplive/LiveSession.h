@@ -75,6 +75,11 @@ struct LiveSession : public AHandler {
 
     void setBufferingSettings(const BufferingSettings &buffering);
 
+    // Number of segments each fetcher downloads ahead of the one it parses,
+    // each on its own connection; 0 turns it off. Applies to the fetchers
+    // started afterwards.
+    void setPrefetchDepth(int32_t depth);
+
     int64_t calculateMediaTimeUs(int64_t firstTimeUs, int64_t timeUs, int32_t discontinuitySeq);
     virtual status_t dequeueAccessUnit(StreamType stream, sp<ABuffer> *accessUnit);
 
@@ -132,6 +137,7 @@ protected:
         kWhatChangeConfiguration3       = 'chC3',
         kWhatPollBuffering              = 'poll',
         kWhatSetBufferingSettings       = 'sBuS',
+        kWhatSetPrefetchDepth           = 'sPfD',
     };
 
     // Bandwidth Switch Mark Defaults
@@ -195,6 +201,7 @@ protected:
     sp<AMessage> mNotify;
     uint32_t mFlags;
     sp<MediaHTTPService> mHTTPService;
+    int32_t mPrefetchDepth;     // of the fetchers to come
 
     bool mBuffering;
     bool mInPreparationPhase;
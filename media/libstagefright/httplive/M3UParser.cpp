@@ -261,7 +261,9 @@ M3UParser::M3UParser(
       mTargetDurationUs(-1LL),
       mDiscontinuitySeq(0),
       mDiscontinuityCount(0),
-      mSelectedIndex(-1) {
+      mSelectedIndex(-1),
+      mParsedSize(0),
+      mParsedRangeOffset(0) {
     mInitCheck = parse(data, size);
 }
 
@@ -565,14 +567,165 @@ AString M3UParser::MediaGroup::Media::makeURL(const char *baseURL) const {
     return out;
 }
 
-status_t M3UParser::parse(const void *_data, size_t size) {
-    int32_t lineNo = 0;
+status_t M3UParser::parse(const void *data, size_t size) {
+    status_t err = parseLines((const char *)data, 0, size, &mItems);
+    if (err == OK) {
+        err = finishParse(0);
+    }
+    if (err == OK && !mIsVariantPlaylist && !mIsComplete) {
+        // kept to take updates
+        mData.setTo((const char *)data, size);
+    }
+    return err;
+}
 
-    sp<AMessage> itemMeta;
+// Returns the offset after the |count|-th segment line from |offset| on, or -1.
+static ssize_t findItemEnd(const char *data, size_t size, size_t offset, size_t count) {
+    while (offset < size) {
+        const char *lineEnd = (const char *)memchr(data + offset, '\n', size - offset);
+        if (lineEnd == NULL) {
+            return -1;
+        }
+        size_t offsetLF = lineEnd - data;
+        if (offsetLF > offset && data[offset] != '#' && data[offset] != '\r') {
+            if (--count == 0) {
+                return offsetLF + 1;
+            }
+        }
+        offset = offsetLF + 1;
+    }
+    return -1;
+}
 
+status_t M3UParser::update(const char *baseURI, const void *_data, size_t size) {
     const char *data = (const char *)_data;
-    size_t offset = 0;
-    uint64_t segmentRangeOffset = 0;
+    if (mInitCheck != OK || mIsVariantPlaylist || mIsComplete || mData.empty()
+            || mBaseURI != baseURI) {
+        return INVALID_OPERATION;
+    }
+
+    // Either the segments were only added to the end, or some were also dropped
+    // from the start. Then the header changed, and the segments still there come
+    // after the new first one.
+    size_t resumeOffset;
+    sp<M3UParser> head;
+    int32_t dropped = 0;
+    if (size >= mParsedSize
+            && mData.c_str()[mParsedSize - 1] == '\n'
+            && !memcmp(data, mData.c_str(), mParsedSize)) {
+        resumeOffset = mParsedSize;
+    } else {
+        ssize_t headSize = findItemEnd(data, size, 0, 1);
+        if (headSize < 0) {
+            return ERROR_MALFORMED;
+        }
+        head = new M3UParser(baseURI, data, headSize);
+        if (head->initCheck() != OK || head->isVariantPlaylist()) {
+            return ERROR_MALFORMED;
+        }
+        dropped = head->mFirstSeqNumber - mFirstSeqNumber;
+        if (dropped <= 0 || dropped >= (int32_t)mItems.size()) {
+            return ERROR_MALFORMED;
+        }
+        ssize_t keptOffset = findItemEnd(mData.c_str(), mParsedSize, 0, dropped + 1);
+        if (keptOffset < 0) {
+            return ERROR_MALFORMED;
+        }
+        size_t keptSize = mParsedSize - keptOffset;
+        if (headSize + keptSize > size
+                || memcmp(data + headSize, mData.c_str() + keptOffset, keptSize)) {
+            return ERROR_MALFORMED;
+        }
+        resumeOffset = headSize + keptSize;
+    }
+
+    // restored if the new part does not parse
+    sp<AMessage> meta = mMeta;
+    bool isComplete = mIsComplete;
+    bool isEvent = mIsEvent;
+    size_t discontinuitySeq = mDiscontinuitySeq;
+    int32_t discontinuityCount = mDiscontinuityCount;
+    int32_t firstSeqNumber = mFirstSeqNumber;
+    int32_t lastSeqNumber = mLastSeqNumber;
+    int64_t targetDurationUs = mTargetDurationUs;
+    size_t parsedSize = mParsedSize;
+    uint64_t parsedRangeOffset = mParsedRangeOffset;
+    Vector<Item> items;
+    size_t numItems = mItems.size();
+
+    if (head == NULL) {
+        if (mMeta != NULL) {
+            mMeta = mMeta->dup();
+        }
+    } else {
+        // the segments still there are kept as they are
+        items = mItems;
+        mItems = head->mItems;
+        for (size_t i = dropped + 1; i < items.size(); ++i) {
+            mItems.push(items.itemAt(i));
+        }
+        mMeta = head->mMeta;
+        mIsEvent = head->mIsEvent;
+        mDiscontinuitySeq = head->mDiscontinuitySeq;
+        if (items.size() == (size_t)dropped + 1) {
+            mParsedRangeOffset = head->mParsedRangeOffset;
+        }
+        numItems = mItems.size();
+    }
+
+    // the lines after the last segment are parsed again
+    int32_t seq;
+    CHECK(mItems.top().mMeta->findInt32("discontinuity-sequence", &seq));
+    mDiscontinuityCount = seq - (int32_t)mDiscontinuitySeq;
+
+    mParsedSize = resumeOffset;
+
+    status_t err = OK;
+    if (mDiscontinuityCount < 0) {
+        err = ERROR_MALFORMED;
+    }
+    if (err == OK) {
+        err = parseLines(data, resumeOffset, size, &mItems);
+    }
+    if (err == OK) {
+        err = finishParse(numItems);
+    }
+    if (err != OK) {
+        mMeta = meta;
+        mIsComplete = isComplete;
+        mIsEvent = isEvent;
+        mDiscontinuitySeq = discontinuitySeq;
+        mDiscontinuityCount = discontinuityCount;
+        mFirstSeqNumber = firstSeqNumber;
+        mLastSeqNumber = lastSeqNumber;
+        mTargetDurationUs = targetDurationUs;
+        mParsedSize = parsedSize;
+        mParsedRangeOffset = parsedRangeOffset;
+        if (head == NULL) {
+            mItems.removeItemsAt(numItems, mItems.size() - numItems);
+        } else {
+            mItems = items;
+        }
+        return err;
+    }
+
+    ALOGV("updated playlist: %d segments dropped, %zu added, %zu of %zu bytes parsed",
+            dropped, mItems.size() - numItems, size - resumeOffset, size);
+    if (mIsComplete) {
+        mData.clear();
+    } else {
+        mData.setTo(data, size);
+    }
+    return OK;
+}
+
+status_t M3UParser::parseLines(
+        const char *data, size_t offset, size_t size, Vector<Item> *items) {
+    int32_t lineNo = offset > 0 ? 1 : 0;
+
+    sp<AMessage> itemMeta;
+
+    uint64_t segmentRangeOffset = mParsedRangeOffset;
     while (offset < size) {
         size_t offsetLF = offset;
         while (offsetLF < size && data[offsetLF] != '\n') {
@@ -692,20 +845,28 @@ status_t M3UParser::parse(const void *_data, size_t size) {
                         mDiscontinuitySeq + mDiscontinuityCount);
             }
 
-            mItems.push();
-            Item *item = &mItems.editItemAt(mItems.size() - 1);
+            items->push();
+            Item *item = &items->editItemAt(items->size() - 1);
 
             item->mURI = line;
 
             item->mMeta = itemMeta;
 
             itemMeta.clear();
+
+            // where an update can pick up from
+            mParsedSize = offsetLF < size ? offsetLF + 1 : size;
+            mParsedRangeOffset = segmentRangeOffset;
         }
 
         offset = offsetLF + 1;
         ++lineNo;
     }
 
+    return OK;
+}
+
+status_t M3UParser::finishParse(size_t firstNewItem) {
     // playlist has no item, would cause exception
     if (mItems.size() == 0) {
         ALOGE("playlist has no item");
@@ -731,7 +892,7 @@ status_t M3UParser::parse(const void *_data, size_t size) {
         mLastSeqNumber = mFirstSeqNumber + mItems.size() - 1;
     }
 
-    for (size_t i = 0; i < mItems.size(); ++i) {
+    for (size_t i = firstNewItem; i < mItems.size(); ++i) {
         sp<AMessage> meta = mItems.itemAt(i).mMeta;
         const char *keys[] = {"audio", "video", "subtitles"};
         for (size_t j = 0; j < sizeof(keys) / sizeof(const char *); ++j) {
@@ -42,6 +42,13 @@ struct M3UParser : public RefBase {
 
     sp<AMessage> meta();
 
+    // Takes the next version of a live media playlist. If segments were only
+    // added to the end, and possibly dropped from the start, only the new lines
+    // are parsed and the segments still there are kept. Otherwise returns an
+    // error, with the playlist left as it was, and the new version has to be
+    // parsed from scratch.
+    status_t update(const char *baseURI, const void *data, size_t size);
+
     size_t size();
     bool itemAt(size_t index, AString *uri, sp<AMessage> *meta = NULL);
 
@@ -87,7 +94,15 @@ private:
     // Media groups keyed by group ID.
     KeyedVector<AString, sp<MediaGroup> > mMediaGroups;
 
+    // For updates of live playlists: what was parsed, and where and in which
+    // state parsing stopped after the last segment.
+    AString mData;
+    size_t mParsedSize;
+    uint64_t mParsedRangeOffset;
+
     status_t parse(const void *data, size_t size);
+    status_t parseLines(const char *data, size_t offset, size_t size, Vector<Item> *items);
+    status_t finishParse(size_t firstNewItem);
 
     static status_t parseMetaData(
             const AString &line, sp<AMessage> *meta, const char *key);
@@ -24,6 +24,7 @@
 #include "HTTPDownloader.h"
 #include "LiveSession.h"
 #include "M3UParser.h"
+#include "SegmentPrefetcher.h"
 #include "include/ID3.h"
 #include "mpeg2ts/AnotherPacketSource.h"
 #include "mpeg2ts/HlsSampleDecryptor.h"
@@ -40,6 +41,7 @@
 #include <media/stagefright/MetaDataUtils.h>
 #include <media/stagefright/Utils.h>
 
+
 #include <ctype.h>
 #include <inttypes.h>
 
@@ -54,6 +56,8 @@ const int64_t PlaylistFetcher::kMinBufferedDurationUs = 30000000LL;
 const int64_t PlaylistFetcher::kMaxMonitorDelayUs = 3000000LL;
 // LCM of 188 (size of a TS packet) & 1k works well
 const int32_t PlaylistFetcher::kDownloadBlockSize = 47 * 1024;
+const int32_t PlaylistFetcher::kDefaultPrefetchDepth = 2;
+const size_t PlaylistFetcher::kMaxPrefetchBytes = 16 * 1024 * 1024;
 
 struct PlaylistFetcher::DownloadState : public RefBase {
     DownloadState();
@@ -146,9 +150,12 @@ PlaylistFetcher::PlaylistFetcher(
         const sp<LiveSession> &session,
         const char *uri,
         int32_t id,
-        int32_t subtitleGeneration)
+        int32_t subtitleGeneration,
+        int32_t prefetchDepth)
     : mNotify(notify),
       mSession(session),
+      mPrefetchDepth(prefetchDepth > 0 ? prefetchDepth : 0),
+      mSegmentPrefetcher(createSegmentPrefetcher(session, mPrefetchDepth)),
       mURI(uri),
       mFetcherID(id),
       mStreamTypeMask(0),
@@ -190,6 +197,19 @@ PlaylistFetcher::PlaylistFetcher(
 PlaylistFetcher::~PlaylistFetcher() {
 }
 
+// static
+sp<SegmentPrefetcher> PlaylistFetcher::createSegmentPrefetcher(
+        const sp<LiveSession> &session, int32_t depth) {
+    if (depth <= 0) {
+        return NULL;
+    }
+    Vector<sp<HTTPDownloader> > downloaders;
+    for (int32_t i = 0; i < depth; ++i) {
+        downloaders.push(session->getHTTPDownloader());
+    }
+    return new SegmentPrefetcher(downloaders, kMaxPrefetchBytes);
+}
+
 int32_t PlaylistFetcher::getFetcherID() const {
     return mFetcherID;
 }
@@ -364,16 +384,21 @@ status_t PlaylistFetcher::decryptBuffer(
         keySrc->readAt(0, key->data(), keyLen);
         key->setRange(0, keyLen);
     } else {
-        ssize_t err = mHTTPDownloader->fetchFile(keyURI.c_str(), &key);
+        if (mSegmentPrefetcher != NULL) {
+            key = mSegmentPrefetcher->takeKey(keyURI);
+        }
+        if (key == NULL) {
+            ssize_t err = mHTTPDownloader->fetchFile(keyURI.c_str(), &key);
 
-        if (err == ERROR_NOT_CONNECTED) {
-            return ERROR_NOT_CONNECTED;
-        } else if (err < 0) {
-            ALOGE("failed to fetch cipher key from '%s'.", uriDebugString(keyURI).c_str());
-            return ERROR_IO;
-        } else if (key->size() != 16) {
-            ALOGE("key file '%s' wasn't 16 bytes in size.", uriDebugString(keyURI).c_str());
-            return ERROR_MALFORMED;
+            if (err == ERROR_NOT_CONNECTED) {
+                return ERROR_NOT_CONNECTED;
+            } else if (err < 0) {
+                ALOGE("failed to fetch cipher key from '%s'.", uriDebugString(keyURI).c_str());
+                return ERROR_IO;
+            } else if (key->size() != 16) {
+                ALOGE("key file '%s' wasn't 16 bytes in size.", uriDebugString(keyURI).c_str());
+                return ERROR_MALFORMED;
+            }
         }
 
         mAESKeyForURI.add(keyURI, key);
@@ -475,6 +500,60 @@ status_t PlaylistFetcher::decryptBuffer(
     return OK;
 }
 
+bool PlaylistFetcher::getKeyURI(size_t playlistIndex, AString *keyURI) {
+    for (ssize_t i = playlistIndex; i >= 0; --i) {
+        AString uri;
+        sp<AMessage> itemMeta;
+        AString method;
+        CHECK(mPlaylist->itemAt(i, &uri, &itemMeta));
+
+        if (itemMeta->findString("cipher-method", &method)) {
+            return (method == "AES-128" || method == "SAMPLE-AES")
+                    && itemMeta->findString("cipher-uri", keyURI)
+                    && !keyURI->startsWith("data:");
+        }
+    }
+    return false;
+}
+
+void PlaylistFetcher::prefetchSegments(
+        int32_t firstSeqNumberInPlaylist,
+        int32_t lastSeqNumberInPlaylist) {
+    // subtitle segments are too small to be worth it
+    if (mSegmentPrefetcher == NULL || mPlaylist == NULL
+            || !(mStreamTypeMask
+                    & (LiveSession::STREAMTYPE_AUDIO | LiveSession::STREAMTYPE_VIDEO))) {
+        return;
+    }
+
+    int32_t lastSeqNumber = mSeqNumber + mPrefetchDepth;
+    if (lastSeqNumber > lastSeqNumberInPlaylist) {
+        lastSeqNumber = lastSeqNumberInPlaylist;
+    }
+    for (int32_t seqNumber = mSeqNumber + 1; seqNumber <= lastSeqNumber; ++seqNumber) {
+        size_t playlistIndex = seqNumber - firstSeqNumberInPlaylist;
+        AString uri;
+        sp<AMessage> itemMeta;
+        if (!mPlaylist->itemAt(playlistIndex, &uri, &itemMeta)) {
+            break;
+        }
+
+        int64_t rangeOffset, rangeLength;
+        if (!itemMeta->findInt64("range-offset", &rangeOffset)
+                || !itemMeta->findInt64("range-length", &rangeLength)) {
+            rangeOffset = 0;
+            rangeLength = -1;
+        }
+
+        AString keyURI;
+        if (!getKeyURI(playlistIndex, &keyURI) || mAESKeyForURI.indexOfKey(keyURI) >= 0) {
+            keyURI.clear();
+        }
+
+        mSegmentPrefetcher->prefetch(seqNumber, uri, rangeOffset, rangeLength, keyURI);
+    }
+}
+
 status_t PlaylistFetcher::checkDecryptPadding(const sp<ABuffer> &buffer) {
     AString method;
     CHECK(buffer->meta()->findString("cipher-method", &method));
@@ -526,6 +605,9 @@ void PlaylistFetcher::setStoppingThreshold(float thresholdRatio, bool disconnect
     }
     if (disconnect) {
         mHTTPDownloader->disconnect();
+        if (mSegmentPrefetcher != NULL) {
+            mSegmentPrefetcher->disconnect();
+        }
     }
 }
 
@@ -540,6 +622,13 @@ void PlaylistFetcher::resetStoppingThreshold(bool disconnect) {
         // allow reconnect
         mHTTPDownloader->reconnect();
     }
+    if (mSegmentPrefetcher != NULL) {
+        if (disconnect) {
+            mSegmentPrefetcher->disconnect();
+        } else {
+            mSegmentPrefetcher->reconnect();
+        }
+    }
 }
 
 float PlaylistFetcher::getStoppingThreshold() {
@@ -782,6 +871,9 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
         mSeqNumber = -1;
         mTimeChangeSignaled = false;
         mDownloadState->resetState();
+        if (mSegmentPrefetcher != NULL) {
+            mSegmentPrefetcher->clear();
+        }
     }
 
     postMonitorQueue();
@@ -812,6 +904,10 @@ void PlaylistFetcher::onStop(const sp<AMessage> &msg) {
     mPacketSources.clear();
     mStreamTypeMask = 0;
 
+    if (mSegmentPrefetcher != NULL) {
+        mSegmentPrefetcher->clear();
+    }
+
     resetStoppingThreshold(true /* disconnect */);
 }
 
@@ -940,7 +1036,7 @@ status_t PlaylistFetcher::refreshPlaylist() {
     if (delayUsToRefreshPlaylist() <= 0) {
         bool unchanged;
         sp<M3UParser> playlist = mHTTPDownloader->fetchPlaylist(
-                mURI.c_str(), mPlaylistHash, &unchanged);
+                mURI.c_str(), mPlaylistHash, &unchanged, mPlaylist);
 
         if (playlist == NULL) {
             if (unchanged) {
@@ -1342,6 +1438,11 @@ void PlaylistFetcher::onDownloadNext() {
     int32_t lastSeqNumberInPlaylist = 0;
     bool connectHTTP = true;
 
+    // A prefetched segment is downloaded whole, so it is handled as one block.
+    sp<ABuffer> prefetched;
+    int64_t prefetchDelayUs = 0;
+    int32_t fromPrefetch = 0;
+
     if (mDownloadState->hasSavedState()) {
         mDownloadState->restoreState(
                 uri,
@@ -1351,6 +1452,9 @@ void PlaylistFetcher::onDownloadNext() {
                 firstSeqNumberInPlaylist,
                 lastSeqNumberInPlaylist);
         connectHTTP = false;
+        if (buffer != NULL) {
+            buffer->meta()->findInt32("prefetched", &fromPrefetch);
+        }
         FLOGV("resuming: '%s'", uri.c_str());
     } else {
         if (!initDownloadState(
@@ -1361,6 +1465,19 @@ void PlaylistFetcher::onDownloadNext() {
             return;
         }
         FLOGV("fetching: '%s'", uri.c_str());
+
+        if (mSegmentPrefetcher != NULL) {
+            status_t err = mSegmentPrefetcher->take(
+                    mSeqNumber, uri, &prefetched, &prefetchDelayUs);
+            if (err == OK) {
+                fromPrefetch = 1;
+                prefetched->meta()->setInt32("prefetched", 1);
+            } else if (err != -ENOENT) {
+                FLOGV("prefetching segment %d failed (%d), fetching it again", mSeqNumber, err);
+            }
+        }
+        // the next ones download while this one is parsed
+        prefetchSegments(firstSeqNumberInPlaylist, lastSeqNumberInPlaylist);
     }
 
     int64_t range_offset, range_length;
@@ -1375,11 +1492,29 @@ void PlaylistFetcher::onDownloadNext() {
     ssize_t bytesRead;
     mLastIDRTimeUs = -1;
     do {
-        int64_t startUs = ALooper::GetNowUs();
-        bytesRead = mHTTPDownloader->fetchBlock(
-                uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize,
-                NULL /* actualURL */, connectHTTP);
-        int64_t delayUs = ALooper::GetNowUs() - startUs;
+        int64_t delayUs;
+        if (fromPrefetch) {
+            bytesRead = 0;
+            delayUs = prefetchDelayUs;
+            if (prefetched != NULL) {
+                buffer = prefetched;
+                bytesRead = buffer->size();
+                prefetched.clear();
+            }
+        } else {
+            // overlaps with the transfers of the prefetcher, if any
+            if (mSegmentPrefetcher != NULL) {
+                mSegmentPrefetcher->beginTransfer();
+            }
+            int64_t startUs = ALooper::GetNowUs();
+            bytesRead = mHTTPDownloader->fetchBlock(
+                    uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize,
+                    NULL /* actualURL */, connectHTTP);
+            delayUs = ALooper::GetNowUs() - startUs;
+            if (mSegmentPrefetcher != NULL) {
+                delayUs = mSegmentPrefetcher->endTransfer();
+            }
+        }
 
         if (bytesRead == ERROR_NOT_CONNECTED) {
             return;
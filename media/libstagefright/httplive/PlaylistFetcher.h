@@ -32,6 +32,7 @@ class DataSource;
 struct HTTPBase;
 struct LiveDataSource;
 struct M3UParser;
+struct SegmentPrefetcher;
 class String8;
 
 struct PlaylistFetcher : public AHandler {
@@ -54,12 +55,15 @@ struct PlaylistFetcher : public AHandler {
         kWhatMetadataDetected,
     };
 
+    static const int32_t kDefaultPrefetchDepth;
+
     PlaylistFetcher(
             const sp<AMessage> &notify,
             const sp<LiveSession> &session,
             const char *uri,
             int32_t id,
-            int32_t subtitleGeneration);
+            int32_t subtitleGeneration,
+            int32_t prefetchDepth = kDefaultPrefetchDepth);
 
     int32_t getFetcherID() const;
 
@@ -108,7 +112,10 @@ protected:
 
     static const int64_t kMaxMonitorDelayUs;
     static const int32_t kNumSkipFrames;
+    static const size_t kMaxPrefetchBytes;
 
+    static sp<SegmentPrefetcher> createSegmentPrefetcher(
+            const sp<LiveSession> &session, int32_t depth);
     static bool bufferStartsWithTsSyncByte(const sp<ABuffer>& buffer);
     static bool bufferStartsWithWebVTTMagicSequence(const sp<ABuffer>& buffer);
 
@@ -118,6 +125,11 @@ protected:
 
     sp<HTTPDownloader> mHTTPDownloader;
     sp<LiveSession> mSession;
+
+    // Segments after the current one being downloaded, if the depth is not 0.
+    // Set up front, as LiveSession disconnects it from its own thread.
+    const int32_t mPrefetchDepth;
+    const sp<SegmentPrefetcher> mSegmentPrefetcher;
     AString mURI;
 
     int32_t mFetcherID;
@@ -204,6 +216,12 @@ protected:
             bool first = true);
     status_t checkDecryptPadding(const sp<ABuffer> &buffer);
 
+    // Returns the uri of the key of the segment, if it has one to download.
+    bool getKeyURI(size_t playlistIndex, AString *keyURI);
+    void prefetchSegments(
+            int32_t firstSeqNumberInPlaylist,
+            int32_t lastSeqNumberInPlaylist);
+
     void postMonitorQueue(int64_t delayUs = 0, int64_t minDelayUs = 0);
     void cancelMonitorQueue();
     void setStoppingThreshold(float thresholdRatio, bool disconnect);
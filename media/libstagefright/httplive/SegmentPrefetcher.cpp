@@ -0,0 +1,298 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SegmentPrefetcher"
+#include <utils/Log.h>
+
+#include "SegmentPrefetcher.h"
+#include "HTTPDownloader.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaErrors.h>
+
+namespace android {
+
+struct SegmentPrefetcher::Entry : public RefBase {
+    int32_t mSeqNumber;
+    AString mURI;
+    int64_t mRangeOffset;
+    int64_t mRangeLength;
+    AString mKeyURI;
+
+    bool mDone;
+    status_t mStatus;
+    sp<ABuffer> mBuffer;
+    int64_t mDelayUs;
+};
+
+// Downloads one segment at a time on its own looper and connection.
+struct SegmentPrefetcher::Worker : public AHandler {
+    enum {
+        kWhatFetch = 'ftch',
+    };
+
+    Worker(const wp<SegmentPrefetcher> &owner, size_t index,
+            const sp<HTTPDownloader> &downloader)
+        : mOwner(owner),
+          mIndex(index),
+          mDownloader(downloader),
+          mLooper(new ALooper) {
+    }
+
+    const wp<SegmentPrefetcher> mOwner;
+    const size_t mIndex;
+    const sp<HTTPDownloader> mDownloader;
+    const sp<ALooper> mLooper;
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        CHECK_EQ(msg->what(), (uint32_t)kWhatFetch);
+        sp<RefBase> obj;
+        CHECK(msg->findObject("entry", &obj));
+        sp<SegmentPrefetcher> owner = mOwner.promote();
+        if (owner != NULL) {
+            owner->onFetch(mIndex, static_cast<Entry *>(obj.get()));
+        }
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(Worker);
+};
+
+SegmentPrefetcher::SegmentPrefetcher(
+        const Vector<sp<HTTPDownloader> > &downloaders, size_t maxBytes)
+    : mMaxBytes(maxBytes),
+      mBufferedBytes(0),
+      mNumTransfers(0),
+      mBusyUs(0),
+      mChargedUs(0),
+      mLastTransferChangeUs(0) {
+    for (size_t i = 0; i < downloaders.size(); ++i) {
+        sp<Worker> worker = new Worker(this, i, downloaders[i]);
+        worker->mLooper->setName("SegmentPrefetcher");
+        worker->mLooper->start();
+        worker->mLooper->registerHandler(worker);
+        mWorkers.push(worker);
+        mIdleWorkers.push(i);
+    }
+}
+
+SegmentPrefetcher::~SegmentPrefetcher() {
+    disconnect();
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->mLooper->unregisterHandler(mWorkers[i]->id());
+        mWorkers[i]->mLooper->stop();
+    }
+}
+
+bool SegmentPrefetcher::prefetch(
+        int32_t seqNumber,
+        const AString &uri,
+        int64_t rangeOffset,
+        int64_t rangeLength,
+        const AString &keyURI) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mEntries.indexOfKey(seqNumber) >= 0
+            || mIdleWorkers.empty()
+            || mBufferedBytes >= mMaxBytes) {
+        return false;
+    }
+
+    sp<Entry> entry = new Entry;
+    entry->mSeqNumber = seqNumber;
+    entry->mURI = uri;
+    entry->mRangeOffset = rangeOffset;
+    entry->mRangeLength = rangeLength;
+    entry->mKeyURI = keyURI;
+    entry->mDone = false;
+    entry->mStatus = OK;
+    entry->mDelayUs = 0;
+    mEntries.add(seqNumber, entry);
+
+    size_t index = mIdleWorkers.top();
+    mIdleWorkers.pop();
+
+    ALOGV("prefetching segment %d on worker %zu", seqNumber, index);
+    sp<AMessage> msg = new AMessage(Worker::kWhatFetch, mWorkers[index]);
+    msg->setObject("entry", entry);
+    msg->post();
+    return true;
+}
+
+void SegmentPrefetcher::onFetch(size_t workerIndex, const sp<Entry> &entry) {
+    const sp<HTTPDownloader> &downloader = mWorkers[workerIndex]->mDownloader;
+
+    beginTransfer();
+
+    sp<ABuffer> key;
+    ssize_t err = OK;
+    if (!entry->mKeyURI.empty()) {
+        err = downloader->fetchFile(entry->mKeyURI.c_str(), &key);
+        if (err < 0 || key->size() != 16) {
+            // leave it to the fetcher, which reports the error
+            key.clear();
+        }
+    }
+
+    sp<ABuffer> buffer;
+    if (err != ERROR_NOT_CONNECTED) {
+        err = downloader->fetchFile(
+                entry->mURI.c_str(), &buffer, NULL /* actualUrl */,
+                entry->mRangeOffset, entry->mRangeLength);
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    entry->mDelayUs = endTransfer_l();
+    entry->mDone = true;
+    entry->mStatus = err < 0 ? (status_t)err : OK;
+
+    ssize_t index = mEntries.indexOfKey(entry->mSeqNumber);
+    if (index >= 0 && mEntries.valueAt(index) == entry) {
+        if (entry->mStatus == OK) {
+            entry->mBuffer = buffer;
+            mBufferedBytes += buffer->size();
+        }
+        if (key != NULL && mKeys.indexOfKey(entry->mKeyURI) < 0) {
+            mKeys.add(entry->mKeyURI, key);
+        }
+    }
+    ALOGV("segment %d: %zd after %lld us", entry->mSeqNumber, err, (long long)entry->mDelayUs);
+
+    mIdleWorkers.push(workerIndex);
+    mCondition.broadcast();
+}
+
+status_t SegmentPrefetcher::take(
+        int32_t seqNumber, const AString &uri, sp<ABuffer> *buffer, int64_t *delayUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mEntries.indexOfKey(seqNumber);
+    if (index < 0) {
+        return -ENOENT;
+    }
+    sp<Entry> entry = mEntries.valueAt(index);
+
+    if (entry->mURI == uri) {
+        while (!entry->mDone) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    // not cleared while waiting, and not a segment of another playlist
+    index = mEntries.indexOfKey(seqNumber);
+    bool found = index >= 0 && mEntries.valueAt(index) == entry && entry->mURI == uri;
+
+    // the segments before it are not going to be needed either
+    while (!mEntries.isEmpty() && mEntries.keyAt(0) <= seqNumber) {
+        const sp<Entry> &dropped = mEntries.valueAt(0);
+        if (dropped->mBuffer != NULL) {
+            mBufferedBytes -= dropped->mBuffer->size();
+        }
+        mEntries.removeItemsAt(0);
+    }
+
+    if (!found) {
+        return -ENOENT;
+    }
+    if (entry->mStatus != OK) {
+        return entry->mStatus;
+    }
+
+    *buffer = entry->mBuffer;
+    *delayUs = entry->mDelayUs;
+    entry->mBuffer.clear();
+    return OK;
+}
+
+size_t SegmentPrefetcher::bufferedBytes() const {
+    Mutex::Autolock autoLock(mLock);
+    return mBufferedBytes;
+}
+
+sp<ABuffer> SegmentPrefetcher::takeKey(const AString &keyURI) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mKeys.indexOfKey(keyURI);
+    if (index < 0) {
+        return NULL;
+    }
+    sp<ABuffer> key = mKeys.valueAt(index);
+    mKeys.removeItemsAt(index);
+    return key;
+}
+
+void SegmentPrefetcher::clear() {
+    Mutex::Autolock autoLock(mLock);
+
+    mEntries.clear();
+    mKeys.clear();
+    mBufferedBytes = 0;
+    mCondition.broadcast();
+}
+
+void SegmentPrefetcher::disconnect() {
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->mDownloader->disconnect();
+    }
+}
+
+void SegmentPrefetcher::reconnect() {
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->mDownloader->reconnect();
+    }
+}
+
+void SegmentPrefetcher::beginTransfer() {
+    Mutex::Autolock autoLock(mLock);
+    beginTransfer_l();
+}
+
+int64_t SegmentPrefetcher::endTransfer() {
+    Mutex::Autolock autoLock(mLock);
+    return endTransfer_l();
+}
+
+void SegmentPrefetcher::beginTransfer_l() {
+    updateBusyTime_l();
+    ++mNumTransfers;
+}
+
+int64_t SegmentPrefetcher::endTransfer_l() {
+    updateBusyTime_l();
+    CHECK_GT(mNumTransfers, 0);
+    --mNumTransfers;
+
+    int64_t delayUs = mBusyUs - mChargedUs;
+    mChargedUs = mBusyUs;
+    return delayUs;
+}
+
+void SegmentPrefetcher::updateBusyTime_l() {
+    int64_t nowUs = ALooper::GetNowUs();
+    if (mNumTransfers > 0) {
+        mBusyUs += nowUs - mLastTransferChangeUs;
+    }
+    mLastTransferChangeUs = nowUs;
+}
+
+}  // namespace android
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEGMENT_PREFETCHER_H_
+
+#define SEGMENT_PREFETCHER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Condition.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+struct HTTPDownloader;
+
+// Downloads the media segments after the one being parsed, each on its own
+// connection, so that a fetcher has several requests in flight instead of one.
+// The keys of encrypted segments are fetched along with them.
+//
+// There are as many requests in flight as there are downloaders, and segments
+// that are done are kept until taken, up to a number of bytes.
+struct SegmentPrefetcher : public RefBase {
+    SegmentPrefetcher(const Vector<sp<HTTPDownloader> > &downloaders, size_t maxBytes);
+
+    size_t depth() const {
+        return mWorkers.size();
+    }
+
+    // Starts downloading segment |seqNumber| from |uri|, and its key from
+    // |keyURI| unless empty. Returns false if the segment was already
+    // requested, or there is no room for it.
+    bool prefetch(
+            int32_t seqNumber,
+            const AString &uri,
+            int64_t rangeOffset,
+            int64_t rangeLength,
+            const AString &keyURI);
+
+    // Takes segment |seqNumber|, waiting for it if it is still downloading, and
+    // drops the segments before it. |delayUs| is the transfer time charged to it.
+    // Returns -ENOENT if it was not prefetched from |uri|, otherwise the status of
+    // the download.
+    status_t take(
+            int32_t seqNumber, const AString &uri, sp<ABuffer> *buffer, int64_t *delayUs);
+
+    // Bytes of the segments that are done and not taken yet.
+    size_t bufferedBytes() const;
+
+    // Takes a key fetched along with a segment, or NULL.
+    sp<ABuffer> takeKey(const AString &keyURI);
+
+    // Drops all segments; the ones in flight are dropped when done.
+    void clear();
+
+    void disconnect();
+    void reconnect();
+
+    // Transfers of the fetcher itself, so that they are accounted for along with
+    // the ones of the prefetcher. The time charged to a transfer is the time
+    // during which any transfer was running since the previous one ended; the
+    // charged times add up to the time spent downloading, and bytes over time
+    // give the throughput of all the connections together.
+    void beginTransfer();
+    int64_t endTransfer();
+
+private:
+    struct Entry;
+    struct Worker;
+
+    mutable Mutex mLock;
+    Condition mCondition;
+
+    Vector<sp<Worker> > mWorkers;
+    Vector<size_t> mIdleWorkers;
+    const size_t mMaxBytes;
+    size_t mBufferedBytes;
+    KeyedVector<int32_t, sp<Entry> > mEntries;
+    KeyedVector<AString, sp<ABuffer> > mKeys;
+
+    int32_t mNumTransfers;
+    int64_t mBusyUs;
+    int64_t mChargedUs;
+    int64_t mLastTransferChangeUs;
+
+    virtual ~SegmentPrefetcher();
+
+    void onFetch(size_t workerIndex, const sp<Entry> &entry);
+
+    void beginTransfer_l();
+    int64_t endTransfer_l();
+    void updateBusyTime_l();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SegmentPrefetcher);
+};
+
+}  // namespace android
+
+#endif  // SEGMENT_PREFETCHER_H_
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "M3UParser_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaErrors.h>
+
+#include "M3UParser.h"
+
+namespace android {
+
+static const char *kBaseURI = "http://localhost/live.m3u8";
+static const int32_t kNumRefreshes = 2000;
+
+// A live playlist as a server would serve it: one segment more on every
+// refresh, with a discontinuity now and then, and the oldest segments dropped
+// once there are |window| of them, unless 0.
+struct LivePlaylist {
+    explicit LivePlaylist(size_t window, bool event = false)
+        : mWindow(window), mEvent(event), mFirstSeq(0), mNumSegments(0) {}
+
+    void addSegment() {
+        ++mNumSegments;
+        if (mWindow > 0 && mNumSegments > mWindow) {
+            ++mFirstSeq;
+            --mNumSegments;
+        }
+    }
+
+    AString text(bool complete = false) const {
+        AString s("#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:6\n");
+        if (mEvent) {
+            s.append("#EXT-X-PLAYLIST-TYPE:EVENT\n");
+        }
+        s.append(AStringPrintf("#EXT-X-MEDIA-SEQUENCE:%d\n", mFirstSeq));
+        // the discontinuities before the first segment
+        s.append(AStringPrintf("#EXT-X-DISCONTINUITY-SEQUENCE:%d\n",
+                mFirstSeq > 0 ? (mFirstSeq - 1) / 50 : 0));
+        for (int32_t seq = mFirstSeq; seq < mFirstSeq + (int32_t)mNumSegments; ++seq) {
+            if (seq > 0 && seq % 50 == 0) {
+                s.append("#EXT-X-DISCONTINUITY\n");
+            }
+            s.append(AStringPrintf(
+                    "#EXTINF:6.006,\nhttp://localhost/segment%d.ts\n", seq));
+        }
+        if (complete) {
+            s.append("#EXT-X-ENDLIST\n");
+        }
+        return s;
+    }
+
+private:
+    const size_t mWindow;
+    const bool mEvent;
+    int32_t mFirstSeq;
+    size_t mNumSegments;
+};
+
+class M3UParserTest : public ::testing::Test {
+protected:
+    void expectSame(const sp<M3UParser> &expected, const sp<M3UParser> &actual) {
+        ASSERT_EQ(OK, expected->initCheck());
+        ASSERT_EQ(expected->size(), actual->size());
+        EXPECT_EQ(expected->isComplete(), actual->isComplete());
+        EXPECT_EQ(expected->isEvent(), actual->isEvent());
+        EXPECT_EQ(expected->getTargetDuration(), actual->getTargetDuration());
+        EXPECT_EQ(expected->getDiscontinuitySeq(), actual->getDiscontinuitySeq());
+
+        int32_t expectedFirst, expectedLast, actualFirst, actualLast;
+        expected->getSeqNumberRange(&expectedFirst, &expectedLast);
+        actual->getSeqNumberRange(&actualFirst, &actualLast);
+        EXPECT_EQ(expectedFirst, actualFirst);
+        EXPECT_EQ(expectedLast, actualLast);
+
+        for (size_t i = 0; i < expected->size(); ++i) {
+            AString expectedURI, actualURI;
+            sp<AMessage> expectedMeta, actualMeta;
+            ASSERT_TRUE(expected->itemAt(i, &expectedURI, &expectedMeta));
+            ASSERT_TRUE(actual->itemAt(i, &actualURI, &actualMeta));
+            EXPECT_EQ(expectedURI, actualURI) << "item " << i;
+
+            int64_t expectedDurationUs, actualDurationUs;
+            ASSERT_TRUE(expectedMeta->findInt64("durationUs", &expectedDurationUs));
+            ASSERT_TRUE(actualMeta->findInt64("durationUs", &actualDurationUs));
+            EXPECT_EQ(expectedDurationUs, actualDurationUs) << "item " << i;
+
+            int32_t expectedSeq, actualSeq;
+            ASSERT_TRUE(expectedMeta->findInt32("discontinuity-sequence", &expectedSeq));
+            ASSERT_TRUE(actualMeta->findInt32("discontinuity-sequence", &actualSeq));
+            EXPECT_EQ(expectedSeq, actualSeq) << "item " << i;
+
+            int32_t discontinuity;
+            EXPECT_EQ(expectedMeta->findInt32("discontinuity", &discontinuity),
+                    actualMeta->findInt32("discontinuity", &discontinuity)) << "item " << i;
+        }
+    }
+
+    // Refreshes |server| kNumRefreshes times, updating one parser and parsing
+    // each version from scratch as well. Returns the time either took in total
+    // over the last quarter of the refreshes.
+    void refresh(LivePlaylist *server, int64_t *fullUs, int64_t *incrementalUs) {
+        server->addSegment();
+        AString text = server->text();
+        sp<M3UParser> playlist = new M3UParser(kBaseURI, text.c_str(), text.size());
+        ASSERT_EQ(OK, playlist->initCheck());
+
+        *fullUs = 0;
+        *incrementalUs = 0;
+        for (int32_t i = 0; i < kNumRefreshes; ++i) {
+            server->addSegment();
+            text = server->text();
+
+            int64_t startUs = ALooper::GetNowUs();
+            sp<M3UParser> parsed = new M3UParser(kBaseURI, text.c_str(), text.size());
+            int64_t parsedUs = ALooper::GetNowUs();
+            ASSERT_EQ(OK, playlist->update(kBaseURI, text.c_str(), text.size()));
+            int64_t updatedUs = ALooper::GetNowUs();
+
+            if (i >= kNumRefreshes * 3 / 4) {
+                *fullUs += parsedUs - startUs;
+                *incrementalUs += updatedUs - parsedUs;
+            }
+            if (i % 100 == 0 || i == kNumRefreshes - 1) {
+                ASSERT_NO_FATAL_FAILURE(expectSame(parsed, playlist));
+            }
+        }
+
+        ALOGI("%zu segments: %lld us to parse, %lld us to update, over %d refreshes",
+                playlist->size(), (long long)*fullUs, (long long)*incrementalUs,
+                kNumRefreshes / 4);
+    }
+};
+
+TEST_F(M3UParserTest, UpdatesGrowingEventPlaylist) {
+    LivePlaylist server(0 /* window */, true /* event */);
+    int64_t fullUs, incrementalUs;
+    ASSERT_NO_FATAL_FAILURE(refresh(&server, &fullUs, &incrementalUs));
+
+    // the new segment only, instead of thousands of them
+    EXPECT_LT(incrementalUs * 10, fullUs);
+}
+
+TEST_F(M3UParserTest, UpdatesSlidingWindowPlaylist) {
+    LivePlaylist server(300 /* window */);
+    int64_t fullUs, incrementalUs;
+    ASSERT_NO_FATAL_FAILURE(refresh(&server, &fullUs, &incrementalUs));
+
+    EXPECT_LT(incrementalUs, fullUs);
+}
+
+TEST_F(M3UParserTest, UpdateEndsPlaylist) {
+    LivePlaylist server(0 /* window */, true /* event */);
+    server.addSegment();
+    AString text = server.text();
+    sp<M3UParser> playlist = new M3UParser(kBaseURI, text.c_str(), text.size());
+    ASSERT_EQ(OK, playlist->initCheck());
+
+    server.addSegment();
+    text = server.text(true /* complete */);
+    ASSERT_EQ(OK, playlist->update(kBaseURI, text.c_str(), text.size()));
+    EXPECT_TRUE(playlist->isComplete());
+    EXPECT_EQ(2u, playlist->size());
+
+    // nothing more to update once complete
+    EXPECT_NE(OK, playlist->update(kBaseURI, text.c_str(), text.size()));
+}
+
+TEST_F(M3UParserTest, RejectsUnrelatedPlaylist) {
+    LivePlaylist server(10 /* window */);
+    for (int32_t i = 0; i < 5; ++i) {
+        server.addSegment();
+    }
+    AString text = server.text();
+    sp<M3UParser> playlist = new M3UParser(kBaseURI, text.c_str(), text.size());
+    ASSERT_EQ(OK, playlist->initCheck());
+
+    AString other(
+            "#EXTM3U\n#EXT-X-TARGETDURATION:4\n#EXT-X-MEDIA-SEQUENCE:2\n"
+            "#EXTINF:4,\nhttp://localhost/other2.ts\n"
+            "#EXTINF:4,\nhttp://localhost/other3.ts\n");
+    EXPECT_NE(OK, playlist->update(kBaseURI, other.c_str(), other.size()));
+    EXPECT_NE(OK, playlist->update("http://localhost/other.m3u8", text.c_str(), text.size()));
+
+    // left as it was
+    sp<M3UParser> parsed = new M3UParser(kBaseURI, text.c_str(), text.size());
+    expectSame(parsed, playlist);
+}
+
+}  // namespace android
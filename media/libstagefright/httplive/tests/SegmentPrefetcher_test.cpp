@@ -0,0 +1,284 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "SegmentPrefetcher_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaErrors.h>
+#include <utils/Condition.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+
+#include "include/HTTPBase.h"
+#include "HTTPDownloader.h"
+#include "SegmentPrefetcher.h"
+
+#include <algorithm>
+
+#include <unistd.h>
+
+namespace android {
+
+static const int64_t kRoundTripUs = 10000ll;    // 10ms per request
+static const size_t kSegmentSize = 64 * 1024;
+static const int32_t kDepth = 3;
+
+// How long a test waits for something that should happen right away.
+static const int64_t kTimeoutUs = 5000000ll;
+
+// Stands in for an http server with a round trip. Every request waits for it,
+// and the number of requests in flight at once is recorded. Requests can also
+// be held until a number of them are in flight, so that whether they overlap
+// does not depend on how long they take.
+struct FakeServer : public RefBase {
+    FakeServer() : mActive(0), mMaxActive(0), mHoldUntilActive(0) {}
+
+    sp<ABuffer> contentFor(const char *uri) {
+        AString path(uri);
+        sp<ABuffer> content = new ABuffer(path.endsWith(".key") ? 16 : kSegmentSize);
+        for (size_t i = 0; i < content->size(); ++i) {
+            content->data()[i] = (path.hash() + i) & 0xff;
+        }
+        return content;
+    }
+
+    void beginRequest() {
+        {
+            Mutex::Autolock autoLock(mLock);
+            if (++mActive > mMaxActive) {
+                mMaxActive = mActive;
+            }
+            if (mActive >= mHoldUntilActive) {
+                mHoldUntilActive = 0;
+                mCondition.broadcast();
+            }
+            while (mHoldUntilActive > 0) {
+                if (mCondition.waitRelative(mLock, kTimeoutUs * 1000ll) != OK) {
+                    // the test sees that the requests did not overlap
+                    mHoldUntilActive = 0;
+                }
+            }
+        }
+        usleep(kRoundTripUs);
+        Mutex::Autolock autoLock(mLock);
+        --mActive;
+    }
+
+    // Holds requests until |count| of them are in flight.
+    void holdUntilActive(int32_t count) {
+        Mutex::Autolock autoLock(mLock);
+        mHoldUntilActive = count;
+    }
+
+    int32_t maxActive() {
+        Mutex::Autolock autoLock(mLock);
+        return mMaxActive;
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    int32_t mActive;
+    int32_t mMaxActive;
+    int32_t mHoldUntilActive;
+};
+
+struct FakeConnection : public HTTPBase {
+    explicit FakeConnection(const sp<FakeServer> &server) : mServer(server) {}
+
+    virtual status_t connect(
+            const char *uri,
+            const KeyedVector<String8, String8> * /* headers */,
+            off64_t /* offset */) {
+        mServer->beginRequest();
+        mContent = mServer->contentFor(uri);
+        return OK;
+    }
+
+    virtual void disconnect() {}
+
+    virtual status_t initCheck() const {
+        return OK;
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        if (mContent == NULL || offset >= (off64_t)mContent->size()) {
+            return 0;
+        }
+        size = std::min(size, (size_t)(mContent->size() - offset));
+        memcpy(data, mContent->data() + offset, size);
+        return size;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        if (mContent == NULL) {
+            return ERROR_UNSUPPORTED;
+        }
+        *size = mContent->size();
+        return OK;
+    }
+
+private:
+    sp<FakeServer> mServer;
+    sp<ABuffer> mContent;
+};
+
+class SegmentPrefetcherTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        mServer = new FakeServer;
+    }
+
+    sp<SegmentPrefetcher> createPrefetcher(size_t maxBytes = 16 * kSegmentSize) {
+        Vector<sp<HTTPDownloader> > downloaders;
+        for (int32_t i = 0; i < kDepth; ++i) {
+            downloaders.push(new HTTPDownloader(
+                    new FakeConnection(mServer), KeyedVector<String8, String8>()));
+        }
+        return new SegmentPrefetcher(downloaders, maxBytes);
+    }
+
+    static AString segmentURI(int32_t seqNumber) {
+        return AStringPrintf("http://localhost/segment%d.ts", seqNumber);
+    }
+
+    void expectContent(const char *uri, const sp<ABuffer> &buffer) {
+        sp<ABuffer> expected = mServer->contentFor(uri);
+        ASSERT_TRUE(buffer != NULL);
+        ASSERT_EQ(expected->size(), buffer->size());
+        EXPECT_EQ(0, memcmp(expected->data(), buffer->data(), buffer->size()));
+    }
+
+    sp<FakeServer> mServer;
+};
+
+TEST_F(SegmentPrefetcherTest, FetchesSegmentsConcurrently) {
+    sp<SegmentPrefetcher> prefetcher = createPrefetcher();
+    mServer->holdUntilActive(kDepth);
+
+    int64_t startUs = ALooper::GetNowUs();
+    for (int32_t i = 0; i < kDepth; ++i) {
+        EXPECT_TRUE(prefetcher->prefetch(i, segmentURI(i), 0, -1, AString()));
+    }
+    // one per downloader
+    EXPECT_FALSE(prefetcher->prefetch(kDepth, segmentURI(kDepth), 0, -1, AString()));
+
+    int64_t totalDelayUs = 0;
+    for (int32_t i = 0; i < kDepth; ++i) {
+        sp<ABuffer> buffer;
+        int64_t delayUs;
+        ASSERT_EQ(OK, prefetcher->take(i, segmentURI(i), &buffer, &delayUs));
+        expectContent(segmentURI(i).c_str(), buffer);
+        totalDelayUs += delayUs;
+    }
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+    ALOGI("%d segments in %lld us, charged %lld us",
+            kDepth, (long long)elapsedUs, (long long)totalDelayUs);
+
+    EXPECT_EQ(kDepth, mServer->maxActive());
+
+    // the overlapping transfers are charged the time they took together, not
+    // each the time it took
+    EXPECT_GE(totalDelayUs, kRoundTripUs);
+    EXPECT_LE(totalDelayUs, elapsedUs);
+}
+
+TEST_F(SegmentPrefetcherTest, OverlapsTransfersOfTheFetcher) {
+    sp<SegmentPrefetcher> prefetcher = createPrefetcher();
+    mServer->holdUntilActive(2);
+
+    int64_t startUs = ALooper::GetNowUs();
+    ASSERT_TRUE(prefetcher->prefetch(1, segmentURI(1), 0, -1, AString()));
+
+    // the fetcher downloads segment 0 itself meanwhile
+    sp<HTTPDownloader> downloader = new HTTPDownloader(
+            new FakeConnection(mServer), KeyedVector<String8, String8>());
+    sp<ABuffer> buffer;
+    prefetcher->beginTransfer();
+    ASSERT_EQ((ssize_t)kSegmentSize, downloader->fetchFile(segmentURI(0).c_str(), &buffer));
+    int64_t delayUs = prefetcher->endTransfer();
+
+    int64_t prefetchDelayUs;
+    ASSERT_EQ(OK, prefetcher->take(1, segmentURI(1), &buffer, &prefetchDelayUs));
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+
+    EXPECT_EQ(2, mServer->maxActive());
+    EXPECT_GE(delayUs + prefetchDelayUs, kRoundTripUs);
+    EXPECT_LE(delayUs + prefetchDelayUs, elapsedUs);
+}
+
+TEST_F(SegmentPrefetcherTest, FetchesKeys) {
+    sp<SegmentPrefetcher> prefetcher = createPrefetcher();
+    AString keyURI("http://localhost/segment.key");
+    ASSERT_TRUE(prefetcher->prefetch(0, segmentURI(0), 0, -1, keyURI));
+
+    sp<ABuffer> buffer;
+    int64_t delayUs;
+    ASSERT_EQ(OK, prefetcher->take(0, segmentURI(0), &buffer, &delayUs));
+    expectContent(segmentURI(0).c_str(), buffer);
+
+    sp<ABuffer> key = prefetcher->takeKey(keyURI);
+    expectContent(keyURI.c_str(), key);
+    EXPECT_TRUE(prefetcher->takeKey(keyURI) == NULL);
+}
+
+TEST_F(SegmentPrefetcherTest, KeepsAtMostMaxBytes) {
+    sp<SegmentPrefetcher> prefetcher = createPrefetcher(kSegmentSize);
+    ASSERT_TRUE(prefetcher->prefetch(0, segmentURI(0), 0, -1, AString()));
+    ASSERT_TRUE(prefetcher->prefetch(1, segmentURI(1), 0, -1, AString()));
+
+    sp<ABuffer> buffer;
+    int64_t delayUs;
+    ASSERT_EQ(OK, prefetcher->take(1, segmentURI(1), &buffer, &delayUs));
+    // segment 0 was dropped when segment 1 was taken
+    EXPECT_EQ(-ENOENT, prefetcher->take(0, segmentURI(0), &buffer, &delayUs));
+
+    // once segment 2 is done, there is no room for more
+    ASSERT_TRUE(prefetcher->prefetch(2, segmentURI(2), 0, -1, AString()));
+    for (int64_t waitedUs = 0;
+            prefetcher->bufferedBytes() < kSegmentSize && waitedUs < kTimeoutUs;
+            waitedUs += 1000) {
+        usleep(1000);
+    }
+    ASSERT_EQ(kSegmentSize, prefetcher->bufferedBytes());
+    EXPECT_FALSE(prefetcher->prefetch(3, segmentURI(3), 0, -1, AString()));
+
+    ASSERT_EQ(OK, prefetcher->take(2, segmentURI(2), &buffer, &delayUs));
+    EXPECT_TRUE(prefetcher->prefetch(3, segmentURI(3), 0, -1, AString()));
+}
+
+TEST_F(SegmentPrefetcherTest, IgnoresOtherPlaylists) {
+    sp<SegmentPrefetcher> prefetcher = createPrefetcher();
+    ASSERT_TRUE(prefetcher->prefetch(0, segmentURI(0), 0, -1, AString()));
+
+    sp<ABuffer> buffer;
+    int64_t delayUs;
+    EXPECT_EQ(-ENOENT, prefetcher->take(0, AString("http://localhost/other0.ts"),
+            &buffer, &delayUs));
+    EXPECT_EQ(-ENOENT, prefetcher->take(5, segmentURI(5), &buffer, &delayUs));
+
+    ASSERT_TRUE(prefetcher->prefetch(1, segmentURI(1), 0, -1, AString()));
+    prefetcher->clear();
+    EXPECT_EQ(-ENOENT, prefetcher->take(1, segmentURI(1), &buffer, &delayUs));
+}
+
+}  // namespace android
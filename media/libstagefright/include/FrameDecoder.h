@@ -17,6 +17,7 @@
 #ifndef FRAME_DECODER_H_
 #define FRAME_DECODER_H_
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -78,6 +79,8 @@ protected:
             bool *done) = 0;
 
     sp<MetaData> trackMeta()     const      { return mTrackMeta; }
+    sp<IMediaSource> source()    const      { return mSource; }
+    sp<MediaCodec> decoder()     const      { return mDecoder; }
     OMX_COLOR_FORMATTYPE dstFormat() const  { return mDstFormat; }
     int32_t dstBpp()             const      { return mDstBpp; }
 
@@ -110,6 +113,21 @@ struct VideoFrameDecoder : public FrameDecoder {
             const sp<MetaData> &trackMeta,
             const sp<IMediaSource> &source);
 
+    // Called with the index in |timesUs| of each frame, as soon as it is decoded.
+    typedef std::function<void(size_t index, const sp<IMemory> &frame)> FrameCallback;
+
+    // Extracts the frames at |timesUs|, in increasing order, with the decoder set up by
+    // init() and the seek mode given to it. The decoder is flushed between frames rather
+    // than set up again. With a sync seek mode only the sync frames are decoded, once
+    // each. With SEEK_CLOSEST decoding goes on from the previous frame if the next one
+    // is in the same group of pictures. Frames are scaled down to fit in maxWidth x
+    // maxHeight, if these are positive.
+    // Returns ERROR_END_OF_STREAM if there is no frame at or after a time, after the
+    // frames before it have been delivered.
+    status_t extractFramesAtTimes(
+            const std::vector<int64_t> &timesUs, int32_t maxWidth, int32_t maxHeight,
+            const FrameCallback &onFrame);
+
 protected:
     virtual sp<AMessage> onGetFormatAndSeekOptions(
             int64_t frameTimeUs,
@@ -140,6 +158,29 @@ private:
     int64_t mTargetTimeUs;
     size_t mNumFrames;
     size_t mNumFramesDecoded;
+
+    // state of extractFramesAtTimes()
+    int32_t mMaxWidth;
+    int32_t mMaxHeight;
+    bool mInputEos;
+    size_t mSamplesQueued;          // since the last sync sample
+    std::vector<uint8_t> mScaled;   // downscaled decoder output, reused between frames
+
+    status_t decodeFrame(
+            MediaBufferBase *sample, bool syncOnly, int64_t targetTimeUs,
+            sp<IMemory> *frame, int64_t *frameTimeUs);
+
+    status_t queueSample(size_t index, MediaBufferBase *sample);
+
+    status_t convertFrame(
+            const sp<MediaCodecBuffer> &videoFrameBuffer,
+            const sp<AMessage> &outputFormat,
+            sp<IMemory> *frameMem);
+
+    bool scaleYUV420(
+            int32_t srcFormat, const uint8_t *src, int32_t stride, int32_t sliceHeight,
+            int32_t cropLeft, int32_t cropTop, int32_t cropWidth, int32_t cropHeight,
+            int32_t dstWidth, int32_t dstHeight);
 };
 
 struct ImageDecoder : public FrameDecoder {
@@ -25,13 +25,17 @@
 namespace android {
 
 struct ALooper;
+struct DiskCache;
 struct PageCache;
 
 struct NuCachedSource2 : public DataSource {
+    // If the cache config asks for a disk cache, its file is created in
+    // |spillDir|, or in /data/misc/media if NULL.
     static sp<NuCachedSource2> Create(
             const sp<DataSource> &source,
             const char *cacheConfig = NULL,
-            bool disconnectAtHighwatermark = false);
+            bool disconnectAtHighwatermark = false,
+            const char *spillDir = NULL);
 
     virtual status_t initCheck() const;
 
@@ -62,6 +66,14 @@ struct NuCachedSource2 : public DataSource {
 
     void resumeFetchingIfNecessary();
 
+    // Bitrate of the content, in bits per second. Unless the client specified the
+    // cache parameters, the watermarks then follow how many seconds of playback
+    // are cached, and how fast the connection is compared to the bitrate.
+    void setBitrate(int64_t bitrate);
+
+    // Bytes served from the disk cache so far.
+    size_t spillBytesRead() const;
+
     // The following methods are supported only if the
     // data source is HTTP-based; otherwise, ERROR_UNSUPPORTED
     // is returned.
@@ -82,7 +94,8 @@ private:
     NuCachedSource2(
             const sp<DataSource> &source,
             const char *cacheConfig,
-            bool disconnectAtHighwatermark);
+            bool disconnectAtHighwatermark,
+            const char *spillDir);
 
     enum {
         kPageSize                       = 65536,
@@ -92,6 +105,20 @@ private:
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
         kDefaultKeepAliveIntervalUs     = 15000000,
+
+        // Bounds of the watermarks derived from the bitrate.
+        kMinHighWaterThreshold          = 4 * 1024 * 1024,
+        kMinLowWaterThreshold           = 256 * 1024,
+        kHighWaterDurationUs            = 60000000,
+        kMinLowWaterDurationUs          = 5000000,
+        kMaxLowWaterDurationUs          = 30000000,
+        kBitrateUpdateIntervalUs        = 1000000,
+
+        // Pages written to the disk cache after each fetch, while fetching.
+        kMaxSpillPagesPerFetch          = 4,
+
+        // Largest disk cache a cache config may ask for.
+        kMaxSpillBytes                  = 256 * 1024 * 1024,
     };
 
     enum {
@@ -113,6 +140,7 @@ private:
     Condition mCondition;
 
     PageCache *mCache;
+    DiskCache *mSpill;      // pages released from mCache, if enabled
     off64_t mCacheOffset;
     status_t mFinalStatus;
     off64_t mLastAccessPos;
@@ -126,6 +154,15 @@ private:
     size_t mHighwaterThresholdBytes;
     size_t mLowwaterThresholdBytes;
 
+    // Configured watermarks, which the ones from the bitrate stay within.
+    size_t mMaxHighwaterThresholdBytes;
+    bool mFixedThresholds;  // set by the client
+    int64_t mBitrate;
+    int64_t mLastThresholdUpdateUs;
+
+    size_t mSpillBytes;     // size of the disk cache, 0 if disabled
+    size_t mSpillBytesRead;
+
     // If the keep-alive interval is 0, keep-alives are disabled.
     int64_t mKeepAliveIntervalUs;
 
@@ -141,6 +178,12 @@ private:
 
     size_t approxDataRemaining_l(off64_t offset, status_t *finalStatus) const;
 
+    size_t releaseFromStart_l(size_t maxBytes);
+    void spillReleasedPages(size_t maxPages);
+    ssize_t readFromSpill_l(off64_t offset, void *data, size_t size);
+    bool isCachedAt_l(off64_t offset, size_t size) const;
+    void updateThresholdsFromBitrate();
+
     void restartPrefetcherIfNecessary_l(
             bool ignoreLowWaterThreshold = false, bool force = false);
 
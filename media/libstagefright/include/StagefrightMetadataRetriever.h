@@ -25,6 +25,7 @@
 
 namespace android {
 
+struct AString;
 class DataSource;
 struct ImageDecoder;
 struct FrameRect;
@@ -50,6 +51,9 @@ struct StagefrightMetadataRetriever : public MediaMetadataRetrieverBase {
     virtual status_t getFrameAtIndex(
             std::vector<sp<IMemory> >* frames,
             int frameIndex, int numFrames, int colorFormat, bool metaOnly);
+    virtual status_t getFramesAtTimes(
+            std::vector<sp<IMemory> >* frames, const std::vector<int64_t> &timesUs,
+            int option, int colorFormat, int maxWidth, int maxHeight);
 
     virtual MediaAlbumArt *extractAlbumArt();
     virtual const char *extractMetadata(int keyCode);
@@ -69,6 +73,9 @@ private:
     // Delete album art and clear metadata.
     void clearMetadata();
 
+    status_t findVideoTrack(size_t *trackIndex, sp<MetaData> *trackMeta);
+    static void findThumbnailCodecs(
+            const sp<MetaData> &trackMeta, Vector<AString> *matchingCodecs);
     status_t getFrameInternal(
             int64_t timeUs, int numFrames, int option, int colorFormat, bool metaOnly,
             sp<IMemory>* outFrame, std::vector<sp<IMemory> >* outFrames);
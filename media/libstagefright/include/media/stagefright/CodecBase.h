@@ -30,6 +30,7 @@
 #include <media/MediaCodecInfo.h>
 #include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/foundation/ColorUtils.h>
+#include <media/stagefright/FrameTrace.h>
 #include <media/stagefright/MediaErrors.h>
 #include <system/graphics.h>
 #include <utils/NativeHandle.h>
@@ -259,6 +260,18 @@ public:
 
     void setDescrambler(const sp<IDescrambler> &descrambler);
 
+    /**
+     * Set the trace where the channel records when frames are submitted to
+     * and returned by the component. See FrameTrace.
+     */
+    inline void setFrameTrace(const sp<FrameTrace> &frameTrace) {
+        mFrameTrace = frameTrace;
+    }
+
+    inline const sp<FrameTrace> &getFrameTrace() const {
+        return mFrameTrace;
+    }
+
     /**
      * Queue an input buffer into the buffer channel.
      *
@@ -318,6 +331,7 @@ protected:
     std::unique_ptr<CodecBase::BufferCallback> mCallback;
     sp<ICrypto> mCrypto;
     sp<IDescrambler> mDescrambler;
+    sp<FrameTrace> mFrameTrace;
 };
 
 }  // namespace android
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_TRACE_H_
+
+#define FRAME_TRACE_H_
+
+#include <atomic>
+#include <vector>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+struct AString;
+
+// Per-frame latency trace of a codec instance. Each layer that a frame goes through
+// records when the frame, keyed by its presentation time, reached its stage. The events
+// go into a fixed ring without locking, so recording is cheap enough to always be on:
+// one atomic increment, a clock read and a few relaxed stores.
+//
+// Frames are put back together from the events by presentation time, so that the time
+// spent in each layer can be broken down even when the codec reorders frames. Outputs
+// that do not keep the timestamp of an input (e.g. audio decoders that split or merge
+// frames) only have their output stages.
+//
+// Recording is header only, so the buffer channels of codecbase do not need to link
+// with libstagefright.
+class FrameTrace : public RefBase {
+public:
+    enum Stage : uint32_t {
+        QUEUED,     // the client queued the input buffer
+        SUBMITTED,  // the buffer channel handed it to the component (emptyBuffer, queue)
+        DONE,       // the component returned the output (fillBufferDone, onWorkDone)
+        DEQUEUED,   // the output buffer was given to the client
+        RENDERED,   // the client released the output buffer to be rendered
+        DROPPED,    // the client released the output buffer without rendering it
+        STAGE_COUNT,
+    };
+
+    // time between two stages of a frame
+    enum Interval : uint32_t {
+        LOOPER,     // QUEUED to SUBMITTED: MediaCodec looper and buffer channel
+        CODEC,      // SUBMITTED to DONE: the component
+        OUTPUT,     // DONE to DEQUEUED: output reordering and delivery to the client
+        CLIENT,     // DEQUEUED to RENDERED or DROPPED: held by the client
+        TOTAL,      // QUEUED to DEQUEUED
+        INTERVAL_COUNT,
+    };
+
+    static constexpr size_t kCapacity = 2048;   // events, a power of 2
+
+    FrameTrace() : mNext(0) {
+        for (Event &event : mEvents) {
+            event.seq.store(0, std::memory_order_relaxed);
+        }
+        for (std::atomic<uint32_t> &count : mCounts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Records that the frame of |timeUs| reached |stage| at |nowNs|. Safe from any thread.
+    void record(Stage stage, int64_t timeUs, nsecs_t nowNs) {
+        const uint64_t seq = mNext.fetch_add(1, std::memory_order_relaxed) + 1;
+        Event &event = mEvents[seq & (kCapacity - 1)];
+        // A reader skips the slot while it is written. Two writers only share a slot if
+        // the whole ring is written over during one record, in which case it can tear.
+        event.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        event.stageFrame.store(
+                ((uint64_t)stage << 32)
+                        | mCounts[stage].fetch_add(1, std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        event.timeUs.store(timeUs, std::memory_order_relaxed);
+        event.nowNs.store(nowNs, std::memory_order_relaxed);
+        event.seq.store(seq, std::memory_order_release);
+    }
+
+    void record(Stage stage, int64_t timeUs) {
+        record(stage, timeUs, systemTime(SYSTEM_TIME_MONOTONIC));
+    }
+
+    struct TraceEvent {
+        Stage stage;
+        uint32_t frame;     // number of events of this stage before this one
+        int64_t timeUs;     // presentation time of the frame
+        nsecs_t nowNs;      // when the stage was reached
+    };
+
+    // one frame put back together; -1 for the stages it has not reached
+    struct Frame {
+        int64_t timeUs;
+        uint32_t frame;     // index of its first recorded stage
+        nsecs_t stageNs[STAGE_COUNT];
+
+        int64_t intervalUs(Interval interval) const;
+    };
+
+    struct Percentiles {
+        size_t count;
+        int64_t p50Us;
+        int64_t p90Us;
+        int64_t p99Us;
+        int64_t maxUs;
+    };
+
+    // Events currently in the ring, oldest first.
+    std::vector<TraceEvent> snapshot() const;
+
+    // Frames of the events currently in the ring, in the order they were first seen.
+    std::vector<Frame> frames() const;
+
+    // Percentiles of each interval over the frames in the ring.
+    void summarize(Percentiles percentiles[INTERVAL_COUNT]) const;
+
+    static const char *intervalName(Interval interval);
+
+    // Appends the percentiles, one line per interval.
+    void dump(AString *out, const char *prefix) const;
+
+    // Appends one line per frame, in presentation order, with the time spent in each
+    // interval. Times are relative, so dumps of the same content can be diffed between
+    // builds.
+    void dumpFrames(AString *out, const char *prefix) const;
+
+private:
+    struct Event {
+        std::atomic<uint64_t> seq;          // 0 while written, else the record number
+        std::atomic<uint64_t> stageFrame;   // stage << 32 | frame
+        std::atomic<int64_t> timeUs;
+        std::atomic<int64_t> nowNs;
+    };
+
+    std::atomic<uint64_t> mNext;
+    std::atomic<uint32_t> mCounts[STAGE_COUNT];
+    Event mEvents[kCapacity];
+
+    DISALLOW_EVIL_CONSTRUCTORS(FrameTrace);
+};
+
+}  // namespace android
+
+#endif  // FRAME_TRACE_H_
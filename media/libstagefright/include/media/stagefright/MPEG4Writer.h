@@ -19,10 +19,14 @@
 #define MPEG4_WRITER_H_
 
 #include <stdio.h>
+#include <sys/uio.h>
+
+#include <atomic>
 
 #include <media/stagefright/MediaWriter.h>
 #include <utils/List.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/foundation/ALooper.h>
 
@@ -216,6 +220,55 @@ protected:
     static void *ThreadWrapper(void *me);
     void threadFunc();
 
+    // Sample data is gathered and written out with one pwritev() per chunk.
+    enum {
+        kMaxWriteIovecs = 256,
+        kMaxWritePrefixSize = 1024,
+    };
+    Vector<struct iovec> mWriteIovecs;  // Pending sample data
+    uint8_t mWritePrefixes[kMaxWritePrefixSize];  // Length prefixes in it
+    size_t mWritePrefixesSize;
+    off64_t mWriteOffset;               // File offset of the pending data
+    size_t mWriteSize;
+
+    // With write-behind, pending sample data is copied to one of two aligned
+    // staging buffers instead, and a full one is written out by a separate
+    // thread while the other one fills up.
+    size_t mWriteBehindSize;            // From kKeyWriteBehindSize; 0 if disabled
+    uint8_t *mStagingBuffers[2];
+    size_t mStagingIndex;               // The buffer being filled
+    size_t mStagingSize;
+    off64_t mStagingOffset;
+    bool mWriteBehindThreadStarted;
+    pthread_t mWriteBehindThread;
+    Mutex mWriteBehindLock;
+    Condition mWriteBehindCondition;
+    uint8_t *mWriteBehindBuffer;        // Being written out, or NULL
+    size_t mWriteBehindBufferSize;
+    off64_t mWriteBehindOffset;
+    bool mWriteBehindDone;
+
+    // First error writing out sample data, returned by reset(). Guarded by
+    // mWriteBehindLock while the threads writing sample data run.
+    status_t mWriteError;
+
+    // Sample write statistics, for dump()
+    int64_t mWriteStatsStartUs;
+    std::atomic<int64_t> mNumSampleWrites;  // System calls
+    std::atomic<int64_t> mMaxWriteStallUs;  // Longest time a flush blocked
+
+    void queueWrite_l(const void *data, size_t size);
+    void queuePrefix_l(const void *data, size_t size);
+    void flushWrites_l();
+    void stageWrites_l();
+    void submitStagingBuffer();
+    void setWriteError(status_t err);
+    status_t writeFully(struct iovec *iov, int iovcnt, off64_t offset);
+    status_t startWriteBehindThread();
+    void stopWriteBehindThread();
+    static void *WriteBehindThreadWrapper(void *me);
+    void writeBehindThreadFunc();
+
     // Buffer a single chunk to be written out later.
     void bufferChunk(const Chunk& chunk);
 
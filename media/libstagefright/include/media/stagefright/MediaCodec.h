@@ -39,6 +39,7 @@ struct AString;
 struct BatteryChecker;
 class BufferChannelBase;
 struct CodecBase;
+class FrameTrace;
 class IBatteryStats;
 struct ICrypto;
 class MediaCodecBuffer;
@@ -152,6 +153,25 @@ struct MediaCodec : public AHandler {
             uint32_t flags,
             AString *errorDetailMsg = NULL);
 
+    // A buffer of queueInputBuffers() and dequeueOutputBuffers(); the fields are
+    // the arguments of queueInputBuffer() and dequeueOutputBuffer().
+    struct BatchBuffer {
+        size_t index;
+        size_t offset;
+        size_t size;
+        int64_t presentationTimeUs;
+        uint32_t flags;
+    };
+
+    // Queues |buffers| in order in a single round trip to the codec looper.
+    // Stops at the first buffer that cannot be queued and returns the error
+    // queueInputBuffer() would have returned for it. |numQueued| is set to the
+    // number of buffers queued before that one.
+    status_t queueInputBuffers(
+            const std::vector<BatchBuffer> &buffers,
+            size_t *numQueued,
+            AString *errorDetailMsg = NULL);
+
     status_t dequeueInputBuffer(size_t *index, int64_t timeoutUs = 0ll);
 
     status_t dequeueOutputBuffer(
@@ -162,6 +182,15 @@ struct MediaCodec : public AHandler {
             uint32_t *flags,
             int64_t timeoutUs = 0ll);
 
+    // Dequeues up to |maxBuffers| output buffers in a single round trip. Waits
+    // for the first one like dequeueOutputBuffer(), then takes the ones already
+    // available. Returns the same errors and INFO_ codes, which are only
+    // returned when |buffers| is left empty.
+    status_t dequeueOutputBuffers(
+            std::vector<BatchBuffer> *buffers,
+            size_t maxBuffers,
+            int64_t timeoutUs = 0ll);
+
     status_t renderOutputBufferAndRelease(size_t index, int64_t timestampNs);
     status_t renderOutputBufferAndRelease(size_t index);
     status_t releaseOutputBuffer(size_t index);
@@ -171,6 +200,9 @@ struct MediaCodec : public AHandler {
     status_t getOutputFormat(sp<AMessage> *format) const;
     status_t getInputFormat(sp<AMessage> *format) const;
 
+    // Per-frame latency trace of this codec, see FrameTrace. Can be read at any time.
+    sp<FrameTrace> getFrameTrace() const;
+
     status_t getInputBuffers(Vector<sp<MediaCodecBuffer> > *buffers) const;
     status_t getOutputBuffers(Vector<sp<MediaCodecBuffer> > *buffers) const;
 
@@ -243,6 +275,8 @@ private:
         kWhatDequeueInputBuffer             = 'deqI',
         kWhatQueueInputBuffer               = 'queI',
         kWhatDequeueOutputBuffer            = 'deqO',
+        kWhatQueueInputBuffers              = 'quIB',
+        kWhatDequeueOutputBuffers           = 'dqOB',
         kWhatReleaseOutputBuffer            = 'relO',
         kWhatSignalEndOfInputStream         = 'eois',
         kWhatGetBuffers                     = 'getB',
@@ -370,6 +404,9 @@ private:
 
     int32_t mDequeueOutputTimeoutGeneration;
     sp<AReplyToken> mDequeueOutputReplyID;
+    // where a dequeueOutputBuffers() call takes its buffers, NULL for dequeueOutputBuffer()
+    std::vector<BatchBuffer> *mDequeueOutputBuffers;
+    size_t mDequeueOutputMaxBuffers;
 
     sp<ICrypto> mCrypto;
 
@@ -516,6 +553,8 @@ private:
 
     Histogram mLatencyHist;
 
+    sp<FrameTrace> mFrameTrace;
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaCodec);
 };
 
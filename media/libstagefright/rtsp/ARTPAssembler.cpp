@@ -26,7 +26,12 @@
 namespace android {
 
 ARTPAssembler::ARTPAssembler()
-    : mFirstFailureTimeUs(-1) {
+    : mFirstFailureTimeUs(-1),
+      mLostPacketTimeoutUs(10000LL) {
+}
+
+void ARTPAssembler::setLostPacketTimeout(int64_t timeoutUs) {
+    mLostPacketTimeoutUs = timeoutUs;
 }
 
 void ARTPAssembler::onPacketReceived(const sp<ARTPSource> &source) {
@@ -35,8 +40,12 @@ void ARTPAssembler::onPacketReceived(const sp<ARTPSource> &source) {
         status = assembleMore(source);
 
         if (status == WRONG_SEQUENCE_NUMBER) {
+            if (mLostPacketTimeoutUs <= 0) {
+                packetLost();
+                continue;
+            }
             if (mFirstFailureTimeUs >= 0) {
-                if (ALooper::GetNowUs() - mFirstFailureTimeUs > 10000LL) {
+                if (ALooper::GetNowUs() - mFirstFailureTimeUs > mLostPacketTimeoutUs) {
                     mFirstFailureTimeUs = -1;
 
                     // LOG(VERBOSE) << "waited too long for packet.";
@@ -40,6 +40,10 @@ struct ARTPAssembler : public RefBase {
     void onPacketReceived(const sp<ARTPSource> &source);
     virtual void onByeReceived() = 0;
 
+    // How long to wait for a missing packet before it is lost. 0 if the
+    // source only hands over packets in order, once it gave up on the others.
+    void setLostPacketTimeout(int64_t timeoutUs);
+
 protected:
     virtual AssemblyStatus assembleMore(const sp<ARTPSource> &source) = 0;
     virtual void packetLost() = 0;
@@ -57,6 +61,7 @@ protected:
 
 private:
     int64_t mFirstFailureTimeUs;
+    int64_t mLostPacketTimeoutUs;
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPAssembler);
 };
@@ -30,6 +30,8 @@
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/hexdump.h>
 
+#include <algorithm>
+
 #include <arpa/inet.h>
 #include <sys/socket.h>
 
@@ -37,6 +39,14 @@ namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// RTP datagrams received in one go, twice as many as came last time within
+// these bounds. RTCP datagrams are received one at a time.
+static const size_t kMinReceiveBatchSize = 4;
+static const size_t kMaxReceiveBatchSize = 32;
+
+// Packet buffers not handed to a source are kept for reuse, enough for a batch.
+static const size_t kMaxFreePacketBuffers = kMaxReceiveBatchSize;
+
 static uint16_t u16at(const uint8_t *data) {
     return data[0] << 8 | data[1];
 }
@@ -52,6 +62,9 @@ static uint64_t u64at(const uint8_t *data) {
 // static
 const int64_t ARTPConnection::kSelectTimeoutUs = 1000LL;
 
+// static
+const int64_t ARTPConnection::kDefaultJitterLatencyUs = 50000LL;
+
 struct ARTPConnection::StreamInfo {
     int mRTPSocket;
     int mRTCPSocket;
@@ -64,13 +77,17 @@ struct ARTPConnection::StreamInfo {
     int64_t mNumRTPPacketsReceived;
     struct sockaddr_in mRemoteRTCPAddr;
 
+    size_t mRTPBatchSize;
+
     bool mIsInjected;
 };
 
-ARTPConnection::ARTPConnection(uint32_t flags)
+ARTPConnection::ARTPConnection(uint32_t flags, int64_t jitterLatencyUs)
     : mFlags(flags),
+      mJitterLatencyUs(jitterLatencyUs),
       mPollEventPending(false),
-      mLastReceiverReportTimeUs(-1) {
+      mLastReceiverReportTimeUs(-1),
+      mPacketBufferSize(kMaxUDPSize) {
 }
 
 ARTPConnection::~ARTPConnection() {
@@ -210,6 +227,7 @@ void ARTPConnection::onAddStream(const sp<AMessage> &msg) {
     info->mNumRTCPPacketsReceived = 0;
     info->mNumRTPPacketsReceived = 0;
     memset(&info->mRemoteRTCPAddr, 0, sizeof(info->mRemoteRTCPAddr));
+    info->mRTPBatchSize = kMinReceiveBatchSize;
 
     if (!injected) {
         postPollEvent();
@@ -234,13 +252,13 @@ void ARTPConnection::onRemoveStream(const sp<AMessage> &msg) {
     mStreams.erase(it);
 }
 
-void ARTPConnection::postPollEvent() {
+void ARTPConnection::postPollEvent(int64_t delayUs) {
     if (mPollEventPending) {
         return;
     }
 
     sp<AMessage> msg = new AMessage(kWhatPollStreams, this);
-    msg->post();
+    msg->post(delayUs);
 
     mPollEventPending = true;
 }
@@ -277,7 +295,23 @@ void ARTPConnection::onPollStreams() {
         }
     }
 
+    // Injected streams (RTSP over TCP) have no socket to wait on, so packets
+    // they hold are handed over from here too.
+    bool holdingPackets = false;
+    for (List<StreamInfo>::iterator it = mStreams.begin();
+         it != mStreams.end(); ++it) {
+        for (size_t i = 0; i < it->mSources.size(); ++i) {
+            if (it->mSources.valueAt(i)->checkJitterBuffer()) {
+                holdingPackets = true;
+            }
+        }
+    }
+
     if (maxSocket == -1) {
+        // nothing to select on; come back only while packets are held
+        if (holdingPackets) {
+            postPollEvent(kSelectTimeoutUs);
+        }
         return;
     }
 
@@ -376,41 +410,113 @@ void ARTPConnection::onPollStreams() {
     }
 }
 
+sp<ABuffer> ARTPConnection::acquirePacketBuffer() {
+    if (mFreePacketBuffers.isEmpty()) {
+        return new ABuffer(mPacketBufferSize);
+    }
+
+    sp<ABuffer> buffer = mFreePacketBuffers.top();
+    mFreePacketBuffers.pop();
+    return buffer;
+}
+
+void ARTPConnection::releasePacketBuffer(const sp<ABuffer> &buffer) {
+    if (buffer->capacity() != mPacketBufferSize
+            || mFreePacketBuffers.size() >= kMaxFreePacketBuffers) {
+        return;
+    }
+
+    buffer->meta()->clear();
+    buffer->setRange(0, buffer->capacity());
+    buffer->setInt32Data(0);
+    mFreePacketBuffers.push(buffer);
+}
+
 status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
     ALOGV("receiving %s", receiveRTP ? "RTP" : "RTCP");
 
     CHECK(!s->mIsInjected);
 
-    sp<ABuffer> buffer = new ABuffer(65536);
+    size_t maxCount = receiveRTP ? s->mRTPBatchSize : 1;
+
+    sp<ABuffer> buffers[kMaxReceiveBatchSize];
+    struct iovec iovs[kMaxReceiveBatchSize];
+    struct mmsghdr msgs[kMaxReceiveBatchSize];
+    memset(msgs, 0, maxCount * sizeof(msgs[0]));
+    for (size_t i = 0; i < maxCount; ++i) {
+        buffers[i] = acquirePacketBuffer();
+        iovs[i].iov_base = buffers[i]->base();
+        iovs[i].iov_len = buffers[i]->capacity();
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
 
-    socklen_t remoteAddrLen =
-        (!receiveRTP && s->mNumRTCPPacketsReceived == 0)
-            ? sizeof(s->mRemoteRTCPAddr) : 0;
+    if (!receiveRTP && s->mNumRTCPPacketsReceived == 0) {
+        msgs[0].msg_hdr.msg_name = &s->mRemoteRTCPAddr;
+        msgs[0].msg_hdr.msg_namelen = sizeof(s->mRemoteRTCPAddr);
+    }
 
-    ssize_t nbytes;
+    int n;
     do {
-        nbytes = recvfrom(
+        n = recvmmsg(
             receiveRTP ? s->mRTPSocket : s->mRTCPSocket,
-            buffer->data(),
-            buffer->capacity(),
-            0,
-            remoteAddrLen > 0 ? (struct sockaddr *)&s->mRemoteRTCPAddr : NULL,
-            remoteAddrLen > 0 ? &remoteAddrLen : NULL);
-    } while (nbytes < 0 && errno == EINTR);
-
-    if (nbytes <= 0) {
+            msgs,
+            maxCount,
+            MSG_DONTWAIT,
+            NULL /* timeout */);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        n = 0;
+    } else if (n <= 0) {
         return -ECONNRESET;
     }
 
-    buffer->setRange(0, nbytes);
+    if (receiveRTP) {
+        s->mRTPBatchSize = std::min(
+                std::max(2 * (size_t)n, kMinReceiveBatchSize), kMaxReceiveBatchSize);
+    }
 
-    // ALOGI("received %d bytes.", buffer->size());
+    status_t err = OK;
+    for (size_t i = 0; i < maxCount; ++i) {
+        if (i >= (size_t)n) {
+            releasePacketBuffer(buffers[i]);
+            continue;
+        }
 
-    status_t err;
-    if (receiveRTP) {
-        err = parseRTP(s, buffer);
-    } else {
-        err = parseRTCP(s, buffer);
+        size_t nbytes = msgs[i].msg_len;
+        if (nbytes == 0) {
+            return -ECONNRESET;
+        }
+
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            // RTP packets normally fit into one ethernet frame; receive
+            // whatever this server sends from now on.
+            ALOGW("dropping %s datagram larger than %zu bytes",
+                  receiveRTP ? "RTP" : "RTCP", mPacketBufferSize);
+            if (mPacketBufferSize < 65536) {
+                mPacketBufferSize = 65536;
+                mFreePacketBuffers.clear();
+            }
+            releasePacketBuffer(buffers[i]);
+            continue;
+        }
+
+        const sp<ABuffer> &buffer = buffers[i];
+        buffer->setRange(0, nbytes);
+
+        // ALOGI("received %d bytes.", buffer->size());
+
+        if (receiveRTP) {
+            err = parseRTP(s, buffer);
+            // a source that took the packet holds on to it
+            if (err != OK) {
+                releasePacketBuffer(buffer);
+            }
+        } else {
+            err = parseRTCP(s, buffer);
+            releasePacketBuffer(buffer);
+        }
     }
 
     return err;
@@ -635,6 +741,7 @@ sp<ARTPSource> ARTPConnection::findSource(StreamInfo *info, uint32_t srcId) {
 
         source = new ARTPSource(
                 srcId, info->mSessionDesc, info->mIndex, info->mNotifyMsg);
+        source->setJitterLatency(mJitterLatencyUs);
 
         info->mSources.add(srcId, source);
     } else {
@@ -672,6 +779,10 @@ void ARTPConnection::onInjectPacket(const sp<AMessage> &msg) {
 
     if (it->mRTPSocket == index) {
         parseRTP(s, buffer);
+        if (mJitterLatencyUs > 0) {
+            // to hand over what is held if no more packets come
+            postPollEvent();
+        }
     } else {
         parseRTCP(s, buffer);
     }
@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/AHandler.h>
 #include <utils/List.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -32,7 +33,12 @@ struct ARTPConnection : public AHandler {
         kRegularlyRequestFIR = 2,
     };
 
-    explicit ARTPConnection(uint32_t flags = 0);
+    static const int64_t kDefaultJitterLatencyUs;
+
+    // RTP packets are held for up to |jitterLatencyUs| to be put back in
+    // order; 0 hands them over as they arrive.
+    explicit ARTPConnection(
+            uint32_t flags = 0, int64_t jitterLatencyUs = kDefaultJitterLatencyUs);
 
     void addStream(
             int rtpSocket, int rtcpSocket,
@@ -68,12 +74,22 @@ private:
     static const int64_t kSelectTimeoutUs;
 
     uint32_t mFlags;
+    int64_t mJitterLatencyUs;
 
     struct StreamInfo;
     List<StreamInfo> mStreams;
 
     bool mPollEventPending;
     int64_t mLastReceiverReportTimeUs;
+
+    // Datagrams are received into these. Those that are not handed to a
+    // source, e.g. RTCP or the rest of a batch, go back to be reused; RTP
+    // packets handed to a source are not, as its assembler may keep them.
+    Vector<sp<ABuffer> > mFreePacketBuffers;
+    size_t mPacketBufferSize;
+
+    sp<ABuffer> acquirePacketBuffer();
+    void releasePacketBuffer(const sp<ABuffer> &buffer);
     void onRemoveStream(const sp<AMessage> &msg);
     void onPollStreams();
     void onInjectPacket(const sp<AMessage> &msg);
@@ -88,7 +104,7 @@ private:
 
     sp<ARTPSource> findSource(StreamInfo *info, uint32_t id);
 
-    void postPollEvent();
+    void postPollEvent(int64_t delayUs = 0);
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPConnection);
 };
@@ -37,6 +37,9 @@ namespace android {
 
 static const uint32_t kSourceID = 0xdeadbeef;
 
+// Packets up to this far ahead of the next one to hand over are held.
+static const uint32_t kJitterBufferSize = 1024;
+
 ARTPSource::ARTPSource(
         uint32_t id,
         const sp<ASessionDescription> &sessionDesc, size_t index,
@@ -47,6 +50,9 @@ ARTPSource::ARTPSource(
       mBaseSeqNumber(0),
       mNumBuffersReceived(0),
       mPrevNumBuffersReceived(0),
+      mNumHeldPackets(0),
+      mNextReleaseSeqNumber(0),
+      mJitterLatencyUs(0),
       mLastNTPTime(0),
       mLastNTPTimeUpdateUs(0),
       mIssueFIRRequests(false),
@@ -94,6 +100,26 @@ void ARTPSource::processRTPPacket(const sp<ABuffer> &buffer) {
     }
 }
 
+void ARTPSource::setJitterLatency(int64_t latencyUs) {
+    mJitterLatencyUs = latencyUs;
+    if (mJitterLatencyUs > 0 && mJitterBuffer.isEmpty()) {
+        mJitterBuffer.resize(kJitterBufferSize);
+        mArrivalTimesUs.resize(kJitterBufferSize);
+    }
+    if (mAssembler != NULL) {
+        // with a jitter buffer, a packet not handed over is not coming
+        mAssembler->setLostPacketTimeout(mJitterLatencyUs > 0 ? 0 : 10000LL);
+    }
+}
+
+bool ARTPSource::checkJitterBuffer() {
+    if (mNumHeldPackets > 0 && releasePackets(ALooper::GetNowUs()) > 0
+            && mAssembler != NULL) {
+        mAssembler->onPacketReceived(this);
+    }
+    return mNumHeldPackets > 0;
+}
+
 void ARTPSource::timeUpdate(uint32_t rtpTime, uint64_t ntpTime) {
     mLastNTPTime = ntpTime;
     mLastNTPTimeUpdateUs = ALooper::GetNowUs();
@@ -111,6 +137,7 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
     if (mNumBuffersReceived++ == 0) {
         mHighestSeqNumber = seqNum;
         mBaseSeqNumber = seqNum;
+        mNextReleaseSeqNumber = seqNum + 1;
         mQueue.push_back(buffer);
         return true;
     }
@@ -155,9 +182,18 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     buffer->setInt32Data(seqNum);
 
-    List<sp<ABuffer> >::iterator it = mQueue.begin();
-    while (it != mQueue.end() && (uint32_t)(*it)->int32Data() < seqNum) {
-        ++it;
+    if (mJitterLatencyUs > 0) {
+        return holdPacket(buffer);
+    }
+
+    // most packets come in order, and go at the end
+    List<sp<ABuffer> >::iterator it = mQueue.end();
+    while (it != mQueue.begin()) {
+        List<sp<ABuffer> >::iterator prev = it;
+        if ((uint32_t)(*--prev)->int32Data() < seqNum) {
+            break;
+        }
+        it = prev;
     }
 
     if (it != mQueue.end() && (uint32_t)(*it)->int32Data() == seqNum) {
@@ -170,6 +206,65 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
     return true;
 }
 
+bool ARTPSource::holdPacket(const sp<ABuffer> &buffer) {
+    uint32_t seqNum = (uint32_t)buffer->int32Data();
+    int64_t nowUs = ALooper::GetNowUs();
+
+    if (seqNum < mNextReleaseSeqNumber) {
+        ALOGV("Discarding late buffer %u", seqNum);
+        return false;
+    }
+
+    size_t numReleased = 0;
+    if (seqNum - mNextReleaseSeqNumber >= kJitterBufferSize) {
+        // no room to wait any longer for the packets still missing
+        numReleased = releasePackets(nowUs, true /* giveUp */);
+        if (seqNum - mNextReleaseSeqNumber >= kJitterBufferSize) {
+            ALOGW("Lost %u packets", seqNum - mNextReleaseSeqNumber);
+            mNextReleaseSeqNumber = seqNum;
+        }
+    }
+
+    size_t index = seqNum % kJitterBufferSize;
+    if (mJitterBuffer.itemAt(index) != NULL) {
+        ALOGW("Discarding duplicate buffer");
+        return numReleased > 0;
+    }
+    mJitterBuffer.editItemAt(index) = buffer;
+    mArrivalTimesUs.editItemAt(index) = nowUs;
+    ++mNumHeldPackets;
+
+    numReleased += releasePackets(nowUs);
+    return numReleased > 0;
+}
+
+size_t ARTPSource::releasePackets(int64_t nowUs, bool giveUp) {
+    size_t numReleased = 0;
+    while (mNumHeldPackets > 0) {
+        size_t index = mNextReleaseSeqNumber % kJitterBufferSize;
+        if (mJitterBuffer.itemAt(index) == NULL) {
+            // the first packet held after the missing ones
+            uint32_t seqNum = mNextReleaseSeqNumber + 1;
+            while (mJitterBuffer.itemAt(seqNum % kJitterBufferSize) == NULL) {
+                ++seqNum;
+            }
+            index = seqNum % kJitterBufferSize;
+            if (!giveUp && nowUs - mArrivalTimesUs.itemAt(index) < mJitterLatencyUs) {
+                break;
+            }
+            ALOGV("Gave up on %u packets", seqNum - mNextReleaseSeqNumber);
+            mNextReleaseSeqNumber = seqNum;
+        }
+
+        mQueue.push_back(mJitterBuffer.itemAt(index));
+        mJitterBuffer.editItemAt(index).clear();
+        --mNumHeldPackets;
+        ++mNextReleaseSeqNumber;
+        ++numReleased;
+    }
+    return numReleased;
+}
+
 void ARTPSource::byeReceived() {
     mAssembler->onByeReceived();
 }
@@ -23,6 +23,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -38,6 +39,17 @@ struct ARTPSource : public RefBase {
             const sp<AMessage> &notify);
 
     void processRTPPacket(const sp<ABuffer> &buffer);
+
+    // Packets received out of order are held until the ones before them arrive,
+    // for up to |latencyUs|, and then handed over in order; those still missing
+    // are lost. If 0, the assembler waits for them instead.
+    void setJitterLatency(int64_t latencyUs);
+
+    // Hands over the packets whose missing predecessors were waited for long
+    // enough, even if no more packets arrive. Returns true if packets are
+    // still held.
+    bool checkJitterBuffer();
+
     void timeUpdate(uint32_t rtpTime, uint64_t ntpTime);
     void byeReceived();
 
@@ -57,6 +69,13 @@ private:
     List<sp<ABuffer> > mQueue;
     sp<ARTPAssembler> mAssembler;
 
+    // Indexed by sequence number modulo its size.
+    Vector<sp<ABuffer> > mJitterBuffer;
+    Vector<int64_t> mArrivalTimesUs;
+    size_t mNumHeldPackets;
+    uint32_t mNextReleaseSeqNumber;
+    int64_t mJitterLatencyUs;
+
     uint64_t mLastNTPTime;
     int64_t mLastNTPTimeUpdateUs;
 
@@ -67,6 +86,8 @@ private:
     sp<AMessage> mNotify;
 
     bool queuePacket(const sp<ABuffer> &buffer);
+    bool holdPacket(const sp<ABuffer> &buffer);
+    size_t releasePackets(int64_t nowUs, bool giveUp = false);
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPSource);
 };
@@ -40,15 +40,27 @@ namespace android {
 // static const size_t kMaxPacketSize = 65507;  // maximum payload in UDP over IP
 static const size_t kMaxPacketSize = 1500;
 
+// Packets handed to the kernel in one go, and kept for reuse once sent.
+static const size_t kMaxSendBatchSize = 64;
+static const size_t kMaxFreePackets = 256;
+
+// Longer gaps between access units are not paced over.
+static const int64_t kMaxFrameIntervalUs = 100000ll;
+
 static int UniformRand(int limit) {
     return ((double)rand() * limit) / RAND_MAX;
 }
 
-ARTPWriter::ARTPWriter(int fd)
+// static
+const int32_t ARTPWriter::kDefaultMaxBurstPackets = 8;
+
+ARTPWriter::ARTPWriter(int fd, int32_t maxBurstPackets)
     : mFlags(0),
       mFd(dup(fd)),
       mLooper(new ALooper),
-      mReflector(new AHandlerReflector<ARTPWriter>(this)) {
+      mReflector(new AHandlerReflector<ARTPWriter>(this)),
+      mMaxBurstPackets(maxBurstPackets > 0 ? maxBurstPackets : 0),
+      mSendPacketsGeneration(0) {
     CHECK_GE(fd, 0);
 
     mLooper->setName("rtp writer");
@@ -130,6 +142,10 @@ status_t ARTPWriter::start(MetaData * /* params */) {
     mLastNTPTime = 0;
     mNumSRsSent = 0;
 
+    mLastFrameTimeUs = -1;
+    mFrameIntervalUs = 0;
+    mBurstIntervalUs = 0;
+
     const char *mime;
     CHECK(mSource->getFormat()->findCString(kKeyMIMEType, &mime));
 
@@ -222,7 +238,10 @@ void ARTPWriter::onMessageReceived(const sp<AMessage> &msg) {
         {
             CHECK_EQ(mSource->stop(), (status_t)OK);
 
+            sendPackets(mPendingPackets.size());
             sendBye();
+            // a send still posted must not pace the packets of a later session
+            ++mSendPacketsGeneration;
 
             {
                 Mutex::Autolock autoLock(mLock);
@@ -258,13 +277,34 @@ void ARTPWriter::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSendPackets:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+            if (generation != mSendPacketsGeneration) {
+                break;
+            }
+
+            {
+                Mutex::Autolock autoLock(mLock);
+                if (!(mFlags & kFlagStarted)) {
+                    break;
+                }
+            }
+
+            if (!mPendingPackets.empty()) {
+                onSendPackets();
+            }
+            break;
+        }
+
         default:
             TRESPASS();
             break;
     }
 }
 
-void ARTPWriter::onRead(const sp<AMessage> &msg) {
+void ARTPWriter::onRead(const sp<AMessage> & /* msg */) {
     MediaBufferBase *mediaBuf;
     status_t err = mSource->read(&mediaBuf);
 
@@ -276,9 +316,12 @@ void ARTPWriter::onRead(const sp<AMessage> &msg) {
         return;
     }
 
+    int64_t timeUs = -1;
     if (mediaBuf->range_length() > 0) {
         ALOGV("read buffer of size %zu", mediaBuf->range_length());
 
+        CHECK(mediaBuf->meta_data().findInt64(kKeyTime, &timeUs));
+
         if (mMode == H264) {
             StripStartcode(mediaBuf);
             sendAVCData(mediaBuf);
@@ -292,7 +335,42 @@ void ARTPWriter::onRead(const sp<AMessage> &msg) {
     mediaBuf->release();
     mediaBuf = NULL;
 
-    msg->post();
+    if (timeUs >= 0) {
+        schedulePackets(timeUs);
+    }
+    onSendPackets();
+}
+
+void ARTPWriter::schedulePackets(int64_t timeUs) {
+    if (mLastFrameTimeUs >= 0 && timeUs > mLastFrameTimeUs) {
+        mFrameIntervalUs = timeUs - mLastFrameTimeUs;
+        if (mFrameIntervalUs > kMaxFrameIntervalUs) {
+            mFrameIntervalUs = kMaxFrameIntervalUs;
+        }
+    }
+    mLastFrameTimeUs = timeUs;
+
+    size_t numBursts = 1;
+    if (mMaxBurstPackets > 0) {
+        numBursts = (mPendingPackets.size() + mMaxBurstPackets - 1) / mMaxBurstPackets;
+    }
+    mBurstIntervalUs = numBursts > 1 ? mFrameIntervalUs / (int64_t)numBursts : 0;
+}
+
+void ARTPWriter::onSendPackets() {
+    size_t count = mPendingPackets.size();
+    if (mMaxBurstPackets > 0 && count > mMaxBurstPackets) {
+        count = mMaxBurstPackets;
+    }
+    sendPackets(count);
+
+    if (mPendingPackets.empty()) {
+        (new AMessage(kWhatRead, mReflector))->post();
+    } else {
+        sp<AMessage> msg = new AMessage(kWhatSendPackets, mReflector);
+        msg->setInt32("generation", mSendPacketsGeneration);
+        msg->post(mBurstIntervalUs);
+    }
 }
 
 void ARTPWriter::onSendSR(const sp<AMessage> &msg) {
@@ -317,6 +395,12 @@ void ARTPWriter::send(const sp<ABuffer> &buffer, bool isRTCP) {
     CHECK_EQ(n, (ssize_t)buffer->size());
 
 #if LOG_TO_FILES
+    logPacket(buffer, isRTCP);
+#endif
+}
+
+#if LOG_TO_FILES
+void ARTPWriter::logPacket(const sp<ABuffer> &buffer, bool isRTCP) {
     int fd = isRTCP ? mRTCPFd : mRTPFd;
 
     uint32_t ms = tolel(ALooper::GetNowUs() / 1000ll);
@@ -324,7 +408,65 @@ void ARTPWriter::send(const sp<ABuffer> &buffer, bool isRTCP) {
     write(fd, &ms, sizeof(ms));
     write(fd, &length, sizeof(length));
     write(fd, buffer->data(), buffer->size());
+}
+#endif
+
+sp<ABuffer> ARTPWriter::acquirePacket() {
+    sp<ABuffer> buffer;
+    if (mFreePackets.empty()) {
+        buffer = new ABuffer(kMaxPacketSize);
+    } else {
+        buffer = mFreePackets.top();
+        mFreePackets.pop();
+        buffer->setRange(0, buffer->capacity());
+    }
+    return buffer;
+}
+
+void ARTPWriter::queuePacket(const sp<ABuffer> &buffer) {
+    mPendingPackets.push_back(buffer);
+}
+
+void ARTPWriter::sendPackets(size_t count) {
+    struct mmsghdr msgs[kMaxSendBatchSize];
+    struct iovec iovs[kMaxSendBatchSize];
+
+    while (count > 0) {
+        size_t batchSize = count < kMaxSendBatchSize ? count : kMaxSendBatchSize;
+
+        memset(msgs, 0, batchSize * sizeof(msgs[0]));
+        List<sp<ABuffer> >::iterator it = mPendingPackets.begin();
+        for (size_t i = 0; i < batchSize; ++i, ++it) {
+            iovs[i].iov_base = (*it)->data();
+            iovs[i].iov_len = (*it)->size();
+            msgs[i].msg_hdr.msg_name = &mRTPAddr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(mRTPAddr);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n;
+        do {
+            n = sendmmsg(mSocket, msgs, batchSize, 0);
+        } while (n < 0 && errno == EINTR);
+
+        CHECK_GT(n, 0);
+
+        for (int i = 0; i < n; ++i) {
+            const sp<ABuffer> &buffer = *mPendingPackets.begin();
+            CHECK_EQ(msgs[i].msg_len, (unsigned)buffer->size());
+
+#if LOG_TO_FILES
+            logPacket(buffer, false /* isRTCP */);
 #endif
+
+            if (mFreePackets.size() < kMaxFreePackets) {
+                mFreePackets.push(buffer);
+            }
+            mPendingPackets.erase(mPendingPackets.begin());
+        }
+        count -= n;
+    }
 }
 
 void ARTPWriter::addSR(const sp<ABuffer> &buffer) {
@@ -581,9 +723,9 @@ void ARTPWriter::sendAVCData(MediaBufferBase *mediaBuf) {
     const uint8_t *mediaData =
         (const uint8_t *)mediaBuf->data() + mediaBuf->range_offset();
 
-    sp<ABuffer> buffer = new ABuffer(kMaxPacketSize);
-    if (mediaBuf->range_length() + 12 <= buffer->capacity()) {
+    if (mediaBuf->range_length() + 12 <= kMaxPacketSize) {
         // The data fits into a single packet
+        sp<ABuffer> buffer = acquirePacket();
         uint8_t *data = buffer->data();
         data[0] = 0x80;
         data[1] = (1 << 7) | PT;  // M-bit
@@ -603,7 +745,7 @@ void ARTPWriter::sendAVCData(MediaBufferBase *mediaBuf) {
 
         buffer->setRange(0, mediaBuf->range_length() + 12);
 
-        send(buffer, false /* isRTCP */);
+        queuePacket(buffer);
 
         ++mSeqNo;
         ++mNumRTPSent;
@@ -616,6 +758,7 @@ void ARTPWriter::sendAVCData(MediaBufferBase *mediaBuf) {
 
         bool firstPacket = true;
         while (offset < mediaBuf->range_length()) {
+            sp<ABuffer> buffer = acquirePacket();
             size_t size = mediaBuf->range_length() - offset;
             bool lastPacket = true;
             if (size + 12 + 2 > buffer->capacity()) {
@@ -650,7 +793,7 @@ void ARTPWriter::sendAVCData(MediaBufferBase *mediaBuf) {
 
             buffer->setRange(0, 14 + size);
 
-            send(buffer, false /* isRTCP */);
+            queuePacket(buffer);
 
             ++mSeqNo;
             ++mNumRTPSent;
@@ -685,7 +828,7 @@ void ARTPWriter::sendH263Data(MediaBufferBase *mediaBuf) {
     size_t size = mediaBuf->range_length();
 
     while (offset < size) {
-        sp<ABuffer> buffer = new ABuffer(kMaxPacketSize);
+        sp<ABuffer> buffer = acquirePacket();
         // CHECK_LE(mediaBuf->range_length() -2 + 14, buffer->capacity());
 
         size_t remaining = size - offset;
@@ -716,7 +859,7 @@ void ARTPWriter::sendH263Data(MediaBufferBase *mediaBuf) {
 
         buffer->setRange(0, remaining + 14);
 
-        send(buffer, false /* isRTCP */);
+        queuePacket(buffer);
 
         ++mSeqNo;
         ++mNumRTPSent;
@@ -772,7 +915,7 @@ void ARTPWriter::sendAMRData(MediaBufferBase *mediaBuf) {
     }
     CHECK_EQ(srcOffset, mediaLength);
 
-    sp<ABuffer> buffer = new ABuffer(kMaxPacketSize);
+    sp<ABuffer> buffer = acquirePacket();
     CHECK_LE(mediaLength + 12 + 1, buffer->capacity());
 
     // The data fits into a single packet
@@ -824,7 +967,7 @@ void ARTPWriter::sendAMRData(MediaBufferBase *mediaBuf) {
 
     buffer->setRange(0, dstOffset);
 
-    send(buffer, false /* isRTCP */);
+    queuePacket(buffer);
 
     ++mSeqNo;
     ++mNumRTPSent;
@@ -23,6 +23,8 @@
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/base64.h>
 #include <media/stagefright/MediaWriter.h>
+#include <utils/List.h>
+#include <utils/Vector.h>
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -35,7 +37,11 @@ struct ABuffer;
 class MediaBuffer;
 
 struct ARTPWriter : public MediaWriter {
-    explicit ARTPWriter(int fd);
+    static const int32_t kDefaultMaxBurstPackets;
+
+    // The RTP packets of an access unit are sent in bursts of up to
+    // |maxBurstPackets|; 0 sends them all at once.
+    explicit ARTPWriter(int fd, int32_t maxBurstPackets = kDefaultMaxBurstPackets);
 
     virtual status_t addSource(const sp<MediaSource> &source);
     virtual bool reachedEOS();
@@ -54,6 +60,7 @@ private:
         kWhatStop   = 'stop',
         kWhatRead   = 'read',
         kWhatSendSR = 'sr  ',
+        kWhatSendPackets = 'sndp',
     };
 
     enum {
@@ -94,6 +101,17 @@ private:
 
     int32_t mNumSRsSent;
 
+    // The RTP packets of an access unit are sent in bursts of up to
+    // mMaxBurstPackets, spread over the time until the next one is due,
+    // from the time between the last two. If 0, they are sent all at once.
+    size_t mMaxBurstPackets;
+    int64_t mLastFrameTimeUs;
+    int64_t mFrameIntervalUs;
+    int64_t mBurstIntervalUs;
+    int32_t mSendPacketsGeneration;     // of kWhatSendPackets, bumped on stop
+    List<sp<ABuffer> > mPendingPackets;
+    Vector<sp<ABuffer> > mFreePackets;
+
     enum {
         INVALID,
         H264,
@@ -106,6 +124,7 @@ private:
 
     void onRead(const sp<AMessage> &msg);
     void onSendSR(const sp<AMessage> &msg);
+    void onSendPackets();
 
     void addSR(const sp<ABuffer> &buffer);
     void addSDES(const sp<ABuffer> &buffer);
@@ -120,6 +139,15 @@ private:
 
     void send(const sp<ABuffer> &buffer, bool isRTCP);
 
+    sp<ABuffer> acquirePacket();
+    void queuePacket(const sp<ABuffer> &buffer);
+    void schedulePackets(int64_t timeUs);
+    void sendPackets(size_t count);
+
+#if LOG_TO_FILES
+    void logPacket(const sp<ABuffer> &buffer, bool isRTCP);
+#endif
+
     DISALLOW_EVIL_CONSTRUCTORS(ARTPWriter);
 };
 
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "ARTPConnection_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/Vector.h>
+
+#include "ARTPConnection.h"
+#include "ASessionDescription.h"
+
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace android {
+
+static const char kSDP[] =
+    "v=0\r\n"
+    "o=- 0 0 IN IP4 127.0.0.1\r\n"
+    "s=test\r\n"
+    "c=IN IP4 127.0.0.1\r\n"
+    "t=0 0\r\n"
+    "m=audio 0 RTP/AVP 0\r\n"
+    "a=rtpmap:0 PCMU/8000/1\r\n";
+
+static const size_t kPayloadSize = 1000;
+static const uint32_t kSSRC = 0x12345678;
+
+// Collects the access units the assembler puts out, one per packet for
+// G.711 audio, with the sequence numbers of the packets.
+struct AccessUnitCollector : public AHandler {
+    enum {
+        kWhatAccessUnit = 'accU',
+    };
+
+    size_t count() {
+        Mutex::Autolock autoLock(mLock);
+        return mSeqNumbers.size();
+    }
+
+    bool waitForCount(size_t count, int64_t timeoutUs) {
+        Mutex::Autolock autoLock(mLock);
+        while (mSeqNumbers.size() < count) {
+            if (mCondition.waitRelative(mLock, timeoutUs * 1000ll) != OK) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Vector<uint32_t> seqNumbers() {
+        Mutex::Autolock autoLock(mLock);
+        return mSeqNumbers;
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        sp<ABuffer> accessUnit;
+        if (!msg->findBuffer("access-unit", &accessUnit)) {
+            return;
+        }
+        Mutex::Autolock autoLock(mLock);
+        mSeqNumbers.push((uint32_t)accessUnit->int32Data());
+        mCondition.broadcast();
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    Vector<uint32_t> mSeqNumbers;
+};
+
+class ARTPConnectionTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        mLooper = new ALooper;
+        mLooper->setName("ARTPConnection_test");
+        mLooper->start();
+
+        mCollector = new AccessUnitCollector;
+        mLooper->registerHandler(mCollector);
+
+        mSenderSocket = -1;
+        mRTPSocket = -1;
+        mRTCPSocket = -1;
+        mInjected = false;
+    }
+
+    virtual void TearDown() {
+        if (mConnection != NULL) {
+            mConnection->removeStream(mRTPSocket, mRTCPSocket);
+            mLooper->unregisterHandler(mConnection->id());
+        }
+        mLooper->unregisterHandler(mCollector->id());
+        mLooper->stop();
+
+        if (mSenderSocket >= 0) {
+            close(mSenderSocket);
+        }
+        if (mRTPSocket >= 0 && !mInjected) {
+            close(mRTPSocket);
+            close(mRTCPSocket);
+        }
+    }
+
+    // Starts receiving on a new port pair, and points the sender at it.
+    void startConnection(int64_t jitterLatencyUs) {
+        sp<ASessionDescription> desc = new ASessionDescription;
+        ASSERT_TRUE(desc->setTo(kSDP, strlen(kSDP)));
+
+        unsigned rtpPort;
+        ARTPConnection::MakePortPair(&mRTPSocket, &mRTCPSocket, &rtpPort);
+
+        mConnection = new ARTPConnection(0 /* flags */, jitterLatencyUs);
+        mLooper->registerHandler(mConnection);
+        mConnection->addStream(
+                mRTPSocket, mRTCPSocket, desc, 1 /* index */,
+                new AMessage(AccessUnitCollector::kWhatAccessUnit, mCollector),
+                false /* injected */);
+
+        mSenderSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        ASSERT_GE(mSenderSocket, 0);
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(rtpPort);
+        ASSERT_EQ(0, connect(mSenderSocket, (const struct sockaddr *)&addr, sizeof(addr)));
+    }
+
+    // Adds a stream whose packets are injected, as with RTSP over TCP.
+    void startInjectedConnection(int64_t jitterLatencyUs) {
+        sp<ASessionDescription> desc = new ASessionDescription;
+        ASSERT_TRUE(desc->setTo(kSDP, strlen(kSDP)));
+
+        // interleaved channels
+        mRTPSocket = 0;
+        mRTCPSocket = 1;
+        mInjected = true;
+
+        mConnection = new ARTPConnection(0 /* flags */, jitterLatencyUs);
+        mLooper->registerHandler(mConnection);
+        mConnection->addStream(
+                mRTPSocket, mRTCPSocket, desc, 1 /* index */,
+                new AMessage(AccessUnitCollector::kWhatAccessUnit, mCollector),
+                true /* injected */);
+    }
+
+    void sendPacket(uint16_t seqNumber) {
+        uint8_t packet[12 + kPayloadSize];
+        makePacket(seqNumber, packet);
+        ASSERT_EQ((ssize_t)sizeof(packet), send(mSenderSocket, packet, sizeof(packet), 0));
+    }
+
+    void injectPacket(uint16_t seqNumber) {
+        sp<ABuffer> buffer = new ABuffer(12 + kPayloadSize);
+        makePacket(seqNumber, buffer->data());
+        mConnection->injectPacket(mRTPSocket, buffer);
+    }
+
+    static void makePacket(uint16_t seqNumber, uint8_t *packet) {
+        memset(packet, 0xff, 12 + kPayloadSize);
+        packet[0] = 0x80;   // version 2
+        packet[1] = 0;      // PCMU
+        packet[2] = seqNumber >> 8;
+        packet[3] = seqNumber & 0xff;
+        uint32_t rtpTime = seqNumber * kPayloadSize;
+        packet[4] = rtpTime >> 24;
+        packet[5] = (rtpTime >> 16) & 0xff;
+        packet[6] = (rtpTime >> 8) & 0xff;
+        packet[7] = rtpTime & 0xff;
+        packet[8] = kSSRC >> 24;
+        packet[9] = (kSSRC >> 16) & 0xff;
+        packet[10] = (kSSRC >> 8) & 0xff;
+        packet[11] = kSSRC & 0xff;
+    }
+
+    static int64_t cpuTimeUs() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll
+                + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    }
+
+    sp<ALooper> mLooper;
+    sp<AccessUnitCollector> mCollector;
+    sp<ARTPConnection> mConnection;
+    int mSenderSocket;
+    int mRTPSocket;
+    int mRTCPSocket;
+    bool mInjected;
+};
+
+TEST_F(ARTPConnectionTest, ReceivesAtHighRate) {
+    ASSERT_NO_FATAL_FAILURE(startConnection(50000ll));
+
+    // over 100 Mbit/s, paced so that the socket buffer does not overflow
+    static const size_t kNumPackets = 50000;
+    static const size_t kBurstSize = 16;
+
+    int64_t startUs = ALooper::GetNowUs();
+    int64_t startCpuUs = cpuTimeUs();
+    for (size_t i = 0; i < kNumPackets; ++i) {
+        ASSERT_NO_FATAL_FAILURE(sendPacket(i & 0xffff));
+        if (i % kBurstSize == kBurstSize - 1) {
+            usleep(1000);
+        }
+    }
+    mCollector->waitForCount(kNumPackets, 2000000ll);
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+    int64_t cpuUs = cpuTimeUs() - startCpuUs;
+
+    size_t received = mCollector->count();
+    ALOGI("%zu of %zu packets in %lld us: %.0f packets/s, %.2f us of cpu per packet",
+            received, kNumPackets, (long long)elapsedUs,
+            received * 1E6 / elapsedUs, (double)cpuUs / received);
+
+    EXPECT_GE(received, kNumPackets * 99 / 100);
+
+    Vector<uint32_t> seqNumbers = mCollector->seqNumbers();
+    for (size_t i = 1; i < seqNumbers.size(); ++i) {
+        ASSERT_LT(seqNumbers[i - 1], seqNumbers[i]);
+    }
+}
+
+TEST_F(ARTPConnectionTest, ReordersAndSkipsLostPackets) {
+    ASSERT_NO_FATAL_FAILURE(startConnection(100000ll));
+
+    static const uint16_t kNumPackets = 200;
+    static const uint16_t kLostPacket = 101;
+
+    ASSERT_NO_FATAL_FAILURE(sendPacket(0));
+    for (uint16_t seqNumber = 1; seqNumber + 1 < kNumPackets; seqNumber += 2) {
+        // every other pair swapped
+        if (seqNumber + 1 != kLostPacket) {
+            ASSERT_NO_FATAL_FAILURE(sendPacket(seqNumber + 1));
+        }
+        if (seqNumber != kLostPacket) {
+            ASSERT_NO_FATAL_FAILURE(sendPacket(seqNumber));
+        }
+    }
+    ASSERT_NO_FATAL_FAILURE(sendPacket(kNumPackets - 1));
+
+    // the packets after the lost one come once it was waited for long enough
+    int64_t startUs = ALooper::GetNowUs();
+    ASSERT_TRUE(mCollector->waitForCount(kNumPackets - 1, 1000000ll));
+    int64_t waitedUs = ALooper::GetNowUs() - startUs;
+    EXPECT_LT(waitedUs, 500000ll);
+
+    Vector<uint32_t> seqNumbers = mCollector->seqNumbers();
+    ASSERT_EQ(kNumPackets - 1u, seqNumbers.size());
+    for (size_t i = 0; i < seqNumbers.size(); ++i) {
+        EXPECT_EQ(i < kLostPacket ? i : i + 1, seqNumbers[i]);
+    }
+}
+
+TEST_F(ARTPConnectionTest, HandsOverHeldInjectedPackets) {
+    ASSERT_NO_FATAL_FAILURE(startInjectedConnection(100000ll));
+
+    // no socket to wait on, and no packet after the one held
+    injectPacket(0);
+    injectPacket(2);
+
+    int64_t startUs = ALooper::GetNowUs();
+    ASSERT_TRUE(mCollector->waitForCount(2, 1000000ll));
+    int64_t waitedUs = ALooper::GetNowUs() - startUs;
+    EXPECT_GE(waitedUs, 90000ll);
+    EXPECT_LT(waitedUs, 500000ll);
+
+    Vector<uint32_t> seqNumbers = mCollector->seqNumbers();
+    ASSERT_EQ(2u, seqNumbers.size());
+    EXPECT_EQ(0u, seqNumbers[0]);
+    EXPECT_EQ(2u, seqNumbers[1]);
+}
+
+}  // namespace android
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "ARTPWriter_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <media/MediaSource.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MetaData.h>
+
+#include "ARTPWriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace android {
+
+static const uint16_t kRTPPort = 5634;   // where ARTPWriter sends to
+static const int32_t kNumFrames = 60;
+static const int64_t kFrameIntervalUs = 33333ll;
+static const size_t kKeyFrameSize = 60000;
+static const size_t kFrameSize = 3000;
+
+// An H.264 encoder at 30 fps, with a large key frame every 10 frames. Frames
+// become available in real time.
+struct FakeVideoSource : public MediaSource {
+    FakeVideoSource() : mNumFramesRead(0), mStartUs(-1) {}
+
+    virtual status_t start(MetaData * /* params */) {
+        mStartUs = ALooper::GetNowUs();
+        return OK;
+    }
+
+    virtual status_t stop() {
+        return OK;
+    }
+
+    virtual sp<MetaData> getFormat() {
+        sp<MetaData> format = new MetaData;
+        format->setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_AVC);
+        return format;
+    }
+
+    virtual status_t read(MediaBufferBase **buffer, const ReadOptions * /* options */) {
+        if (mNumFramesRead == kNumFrames) {
+            return ERROR_END_OF_STREAM;
+        }
+        int64_t timeUs = mNumFramesRead * kFrameIntervalUs;
+        int64_t delayUs = mStartUs + timeUs - ALooper::GetNowUs();
+        if (delayUs > 0) {
+            usleep(delayUs);
+        }
+
+        bool keyFrame = mNumFramesRead % 10 == 0;
+        MediaBuffer *frame = new MediaBuffer(keyFrame ? kKeyFrameSize : kFrameSize);
+        uint8_t *data = (uint8_t *)frame->data();
+        memset(data, 0xaa, frame->size());
+        memcpy(data, "\x00\x00\x00\x01", 4);
+        data[4] = keyFrame ? 0x65 : 0x41;
+        frame->meta_data().setInt64(kKeyTime, timeUs);
+
+        ++mNumFramesRead;
+        *buffer = frame;
+        return OK;
+    }
+
+private:
+    int32_t mNumFramesRead;
+    int64_t mStartUs;
+};
+
+struct Arrival {
+    int64_t timeUs;
+    uint16_t seqNumber;
+    uint32_t rtpTime;
+};
+
+class ARTPWriterTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        ASSERT_GE(mSocket, 0);
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(kRTPPort);
+        ASSERT_EQ(0, bind(mSocket, (const struct sockaddr *)&addr, sizeof(addr)));
+
+        int size = 4 * 1024 * 1024;
+        setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        struct timeval tv = { 0, 100000 };
+        setsockopt(mSocket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+    virtual void TearDown() {
+        close(mSocket);
+    }
+
+    // Streams all frames with |maxBurstPackets|, and records when each RTP
+    // packet arrived.
+    void stream(int32_t maxBurstPackets, std::vector<Arrival> *arrivals) {
+        int fd = open("/dev/null", O_WRONLY);
+        ASSERT_GE(fd, 0);
+        sp<ARTPWriter> writer = new ARTPWriter(fd, maxBurstPackets);
+        close(fd);
+        writer->addSource(new FakeVideoSource);
+
+        std::atomic<bool> done(false);
+        std::thread receiver([this, &done, arrivals] {
+            uint8_t packet[2048];
+            while (!done) {
+                ssize_t n = recv(mSocket, packet, sizeof(packet), 0);
+                if (n < 12) {
+                    continue;
+                }
+                Arrival arrival;
+                arrival.timeUs = ALooper::GetNowUs();
+                arrival.seqNumber = packet[2] << 8 | packet[3];
+                arrival.rtpTime = (uint32_t)packet[4] << 24 | packet[5] << 16
+                        | packet[6] << 8 | packet[7];
+                arrivals->push_back(arrival);
+            }
+        });
+
+        writer->start(NULL);
+        while (!writer->reachedEOS()) {
+            usleep(10000);
+        }
+        writer->stop();
+
+        usleep(100000);
+        done = true;
+        receiver.join();
+    }
+
+    // Packets less than this apart went out in one burst.
+    static const int64_t kBurstGapUs = 1000ll;
+
+    // Returns the longest time over which the packets of one frame arrived,
+    // and the size of the largest burst. Logs the number of bursts, which is
+    // how many sends there were at least, and how regular the packets of key
+    // frames were.
+    void analyze(const char *name, const std::vector<Arrival> &arrivals,
+            int64_t *maxFrameSpanUs, size_t *maxBurstSize) {
+        *maxFrameSpanUs = 0;
+        *maxBurstSize = 0;
+
+        size_t numBursts = 0;
+        size_t burstSize = 0;
+        int64_t frameStartUs = 0;
+        std::vector<double> intervalsUs;
+        for (size_t i = 0; i < arrivals.size(); ++i) {
+            const Arrival &arrival = arrivals[i];
+            bool newFrame = i == 0 || arrival.rtpTime != arrivals[i - 1].rtpTime;
+            if (i > 0) {
+                EXPECT_EQ((uint16_t)(arrivals[i - 1].seqNumber + 1), arrival.seqNumber);
+            }
+
+            if (newFrame) {
+                frameStartUs = arrival.timeUs;
+            } else {
+                *maxFrameSpanUs = std::max(*maxFrameSpanUs, arrival.timeUs - frameStartUs);
+                intervalsUs.push_back(arrival.timeUs - arrivals[i - 1].timeUs);
+            }
+
+            if (i == 0 || arrival.timeUs - arrivals[i - 1].timeUs >= kBurstGapUs) {
+                ++numBursts;
+                burstSize = 0;
+            }
+            *maxBurstSize = std::max(*maxBurstSize, ++burstSize);
+        }
+
+        double meanUs = 0;
+        for (double intervalUs : intervalsUs) {
+            meanUs += intervalUs;
+        }
+        meanUs /= std::max((size_t)1, intervalsUs.size());
+        double varianceUs = 0;
+        for (double intervalUs : intervalsUs) {
+            varianceUs += (intervalUs - meanUs) * (intervalUs - meanUs);
+        }
+        varianceUs /= std::max((size_t)1, intervalsUs.size());
+
+        ALOGI("%s: %zu packets in %zu bursts (at most %zu packets), "
+                "packet interval within frames %.0f +- %.0f us, frames spread over %lld us",
+                name, arrivals.size(), numBursts, *maxBurstSize,
+                meanUs, sqrt(varianceUs), (long long)*maxFrameSpanUs);
+    }
+
+    int mSocket;
+};
+
+TEST_F(ARTPWriterTest, PacesKeyFramesOverFrameInterval) {
+    std::vector<Arrival> arrivals;
+    ASSERT_NO_FATAL_FAILURE(stream(4, &arrivals));
+    ASSERT_FALSE(arrivals.empty());
+
+    int64_t maxFrameSpanUs;
+    size_t maxBurstSize;
+    analyze("paced", arrivals, &maxFrameSpanUs, &maxBurstSize);
+
+    // a key frame is some 40 packets, sent 4 at a time
+    EXPECT_GE(maxFrameSpanUs, kFrameIntervalUs / 2);
+    EXPECT_LT(maxFrameSpanUs, kFrameIntervalUs * 3 / 2);
+    EXPECT_LE(maxBurstSize, 8u);
+}
+
+TEST_F(ARTPWriterTest, SendsFramesAtOnceUnpaced) {
+    std::vector<Arrival> arrivals;
+    ASSERT_NO_FATAL_FAILURE(stream(0, &arrivals));
+    ASSERT_FALSE(arrivals.empty());
+
+    int64_t maxFrameSpanUs;
+    size_t maxBurstSize;
+    analyze("unpaced", arrivals, &maxFrameSpanUs, &maxBurstSize);
+
+    EXPECT_LT(maxFrameSpanUs, kFrameIntervalUs / 4);
+}
+
+}  // namespace android
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "FrameTrace_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/FrameTrace.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace android {
+
+typedef FrameTrace::TraceEvent TraceEvent;
+typedef FrameTrace::Frame Frame;
+
+TEST(FrameTraceTest, SnapshotsEmptyTrace) {
+    sp<FrameTrace> trace = new FrameTrace;
+    EXPECT_TRUE(trace->snapshot().empty());
+    EXPECT_TRUE(trace->frames().empty());
+
+    FrameTrace::Percentiles percentiles[FrameTrace::INTERVAL_COUNT];
+    trace->summarize(percentiles);
+    for (uint32_t i = 0; i < FrameTrace::INTERVAL_COUNT; ++i) {
+        EXPECT_EQ(0u, percentiles[i].count);
+        EXPECT_EQ(-1, percentiles[i].p50Us);
+        EXPECT_EQ(-1, percentiles[i].maxUs);
+    }
+}
+
+TEST(FrameTraceTest, KeepsNewestEventsAcrossWrap) {
+    sp<FrameTrace> trace = new FrameTrace;
+    const size_t numEvents = 3 * FrameTrace::kCapacity + 5;
+    for (size_t i = 0; i < numEvents; ++i) {
+        trace->record(i % 2 ? FrameTrace::DONE : FrameTrace::QUEUED, i, i * 1000);
+    }
+
+    std::vector<TraceEvent> events = trace->snapshot();
+    ASSERT_EQ(FrameTrace::kCapacity, events.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+        const size_t n = numEvents - FrameTrace::kCapacity + i;
+        EXPECT_EQ(n % 2 ? FrameTrace::DONE : FrameTrace::QUEUED, events[i].stage);
+        EXPECT_EQ((uint32_t)(n / 2), events[i].frame);     // counted per stage
+        EXPECT_EQ((int64_t)n, events[i].timeUs);
+        EXPECT_EQ((nsecs_t)n * 1000, events[i].nowNs);
+    }
+}
+
+TEST(FrameTraceTest, JoinsStagesByPresentationTime) {
+    sp<FrameTrace> trace = new FrameTrace;
+    // three frames, the codec returns the second one last
+    const int64_t timesUs[3] = { 0, 33333, 66666 };
+    nsecs_t nowNs = 1000000;
+    for (int64_t timeUs : timesUs) {
+        trace->record(FrameTrace::QUEUED, timeUs, nowNs += 1000);
+        trace->record(FrameTrace::SUBMITTED, timeUs, nowNs += 1000);
+    }
+    for (int i : { 0, 2, 1 }) {
+        trace->record(FrameTrace::DONE, timesUs[i], nowNs += 10000);
+        trace->record(FrameTrace::DEQUEUED, timesUs[i], nowNs += 3000);
+    }
+    trace->record(FrameTrace::RENDERED, timesUs[0], nowNs += 4000);
+    trace->record(FrameTrace::DROPPED, timesUs[2], nowNs += 5000);
+    // an output without an input timestamp
+    trace->record(FrameTrace::DONE, 99999, nowNs += 1000);
+
+    std::vector<Frame> frames = trace->frames();
+    ASSERT_EQ(4u, frames.size());
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(timesUs[i], frames[i].timeUs);
+        EXPECT_EQ(i, frames[i].frame);
+        EXPECT_EQ(1, frames[i].intervalUs(FrameTrace::LOOPER));
+        EXPECT_EQ(3, frames[i].intervalUs(FrameTrace::OUTPUT));
+    }
+
+    EXPECT_EQ(14, frames[0].intervalUs(FrameTrace::CODEC));
+    EXPECT_EQ(38, frames[1].intervalUs(FrameTrace::CODEC));    // returned last
+    EXPECT_EQ(23, frames[2].intervalUs(FrameTrace::CODEC));
+    EXPECT_EQ(1 + 38 + 3, frames[1].intervalUs(FrameTrace::TOTAL));
+
+    EXPECT_EQ(30, frames[0].intervalUs(FrameTrace::CLIENT));   // rendered
+    EXPECT_EQ(-1, frames[1].intervalUs(FrameTrace::CLIENT));   // still held
+    EXPECT_EQ(-1, frames[1].stageNs[FrameTrace::RENDERED]);
+    EXPECT_EQ(-1, frames[1].stageNs[FrameTrace::DROPPED]);
+    EXPECT_EQ(22, frames[2].intervalUs(FrameTrace::CLIENT));   // dropped
+
+    EXPECT_EQ(99999, frames[3].timeUs);
+    EXPECT_EQ(-1, frames[3].stageNs[FrameTrace::QUEUED]);
+    EXPECT_GE(frames[3].stageNs[FrameTrace::DONE], 0);
+    EXPECT_EQ(-1, frames[3].intervalUs(FrameTrace::CODEC));
+    EXPECT_EQ(-1, frames[3].intervalUs(FrameTrace::TOTAL));
+}
+
+TEST(FrameTraceTest, StartsNewFrameWhenTimeIsQueuedAgain) {
+    sp<FrameTrace> trace = new FrameTrace;
+    // e.g. after seeking back to the start
+    trace->record(FrameTrace::QUEUED, 0, 1000);
+    trace->record(FrameTrace::SUBMITTED, 0, 2000);
+    trace->record(FrameTrace::QUEUED, 0, 10000);
+    trace->record(FrameTrace::SUBMITTED, 0, 15000);
+
+    std::vector<Frame> frames = trace->frames();
+    ASSERT_EQ(2u, frames.size());
+    EXPECT_EQ(0u, frames[0].frame);
+    EXPECT_EQ(1, frames[0].intervalUs(FrameTrace::LOOPER));
+    EXPECT_EQ(1u, frames[1].frame);
+    EXPECT_EQ(5, frames[1].intervalUs(FrameTrace::LOOPER));
+}
+
+TEST(FrameTraceTest, SummarizesPercentiles) {
+    sp<FrameTrace> trace = new FrameTrace;
+    // looper latencies of 1..100 us, in shuffled order
+    for (int64_t i = 0; i < 100; ++i) {
+        const int64_t us = (i * 37) % 100 + 1;
+        const nsecs_t queuedNs = i * 1000000;
+        trace->record(FrameTrace::QUEUED, i, queuedNs);
+        trace->record(FrameTrace::SUBMITTED, i, queuedNs + us * 1000);
+    }
+
+    FrameTrace::Percentiles percentiles[FrameTrace::INTERVAL_COUNT];
+    trace->summarize(percentiles);
+
+    const FrameTrace::Percentiles &looper = percentiles[FrameTrace::LOOPER];
+    EXPECT_EQ(100u, looper.count);
+    EXPECT_EQ(50, looper.p50Us);
+    EXPECT_EQ(90, looper.p90Us);
+    EXPECT_EQ(99, looper.p99Us);
+    EXPECT_EQ(100, looper.maxUs);
+
+    for (FrameTrace::Interval interval :
+            { FrameTrace::CODEC, FrameTrace::OUTPUT, FrameTrace::CLIENT, FrameTrace::TOTAL }) {
+        EXPECT_EQ(0u, percentiles[interval].count) << FrameTrace::intervalName(interval);
+        EXPECT_EQ(-1, percentiles[interval].p99Us) << FrameTrace::intervalName(interval);
+    }
+}
+
+TEST(FrameTraceTest, SummarizesSingleSample) {
+    sp<FrameTrace> trace = new FrameTrace;
+    trace->record(FrameTrace::QUEUED, 0, 0);
+    trace->record(FrameTrace::SUBMITTED, 0, 7000);
+
+    FrameTrace::Percentiles percentiles[FrameTrace::INTERVAL_COUNT];
+    trace->summarize(percentiles);
+    const FrameTrace::Percentiles &looper = percentiles[FrameTrace::LOOPER];
+    EXPECT_EQ(1u, looper.count);
+    EXPECT_EQ(7, looper.p50Us);
+    EXPECT_EQ(7, looper.p99Us);
+    EXPECT_EQ(7, looper.maxUs);
+}
+
+TEST(FrameTraceTest, SnapshotsWhileRecording) {
+    sp<FrameTrace> trace = new FrameTrace;
+    const int64_t numEvents = 200 * FrameTrace::kCapacity;
+
+    // every field of an event is derived from its time, so a torn event shows
+    std::atomic<bool> done(false);
+    std::thread writer([trace, &done] {
+        for (int64_t i = 0; i < numEvents; ++i) {
+            trace->record(FrameTrace::QUEUED, i, i * 1000);
+        }
+        done = true;
+    });
+
+    // no ASSERTs until the writer is joined
+    size_t numSnapshots = 0;
+    bool consistent = true;
+    while (!done && consistent) {
+        std::vector<TraceEvent> events = trace->snapshot();
+        EXPECT_LE(events.size(), FrameTrace::kCapacity);
+        for (size_t i = 0; i < events.size() && consistent; ++i) {
+            const TraceEvent &event = events[i];
+            EXPECT_EQ(FrameTrace::QUEUED, event.stage);
+            EXPECT_EQ((uint32_t)event.timeUs, event.frame);
+            EXPECT_EQ((nsecs_t)event.timeUs * 1000, event.nowNs);
+            // oldest first; slots being written are skipped
+            if (i > 0) {
+                EXPECT_LT(events[i - 1].timeUs, event.timeUs);
+            }
+            consistent = !::testing::Test::HasFailure();
+        }
+        ++numSnapshots;
+    }
+    writer.join();
+    ALOGI("%zu snapshots while recording %lld events", numSnapshots, (long long)numEvents);
+
+    std::vector<TraceEvent> events = trace->snapshot();
+    ASSERT_EQ(FrameTrace::kCapacity, events.size());
+    EXPECT_EQ(numEvents - 1, events.back().timeUs);
+}
+
+}  // namespace android
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "MPEG4Writer_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <media/MediaSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/MPEG4Writer.h>
+#include <utils/String8.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace android {
+
+static const int32_t kNumVideoFrames = 90;
+static const size_t kVideoFrameSize = 50000;
+static const uint8_t kVideoByte = 0x11;
+
+static const int32_t kNumAudioFrames = 150;
+static const size_t kAudioFrameSize = 32;
+static const uint8_t kAudioByte = 0x22;
+
+// Produces |numFrames| frames of |frameSize| bytes, all |fill|, as fast as
+// they are read.
+struct FakeSource : public MediaSource {
+    FakeSource(const sp<MetaData> &format, int32_t numFrames, size_t frameSize,
+            int64_t frameDurationUs, uint8_t fill)
+        : mFormat(format),
+          mNumFrames(numFrames),
+          mFrameSize(frameSize),
+          mFrameDurationUs(frameDurationUs),
+          mFill(fill),
+          mNumFramesRead(0) {
+    }
+
+    virtual status_t start(MetaData * /* params */) {
+        return OK;
+    }
+
+    virtual status_t stop() {
+        return OK;
+    }
+
+    virtual sp<MetaData> getFormat() {
+        return mFormat;
+    }
+
+    virtual status_t read(MediaBufferBase **buffer, const ReadOptions * /* options */) {
+        if (mNumFramesRead == mNumFrames) {
+            return ERROR_END_OF_STREAM;
+        }
+
+        MediaBuffer *frame = new MediaBuffer(mFrameSize);
+        memset(frame->data(), mFill, mFrameSize);
+        int64_t timeUs = mNumFramesRead * mFrameDurationUs;
+        frame->meta_data().setInt64(kKeyTime, timeUs);
+        frame->meta_data().setInt64(kKeyDecodingTime, timeUs);
+        frame->meta_data().setInt32(kKeyIsSyncFrame, true);
+
+        ++mNumFramesRead;
+        *buffer = frame;
+        return OK;
+    }
+
+private:
+    sp<MetaData> mFormat;
+    int32_t mNumFrames;
+    size_t mFrameSize;
+    int64_t mFrameDurationUs;
+    uint8_t mFill;
+    int32_t mNumFramesRead;
+};
+
+class MPEG4WriterTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        strcpy(mPath, "/data/local/tmp/MPEG4Writer_test.XXXXXX");
+        mFd = mkstemp(mPath);
+        ASSERT_GE(mFd, 0);
+    }
+
+    virtual void TearDown() {
+        close(mFd);
+        unlink(mPath);
+    }
+
+    // Records a video and an audio track to |fd| with the given staging buffer
+    // size, and returns what dump() says about the sample writes and what
+    // stop() returned.
+    void record(int fd, int32_t writeBehindSize, String8 *stats, status_t *stopStatus) {
+        sp<MetaData> videoFormat = new MetaData;
+        videoFormat->setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_H263);
+        videoFormat->setInt32(kKeyWidth, 176);
+        videoFormat->setInt32(kKeyHeight, 144);
+
+        sp<MetaData> audioFormat = new MetaData;
+        audioFormat->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_AMR_NB);
+        audioFormat->setInt32(kKeySampleRate, 8000);
+        audioFormat->setInt32(kKeyChannelCount, 1);
+
+        sp<MPEG4Writer> writer = new MPEG4Writer(fd);
+        writer->setInterleaveDuration(200000);
+        ASSERT_EQ(OK, writer->addSource(new FakeSource(
+                videoFormat, kNumVideoFrames, kVideoFrameSize, 33333ll, kVideoByte)));
+        ASSERT_EQ(OK, writer->addSource(new FakeSource(
+                audioFormat, kNumAudioFrames, kAudioFrameSize, 20000ll, kAudioByte)));
+
+        sp<MetaData> params = new MetaData;
+        params->setInt32(kKeyWriteBehindSize, writeBehindSize);
+        ASSERT_EQ(OK, writer->start(params.get()));
+        while (!writer->reachedEOS()) {
+            usleep(10000);
+        }
+
+        int fds[2];
+        ASSERT_EQ(0, pipe(fds));
+        writer->dump(fds[1], Vector<String16>());
+        close(fds[1]);
+        char buffer[1024];
+        ssize_t n;
+        while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+            stats->append(buffer, n);
+        }
+        close(fds[0]);
+
+        *stopStatus = writer->stop();
+    }
+
+    // Checks that all sample data made it into the 'mdat' box.
+    void verifyMediaData() {
+        off64_t size = lseek64(mFd, 0, SEEK_END);
+        ASSERT_GT(size, 0);
+        uint8_t *data = new uint8_t[size];
+        ASSERT_EQ(size, pread64(mFd, data, size, 0));
+
+        uint8_t *mdat = (uint8_t *)memmem(data, size, "mdat", 4);
+        ASSERT_TRUE(mdat != NULL);
+        ASSERT_GE(mdat - data, 4);
+        size_t mdatSize = U32_AT(mdat - 4);
+        ASSERT_LE(mdat - 4 + mdatSize, data + size);
+
+        size_t numVideoBytes = 0;
+        size_t numAudioBytes = 0;
+        for (const uint8_t *ptr = mdat + 4; ptr < mdat - 4 + mdatSize; ++ptr) {
+            if (*ptr == kVideoByte) {
+                ++numVideoBytes;
+            } else if (*ptr == kAudioByte) {
+                ++numAudioBytes;
+            }
+        }
+        EXPECT_EQ(8 + kNumVideoFrames * kVideoFrameSize + kNumAudioFrames * kAudioFrameSize,
+                mdatSize);
+        EXPECT_EQ(kNumVideoFrames * kVideoFrameSize, numVideoBytes);
+        EXPECT_EQ(kNumAudioFrames * kAudioFrameSize, numAudioBytes);
+
+        delete[] data;
+    }
+
+    static uint32_t U32_AT(const uint8_t *ptr) {
+        return ptr[0] << 24 | ptr[1] << 16 | ptr[2] << 8 | ptr[3];
+    }
+
+    char mPath[64];
+    int mFd;
+};
+
+TEST_F(MPEG4WriterTest, WritesChunksVectored) {
+    String8 stats;
+    status_t stopStatus;
+    ASSERT_NO_FATAL_FAILURE(record(mFd, 0, &stats, &stopStatus));
+    EXPECT_EQ(OK, stopStatus);
+    ALOGI("%s", stats.string());
+    EXPECT_TRUE(strstr(stats.string(), "sample writes:") != NULL);
+    EXPECT_TRUE(strstr(stats.string(), "write-behind") == NULL);
+
+    ASSERT_NO_FATAL_FAILURE(verifyMediaData());
+}
+
+TEST_F(MPEG4WriterTest, WritesBehind) {
+    // smaller than a video chunk, so that the staging buffers take turns
+    String8 stats;
+    status_t stopStatus;
+    ASSERT_NO_FATAL_FAILURE(record(mFd, 256 * 1024, &stats, &stopStatus));
+    EXPECT_EQ(OK, stopStatus);
+    ALOGI("%s", stats.string());
+    EXPECT_TRUE(strstr(stats.string(), "write-behind") != NULL);
+
+    ASSERT_NO_FATAL_FAILURE(verifyMediaData());
+}
+
+TEST_F(MPEG4WriterTest, ReturnsWriteErrorFromStop) {
+    int fd = open(mPath, O_RDONLY);
+    ASSERT_GE(fd, 0);
+    for (int32_t writeBehindSize : { 0, 256 * 1024 }) {
+        String8 stats;
+        status_t stopStatus;
+        ASSERT_NO_FATAL_FAILURE(record(fd, writeBehindSize, &stats, &stopStatus));
+        EXPECT_NE(OK, stopStatus) << "write-behind size " << writeBehindSize;
+    }
+    close(fd);
+}
+
+}  // namespace android
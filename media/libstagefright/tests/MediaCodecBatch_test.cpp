@@ -0,0 +1,225 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "MediaCodecBatch_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <binder/ProcessState.h>
+#include <media/MediaCodecBuffer.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaErrors.h>
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+namespace android {
+
+typedef MediaCodec::BatchBuffer BatchBuffer;
+
+// G.711 decodes every input buffer into one output buffer of twice the size.
+static const char kMime[] = "audio/g711-alaw";
+static const size_t kFrameSize = 160;   // 20ms at 8kHz
+static const int64_t kFrameDurationUs = 20000ll;
+
+// How long a test waits for something that should happen right away.
+static const int64_t kTimeoutUs = 5000000ll;
+
+class MediaCodecBatchTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        ProcessState::self()->startThreadPool();
+
+        mLooper = new ALooper;
+        mLooper->setName("MediaCodecBatch_test");
+        mLooper->start();
+
+        mCodec = MediaCodec::CreateByType(mLooper, kMime, false /* encoder */);
+        ASSERT_TRUE(mCodec != NULL);
+
+        sp<AMessage> format = new AMessage;
+        format->setString("mime", kMime);
+        format->setInt32("channel-count", 1);
+        format->setInt32("sample-rate", 8000);
+        ASSERT_EQ(OK, mCodec->configure(format, NULL, NULL, 0 /* flags */));
+        ASSERT_EQ(OK, mCodec->start());
+
+        mNextTimeUs = 0;
+    }
+
+    virtual void TearDown() {
+        if (mCodec != NULL) {
+            mCodec->release();
+            mCodec.clear();
+        }
+        mLooper->stop();
+    }
+
+    // Dequeues an input buffer and fills it with a frame.
+    void dequeueInput(BatchBuffer *input) {
+        ASSERT_EQ(OK, mCodec->dequeueInputBuffer(&input->index, kTimeoutUs));
+        sp<MediaCodecBuffer> buffer;
+        ASSERT_EQ(OK, mCodec->getInputBuffer(input->index, &buffer));
+        ASSERT_GE(buffer->capacity(), kFrameSize);
+        memset(buffer->base(), 0xd5, kFrameSize);   // A-law silence
+        input->offset = 0;
+        input->size = kFrameSize;
+        input->presentationTimeUs = mNextTimeUs;
+        input->flags = 0;
+        mNextTimeUs += kFrameDurationUs;
+    }
+
+    // Dequeues output buffers in batches until |count| are taken, skipping
+    // format and buffer changes, and releases them. Returns their times.
+    void takeOutput(size_t count, std::vector<int64_t> *timesUs) {
+        while (timesUs->size() < count) {
+            std::vector<BatchBuffer> outputs;
+            status_t err = mCodec->dequeueOutputBuffers(&outputs, 4, kTimeoutUs);
+            if (err == INFO_FORMAT_CHANGED || err == INFO_OUTPUT_BUFFERS_CHANGED) {
+                EXPECT_TRUE(outputs.empty());
+                continue;
+            }
+            ASSERT_EQ(OK, err);
+            ASSERT_FALSE(outputs.empty());
+            ASSERT_LE(outputs.size(), 4u);
+            for (const BatchBuffer &output : outputs) {
+                EXPECT_EQ(2 * kFrameSize, output.size);
+                timesUs->push_back(output.presentationTimeUs);
+                ASSERT_EQ(OK, mCodec->releaseOutputBuffer(output.index));
+            }
+        }
+    }
+
+    // Starts two output dequeues at once, with no output to be had until an
+    // input buffer is queued after one of them returned. Returns what each
+    // one returned.
+    void dequeueTwice(bool firstBatch, bool secondBatch, status_t *first, status_t *second) {
+        // any format change is out of the way first
+        BatchBuffer input;
+        ASSERT_NO_FATAL_FAILURE(dequeueInput(&input));
+        size_t numQueued;
+        ASSERT_EQ(OK, mCodec->queueInputBuffers({ input }, &numQueued));
+        std::vector<int64_t> timesUs;
+        ASSERT_NO_FATAL_FAILURE(takeOutput(1, &timesUs));
+        ASSERT_NO_FATAL_FAILURE(dequeueInput(&input));
+
+        sp<MediaCodec> codec = mCodec;
+        auto dequeue = [codec](bool batch) {
+            status_t err;
+            size_t index;
+            if (batch) {
+                std::vector<BatchBuffer> outputs;
+                err = codec->dequeueOutputBuffers(&outputs, 4, kTimeoutUs);
+                index = outputs.empty() ? SIZE_MAX : outputs[0].index;
+            } else {
+                size_t offset, size;
+                int64_t timeUs;
+                uint32_t flags;
+                err = codec->dequeueOutputBuffer(
+                        &index, &offset, &size, &timeUs, &flags, kTimeoutUs);
+            }
+            if (err == OK) {
+                codec->releaseOutputBuffer(index);
+            }
+            return err;
+        };
+        std::future<status_t> firstResult = std::async(std::launch::async, dequeue, firstBatch);
+        std::future<status_t> secondResult = std::async(std::launch::async, dequeue, secondBatch);
+
+        // whichever came second is turned away without waiting
+        std::chrono::microseconds timeout(kTimeoutUs);
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (firstResult.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready
+                && secondResult.wait_for(std::chrono::milliseconds(1))
+                        != std::future_status::ready
+                && std::chrono::steady_clock::now() < deadline) {
+        }
+
+        EXPECT_EQ(OK, mCodec->queueInputBuffers({ input }, &numQueued));
+        *first = firstResult.get();
+        *second = secondResult.get();
+    }
+
+    sp<ALooper> mLooper;
+    sp<MediaCodec> mCodec;
+    int64_t mNextTimeUs;
+};
+
+TEST_F(MediaCodecBatchTest, QueuesAndDequeuesBatches) {
+    std::vector<BatchBuffer> inputs(4);
+    for (BatchBuffer &input : inputs) {
+        ASSERT_NO_FATAL_FAILURE(dequeueInput(&input));
+    }
+    size_t numQueued;
+    ASSERT_EQ(OK, mCodec->queueInputBuffers(inputs, &numQueued));
+    EXPECT_EQ(inputs.size(), numQueued);
+
+    std::vector<int64_t> timesUs;
+    ASSERT_NO_FATAL_FAILURE(takeOutput(inputs.size(), &timesUs));
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        EXPECT_EQ(inputs[i].presentationTimeUs, timesUs[i]);
+    }
+}
+
+TEST_F(MediaCodecBatchTest, StopsAtFirstBadInputBuffer) {
+    std::vector<BatchBuffer> inputs(3);
+    for (BatchBuffer &input : inputs) {
+        ASSERT_NO_FATAL_FAILURE(dequeueInput(&input));
+    }
+    // the second one again, which is no longer the client's once queued
+    inputs.insert(inputs.begin() + 2, inputs[1]);
+
+    size_t numQueued;
+    EXPECT_NE(OK, mCodec->queueInputBuffers(inputs, &numQueued));
+    EXPECT_EQ(2u, numQueued);
+
+    // the ones before it are decoded, and the last one is still the client's
+    std::vector<int64_t> timesUs;
+    ASSERT_NO_FATAL_FAILURE(takeOutput(2, &timesUs));
+    EXPECT_EQ(inputs[0].presentationTimeUs, timesUs[0]);
+    EXPECT_EQ(inputs[1].presentationTimeUs, timesUs[1]);
+
+    ASSERT_EQ(OK, mCodec->queueInputBuffers({ inputs[3] }, &numQueued));
+    EXPECT_EQ(1u, numQueued);
+    timesUs.clear();
+    ASSERT_NO_FATAL_FAILURE(takeOutput(1, &timesUs));
+    EXPECT_EQ(inputs[3].presentationTimeUs, timesUs[0]);
+}
+
+TEST_F(MediaCodecBatchTest, RejectsOverlappingDequeues) {
+    for (bool firstBatch : { true, false }) {
+        for (bool secondBatch : { true, false }) {
+            if (!firstBatch && !secondBatch) {
+                continue;   // not the batch API
+            }
+            SCOPED_TRACE(testing::Message() << "batch " << firstBatch << "/" << secondBatch);
+            status_t first, second;
+            ASSERT_NO_FATAL_FAILURE(dequeueTwice(firstBatch, secondBatch, &first, &second));
+
+            // one waited for the output, the other one was turned away
+            EXPECT_TRUE((first == OK && second == INVALID_OPERATION)
+                    || (first == INVALID_OPERATION && second == OK))
+                    << "returned " << first << " and " << second;
+        }
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "NuCachedSource2_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include "include/HTTPBase.h"
+#include "include/NuCachedSource2.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <unistd.h>
+
+namespace android {
+
+static const off64_t kSourceSize = 8 * 1024 * 1024;
+static const size_t kReadSize = 16 * 1024;
+static const off64_t kPlayedSize = 4 * 1024 * 1024;
+static const int64_t kRequestLatencyUs = 10000ll;   // 10ms per request
+static const char kSpillDir[] = "/data/local/tmp";
+
+// Stands in for an http server: every request takes a while, and the bytes it
+// serves more than once are counted.
+struct FakeHTTPSource : public HTTPBase {
+    FakeHTTPSource() : mServedEnd(0), mBytesRefetched(0) {}
+
+    virtual status_t connect(
+            const char * /* uri */,
+            const KeyedVector<String8, String8> * /* headers */,
+            off64_t /* offset */) {
+        return OK;
+    }
+
+    virtual void disconnect() {}
+
+    virtual status_t initCheck() const {
+        return OK;
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        usleep(kRequestLatencyUs);
+        if (offset >= kSourceSize) {
+            return 0;
+        }
+        size = std::min(size, (size_t)(kSourceSize - offset));
+        for (size_t i = 0; i < size; ++i) {
+            ((uint8_t *)data)[i] = byteAt(offset + i);
+        }
+        if (offset < mServedEnd) {
+            mBytesRefetched += std::min(offset + (off64_t)size, mServedEnd.load()) - offset;
+        }
+        mServedEnd = std::max(mServedEnd.load(), offset + (off64_t)size);
+        return size;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        *size = kSourceSize;
+        return OK;
+    }
+
+    virtual uint32_t flags() {
+        return kIsHTTPBasedSource;
+    }
+
+    static uint8_t byteAt(off64_t offset) {
+        return (offset * 31 + (offset >> 12)) & 0xff;
+    }
+
+    size_t bytesRefetched() const {
+        return mBytesRefetched;
+    }
+
+private:
+    std::atomic<off64_t> mServedEnd;
+    std::atomic<size_t> mBytesRefetched;
+};
+
+class NuCachedSource2Test : public ::testing::Test {
+protected:
+    // Plays the first kPlayedSize bytes, then seeks back to the start. Returns
+    // how many bytes of the first read after the seek came from the disk cache,
+    // and how many bytes the server had to send again.
+    void playAndSeekBack(const char *cacheConfig, size_t *seekSpillRead, size_t *refetched) {
+        sp<FakeHTTPSource> http = new FakeHTTPSource;
+        sp<NuCachedSource2> source = NuCachedSource2::Create(
+                http, cacheConfig, false /* disconnectAtHighwatermark */, kSpillDir);
+
+        std::vector<uint8_t> buffer(kReadSize);
+        for (off64_t offset = 0; offset < kPlayedSize; offset += kReadSize) {
+            ASSERT_EQ((ssize_t)kReadSize, source->readAt(offset, buffer.data(), kReadSize));
+        }
+        ASSERT_EQ(FakeHTTPSource::byteAt(kPlayedSize - 1), buffer[kReadSize - 1]);
+
+        size_t spillRead = source->spillBytesRead();
+        ASSERT_EQ((ssize_t)kReadSize, source->readAt(0, buffer.data(), kReadSize));
+        *seekSpillRead = source->spillBytesRead() - spillRead;
+        for (size_t i = 0; i < kReadSize; ++i) {
+            ASSERT_EQ(FakeHTTPSource::byteAt(i), buffer[i]) << "at " << i;
+        }
+        *refetched = http->bytesRefetched();
+        ALOGI("%s: seek back read %zu bytes from disk, %zu bytes fetched again",
+                cacheConfig, *seekSpillRead, *refetched);
+    }
+};
+
+TEST_F(NuCachedSource2Test, SeekBackWithoutSpill) {
+    size_t spillRead;
+    size_t refetched;
+    playAndSeekBack("256/1024/0", &spillRead, &refetched);
+
+    EXPECT_EQ(0u, spillRead);
+    EXPECT_GT(refetched, 0u);
+}
+
+TEST_F(NuCachedSource2Test, SeekBackServedFromSpill) {
+    size_t spillRead;
+    size_t refetched;
+    playAndSeekBack("256/1024/0/8192", &spillRead, &refetched);
+
+    EXPECT_GE(spillRead, kReadSize);
+    EXPECT_EQ(0u, refetched);
+}
+
+TEST_F(NuCachedSource2Test, SpillIsBounded) {
+    size_t spillRead;
+    size_t refetched;
+    // only the last 1MB played fits on disk; the start has to be fetched again
+    playAndSeekBack("256/1024/0/1024", &spillRead, &refetched);
+
+    EXPECT_EQ(0u, spillRead);
+    EXPECT_GT(refetched, 0u);
+}
+
+TEST_F(NuCachedSource2Test, SpillSizeIsBounded) {
+    size_t spillRead;
+    size_t refetched;
+    // a negative or huge size must not overflow into a usable disk cache size
+    playAndSeekBack("256/1024/0/-1", &spillRead, &refetched);
+    EXPECT_EQ(0u, spillRead);
+
+    playAndSeekBack("256/1024/0/2147483647", &spillRead, &refetched);
+    EXPECT_GE(spillRead, kReadSize);
+    EXPECT_EQ(0u, refetched);
+}
+
+}  // namespace android
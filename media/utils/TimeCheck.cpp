@@ -15,7 +15,13 @@
  */
 
 
+#include <algorithm>
+#include <inttypes.h>
+#include <memory>
+#include <string.h>
+
 #include <utils/Log.h>
+#include <media/MediaAnalyticsItem.h>
 #include <media/TimeCheck.h>
 #include <media/EventLog.h>
 
@@ -29,14 +35,216 @@ sp<TimeCheck::TimeCheckThread> TimeCheck::getTimeCheckThread()
 }
 
 TimeCheck::TimeCheck(const char *tag, uint32_t timeoutMs)
-    : mEndTimeNs(getTimeCheckThread()->startMonitoring(tag, timeoutMs))
+    : mEndTimeNs(getTimeCheckThread()->startMonitoring(tag, timeoutMs)),
+      mStartTimeNs(0), mInterfaceIndex(-1), mCode(0)
+{
+}
+
+TimeCheck::TimeCheck(const char *tag, const char *interfaceName, uint32_t code,
+                     uint32_t timeoutMs)
+    : mEndTimeNs(getTimeCheckThread()->startMonitoring(tag, timeoutMs)),
+      mStartTimeNs(systemTime()),
+      mInterfaceIndex(LatencyHistograms::getInterfaceIndex(interfaceName)),
+      mCode(code)
 {
 }
 
 TimeCheck::~TimeCheck() {
     getTimeCheckThread()->stopMonitoring(mEndTimeNs);
+    if (mInterfaceIndex >= 0) {
+        const nsecs_t nowNs = systemTime();
+        LatencyHistograms::record(mInterfaceIndex, mCode, nowNs - mStartTimeNs);
+        LatencyHistograms::sendStatistics(nowNs);
+    }
+}
+
+/* static */
+std::string TimeCheck::dumpLatencies()
+{
+    return LatencyHistograms::dump();
+}
+
+// ----------------------------------------------------------------------------
+
+std::atomic<const char *> TimeCheck::LatencyHistograms::sInterfaceNames[kMaxInterfaces];
+std::atomic<nsecs_t> TimeCheck::LatencyHistograms::sNextReportTimeNs(0);
+std::mutex TimeCheck::LatencyHistograms::sThreadsLock;
+std::vector<TimeCheck::LatencyHistograms::ThreadHistograms *>
+        TimeCheck::LatencyHistograms::sThreads;
+
+/* static */
+int TimeCheck::LatencyHistograms::getInterfaceIndex(const char *interfaceName)
+{
+    for (size_t i = 0; i < kMaxInterfaces; ++i) {
+        const char *name = sInterfaceNames[i].load(std::memory_order_acquire);
+        if (name == nullptr) {
+            // claim the free slot, or check the name installed by a concurrent caller
+            if (sInterfaceNames[i].compare_exchange_strong(name, interfaceName)) {
+                return i;
+            }
+        }
+        if (name == interfaceName || strcmp(name, interfaceName) == 0) {
+            return i;
+        }
+    }
+    ALOGW("%s: no room for interface %s", __func__, interfaceName);
+    return -1;
+}
+
+/* static */
+TimeCheck::LatencyHistograms::ThreadHistograms *
+        TimeCheck::LatencyHistograms::getThreadHistograms()
+{
+    thread_local ThreadHistograms *tHistograms = nullptr;
+    if (tHistograms == nullptr) {
+        tHistograms = new ThreadHistograms{};
+        std::lock_guard<std::mutex> _l(sThreadsLock);
+        sThreads.push_back(tHistograms);
+    }
+    return tHistograms;
+}
+
+/* static */
+void TimeCheck::LatencyHistograms::record(int interfaceIndex, uint32_t code, nsecs_t latencyNs)
+{
+    if (code >= kMaxCodes) {
+        return;
+    }
+    const uint64_t latencyUs = latencyNs > 0 ? (uint64_t)latencyNs / 1000 : 0;
+    size_t bucket = 0;
+    for (uint64_t limitUs = kFirstBucketUs;
+            latencyUs >= limitUs && bucket < kNumBuckets - 1; limitUs <<= 1) {
+        ++bucket;
+    }
+    const uint32_t clampedUs = latencyUs > UINT32_MAX ? UINT32_MAX : (uint32_t)latencyUs;
+
+    // only this thread writes its histograms, so relaxed load/store pairs are sufficient
+    ThreadHistograms *h = getThreadHistograms();
+    auto &count = h->buckets[interfaceIndex][code][bucket];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    auto &total = h->totalUs[interfaceIndex][code];
+    total.store(total.load(std::memory_order_relaxed) + latencyUs, std::memory_order_relaxed);
+    auto &max = h->maxUs[interfaceIndex][code];
+    if (clampedUs > max.load(std::memory_order_relaxed)) {
+        max.store(clampedUs, std::memory_order_relaxed);
+    }
 }
 
+/* static */
+std::vector<TimeCheck::LatencyHistograms::MethodStats> TimeCheck::LatencyHistograms::getStats()
+{
+    std::vector<MethodStats> stats;
+    std::lock_guard<std::mutex> _l(sThreadsLock);
+    for (size_t i = 0; i < kMaxInterfaces; ++i) {
+        const char *name = sInterfaceNames[i].load(std::memory_order_acquire);
+        if (name == nullptr) {
+            break;
+        }
+        for (uint32_t code = 0; code < kMaxCodes; ++code) {
+            MethodStats method{};
+            method.interfaceName = name;
+            method.code = code;
+            for (const ThreadHistograms *h : sThreads) {
+                for (size_t b = 0; b < kNumBuckets; ++b) {
+                    const uint32_t count = h->buckets[i][code][b].load(std::memory_order_relaxed);
+                    method.buckets[b] += count;
+                    method.count += count;
+                }
+                method.totalUs += h->totalUs[i][code].load(std::memory_order_relaxed);
+                method.maxUs = std::max(method.maxUs,
+                        h->maxUs[i][code].load(std::memory_order_relaxed));
+            }
+            if (method.count != 0) {
+                stats.push_back(method);
+            }
+        }
+    }
+    return stats;
+}
+
+uint32_t TimeCheck::LatencyHistograms::MethodStats::percentileUs(double percentile) const
+{
+    const uint64_t target = (uint64_t)(count * percentile / 100.);
+    uint64_t accumulated = 0;
+    for (size_t b = 0; b < kNumBuckets - 1; ++b) {
+        accumulated += buckets[b];
+        if (accumulated > target) {
+            return std::min(kFirstBucketUs << b, maxUs);
+        }
+    }
+    return maxUs;
+}
+
+/* static */
+std::string TimeCheck::LatencyHistograms::dump()
+{
+    const std::vector<MethodStats> stats = getStats();
+    std::string result("TimeCheck latencies (us):\n");
+    if (stats.empty()) {
+        result.append("  none\n");
+        return result;
+    }
+    char buffer[256];
+    for (const auto &method : stats) {
+        snprintf(buffer, sizeof(buffer),
+                "  %s code %u: count %" PRIu64 " mean %" PRIu64 " p50 %u p90 %u p99 %u max %u\n"
+                "    buckets:",
+                method.interfaceName, method.code, method.count,
+                method.totalUs / method.count, method.percentileUs(50.),
+                method.percentileUs(90.), method.percentileUs(99.), method.maxUs);
+        result.append(buffer);
+        for (size_t b = 0; b < kNumBuckets; ++b) {
+            if (b < kNumBuckets - 1) {
+                snprintf(buffer, sizeof(buffer), " <%u:%" PRIu64,
+                        kFirstBucketUs << b, method.buckets[b]);
+            } else {
+                snprintf(buffer, sizeof(buffer), " >=%u:%" PRIu64,
+                        kFirstBucketUs << (b - 1), method.buckets[b]);
+            }
+            result.append(buffer);
+        }
+        result.append("\n");
+    }
+    return result;
+}
+
+/* static */
+void TimeCheck::LatencyHistograms::sendStatistics(nsecs_t nowNs)
+{
+    nsecs_t nextReportTimeNs = sNextReportTimeNs.load(std::memory_order_relaxed);
+    if (nextReportTimeNs == 0) {
+        // first call: start the reporting period
+        sNextReportTimeNs.compare_exchange_strong(nextReportTimeNs, nowNs + kReportPeriodNs);
+        return;
+    }
+    // only the thread advancing the report time sends the statistics
+    if (nowNs < nextReportTimeNs || !sNextReportTimeNs.compare_exchange_strong(
+            nextReportTimeNs, nowNs + kReportPeriodNs)) {
+        return;
+    }
+
+    std::unique_ptr<MediaAnalyticsItem> item(MediaAnalyticsItem::create("audiobinder"));
+
+#define MM_PREFIX "android.media.audiobinder." // avoid cut-n-paste errors.
+
+    for (const auto &method : getStats()) {
+        const std::string prefix = std::string(MM_PREFIX) + method.interfaceName + "."
+                + std::to_string(method.code) + ".";
+        item->setInt64((prefix + "count").c_str(), (int64_t)method.count);
+        item->setInt64((prefix + "meanUs").c_str(), (int64_t)(method.totalUs / method.count));
+        item->setInt32((prefix + "p50Us").c_str(), (int32_t)method.percentileUs(50.));
+        item->setInt32((prefix + "p90Us").c_str(), (int32_t)method.percentileUs(90.));
+        item->setInt32((prefix + "p99Us").c_str(), (int32_t)method.percentileUs(99.));
+        item->setInt32((prefix + "maxUs").c_str(), (int32_t)method.maxUs);
+    }
+
+#undef MM_PREFIX
+
+    item->selfrecord();
+}
+
+// ----------------------------------------------------------------------------
+
 TimeCheck::TimeCheckThread::~TimeCheckThread()
 {
     AutoMutex _l(mMutex);
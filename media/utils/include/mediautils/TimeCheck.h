@@ -18,6 +18,11 @@
 #ifndef ANDROID_TIME_CHECK_H
 #define ANDROID_TIME_CHECK_H
 
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <utils/KeyedVector.h>
 #include <utils/Thread.h>
 
@@ -25,7 +30,9 @@
 namespace android {
 
 // A class monitoring execution time for a code block (scoped variable) and causing an assert
-// if it exceeds a certain time
+// if it exceeds a certain time.
+// When constructed with an interface name and a method code, the execution time is also
+// recorded in a per method latency histogram which can be dumped or sent to media.metrics.
 
 class TimeCheck {
 public:
@@ -34,10 +41,66 @@ public:
     static constexpr uint32_t kDefaultTimeOutMs = 5000;
 
             TimeCheck(const char *tag, uint32_t timeoutMs = kDefaultTimeOutMs);
+            // interfaceName must be a string literal or otherwise outlive the process.
+            TimeCheck(const char *tag, const char *interfaceName, uint32_t code,
+                      uint32_t timeoutMs = kDefaultTimeOutMs);
             ~TimeCheck();
 
+    // Returns the latency histograms of all monitored methods, merged across threads.
+    static  std::string dumpLatencies();
+
 private:
 
+    // Lock-free latency histograms: each thread owns its buckets and is the only writer,
+    // readers merge all threads' buckets on dump.
+    class LatencyHistograms {
+    public:
+        static constexpr size_t kMaxInterfaces = 2; // IAudioFlinger and IAudioPolicyService
+        static constexpr size_t kMaxCodes = 128;
+        // Bucket 0 holds latencies below kFirstBucketUs, bucket i > 0 holds latencies
+        // in [kFirstBucketUs << (i - 1), kFirstBucketUs << i), the last bucket is open ended.
+        static constexpr size_t kNumBuckets = 16;
+        static constexpr uint32_t kFirstBucketUs = 64;
+
+        struct MethodStats {
+            const char *interfaceName;
+            uint32_t    code;
+            uint64_t    count;
+            uint64_t    totalUs;
+            uint32_t    maxUs;
+            uint64_t    buckets[kNumBuckets];
+
+            // returns the upper bound in us of the bucket containing the given percentile
+            uint32_t    percentileUs(double percentile) const;
+        };
+
+                // returns the interface index or -1 if the table is full
+        static  int         getInterfaceIndex(const char *interfaceName);
+        static  void        record(int interfaceIndex, uint32_t code, nsecs_t latencyNs);
+        static  std::vector<MethodStats> getStats();
+        static  std::string dump();
+                // sends the merged histograms to media.metrics at most every kReportPeriodNs
+        static  void        sendStatistics(nsecs_t nowNs);
+
+    private:
+        static constexpr nsecs_t kReportPeriodNs = 12 * 3600 * 1000000000LL;
+
+        struct ThreadHistograms {
+            std::atomic<uint32_t> buckets[kMaxInterfaces][kMaxCodes][kNumBuckets];
+            std::atomic<uint64_t> totalUs[kMaxInterfaces][kMaxCodes];
+            std::atomic<uint32_t> maxUs[kMaxInterfaces][kMaxCodes];
+        };
+
+        static  ThreadHistograms *getThreadHistograms();
+
+        static  std::atomic<const char *> sInterfaceNames[kMaxInterfaces];
+        static  std::atomic<nsecs_t>      sNextReportTimeNs;
+                // Per thread histograms are retained for the process lifetime so that
+                // the merged view includes threads which have exited.
+        static  std::mutex                      sThreadsLock;
+        static  std::vector<ThreadHistograms *> sThreads; // guarded by sThreadsLock
+    };
+
     class TimeCheckThread : public Thread {
     public:
 
@@ -65,6 +128,9 @@ private:
     static sp<TimeCheckThread> getTimeCheckThread();
 
     const           nsecs_t mEndTimeNs;
+    const           nsecs_t mStartTimeNs;
+    const           int     mInterfaceIndex;
+    const           uint32_t mCode;
 };
 
 }; // namespace android
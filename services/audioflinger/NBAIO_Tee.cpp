@@ -23,14 +23,19 @@
 #include <dirent.h>
 #include <future>
 #include <list>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <thread>
 #include <vector>
 
 #include <audio_utils/format.h>
 #include <audio_utils/sndfile.h>
 #include <media/nbaio/PipeReader.h>
+#include <system/thread_defs.h>
 
 #include "Configuration.h"
 #include "NBAIO_Tee.h"
+#include "TeeCodec.h"
 
 // Enabled with TEE_SINK in Configuration.h
 #ifdef TEE_SINK
@@ -65,6 +70,14 @@ static constexpr char DEFAULT_PREFIX[] = "aftee_";
 static constexpr char DEFAULT_DIRECTORY[] = "/data/misc/audioserver";
 static constexpr size_t DEFAULT_THREADPOOL_SIZE = 8;
 
+// Continuous Tees keep this much of the most recent audio, whichever limit comes first.
+static constexpr size_t CONTINUOUS_TEE_SECONDS = 180;
+// A quarter of a default Tee pipe: about 20 seconds of compressed 48 kHz stereo 16-bit music,
+// or the full CONTINUOUS_TEE_SECONDS of mostly silent mixer output.
+static constexpr size_t CONTINUOUS_TEE_MAX_BYTES = 0x200000;
+static constexpr size_t CONTINUOUS_TEE_BLOCK_FRAMES = 4096;
+static constexpr int64_t CONTINUOUS_TEE_PERIOD_MS = 100;
+
 /** AudioFileHandler manages temporary audio wav files with a least recently created
     retention policy.
 
@@ -185,13 +198,110 @@ private:
     static constexpr size_t MAX_FILES_KEEP = 32;
 };
 
+/** CompressedRing holds the most recent audio of a continuous Tee as TeeCodec blocks.
+
+    compress() is called by the compressor thread, and by a dump to pick up the
+    latest data; it is the only reader of the Tee pipe. */
+
+class NBAIO_Tee::CompressedRing {
+public:
+    struct Block {
+        size_t frames;
+        std::vector<uint8_t> data;
+    };
+    // blocks are immutable once compressed, so a dump can share them with the ring.
+    using Blocks = std::deque<std::shared_ptr<const Block>>;
+
+    explicit CompressedRing(const NBAIO_Format &format)
+        : mFrameSize(Format_frameSize(format))
+        , mBytesPerSample(audio_bytes_per_sample(format.mFormat))
+        , mChannelCount(Format_channelCount(format))
+        , mMaxFrames(Format_sampleRate(format) * CONTINUOUS_TEE_SECONDS)
+        , mCodec(mBytesPerSample, mChannelCount)
+        , mStaging(CONTINUOUS_TEE_BLOCK_FRAMES * mFrameSize)
+    { }
+
+    /** reads everything available from source into the ring.
+        The last partial block is only compressed if flush is set. */
+    void compress(const sp<NBAIO_Source> &source, bool flush) {
+        std::lock_guard<std::mutex> _l(mLock);
+        bool firstRead = true;
+        for (;;) {
+            const size_t frames = CONTINUOUS_TEE_BLOCK_FRAMES - mStagingFrames;
+            ssize_t actualRead = source->read(&mStaging[mStagingFrames * mFrameSize], frames);
+            if (actualRead == (ssize_t)OVERRUN && firstRead) {
+                // the writer lapped us, the pipe reader has caught up so recheck once.
+                ALOGV("%s: overrun", __func__);
+                actualRead = source->read(&mStaging[mStagingFrames * mFrameSize], frames);
+            }
+            firstRead = false;
+            if (actualRead <= 0) break;
+            mStagingFrames += actualRead;
+            if (mStagingFrames == CONTINUOUS_TEE_BLOCK_FRAMES) {
+                compressStaging();
+            }
+        }
+        if (flush && mStagingFrames > 0) {
+            compressStaging();
+        }
+    }
+
+    /** returns the blocks in the ring, oldest first, leaving the ring as is. */
+    Blocks getBlocks(size_t *rawBytes, size_t *compressedBytes) {
+        std::lock_guard<std::mutex> _l(mLock);
+        *rawBytes = mFrames * mFrameSize;
+        *compressedBytes = mBytes;
+        return mBlocks;
+    }
+
+    size_t bytesPerSample() const { return mBytesPerSample; }
+    size_t channelCount() const { return mChannelCount; }
+    size_t frameSize() const { return mFrameSize; }
+
+private:
+    void compressStaging() { // REQUIRES(mLock)
+        auto block = std::make_shared<Block>();
+        block->frames = mStagingFrames;
+        mCodec.encode(mStaging.data(), mStagingFrames, &block->data);
+        block->data.shrink_to_fit();
+        mStagingFrames = 0;
+        mFrames += block->frames;
+        mBytes += block->data.size();
+        mBlocks.emplace_back(std::move(block));
+        while (mBlocks.size() > 1 && (mFrames > mMaxFrames || mBytes > CONTINUOUS_TEE_MAX_BYTES)) {
+            mFrames -= mBlocks.front()->frames;
+            mBytes -= mBlocks.front()->data.size();
+            mBlocks.pop_front();
+        }
+    }
+
+    const size_t mFrameSize;
+    const size_t mBytesPerSample;
+    const size_t mChannelCount;
+    const size_t mMaxFrames;
+
+    std::mutex mLock;
+    TeeCodec mCodec;                   // GUARDED_BY(mLock)
+    std::vector<uint8_t> mStaging;     // GUARDED_BY(mLock) frames not yet compressed
+    size_t mStagingFrames = 0;         // GUARDED_BY(mLock)
+    Blocks mBlocks;                    // GUARDED_BY(mLock)
+    size_t mFrames = 0;                // GUARDED_BY(mLock) total frames in mBlocks
+    size_t mBytes = 0;                 // GUARDED_BY(mLock) total compressed bytes in mBlocks
+};
+
+// Singleton. Constructed thread-safe on first call, never destroyed.
+static AudioFileHandler &getAudioFileHandler()
+{
+    static AudioFileHandler audioFileHandler(
+            DEFAULT_PREFIX, DEFAULT_DIRECTORY, DEFAULT_THREADPOOL_SIZE);
+    return audioFileHandler;
+}
+
 /* static */
 void NBAIO_Tee::NBAIO_TeeImpl::dumpTee(
         int fd, const NBAIO_SinkSource &sinkSource, const std::string &suffix)
 {
-    // Singleton. Constructed thread-safe on first call, never destroyed.
-    static AudioFileHandler audioFileHandler(
-            DEFAULT_PREFIX, DEFAULT_DIRECTORY, DEFAULT_THREADPOOL_SIZE);
+    AudioFileHandler &audioFileHandler = getAudioFileHandler();
 
     auto &source = sinkSource.second;
     if (source.get() == nullptr) {
@@ -222,6 +332,98 @@ void NBAIO_Tee::NBAIO_TeeImpl::dumpTee(
     }
 }
 
+/* static */
+void NBAIO_Tee::NBAIO_TeeImpl::dumpCompressedTee(int fd, const NBAIO_SinkSource &sinkSource,
+        const std::shared_ptr<CompressedRing> &ring, const std::string &suffix)
+{
+    auto &source = sinkSource.second;
+    if (source.get() == nullptr) {
+        return;
+    }
+
+    // pick up the data written since the last compression.
+    ring->compress(source, true /* flush */);
+    size_t rawBytes;
+    size_t compressedBytes;
+    auto blocks = std::make_shared<CompressedRing::Blocks>(
+            ring->getBlocks(&rawBytes, &compressedBytes));
+    if (blocks->empty()) {
+        return;
+    }
+
+    const NBAIO_Format format = source->format();
+    const size_t frameSize = ring->frameSize();
+    std::string filename = getAudioFileHandler().create(
+            // this functor must not hold references to stack
+            [blocks, frameSize,
+                    codec = TeeCodec(ring->bytesPerSample(), ring->channelCount()),
+                    decoded = std::vector<uint8_t>(),
+                    next = (size_t)0, decodedFrames = (size_t)0, offset = (size_t)0]
+                    (void *buffer, size_t frames) mutable -> ssize_t {
+                if (offset == decodedFrames) {
+                    if (next == blocks->size()) {
+                        return 0;
+                    }
+                    const CompressedRing::Block &block = *(*blocks)[next++];
+                    decoded.resize(block.frames * frameSize);
+                    if (!codec.decode(block.data, block.frames, decoded.data())) {
+                        ALOGW("corrupt compressed tee block %zu", next - 1);
+                        return 0;
+                    }
+                    decodedFrames = block.frames;
+                    offset = 0;
+                }
+                const size_t actualRead = std::min(frames, decodedFrames - offset);
+                memcpy(buffer, &decoded[offset * frameSize], actualRead * frameSize);
+                offset += actualRead;
+                return actualRead;
+            },
+            Format_sampleRate(format),
+            Format_channelCount(format),
+            format.mFormat,
+            suffix);
+
+    if (fd >= 0 && filename.size() > 0) {
+        dprintf(fd, "tee wrote to %s (compressed %zu to %zu bytes, %.1fx)\n",
+                filename.c_str(), rawBytes, compressedBytes,
+                compressedBytes > 0 ? (double)rawBytes / compressedBytes : 0.);
+    }
+}
+
+/* static */
+void NBAIO_Tee::NBAIO_TeeImpl::compressTee(
+        const NBAIO_SinkSource &sinkSource, const std::shared_ptr<CompressedRing> &ring)
+{
+    auto &source = sinkSource.second;
+    if (source.get() != nullptr) {
+        ring->compress(source, false /* flush */);
+    }
+}
+
+/* static */
+std::shared_ptr<NBAIO_Tee::CompressedRing> NBAIO_Tee::NBAIO_TeeImpl::makeCompressedRing(
+        const NBAIO_Format &format)
+{
+    return std::make_shared<CompressedRing>(format);
+}
+
+/* static */
+void NBAIO_Tee::NBAIO_TeeImpl::startCompressorThread()
+{
+    static std::once_flag once;
+    std::call_once(once, [] {
+        std::thread([] {
+            (void)pthread_setname_np(pthread_self(), "AFTeeCompress");
+            // setpriority() on Linux applies to the calling thread only.
+            (void)setpriority(PRIO_PROCESS, 0 /* who */, ANDROID_PRIORITY_BACKGROUND);
+            for (;;) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(CONTINUOUS_TEE_PERIOD_MS));
+                getRunningTees().compress();
+            }
+        }).detach();
+    });
+}
+
 /* static */
 NBAIO_Tee::NBAIO_TeeImpl::NBAIO_SinkSource NBAIO_Tee::NBAIO_TeeImpl::makeSinkSource(
         const NBAIO_Format &format, size_t frames, bool *enabled)
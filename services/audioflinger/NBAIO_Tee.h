@@ -53,6 +53,7 @@ namespace android {
  *    any output files.
  * 2) Once a Tee dumps data, it is considered "emptied" and new data
  *    needs to be written before another Tee file is generated.
+ *    Continuous Tees are the exception, see below.
  * 3) Tee file format is
  *    WAV integer PCM 16 bit for AUDIO_FORMAT_PCM_8_BIT, AUDIO_FORMAT_PCM_16_BIT.
  *    WAV integer PCM 32 bit for AUDIO_FORMAT_PCM_8_24_BIT, AUDIO_FORMAT_PCM_24_BIT_PACKED
@@ -78,6 +79,14 @@ namespace android {
  * 2) The mechanism is on the AudioBufferProvider release() so large static Track
  *    playback may not show any Tee data depending on when it is released.
  * 3) When a track becomes inactive, the Thread will trigger a dump.
+ *
+ * Continuous Tees:
+ * 1) With TEE_FLAG_CONTINUOUS set in af.tee, the Thread Tees write into a small pipe which
+ *    a low priority background thread drains periodically into a ring of losslessly
+ *    compressed blocks holding the last few minutes of audio.
+ * 2) The write() is unchanged, so the FastMixer does no extra work.
+ * 3) A dump decompresses the ring into the usual WAV file. The ring is left as is,
+ *    so each dump holds the last few minutes up to the time of the dump.
  */
 
 class NBAIO_Tee {
@@ -90,6 +99,7 @@ public:
         TEE_FLAG_INPUT_THREAD = (1 << 0),  // treat as a Tee for input (Capture) Threads
         TEE_FLAG_OUTPUT_THREAD = (1 << 1), // treat as a Tee for output (Playback) Threads
         TEE_FLAG_TRACK = (1 << 2),         // treat as a Tee for tracks (Record and Playback)
+        TEE_FLAG_CONTINUOUS = (1 << 3),    // compress continuously into a ring (Threads only)
     };
 
     NBAIO_Tee()
@@ -114,6 +124,8 @@ public:
      *              - TEE_FLAG_INPUT_THREAD to check af.tee if input thread logging set;
      *              - TEE_FLAG_OUTPUT_THREAD to check af.tee if output thread logging set;
      *              - TEE_FLAG_TRACK to check af.tee if track logging set.
+     *              - TEE_FLAG_CONTINUOUS may be added to capture continuously,
+     *                as is done for Thread Tees if set in af.tee.
      * \param frames number of frames to open the NBAIO pipe (set to 0 to use default).
      *
      * \return
@@ -173,6 +185,9 @@ public:
 
 private:
 
+    /** Ring of losslessly compressed audio blocks for continuous Tees, see NBAIO_Tee.cpp. */
+    class CompressedRing;
+
     /** The underlying implementation of the Tee - the lifetime is through
         a shared pointer so destruction of the NBAIO_Tee container may proceed
         even though dumping is occurring. */
@@ -196,16 +211,23 @@ private:
                 return PERMISSION_DENIED;
             }
 
+            // Thread Tees are continuous if configured, as they are long lived.
+            const bool continuous = (flags & TEE_FLAG_CONTINUOUS) != 0
+                    || ((type & (TEE_FLAG_INPUT_THREAD | TEE_FLAG_OUTPUT_THREAD)) != 0
+                            && (teeConfig & TEE_FLAG_CONTINUOUS) != 0);
+
             // determine number of frames for Tee
             if (frames == 0) {
                 // TODO: consider varying frame count based on type.
-                frames = DEFAULT_TEE_FRAMES;
+                // A continuous Tee only needs to hold the data between two compressions.
+                frames = continuous ? CONTINUOUS_TEE_FRAMES : DEFAULT_TEE_FRAMES;
             }
 
             // TODO: should we check minimum number of frames?
 
             // don't do anything if format and frames are the same.
-            if (Format_isEqual(format, mFormat) && frames == mFrames) {
+            if (Format_isEqual(format, mFormat) && frames == mFrames
+                    && continuous == mContinuous.load()) {
                 return NO_ERROR;
             }
 
@@ -221,7 +243,12 @@ private:
                 mFormat = format; // could get this from the Sink.
                 mFrames = frames;
                 mSinkSource = std::move(sinksource);
+                mRing = continuous ? makeCompressedRing(format) : nullptr;
+                mContinuous.store(continuous);
                 mEnabled.store(true);
+                if (continuous) {
+                    startCompressorThread();
+                }
                 return NO_ERROR;
             }
             return BAD_VALUE;
@@ -233,15 +260,37 @@ private:
         }
 
         void dump(int fd, const std::string &reason) {
-            if (!mDataReady.exchange(false)) return;
+            // a continuous Tee may have compressed data even if nothing was written since.
+            if (!mDataReady.exchange(false) && !mContinuous.load()) return;
             std::string suffix;
             NBAIO_SinkSource sinkSource;
+            std::shared_ptr<CompressedRing> ring;
             {
                 std::lock_guard<std::mutex> _l(mLock);
                 suffix = mId + reason;
                 sinkSource = mSinkSource;
+                ring = mRing;
+            }
+            if (ring.get() != nullptr) {
+                dumpCompressedTee(fd, sinkSource, ring, suffix);
+            } else {
+                dumpTee(fd, sinkSource, suffix);
+            }
+        }
+
+        // Called periodically by the compressor thread, never by the writer.
+        void compress() {
+            if (!mContinuous.load()) return;
+            NBAIO_SinkSource sinkSource;
+            std::shared_ptr<CompressedRing> ring;
+            {
+                std::lock_guard<std::mutex> _l(mLock);
+                sinkSource = mSinkSource;
+                ring = mRing;
+            }
+            if (ring.get() != nullptr) {
+                compressTee(sinkSource, ring);
             }
-            dumpTee(fd, sinkSource, suffix);
         }
 
         void write(const void *buffer, size_t frameCount) {
@@ -257,15 +306,30 @@ private:
 
         static void dumpTee(int fd, const NBAIO_SinkSource& sinkSource, const std::string& suffix);
 
+        static void dumpCompressedTee(int fd, const NBAIO_SinkSource& sinkSource,
+                const std::shared_ptr<CompressedRing> &ring, const std::string& suffix);
+
+        static void compressTee(const NBAIO_SinkSource& sinkSource,
+                const std::shared_ptr<CompressedRing> &ring);
+
         static NBAIO_SinkSource makeSinkSource(
                 const NBAIO_Format &format, size_t frames, bool *enabled);
 
+        static std::shared_ptr<CompressedRing> makeCompressedRing(const NBAIO_Format &format);
+
+        // starts the background thread that compresses all continuous Tees, once.
+        static void startCompressorThread();
+
         // 0x200000 stereo 16-bit PCM frames = 47.5 seconds at 44.1 kHz, 8 megabytes
         static constexpr size_t DEFAULT_TEE_FRAMES = 0x200000;
 
+        // 0x10000 frames = 1.36 seconds at 48 kHz, well above the compression period
+        static constexpr size_t CONTINUOUS_TEE_FRAMES = 0x10000;
+
         // atomic status checking
         std::atomic<bool> mEnabled{false};
         std::atomic<bool> mDataReady{false};
+        std::atomic<bool> mContinuous{false};
 
         // locked dump information
         mutable std::mutex mLock;
@@ -274,6 +338,7 @@ private:
         NBAIO_Format mFormat = Format_Invalid;                   // GUARDED_BY(mLock)
         size_t mFrames = 0;                                      // GUARDED_BY(mLock)
         NBAIO_SinkSource mSinkSource;                            // GUARDED_BY(mLock)
+        std::shared_ptr<CompressedRing> mRing;                   // GUARDED_BY(mLock)
     };
 
     /** RunningTees tracks current running tees for dump purposes.
@@ -303,6 +368,17 @@ private:
             }
         }
 
+        void compress() {
+            std::vector<std::shared_ptr<NBAIO_TeeImpl>> tees; // safe snapshot of tees
+            {
+                std::lock_guard<std::mutex> _l(mLock);
+                tees.insert(tees.end(), mTees.begin(), mTees.end());
+            }
+            for (const auto &tee : tees) {
+                tee->compress();
+            }
+        }
+
     private:
         std::mutex mLock;
         std::set<std::shared_ptr<NBAIO_TeeImpl>> mTees; // GUARDED_BY(mLock)
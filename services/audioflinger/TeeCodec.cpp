@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <string.h>
+
+#include "TeeCodec.h"
+
+namespace android {
+
+int32_t TeeCodec::readSample(const uint8_t *in) const
+{
+    switch (mBytesPerSample) {
+    case 1:
+        return (int8_t)(in[0] ^ 0x80); // unsigned 8 bit
+    case 2: {
+        int16_t sample;
+        memcpy(&sample, in, sizeof(sample));
+        return sample;
+    }
+    case 3: {
+        const uint32_t sample = in[0] | (in[1] << 8) | (in[2] << 16);
+        return (int32_t)(sample << 8) >> 8;
+    }
+    default: {
+        int32_t sample; // also the bits of a float
+        memcpy(&sample, in, sizeof(sample));
+        return sample;
+    }
+    }
+}
+
+void TeeCodec::writeSample(int32_t sample, uint8_t *out) const
+{
+    switch (mBytesPerSample) {
+    case 1:
+        out[0] = (uint8_t)sample ^ 0x80;
+        break;
+    case 2: {
+        const int16_t sample16 = (int16_t)sample;
+        memcpy(out, &sample16, sizeof(sample16));
+        break;
+    }
+    case 3:
+        out[0] = (uint8_t)sample;
+        out[1] = (uint8_t)(sample >> 8);
+        out[2] = (uint8_t)(sample >> 16);
+        break;
+    default:
+        memcpy(out, &sample, sizeof(sample));
+        break;
+    }
+}
+
+void TeeCodec::encode(const uint8_t *in, size_t frames, std::vector<uint8_t> *out)
+{
+    BitWriter writer(out);
+    mChannel.resize(frames);
+    const size_t frameSize = mBytesPerSample * mChannelCount;
+    for (size_t channel = 0; channel < mChannelCount; ++channel) {
+        const uint8_t *sample = in + channel * mBytesPerSample;
+        for (size_t i = 0; i < frames; ++i, sample += frameSize) {
+            mChannel[i] = readSample(sample);
+        }
+        encodeChannel(mChannel.data(), frames, &writer);
+    }
+    writer.flush();
+}
+
+bool TeeCodec::decode(const std::vector<uint8_t> &in, size_t frames, uint8_t *out)
+{
+    BitReader reader(in);
+    mChannel.resize(frames);
+    const size_t frameSize = mBytesPerSample * mChannelCount;
+    for (size_t channel = 0; channel < mChannelCount; ++channel) {
+        if (!decodeChannel(&reader, frames, mChannel.data())) {
+            return false;
+        }
+        uint8_t *sample = out + channel * mBytesPerSample;
+        for (size_t i = 0; i < frames; ++i, sample += frameSize) {
+            writeSample(mChannel[i], sample);
+        }
+    }
+    return true;
+}
+
+// x is modified.
+void TeeCodec::encodeChannel(int32_t *x, size_t frames, BitWriter *writer)
+{
+    // Remove the low order bits which are zero in every sample, e.g. for 8.24 data.
+    uint32_t ored = 0;
+    bool constant = true;
+    for (size_t i = 0; i < frames; ++i) {
+        ored |= (uint32_t)x[i];
+        constant = constant && x[i] == x[0];
+    }
+    if (constant) {
+        writer->write(0, 6);
+        writer->write(SUBFRAME_CONSTANT, 2);
+        writer->write((uint32_t)x[0], 32);
+        return;
+    }
+    const unsigned shift = __builtin_ctz(ored); // ored != 0 as x is not constant
+    const unsigned sampleBits = mBytesPerSample * 8 - shift;
+    if (shift > 0) {
+        for (size_t i = 0; i < frames; ++i) {
+            x[i] >>= shift;
+        }
+    }
+    writer->write(shift, 6);
+
+    // Choose the fixed predictor with the smallest residual, as FLAC does.
+    uint64_t sums[MAX_ORDER + 1] = {};
+    for (size_t i = MAX_ORDER; i < frames; ++i) {
+        for (unsigned order = 0; order <= MAX_ORDER; ++order) {
+            const int64_t residual = x[i] - fixedPrediction(x, i, order);
+            sums[order] += (uint64_t)(residual < 0 ? -residual : residual);
+        }
+    }
+    unsigned order = 0;
+    for (unsigned i = 1; i <= MAX_ORDER; ++i) {
+        if (sums[i] < sums[order]) order = i;
+    }
+    if (frames <= order) {
+        order = 0;
+    }
+
+    // Rice parameter per partition, with the estimated size in bits.
+    mResidual.resize(frames);
+    for (size_t i = order; i < frames; ++i) {
+        mResidual[i] = zigzag(x[i] - fixedPrediction(x, i, order));
+    }
+    const size_t partitions = (frames + PARTITION_SAMPLES - 1) / PARTITION_SAMPLES;
+    mParameters.resize(partitions);
+    uint64_t estimatedBits = order * sampleBits;
+    for (size_t partition = 0; partition < partitions; ++partition) {
+        const size_t begin = std::max(partition * PARTITION_SAMPLES, (size_t)order);
+        const size_t end = std::min((partition + 1) * PARTITION_SAMPLES, frames);
+        uint64_t sum = 0;
+        for (size_t i = begin; i < end; ++i) {
+            sum += mResidual[i];
+        }
+        const uint64_t count = end - begin;
+        unsigned best = 0;
+        uint64_t bestBits = UINT64_MAX;
+        for (unsigned k = 0; k <= MAX_RICE_PARAMETER; ++k) {
+            const uint64_t bits = count * (k + 1) + (sum >> k);
+            if (bits < bestBits) {
+                bestBits = bits;
+                best = k;
+            }
+        }
+        mParameters[partition] = best;
+        estimatedBits += 6 + bestBits;
+    }
+
+    if (estimatedBits >= (uint64_t)frames * sampleBits) {
+        writer->write(SUBFRAME_VERBATIM, 2);
+        for (size_t i = 0; i < frames; ++i) {
+            writer->write((uint32_t)x[i], sampleBits);
+        }
+        return;
+    }
+
+    writer->write(SUBFRAME_FIXED, 2);
+    writer->write(order, 2);
+    for (size_t i = 0; i < order; ++i) {
+        writer->write((uint32_t)x[i], sampleBits);
+    }
+    for (size_t partition = 0; partition < partitions; ++partition) {
+        const size_t begin = std::max(partition * PARTITION_SAMPLES, (size_t)order);
+        const size_t end = std::min((partition + 1) * PARTITION_SAMPLES, frames);
+        const unsigned k = mParameters[partition];
+        writer->write(k, 6);
+        for (size_t i = begin; i < end; ++i) {
+            const uint64_t quotient = mResidual[i] >> k;
+            if (quotient < RICE_ESCAPE) {
+                writer->write(1, quotient + 1); // quotient zeros then a one
+                writer->write64(mResidual[i], k);
+            } else {
+                writer->write(0, RICE_ESCAPE);
+                writer->write64(mResidual[i], 64);
+            }
+        }
+    }
+}
+
+bool TeeCodec::decodeChannel(BitReader *reader, size_t frames, int32_t *x)
+{
+    const unsigned shift = reader->read(6);
+    const unsigned type = reader->read(2);
+    if (shift >= mBytesPerSample * 8 && type != SUBFRAME_CONSTANT) {
+        return false;
+    }
+    const unsigned sampleBits = mBytesPerSample * 8 - shift;
+    auto readRaw = [reader, sampleBits]() {
+        const uint32_t raw = reader->read(sampleBits);
+        return sampleBits == 32 ? (int32_t)raw
+                : (int32_t)(raw << (32 - sampleBits)) >> (32 - sampleBits);
+    };
+
+    switch (type) {
+    case SUBFRAME_CONSTANT: {
+        const int32_t value = (int32_t)reader->read(32);
+        std::fill(x, x + frames, value);
+        return !reader->error();
+    }
+    case SUBFRAME_VERBATIM:
+        for (size_t i = 0; i < frames; ++i) {
+            x[i] = readRaw();
+        }
+        break;
+    case SUBFRAME_FIXED: {
+        const unsigned order = reader->read(2);
+        if (order > frames) {
+            return false;
+        }
+        for (size_t i = 0; i < order; ++i) {
+            x[i] = readRaw();
+        }
+        const size_t partitions = (frames + PARTITION_SAMPLES - 1) / PARTITION_SAMPLES;
+        for (size_t partition = 0; partition < partitions; ++partition) {
+            const size_t begin = std::max(partition * PARTITION_SAMPLES, (size_t)order);
+            const size_t end = std::min((partition + 1) * PARTITION_SAMPLES, frames);
+            const unsigned k = reader->read(6);
+            for (size_t i = begin; i < end; ++i) {
+                unsigned quotient = 0;
+                while (quotient < RICE_ESCAPE && reader->read(1) == 0) {
+                    if (reader->error()) return false;
+                    ++quotient;
+                }
+                const uint64_t residual = quotient < RICE_ESCAPE
+                        ? ((uint64_t)quotient << k) | reader->read64(k) : reader->read64(64);
+                int64_t sample;
+                if (__builtin_add_overflow(
+                        fixedPrediction(x, i, order), unzigzag(residual), &sample)) {
+                    return false;   // only in a corrupt block
+                }
+                x[i] = (int32_t)sample;
+            }
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+    if (shift > 0) {
+        for (size_t i = 0; i < frames; ++i) {
+            x[i] = (int32_t)((uint32_t)x[i] << shift);
+        }
+    }
+    return !reader->error();
+}
+
+} // namespace android
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_TEE_CODEC_H
+#define ANDROID_AUDIO_TEE_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace android {
+
+/** TeeCodec is a lossless, FLAC style, coder for the blocks of a continuous Tee.
+
+    Each channel of a block is coded on its own, after removing the low order bits
+    that are zero in every sample.  It is then either constant, verbatim, or a fixed
+    polynomial prediction of order 0 to 3 whose residual is Rice coded in partitions.
+
+    Samples are handled as signed integers of the container size, so every linear PCM
+    format round trips exactly.  Float samples predict poorly and are usually verbatim.
+
+    Not thread safe, each user should have its own TeeCodec. */
+
+class TeeCodec {
+public:
+    TeeCodec(size_t bytesPerSample, size_t channelCount)
+        : mBytesPerSample(bytesPerSample)
+        , mChannelCount(channelCount)
+    { }
+
+    /** encodes frames of interleaved samples, appending to out. */
+    void encode(const uint8_t *in, size_t frames, std::vector<uint8_t> *out);
+
+    /** decodes frames of interleaved samples from a block made by encode().
+        returns false if the block is corrupt. */
+    bool decode(const std::vector<uint8_t> &in, size_t frames, uint8_t *out);
+
+private:
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<uint8_t> *out) : mOut(out) { }
+
+        void write(uint32_t value, unsigned bits) { // bits <= 32
+            if (bits == 0) return;
+            mBits = (mBits << bits) | (value & (uint32_t)((1ULL << bits) - 1));
+            mCount += bits;
+            while (mCount >= 8) {
+                mCount -= 8;
+                mOut->push_back((uint8_t)(mBits >> mCount));
+            }
+        }
+
+        void write64(uint64_t value, unsigned bits) { // bits <= 64
+            if (bits > 32) {
+                write((uint32_t)(value >> 32), bits - 32);
+                bits = 32;
+            }
+            write((uint32_t)value, bits);
+        }
+
+        void flush() {
+            if (mCount > 0) write(0, 8 - mCount);
+        }
+
+    private:
+        std::vector<uint8_t> * const mOut;
+        uint64_t mBits = 0;     // only the low mCount + 32 bits are meaningful
+        unsigned mCount = 0;    // pending bits, always < 8 between calls
+    };
+
+    class BitReader {
+    public:
+        explicit BitReader(const std::vector<uint8_t> &in) : mIn(in) { }
+
+        uint32_t read(unsigned bits) { // bits <= 32
+            if (bits == 0) return 0;
+            while (mCount < bits) {
+                if (mPosition < mIn.size()) {
+                    mBits = (mBits << 8) | mIn[mPosition++];
+                } else {
+                    mBits <<= 8;
+                    mError = true;
+                }
+                mCount += 8;
+            }
+            mCount -= bits;
+            return (uint32_t)(mBits >> mCount) & (uint32_t)((1ULL << bits) - 1);
+        }
+
+        uint64_t read64(unsigned bits) { // bits <= 64
+            uint64_t value = 0;
+            if (bits > 32) {
+                value = (uint64_t)read(bits - 32) << 32;
+                bits = 32;
+            }
+            return value | read(bits);
+        }
+
+        bool error() const { return mError; }
+
+    private:
+        const std::vector<uint8_t> &mIn;
+        size_t mPosition = 0;
+        uint64_t mBits = 0;
+        unsigned mCount = 0;
+        bool mError = false;
+    };
+
+    enum SubframeType {
+        SUBFRAME_CONSTANT = 0,
+        SUBFRAME_VERBATIM = 1,
+        SUBFRAME_FIXED = 2,
+    };
+
+    static constexpr size_t PARTITION_SAMPLES = 256;
+    static constexpr unsigned MAX_ORDER = 3;
+    static constexpr unsigned RICE_ESCAPE = 32;     // unary quotients this long are escaped
+    static constexpr unsigned MAX_RICE_PARAMETER = 48;
+
+    int32_t readSample(const uint8_t *in) const;
+    void writeSample(int32_t sample, uint8_t *out) const;
+
+    // prediction of x[i] from the previous samples, exact in 64 bits.
+    static int64_t fixedPrediction(const int32_t *x, size_t i, unsigned order) {
+        switch (order) {
+        case 0: return 0;
+        case 1: return x[i - 1];
+        case 2: return 2 * (int64_t)x[i - 1] - x[i - 2];
+        default: return 3 * (int64_t)x[i - 1] - 3 * (int64_t)x[i - 2] + x[i - 3];
+        }
+    }
+
+    static uint64_t zigzag(int64_t value) {
+        return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    }
+
+    static int64_t unzigzag(uint64_t value) {
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    void encodeChannel(int32_t *x, size_t frames, BitWriter *writer);
+    bool decodeChannel(BitReader *reader, size_t frames, int32_t *x);
+
+    const size_t mBytesPerSample;
+    const size_t mChannelCount;
+    std::vector<int32_t> mChannel;      // one channel of a block, deinterleaved
+    std::vector<uint64_t> mResidual;    // zigzag residual of mChannel
+    std::vector<unsigned> mParameters;  // Rice parameter of each partition
+};
+
+} // namespace android
+
+#endif // ANDROID_AUDIO_TEE_CODEC_H
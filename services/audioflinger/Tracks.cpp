@@ -648,6 +648,7 @@ void AudioFlinger::PlaybackThread::Track::appendDumpHeader(String8& result)
                         "ST Usg CT "
                         " G db  L dB  R dB  VS dB "
                         "  Server FrmCnt  FrmRdy F Underruns  Flushed"
+                        " Wake/s WakeUs"
                         "%s\n",
                         isServerLatencySupported() ? "   Latency" : "");
 }
@@ -733,7 +734,8 @@ void AudioFlinger::PlaybackThread::Track::appendDump(String8& result, bool activ
                         "%08X %08X %6u "
                         "%2u %3x %2x "
                         "%5.2g %5.2g %5.2g %5.2g%c "
-                        "%08X %6zu%c %6zu %c %9u%c %7u",
+                        "%08X %6zu%c %6zu %c %9u%c %7u "
+                        "%6.0f %6u",
             active ? "yes" : "no",
             (mClient == 0) ? getpid() : mClient->pid(),
             mSessionId,
@@ -762,7 +764,10 @@ void AudioFlinger::PlaybackThread::Track::appendDump(String8& result, bool activ
             fillingStatus,
             mAudioTrackServerProxy->getUnderrunFrames(),
             nowInUnderrun,
-            (unsigned)mAudioTrackServerProxy->framesFlushed() % 10000000
+            (unsigned)mAudioTrackServerProxy->framesFlushed() % 10000000,
+
+            mServerProxy->getWakesPerSecond(),
+            mServerProxy->getWakeLatencyUs()
             );
 
     if (isServerLatencySupported()) {
@@ -2216,7 +2221,7 @@ void AudioFlinger::RecordThread::RecordTrack::appendDumpHeader(String8& result)
 {
     result.appendFormat("Active     Id Client Session Port Id  S  Flags  "
                         " Format Chn mask  SRate Source  "
-                        " Server FrmCnt FrmRdy Sil%s\n",
+                        " Server FrmCnt FrmRdy Sil Wake/s WakeUs%s\n",
                         isServerLatencySupported() ? "   Latency" : "");
 }
 
@@ -2224,7 +2229,8 @@ void AudioFlinger::RecordThread::RecordTrack::appendDump(String8& result, bool a
 {
     result.appendFormat("%c%5s %6d %6u %7u %7u  %2s 0x%03X "
             "%08X %08X %6u %6X "
-            "%08X %6zu %6zu %3c",
+            "%08X %6zu %6zu %3c "
+            "%6.0f %6u",
             isFastTrack() ? 'F' : ' ',
             active ? "yes" : "no",
             mId,
@@ -2242,7 +2248,10 @@ void AudioFlinger::RecordThread::RecordTrack::appendDump(String8& result, bool a
             mCblk->mServer,
             mFrameCount,
             mServerProxy->framesReadySafe(),
-            isSilenced() ? 's' : 'n'
+            isSilenced() ? 's' : 'n',
+
+            mServerProxy->getWakesPerSecond(),
+            mServerProxy->getWakeLatencyUs()
             );
     if (isServerLatencySupported()) {
         double latencyMs;
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TeeCodec.h"
+
+namespace android {
+
+static constexpr size_t kBlockFrames = 4096;   // as used by continuous Tees
+
+// encodes and decodes in, which must come back bit exact. Returns the encoded size.
+static size_t roundTrip(size_t bytesPerSample, size_t channelCount, size_t frames,
+        const std::vector<uint8_t> &in) {
+    TeeCodec encoder(bytesPerSample, channelCount);
+    std::vector<uint8_t> encoded;
+    encoder.encode(in.data(), frames, &encoded);
+
+    TeeCodec decoder(bytesPerSample, channelCount);
+    std::vector<uint8_t> out(in.size());
+    EXPECT_TRUE(decoder.decode(encoded, frames, out.data()));
+    EXPECT_EQ(in, out);
+    return encoded.size();
+}
+
+// a full scale tone with white noise, as 16 bit stereo.
+static std::vector<uint8_t> noisyTone(size_t frames, double noiseDb) {
+    std::mt19937 random(42);
+    std::normal_distribution<double> noise(0., pow(10., noiseDb / 20.));
+    std::vector<uint8_t> data(frames * 2 * sizeof(int16_t));
+    int16_t *samples = reinterpret_cast<int16_t *>(data.data());
+    for (size_t i = 0; i < frames * 2; ++i) {
+        const double value = 0.5 * sin(2 * M_PI * 440. * (i / 2) / 48000.) + noise(random);
+        samples[i] = (int16_t)lrint(std::max(-1., std::min(value, 32767. / 32768.)) * 32768.);
+    }
+    return data;
+}
+
+TEST(TeeCodecTest, RandomDataRoundTrips) {
+    std::mt19937 random(1);
+    for (size_t bytesPerSample : {1, 2, 3, 4}) {
+        for (size_t channelCount = 1; channelCount <= 6; ++channelCount) {
+            for (size_t frames : std::vector<size_t>{1, 2, 3, 4, 255, 256, 257, kBlockFrames}) {
+                SCOPED_TRACE(testing::Message() << bytesPerSample << " bytes, "
+                        << channelCount << " channels, " << frames << " frames");
+                std::vector<uint8_t> data(frames * channelCount * bytesPerSample);
+                for (uint8_t &byte : data) {
+                    byte = (uint8_t)random();
+                }
+                roundTrip(bytesPerSample, channelCount, frames, data);
+            }
+        }
+    }
+}
+
+TEST(TeeCodecTest, ExtremeValuesRoundTrip) {
+    // alternating extremes give the largest residuals, which are escaped
+    for (size_t bytesPerSample : {1, 2, 3, 4}) {
+        SCOPED_TRACE(testing::Message() << bytesPerSample << " bytes");
+        std::vector<uint8_t> data(kBlockFrames * bytesPerSample);
+        for (size_t i = 0; i < kBlockFrames; ++i) {
+            memset(&data[i * bytesPerSample], (i / 3) % 2 ? 0xFF : 0x00, bytesPerSample);
+            data[(i + 1) * bytesPerSample - 1] ^= 0x80;
+        }
+        roundTrip(bytesPerSample, 1 /* channelCount */, kBlockFrames, data);
+    }
+}
+
+TEST(TeeCodecTest, LowZeroBitsRoundTrip) {
+    // 8.24 data in 32 bit containers, and 16 bit data padded to 32 bits
+    std::mt19937 random(2);
+    for (unsigned shift : {8, 16}) {
+        std::vector<uint8_t> data(kBlockFrames * 2 * sizeof(int32_t));
+        int32_t *samples = reinterpret_cast<int32_t *>(data.data());
+        for (size_t i = 0; i < kBlockFrames * 2; ++i) {
+            samples[i] = (int32_t)((uint32_t)random() << shift);
+        }
+        roundTrip(sizeof(int32_t), 2 /* channelCount */, kBlockFrames, data);
+    }
+}
+
+TEST(TeeCodecTest, Compresses) {
+    const size_t rawBytes = kBlockFrames * 2 * sizeof(int16_t);
+
+    const std::vector<uint8_t> silence(rawBytes);
+    EXPECT_LT(roundTrip(sizeof(int16_t), 2, kBlockFrames, silence) * 800, rawBytes);
+
+    // Only near silence reaches 3x: a tone over a noise floor of a few LSBs
+    // compresses by about 2.6x, and over a -40 dB floor, like dense music, by about 1.35x.
+    EXPECT_LT(roundTrip(sizeof(int16_t), 2, kBlockFrames, noisyTone(kBlockFrames, -80.)) * 5,
+            rawBytes * 2);
+    EXPECT_LT(roundTrip(sizeof(int16_t), 2, kBlockFrames, noisyTone(kBlockFrames, -40.)) * 13,
+            rawBytes * 10);
+}
+
+TEST(TeeCodecTest, RejectsCorruptBlocks) {
+    const std::vector<uint8_t> data = noisyTone(kBlockFrames, -40.);
+    TeeCodec codec(sizeof(int16_t), 2 /* channelCount */);
+    std::vector<uint8_t> encoded;
+    codec.encode(data.data(), kBlockFrames, &encoded);
+
+    std::vector<uint8_t> out(data.size());
+    for (size_t size : {(size_t)0, (size_t)1, encoded.size() / 2, encoded.size() - 1}) {
+        const std::vector<uint8_t> truncated(encoded.begin(), encoded.begin() + size);
+        EXPECT_FALSE(codec.decode(truncated, kBlockFrames, out.data())) << size << " bytes";
+    }
+    // a shift which leaves no bits for the samples
+    std::vector<uint8_t> badShift(encoded);
+    badShift[0] = (uint8_t)((16 << 2) | 1); // shift 16, verbatim
+    EXPECT_FALSE(codec.decode(badShift, kBlockFrames, out.data()));
+
+    // garbage decodes or not, but stays in bounds
+    std::mt19937 random(3);
+    for (int i = 0; i < 1000; ++i) {
+        std::vector<uint8_t> garbage(random() % (2 * encoded.size()));
+        for (uint8_t &byte : garbage) {
+            byte = (uint8_t)random();
+        }
+        (void)codec.decode(garbage, kBlockFrames, out.data());
+    }
+}
+
+} // namespace android
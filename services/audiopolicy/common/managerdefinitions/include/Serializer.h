@@ -16,10 +16,29 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include "AudioPolicyConfig.h"
 
 namespace android {
 
-status_t deserializeAudioPolicyFile(const char *fileName, AudioPolicyConfig *config);
+// If includedFiles is not null, it receives the paths of the files pulled in by XInclude.
+status_t deserializeAudioPolicyFile(const char *fileName, AudioPolicyConfig *config,
+                                    std::vector<std::string> *includedFiles = nullptr);
+
+// Loads the configuration from the binary cache file if it was compiled from the current
+// content of fileName and of its included files. Otherwise parses the XML file with
+// deserializeAudioPolicyFile() and rewrites the cache file. A cache write failure is not fatal.
+status_t deserializeAudioPolicyFileCached(const char *fileName, const char *cacheFileName,
+                                          AudioPolicyConfig *config);
+
+// Compiled form of the configuration, exposed for tests.
+status_t serializeAudioPolicyCache(const std::string &fileName,
+                                   const std::vector<std::string> &includedFiles,
+                                   const AudioPolicyConfig &config, std::vector<uint8_t> *data);
+status_t deserializeAudioPolicyCache(const std::string &fileName,
+                                     const std::vector<uint8_t> &data,
+                                     AudioPolicyConfig *config);
 
 } // namespace android
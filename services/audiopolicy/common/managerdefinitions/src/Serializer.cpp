@@ -233,7 +233,8 @@ public:
     {
         ALOGV("%s: Version=%s Root=%s", __func__, mVersion.c_str(), rootName);
     }
-    status_t deserialize(const char *configFile, AudioPolicyConfig *config);
+    status_t deserialize(const char *configFile, AudioPolicyConfig *config,
+                         std::vector<std::string> *includedFiles);
 
 private:
     static constexpr const char *rootName = "audioPolicyConfiguration";
@@ -274,6 +275,21 @@ std::string getXmlAttribute(const xmlNode *cur, const char *attribute)
     return value;
 }
 
+// Collects the targets of the XInclude directives which were processed in the document.
+void getIncludedFiles(const xmlNode *cur, const std::string &directory,
+                      std::vector<std::string> *includedFiles)
+{
+    for (; cur != NULL; cur = cur->next) {
+        if (cur->type == XML_XINCLUDE_START) {
+            std::string href = getXmlAttribute(cur, "href");
+            if (!href.empty()) {
+                includedFiles->push_back(href[0] == '/' ? href : directory + href);
+            }
+        }
+        getIncludedFiles(cur->children, directory, includedFiles);
+    }
+}
+
 template <class Trait>
 const xmlNode* getReference(const xmlNode *cur, const std::string &refName)
 {
@@ -738,7 +754,8 @@ Return<SurroundSoundFormatTraits::Element> SurroundSoundFormatTraits::deserializ
     return pair;
 }
 
-status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig *config)
+status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig *config,
+                                       std::vector<std::string> *includedFiles)
 {
     auto doc = make_xmlUnique(xmlParseFile(configFile));
     if (doc == nullptr) {
@@ -753,6 +770,12 @@ status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig
     if (xmlXIncludeProcess(doc.get()) < 0) {
         ALOGE("%s: libxml failed to resolve XIncludes on %s document.", __func__, configFile);
     }
+    if (includedFiles != nullptr) {
+        const std::string path(configFile);
+        const size_t slash = path.rfind('/');
+        getIncludedFiles(root, slash == std::string::npos ? "" : path.substr(0, slash + 1),
+                         includedFiles);
+    }
 
     if (xmlStrcmp(root->name, reinterpret_cast<const xmlChar*>(rootName)))  {
         ALOGE("%s: No %s root element found in xml data %s.", __func__, rootName,
@@ -790,10 +813,11 @@ status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig
 
 }  // namespace
 
-status_t deserializeAudioPolicyFile(const char *fileName, AudioPolicyConfig *config)
+status_t deserializeAudioPolicyFile(const char *fileName, AudioPolicyConfig *config,
+                                    std::vector<std::string> *includedFiles)
 {
     PolicySerializer serializer;
-    return serializer.deserialize(fileName, config);
+    return serializer.deserialize(fileName, config, includedFiles);
 }
 
 } // namespace android
@@ -0,0 +1,664 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "APM::SerializerCache"
+//#define LOG_NDEBUG 0
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <utils/Log.h>
+#include <utils/Errors.h>
+#include "Serializer.h"
+
+namespace android {
+
+namespace {
+
+// The cache holds the graph built by the XML Serializer: modules with their mix ports,
+// device ports and routes, the attached and default devices, the global configuration
+// and the surround formats. All values are stored little endian, strings are length prefixed.
+//
+// Bump kCacheVersion whenever the layout or the XML Serializer semantics change.
+constexpr uint32_t kCacheMagic = 0x43435041; // "APCC"
+constexpr uint32_t kCacheVersion = 1;
+
+// FNV-1a, only used to detect changes of the source files.
+constexpr uint64_t kHashOffset = 0xcbf29ce484222325ULL;
+constexpr uint64_t kHashPrime = 0x100000001b3ULL;
+
+void hashBytes(const void *data, size_t size, uint64_t *hash)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+        *hash = (*hash ^ bytes[i]) * kHashPrime;
+    }
+}
+
+bool readFile(const std::string &fileName, std::vector<uint8_t> *data)
+{
+    int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok) {
+        data->resize(st.st_size);
+        size_t offset = 0;
+        while (offset < data->size()) {
+            ssize_t ret = read(fd, data->data() + offset, data->size() - offset);
+            if (ret <= 0) {
+                ok = false;
+                break;
+            }
+            offset += ret;
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+// Hashes the path and content of the main file and of its included files.
+bool hashSourceFiles(const std::string &fileName, const std::vector<std::string> &includedFiles,
+                     uint64_t *hash)
+{
+    *hash = kHashOffset;
+    std::vector<std::string> files(1, fileName);
+    files.insert(files.end(), includedFiles.begin(), includedFiles.end());
+    std::vector<uint8_t> content;
+    for (const auto &file : files) {
+        if (!readFile(file, &content)) {
+            return false;
+        }
+        hashBytes(file.c_str(), file.size() + 1, hash);
+        hashBytes(content.data(), content.size(), hash);
+    }
+    return true;
+}
+
+class CacheWriter
+{
+public:
+    explicit CacheWriter(std::vector<uint8_t> *data) : mData(data) {}
+
+    void writeU32(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            mData->push_back((value >> (8 * i)) & 0xff);
+        }
+    }
+    void writeU64(uint64_t value) {
+        writeU32(value & 0xffffffff);
+        writeU32(value >> 32);
+    }
+    void writeString(const std::string &value) {
+        writeU32(value.size());
+        mData->insert(mData->end(), value.begin(), value.end());
+    }
+
+private:
+    std::vector<uint8_t> *mData;
+};
+
+// All read methods return false once the end of data is reached so a truncated or
+// corrupted cache is rejected rather than partially applied.
+class CacheReader
+{
+public:
+    explicit CacheReader(const std::vector<uint8_t> &data) : mData(data) {}
+
+    bool readU32(uint32_t *value) {
+        if (mData.size() - mOffset < 4) {
+            return false;
+        }
+        *value = 0;
+        for (int i = 0; i < 4; i++) {
+            *value |= (uint32_t)mData[mOffset++] << (8 * i);
+        }
+        return true;
+    }
+    bool readU64(uint64_t *value) {
+        uint32_t low, high;
+        if (!readU32(&low) || !readU32(&high)) {
+            return false;
+        }
+        *value = ((uint64_t)high << 32) | low;
+        return true;
+    }
+    bool readInt(int *value) {
+        uint32_t u;
+        if (!readU32(&u)) {
+            return false;
+        }
+        *value = (int)u;
+        return true;
+    }
+    bool readString(std::string *value) {
+        uint32_t size;
+        if (!readU32(&size) || mData.size() - mOffset < size) {
+            return false;
+        }
+        value->assign(reinterpret_cast<const char *>(mData.data()) + mOffset, size);
+        mOffset += size;
+        return true;
+    }
+    bool atEnd() const { return mOffset == mData.size(); }
+
+private:
+    const std::vector<uint8_t> &mData;
+    size_t mOffset = 0;
+};
+
+void writeAudioProfiles(CacheWriter *writer, AudioProfileVector &profiles)
+{
+    writer->writeU32(profiles.size());
+    for (const auto &profile : profiles) {
+        writer->writeU32(profile->getFormat());
+        writer->writeU32(profile->getChannels().size());
+        for (const auto channelMask : profile->getChannels()) {
+            writer->writeU32(channelMask);
+        }
+        writer->writeU32(profile->getSampleRates().size());
+        for (const auto rate : profile->getSampleRates()) {
+            writer->writeU32(rate);
+        }
+        writer->writeU32((profile->isDynamicFormat() ? 1 : 0) |
+                         (profile->isDynamicChannels() ? 2 : 0) |
+                         (profile->isDynamicRate() ? 4 : 0));
+    }
+}
+
+bool readAudioProfiles(CacheReader *reader, AudioProfileVector *profiles)
+{
+    uint32_t count;
+    if (!reader->readU32(&count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t format, channelCount, rateCount, dynamic;
+        if (!reader->readU32(&format) || !reader->readU32(&channelCount)) {
+            return false;
+        }
+        ChannelsVector channelMasks;
+        for (uint32_t j = 0; j < channelCount; j++) {
+            uint32_t channelMask;
+            if (!reader->readU32(&channelMask)) {
+                return false;
+            }
+            channelMasks.add(channelMask);
+        }
+        if (!reader->readU32(&rateCount)) {
+            return false;
+        }
+        SampleRateVector rates;
+        for (uint32_t j = 0; j < rateCount; j++) {
+            uint32_t rate;
+            if (!reader->readU32(&rate)) {
+                return false;
+            }
+            rates.add(rate);
+        }
+        if (!reader->readU32(&dynamic)) {
+            return false;
+        }
+        sp<AudioProfile> profile = new AudioProfile((audio_format_t)format, channelMasks, rates);
+        profile->setDynamicFormat((dynamic & 1) != 0);
+        profile->setDynamicChannels((dynamic & 2) != 0);
+        profile->setDynamicRate((dynamic & 4) != 0);
+        profiles->add(profile);
+    }
+    return true;
+}
+
+void writeGains(CacheWriter *writer, const AudioGains &gains)
+{
+    writer->writeU32(gains.size());
+    for (const auto &gain : gains) {
+        writer->writeU32(gain->getIndex());
+        writer->writeU32(gain->getMode());
+        writer->writeU32(gain->getChannelMask());
+        writer->writeU32(gain->getMinValueInMb());
+        writer->writeU32(gain->getMaxValueInMb());
+        writer->writeU32(gain->getDefaultValueInMb());
+        writer->writeU32(gain->getStepValueInMb());
+        writer->writeU32(gain->getMinRampInMs());
+        writer->writeU32(gain->getMaxRampInMs());
+        writer->writeU32(gain->canUseForVolume());
+    }
+}
+
+bool readGains(CacheReader *reader, AudioGains *gains)
+{
+    uint32_t count;
+    if (!reader->readU32(&count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        int index, minValue, maxValue, defaultValue;
+        uint32_t mode, channelMask, stepValue, minRamp, maxRamp, useForVolume;
+        if (!reader->readInt(&index) || !reader->readU32(&mode) ||
+                !reader->readU32(&channelMask) || !reader->readInt(&minValue) ||
+                !reader->readInt(&maxValue) || !reader->readInt(&defaultValue) ||
+                !reader->readU32(&stepValue) || !reader->readU32(&minRamp) ||
+                !reader->readU32(&maxRamp) || !reader->readU32(&useForVolume)) {
+            return false;
+        }
+        sp<AudioGain> gain = new AudioGain(index, true);
+        gain->setMode((audio_gain_mode_t)mode);
+        gain->setChannelMask((audio_channel_mask_t)channelMask);
+        gain->setMinValueInMb(minValue);
+        gain->setMaxValueInMb(maxValue);
+        gain->setDefaultValueInMb(defaultValue);
+        gain->setStepValueInMb(stepValue);
+        gain->setMinRampInMs(minRamp);
+        gain->setMaxRampInMs(maxRamp);
+        gain->setUseForVolume(useForVolume != 0);
+        gains->add(gain);
+    }
+    return true;
+}
+
+void writeMixPort(CacheWriter *writer, const sp<IOProfile> &mixPort)
+{
+    writer->writeString(mixPort->getName().string());
+    writer->writeU32(mixPort->getRole());
+    writer->writeU32(mixPort->getFlags());
+    writer->writeU32(mixPort->maxOpenCount);
+    writer->writeU32(mixPort->maxActiveCount);
+    writeAudioProfiles(writer, mixPort->getAudioProfiles());
+    writeGains(writer, mixPort->getGains());
+}
+
+bool readMixPort(CacheReader *reader, sp<IOProfile> *mixPort)
+{
+    std::string name;
+    uint32_t role, flags, maxOpenCount, maxActiveCount;
+    if (!reader->readString(&name) || !reader->readU32(&role) || !reader->readU32(&flags) ||
+            !reader->readU32(&maxOpenCount) || !reader->readU32(&maxActiveCount)) {
+        return false;
+    }
+    *mixPort = new IOProfile(String8(name.c_str()), (audio_port_role_t)role);
+    AudioProfileVector profiles;
+    AudioGains gains;
+    if (!readAudioProfiles(reader, &profiles) || !readGains(reader, &gains)) {
+        return false;
+    }
+    (*mixPort)->setAudioProfiles(profiles);
+    // same order as the XML Serializer: setFlags() may reset maxActiveCount
+    (*mixPort)->setFlags(flags);
+    (*mixPort)->maxOpenCount = maxOpenCount;
+    (*mixPort)->maxActiveCount = maxActiveCount;
+    (*mixPort)->setGains(gains);
+    return true;
+}
+
+void writeDevicePort(CacheWriter *writer, const sp<DeviceDescriptor> &devicePort)
+{
+    writer->writeString(devicePort->getTagName().string());
+    writer->writeU32(devicePort->type());
+    writer->writeU32(devicePort->encodedFormats().size());
+    for (const auto format : devicePort->encodedFormats()) {
+        writer->writeU32(format);
+    }
+    writer->writeString(devicePort->address().string());
+    writeAudioProfiles(writer, devicePort->getAudioProfiles());
+    writeGains(writer, devicePort->getGains());
+}
+
+bool readDevicePort(CacheReader *reader, sp<DeviceDescriptor> *devicePort)
+{
+    std::string tagName, address;
+    uint32_t type, formatCount;
+    if (!reader->readString(&tagName) || !reader->readU32(&type) ||
+            !reader->readU32(&formatCount)) {
+        return false;
+    }
+    FormatVector encodedFormats;
+    for (uint32_t i = 0; i < formatCount; i++) {
+        uint32_t format;
+        if (!reader->readU32(&format)) {
+            return false;
+        }
+        encodedFormats.add((audio_format_t)format);
+    }
+    if (!reader->readString(&address)) {
+        return false;
+    }
+    *devicePort = new DeviceDescriptor((audio_devices_t)type, encodedFormats,
+                                       String8(tagName.c_str()));
+    if (!address.empty()) {
+        (*devicePort)->setAddress(String8(address.c_str()));
+    }
+    AudioProfileVector profiles;
+    if (!readAudioProfiles(reader, &profiles) || !readGains(reader, &(*devicePort)->mGains)) {
+        return false;
+    }
+    (*devicePort)->setAudioProfiles(profiles);
+    return true;
+}
+
+void writeRoute(CacheWriter *writer, const sp<AudioRoute> &route)
+{
+    writer->writeU32(route->getType());
+    writer->writeString(route->getSink()->getTagName().string());
+    writer->writeU32(route->getSources().size());
+    for (const auto &source : route->getSources()) {
+        writer->writeString(source->getTagName().string());
+    }
+}
+
+bool readRoute(CacheReader *reader, const sp<HwModule> &module, sp<AudioRoute> *route)
+{
+    uint32_t type, sourceCount;
+    std::string sinkName;
+    if (!reader->readU32(&type) || !reader->readString(&sinkName) ||
+            !reader->readU32(&sourceCount)) {
+        return false;
+    }
+    sp<AudioPort> sink = module->findPortByTagName(String8(sinkName.c_str()));
+    if (sink == 0) {
+        ALOGE("%s: no sink found with name=%s", __func__, sinkName.c_str());
+        return false;
+    }
+    AudioPortVector sources;
+    for (uint32_t i = 0; i < sourceCount; i++) {
+        std::string sourceName;
+        if (!reader->readString(&sourceName)) {
+            return false;
+        }
+        sp<AudioPort> source = module->findPortByTagName(String8(sourceName.c_str()));
+        if (source == 0) {
+            ALOGE("%s: no source found with name=%s", __func__, sourceName.c_str());
+            return false;
+        }
+        sources.add(source);
+    }
+    *route = new AudioRoute((audio_route_type_t)type);
+    (*route)->setSink(sink);
+    sink->addRoute(*route);
+    for (const auto &source : sources) {
+        source->addRoute(*route);
+    }
+    (*route)->setSources(sources);
+    return true;
+}
+
+bool readTagNames(CacheReader *reader, std::vector<std::string> *names)
+{
+    uint32_t count;
+    if (!reader->readU32(&count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        std::string name;
+        if (!reader->readString(&name)) {
+            return false;
+        }
+        names->push_back(name);
+    }
+    return true;
+}
+
+bool readIncludedFiles(CacheReader *reader, uint64_t *hash,
+                       std::vector<std::string> *includedFiles)
+{
+    uint32_t magic, version;
+    if (!reader->readU32(&magic) || magic != kCacheMagic ||
+            !reader->readU32(&version) || version != kCacheVersion ||
+            !reader->readU64(hash)) {
+        return false;
+    }
+    return readTagNames(reader, includedFiles);
+}
+
+} // namespace
+
+status_t serializeAudioPolicyCache(const std::string &fileName,
+                                   const std::vector<std::string> &includedFiles,
+                                   const AudioPolicyConfig &config, std::vector<uint8_t> *data)
+{
+    uint64_t hash;
+    if (!hashSourceFiles(fileName, includedFiles, &hash)) {
+        return BAD_VALUE;
+    }
+    data->clear();
+    CacheWriter writer(data);
+    writer.writeU32(kCacheMagic);
+    writer.writeU32(kCacheVersion);
+    writer.writeU64(hash);
+    writer.writeU32(includedFiles.size());
+    for (const auto &file : includedFiles) {
+        writer.writeString(file);
+    }
+
+    writer.writeU32(config.isSpeakerDrcEnabled());
+    const AudioPolicyConfig::SurroundFormats &surroundFormats = config.getSurroundFormats();
+    writer.writeU32(surroundFormats.size());
+    for (const auto &format : surroundFormats) {
+        writer.writeU32(format.first);
+        writer.writeU32(format.second.size());
+        for (const auto subformat : format.second) {
+            writer.writeU32(subformat);
+        }
+    }
+
+    const HwModuleCollection modules = config.getHwModules();
+    writer.writeU32(modules.size());
+    for (const auto &module : modules) {
+        writer.writeString(module->getName());
+        writer.writeU32(module->getHalVersionMajor());
+        writer.writeU32(module->getHalVersionMinor());
+
+        writer.writeU32(module->getOutputProfiles().size() + module->getInputProfiles().size());
+        for (const auto &mixPort : module->getOutputProfiles()) {
+            writeMixPort(&writer, mixPort);
+        }
+        for (const auto &mixPort : module->getInputProfiles()) {
+            writeMixPort(&writer, mixPort);
+        }
+        const DeviceVector &devicePorts = module->getDeclaredDevices();
+        writer.writeU32(devicePorts.size());
+        for (const auto &devicePort : devicePorts) {
+            writeDevicePort(&writer, devicePort);
+        }
+        writer.writeU32(module->getRoutes().size());
+        for (const auto &route : module->getRoutes()) {
+            writeRoute(&writer, route);
+        }
+
+        std::vector<std::string> attachedDevices;
+        for (const auto &devicePort : devicePorts) {
+            if (config.getAvailableOutputDevices().contains(devicePort) ||
+                    config.getAvailableInputDevices().contains(devicePort)) {
+                attachedDevices.push_back(devicePort->getTagName().string());
+            }
+        }
+        writer.writeU32(attachedDevices.size());
+        for (const auto &name : attachedDevices) {
+            writer.writeString(name);
+        }
+        const sp<DeviceDescriptor> &defaultDevice = config.getDefaultOutputDevice();
+        writer.writeString(defaultDevice != 0 && devicePorts.contains(defaultDevice) ?
+                defaultDevice->getTagName().string() : "");
+    }
+    return NO_ERROR;
+}
+
+status_t deserializeAudioPolicyCache(const std::string &fileName,
+                                     const std::vector<uint8_t> &data,
+                                     AudioPolicyConfig *config)
+{
+    CacheReader reader(data);
+    uint64_t cachedHash, hash;
+    std::vector<std::string> includedFiles;
+    if (!readIncludedFiles(&reader, &cachedHash, &includedFiles)) {
+        ALOGW("%s: invalid cache header", __func__);
+        return BAD_VALUE;
+    }
+    if (!hashSourceFiles(fileName, includedFiles, &hash) || hash != cachedHash) {
+        ALOGV("%s: cache is stale for %s", __func__, fileName.c_str());
+        return BAD_VALUE;
+    }
+
+    // Build everything aside and only apply to the config once the whole cache has been read.
+    uint32_t speakerDrcEnabled, formatCount;
+    if (!reader.readU32(&speakerDrcEnabled) || !reader.readU32(&formatCount)) {
+        return BAD_VALUE;
+    }
+    AudioPolicyConfig::SurroundFormats surroundFormats;
+    for (uint32_t i = 0; i < formatCount; i++) {
+        uint32_t format, subformatCount;
+        if (!reader.readU32(&format) || !reader.readU32(&subformatCount)) {
+            return BAD_VALUE;
+        }
+        auto &subformats = surroundFormats[(audio_format_t)format];
+        for (uint32_t j = 0; j < subformatCount; j++) {
+            uint32_t subformat;
+            if (!reader.readU32(&subformat)) {
+                return BAD_VALUE;
+            }
+            subformats.insert((audio_format_t)subformat);
+        }
+    }
+
+    uint32_t moduleCount;
+    if (!reader.readU32(&moduleCount)) {
+        return BAD_VALUE;
+    }
+    HwModuleCollection modules;
+    DeviceVector availableDevices;
+    sp<DeviceDescriptor> defaultOutputDevice;
+    for (uint32_t i = 0; i < moduleCount; i++) {
+        std::string name;
+        uint32_t versionMajor, versionMinor, mixPortCount, devicePortCount, routeCount;
+        if (!reader.readString(&name) || !reader.readU32(&versionMajor) ||
+                !reader.readU32(&versionMinor) || !reader.readU32(&mixPortCount)) {
+            return BAD_VALUE;
+        }
+        sp<HwModule> module = new HwModule(name.c_str(), versionMajor, versionMinor);
+
+        IOProfileCollection mixPorts;
+        for (uint32_t j = 0; j < mixPortCount; j++) {
+            sp<IOProfile> mixPort;
+            if (!readMixPort(&reader, &mixPort)) {
+                return BAD_VALUE;
+            }
+            mixPorts.add(mixPort);
+        }
+        module->setProfiles(mixPorts);
+
+        if (!reader.readU32(&devicePortCount)) {
+            return BAD_VALUE;
+        }
+        DeviceVector devicePorts;
+        for (uint32_t j = 0; j < devicePortCount; j++) {
+            sp<DeviceDescriptor> devicePort;
+            if (!readDevicePort(&reader, &devicePort)) {
+                return BAD_VALUE;
+            }
+            devicePorts.add(devicePort);
+        }
+        module->setDeclaredDevices(devicePorts);
+
+        if (!reader.readU32(&routeCount)) {
+            return BAD_VALUE;
+        }
+        AudioRouteVector routes;
+        for (uint32_t j = 0; j < routeCount; j++) {
+            sp<AudioRoute> route;
+            if (!readRoute(&reader, module, &route)) {
+                return BAD_VALUE;
+            }
+            routes.add(route);
+        }
+        module->setRoutes(routes);
+
+        std::vector<std::string> attachedDevices;
+        std::string defaultDeviceName;
+        if (!readTagNames(&reader, &attachedDevices) || !reader.readString(&defaultDeviceName)) {
+            return BAD_VALUE;
+        }
+        for (const auto &deviceName : attachedDevices) {
+            sp<DeviceDescriptor> device =
+                    devicePorts.getDeviceFromTagName(String8(deviceName.c_str()));
+            if (device == 0) {
+                return BAD_VALUE;
+            }
+            availableDevices.add(device);
+        }
+        if (!defaultDeviceName.empty() && defaultOutputDevice == 0) {
+            defaultOutputDevice =
+                    devicePorts.getDeviceFromTagName(String8(defaultDeviceName.c_str()));
+        }
+        modules.add(module);
+    }
+    if (!reader.atEnd()) {
+        return BAD_VALUE;
+    }
+
+    config->setHwModules(modules);
+    for (const auto &device : availableDevices) {
+        config->addAvailableDevice(device);
+    }
+    if (defaultOutputDevice != 0 && config->getDefaultOutputDevice() == 0) {
+        config->setDefaultOutputDevice(defaultOutputDevice);
+    }
+    config->setSpeakerDrcEnabled(speakerDrcEnabled != 0);
+    config->setSurroundFormats(surroundFormats);
+    return NO_ERROR;
+}
+
+status_t deserializeAudioPolicyFileCached(const char *fileName, const char *cacheFileName,
+                                          AudioPolicyConfig *config)
+{
+    std::vector<uint8_t> data;
+    if (readFile(cacheFileName, &data) &&
+            deserializeAudioPolicyCache(fileName, data, config) == NO_ERROR) {
+        ALOGV("%s: loaded %s from %s", __func__, fileName, cacheFileName);
+        return NO_ERROR;
+    }
+
+    std::vector<std::string> includedFiles;
+    status_t status = deserializeAudioPolicyFile(fileName, config, &includedFiles);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    if (serializeAudioPolicyCache(fileName, includedFiles, *config, &data) != NO_ERROR) {
+        return NO_ERROR;
+    }
+    // write to a temporary file and rename it so a concurrent reader never sees a partial cache
+    const std::string tmpFileName = std::string(cacheFileName) + ".tmp";
+    int fd = open(tmpFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        ALOGW("%s: cannot create %s", __func__, tmpFileName.c_str());
+        return NO_ERROR;
+    }
+    bool ok = write(fd, data.data(), data.size()) == (ssize_t)data.size();
+    ok = fsync(fd) == 0 && ok;
+    close(fd);
+    if (!ok || rename(tmpFileName.c_str(), cacheFileName) != 0) {
+        ALOGW("%s: cannot write %s", __func__, cacheFileName);
+        unlink(tmpFileName.c_str());
+    }
+    return NO_ERROR;
+}
+
+} // namespace android
@@ -197,6 +197,9 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(audio_devices_t deviceT
             return BAD_VALUE;
         }
 
+        // Outputs supporting the device and its encoded formats may have changed
+        invalidateMixedOutputCache();
+
         // Propagate device availability to Engine
         setEngineDeviceConnectionState(device, state);
 
@@ -777,6 +780,7 @@ void AudioPolicyManager::setForceUse(audio_policy_force_use_t usage,
         ALOGW("setForceUse() could not set force cfg %d for usage %d", config, usage);
         return;
     }
+    invalidateMixedOutputCache();
     bool forceVolumeReeval = (usage == AUDIO_POLICY_FORCE_FOR_COMMUNICATION) ||
             (usage == AUDIO_POLICY_FORCE_FOR_DOCK) ||
             (usage == AUDIO_POLICY_FORCE_FOR_SYSTEM);
@@ -1284,13 +1288,12 @@ non_direct_output:
 
     // for non direct outputs, only PCM is supported
     if (audio_is_linear_pcm(config->format)) {
-        // get which output is suitable for the specified stream. The actual
-        // routing change will happen when startOutput() will be called
-        SortedVector<audio_io_handle_t> outputs = getOutputsForDevices(devices, mOutputs);
-
         // at this stage we should ignore the DIRECT flag as no direct output could be found earlier
         *flags = (audio_output_flags_t)(*flags & ~AUDIO_OUTPUT_FLAG_DIRECT);
-        output = selectOutput(outputs, *flags, config->format, channelMask, config->sample_rate);
+        // get which output is suitable for the specified stream. The actual
+        // routing change will happen when startOutput() will be called
+        output = selectMixedOutputForDevices(devices, *flags, config->format, channelMask,
+                                             config->sample_rate);
     }
     ALOGW_IF((output == 0), "getOutputForDevices() could not find output for stream %d, "
             "sampling rate %d, format %#x, channels %#x, flags %#x",
@@ -1454,6 +1457,33 @@ status_t AudioPolicyManager::setMsdPatch(const sp<DeviceDescriptor> &outputDevic
     return status;
 }
 
+audio_io_handle_t AudioPolicyManager::selectMixedOutputForDevices(const DeviceVector &devices,
+                                                                  audio_output_flags_t flags,
+                                                                  audio_format_t format,
+                                                                  audio_channel_mask_t channelMask,
+                                                                  uint32_t samplingRate)
+{
+    MixedOutputCacheKey key{{}, flags, format, channelMask, samplingRate};
+    for (const auto &device : devices) {
+        key.deviceIds.push_back(device->getId());
+    }
+    auto it = mMixedOutputCache.find(key);
+    if (it != mMixedOutputCache.end()) {
+        mMixedOutputCacheHits++;
+        return it->second;
+    }
+    mMixedOutputCacheMisses++;
+
+    SortedVector<audio_io_handle_t> outputs = getOutputsForDevices(devices, mOutputs);
+    audio_io_handle_t output = selectOutput(outputs, flags, format, channelMask, samplingRate);
+
+    if (mMixedOutputCache.size() >= kMaxMixedOutputCacheSize) {
+        mMixedOutputCache.clear();
+    }
+    mMixedOutputCache.emplace(std::move(key), output);
+    return output;
+}
+
 audio_io_handle_t AudioPolicyManager::selectOutput(const SortedVector<audio_io_handle_t>& outputs,
                                                        audio_output_flags_t flags,
                                                        audio_format_t format,
@@ -2867,6 +2897,7 @@ status_t AudioPolicyManager::registerPolicyMixes(const Vector<AudioMix>& mixes)
 {
     ALOGV("registerPolicyMixes() %zu mix(es)", mixes.size());
     status_t res = NO_ERROR;
+    invalidateMixedOutputCache();
 
     sp<HwModule> rSubmixModule;
     // examine each mix's route type
@@ -2982,6 +3013,7 @@ status_t AudioPolicyManager::unregisterPolicyMixes(Vector<AudioMix> mixes)
 {
     ALOGV("unregisterPolicyMixes() num mixes %zu", mixes.size());
     status_t res = NO_ERROR;
+    invalidateMixedOutputCache();
     sp<HwModule> rSubmixModule;
     // examine each mix's route type
     for (const auto& mix : mixes) {
@@ -3109,6 +3141,8 @@ void AudioPolicyManager::dump(String8 *dst) const
     dst->appendFormat(" TTS output %savailable\n", mTtsOutputAvailable ? "" : "not ");
     dst->appendFormat(" Master mono: %s\n", mMasterMono ? "on" : "off");
     dst->appendFormat(" Config source: %s\n", mConfig.getSource().c_str()); // getConfig not const
+    dst->appendFormat(" Mixed output cache: %zu entries, %" PRIu64 " hits, %" PRIu64 " misses\n",
+            mMixedOutputCache.size(), mMixedOutputCacheHits, mMixedOutputCacheMisses);
     mAvailableOutputDevices.dump(dst, String8("Available output"));
     mAvailableInputDevices.dump(dst, String8("Available input"));
     mHwModulesAll.dump(dst);
@@ -4266,6 +4300,9 @@ static const char *kConfigLocationList[] =
         {"/odm/etc", "/vendor/etc/audio", "/vendor/etc", "/system/etc"};
 static const int kConfigLocationListSize =
         (sizeof(kConfigLocationList) / sizeof(kConfigLocationList[0]));
+// Compiled form of the last parsed configuration, used when persist.audio.policy.config_cache
+// is set to skip the XML parsing at boot.
+static const char *kConfigCacheFile = "/data/misc/audioserver/audio_policy_configuration.cache";
 
 static status_t deserializeAudioPolicyXmlConfig(AudioPolicyConfig &config) {
     char audioPolicyXmlConfigFile[AUDIO_POLICY_XML_CONFIG_FILE_PATH_MAX_LENGTH];
@@ -4287,11 +4324,15 @@ static status_t deserializeAudioPolicyXmlConfig(AudioPolicyConfig &config) {
     }
     fileNames.push_back(AUDIO_POLICY_XML_CONFIG_FILE_NAME);
 
+    const bool useCache = property_get_bool("persist.audio.policy.config_cache", false);
     for (const char* fileName : fileNames) {
         for (int i = 0; i < kConfigLocationListSize; i++) {
             snprintf(audioPolicyXmlConfigFile, sizeof(audioPolicyXmlConfigFile),
                      "%s/%s", kConfigLocationList[i], fileName);
-            ret = deserializeAudioPolicyFile(audioPolicyXmlConfigFile, &config);
+            ret = useCache ?
+                    deserializeAudioPolicyFileCached(audioPolicyXmlConfigFile, kConfigCacheFile,
+                                                     &config) :
+                    deserializeAudioPolicyFile(audioPolicyXmlConfigFile, &config);
             if (ret == NO_ERROR) {
                 config.setSource(audioPolicyXmlConfigFile);
                 return ret;
@@ -4554,6 +4595,7 @@ void AudioPolicyManager::addOutput(audio_io_handle_t output,
                                    const sp<SwAudioOutputDescriptor>& outputDesc)
 {
     mOutputs.add(output, outputDesc);
+    invalidateMixedOutputCache();
     applyStreamVolumes(outputDesc, AUDIO_DEVICE_NONE, 0 /* delayMs */, true /* force */);
     updateMono(output); // update mono status when adding to output list
     selectOutputForMusicEffects();
@@ -4563,6 +4605,7 @@ void AudioPolicyManager::addOutput(audio_io_handle_t output,
 void AudioPolicyManager::removeOutput(audio_io_handle_t output)
 {
     mOutputs.removeItem(output);
+    invalidateMixedOutputCache();
     selectOutputForMusicEffects();
 }
 
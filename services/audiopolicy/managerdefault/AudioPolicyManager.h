@@ -18,8 +18,11 @@
 
 #include <atomic>
 #include <functional>
+#include <map>
 #include <memory>
+#include <tuple>
 #include <unordered_set>
+#include <vector>
 
 #include <stdint.h>
 #include <sys/types.h>
@@ -579,6 +582,14 @@ protected:
                                        audio_format_t format = AUDIO_FORMAT_INVALID,
                                        audio_channel_mask_t channelMask = AUDIO_CHANNEL_NONE,
                                        uint32_t samplingRate = 0);
+        // Returns the mixed output selected by selectOutput() among the outputs reaching
+        // all the given devices. The result is memoised in mMixedOutputCache.
+        audio_io_handle_t selectMixedOutputForDevices(const DeviceVector &devices,
+                                                      audio_output_flags_t flags,
+                                                      audio_format_t format,
+                                                      audio_channel_mask_t channelMask,
+                                                      uint32_t samplingRate);
+        void invalidateMixedOutputCache() { mMixedOutputCache.clear(); }
         // samplingRate, format, channelMask are in/out and so may be modified
         sp<IOProfile> getInputProfile(const sp<DeviceDescriptor> & device,
                                       uint32_t& samplingRate,
@@ -759,6 +770,28 @@ protected:
         std::unordered_set<audio_format_t> mManualSurroundFormats;
 
         std::unordered_map<uid_t, audio_flags_mask_t> mAllowedCapturePolicies;
+
+        // Cache of the mixed output selection done for track creation. The selection only
+        // depends on the request and on the opened outputs and their supported devices so
+        // the cache must be invalidated when an output is opened or closed, a device is
+        // connected or disconnected, a forced usage changes or policy mixes are (un)registered.
+        struct MixedOutputCacheKey {
+            std::vector<audio_port_handle_t> deviceIds;
+            audio_output_flags_t flags;
+            audio_format_t format;
+            audio_channel_mask_t channelMask;
+            uint32_t samplingRate;
+
+            bool operator<(const MixedOutputCacheKey &other) const {
+                return std::tie(deviceIds, flags, format, channelMask, samplingRate) <
+                        std::tie(other.deviceIds, other.flags, other.format, other.channelMask,
+                                 other.samplingRate);
+            }
+        };
+        static constexpr size_t kMaxMixedOutputCacheSize = 64;
+        std::map<MixedOutputCacheKey, audio_io_handle_t> mMixedOutputCache;
+        uint64_t mMixedOutputCacheHits = 0;
+        uint64_t mMixedOutputCacheMisses = 0;
 protected:
         // Add or remove AC3 DTS encodings based on user preferences.
         void modifySurroundFormats(const sp<DeviceDescriptor>& devDesc, FormatVector *formatsPtr);
@@ -12,6 +12,7 @@ LOCAL_SHARED_LIBRARIES := \
   liblog \
   libmedia_helper \
   libutils \
+  libxml2 \
 
 LOCAL_STATIC_LIBRARIES := \
   libaudiopolicycomponents \
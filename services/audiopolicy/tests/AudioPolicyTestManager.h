@@ -25,6 +25,8 @@ class AudioPolicyTestManager : public AudioPolicyManager {
             : AudioPolicyManager(clientInterface, true /*forTesting*/) { }
     using AudioPolicyManager::getConfig;
     using AudioPolicyManager::initialize;
+    uint64_t getMixedOutputCacheHits() const { return mMixedOutputCacheHits; }
+    uint64_t getMixedOutputCacheMisses() const { return mMixedOutputCacheMisses; }
 };
 
 }  // namespace android
@@ -14,16 +14,22 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <set>
+#include <vector>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <android-base/file.h>
 #include <gtest/gtest.h>
 
 #define LOG_TAG "APM_Test"
 #include <log/log.h>
 #include <media/PatchBuilder.h>
+#include <Serializer.h>
 
 #include "AudioPolicyTestClient.h"
 #include "AudioPolicyTestManager.h"
@@ -275,6 +281,58 @@ TEST_F(AudioPolicyManagerTest, CreateAudioPatchFromMix) {
 
 // TODO: Add patch creation tests that involve already existing patch
 
+TEST_F(AudioPolicyManagerTest, GetOutputForAttrMixedOutputCache) {
+    audio_port_handle_t selectedDeviceId, portId;
+    getOutputForAttr(&selectedDeviceId,
+            AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO, 48000, AUDIO_OUTPUT_FLAG_NONE,
+            &portId);
+    const uint64_t misses = mManager->getMixedOutputCacheMisses();
+    const uint64_t hits = mManager->getMixedOutputCacheHits();
+    ASSERT_LT(0u, misses);
+
+    audio_port_handle_t cachedSelectedDeviceId, cachedPortId;
+    getOutputForAttr(&cachedSelectedDeviceId,
+            AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO, 48000, AUDIO_OUTPUT_FLAG_NONE,
+            &cachedPortId);
+    ASSERT_EQ(selectedDeviceId, cachedSelectedDeviceId);
+    ASSERT_EQ(misses, mManager->getMixedOutputCacheMisses());
+    ASSERT_EQ(hits + 1, mManager->getMixedOutputCacheHits());
+
+    // A forced usage change must invalidate the cache.
+    mManager->setForceUse(AUDIO_POLICY_FORCE_FOR_MEDIA, AUDIO_POLICY_FORCE_NO_BT_A2DP);
+    getOutputForAttr(&cachedSelectedDeviceId,
+            AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO, 48000);
+    ASSERT_EQ(misses + 1, mManager->getMixedOutputCacheMisses());
+    mManager->releaseOutput(portId);
+    mManager->releaseOutput(cachedPortId);
+}
+
+// Not a pass/fail test: logs the cost of getOutputForAttr() when the mixed output
+// selection is served from the cache.
+TEST_F(AudioPolicyManagerTest, GetOutputForAttrMicrobenchmark) {
+    constexpr size_t kIterations = 1000;
+    std::vector<audio_port_handle_t> portIds(kIterations);
+    const uint64_t hits = mManager->getMixedOutputCacheHits();
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kIterations; ++i) {
+        audio_port_handle_t selectedDeviceId;
+        getOutputForAttr(&selectedDeviceId,
+                AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO, 48000, AUDIO_OUTPUT_FLAG_NONE,
+                &portIds[i]);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    for (audio_port_handle_t portId : portIds) {
+        mManager->releaseOutput(portId);
+    }
+    const auto nsPerCall =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / kIterations;
+    ALOGI("getOutputForAttr: %lld ns per call, mixed output cache %llu hits %llu misses",
+            (long long)nsPerCall, (unsigned long long)mManager->getMixedOutputCacheHits(),
+            (unsigned long long)mManager->getMixedOutputCacheMisses());
+    printf("getOutputForAttr: %lld ns per call\n", (long long)nsPerCall);
+    ASSERT_EQ(hits + kIterations - 1, mManager->getMixedOutputCacheHits());
+}
+
 class AudioPolicyManagerTestMsd : public AudioPolicyManagerTest {
   protected:
     void SetUpConfig(AudioPolicyConfig *config) override;
@@ -434,3 +492,116 @@ TEST_F(AudioPolicyManagerTestMsd, GetOutputForAttrFormatSwitching) {
         ASSERT_EQ(0, patchCount.deltaFromSnapshot());
     }
 }
+
+class AudioPolicyConfigHolder {
+  public:
+    AudioPolicyConfigHolder()
+            : config(mHwModules, mAvailableOutputDevices, mAvailableInputDevices,
+                     mDefaultOutputDevice) {}
+
+    // DeviceVector is ordered by pointer value, so the dump lines are sorted to compare
+    // configurations built separately.
+    std::string dump() const {
+        String8 result;
+        config.getHwModules().dump(&result);
+        config.getAvailableOutputDevices().dump(&result, String8("Available output"));
+        config.getAvailableInputDevices().dump(&result, String8("Available input"));
+        if (config.getDefaultOutputDevice() != 0) {
+            result.appendFormat("Default output: %s\n",
+                    config.getDefaultOutputDevice()->getTagName().string());
+        }
+        result.appendFormat("Speaker DRC: %d surround formats: %zu\n",
+                config.isSpeakerDrcEnabled(), config.getSurroundFormats().size());
+        std::vector<std::string> lines;
+        std::string text(result.string());
+        for (size_t start = 0, end; start < text.size(); start = end + 1) {
+            end = text.find('\n', start);
+            if (end == std::string::npos) end = text.size();
+            lines.push_back(text.substr(start, end - start));
+        }
+        std::sort(lines.begin(), lines.end());
+        std::string sorted;
+        for (const auto& line : lines) sorted += line + "\n";
+        return sorted;
+    }
+
+  private:
+    HwModuleCollection mHwModules;
+    DeviceVector mAvailableOutputDevices;
+    DeviceVector mAvailableInputDevices;
+    sp<DeviceDescriptor> mDefaultOutputDevice;
+
+  public:
+    AudioPolicyConfig config;
+};
+
+// Compares the configuration and the load time of the XML parser and of the binary cache.
+TEST(AudioPolicyConfigCacheTest, MatchesXmlAndLoadsFaster) {
+    const std::string kConfigFile = "/vendor/etc/audio_policy_configuration.xml";
+    if (access(kConfigFile.c_str(), R_OK) != 0) {
+        ALOGW("%s not available, skipping", kConfigFile.c_str());
+        return;
+    }
+    std::vector<std::string> includedFiles;
+    AudioPolicyConfigHolder xmlConfig;
+    ASSERT_EQ(NO_ERROR,
+            deserializeAudioPolicyFile(kConfigFile.c_str(), &xmlConfig.config, &includedFiles));
+    std::vector<uint8_t> cache;
+    ASSERT_EQ(NO_ERROR,
+            serializeAudioPolicyCache(kConfigFile, includedFiles, xmlConfig.config, &cache));
+    AudioPolicyConfigHolder cachedConfig;
+    ASSERT_EQ(NO_ERROR, deserializeAudioPolicyCache(kConfigFile, cache, &cachedConfig.config));
+    ASSERT_EQ(xmlConfig.dump(), cachedConfig.dump());
+
+    // A corrupted cache must be rejected without touching the config.
+    std::vector<uint8_t> truncatedCache(cache.begin(), cache.end() - 1);
+    AudioPolicyConfigHolder rejectedConfig;
+    ASSERT_NE(NO_ERROR,
+            deserializeAudioPolicyCache(kConfigFile, truncatedCache, &rejectedConfig.config));
+    ASSERT_EQ(0u, rejectedConfig.config.getHwModules().size());
+
+    constexpr int kIterations = 20;
+    auto measureUs = [](const std::function<void()>& load) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; ++i) {
+            load();
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count() / kIterations;
+    };
+    const auto xmlUs = measureUs([&]() {
+        AudioPolicyConfigHolder holder;
+        EXPECT_EQ(NO_ERROR, deserializeAudioPolicyFile(kConfigFile.c_str(), &holder.config));
+    });
+    const auto cacheUs = measureUs([&]() {
+        AudioPolicyConfigHolder holder;
+        EXPECT_EQ(NO_ERROR, deserializeAudioPolicyCache(kConfigFile, cache, &holder.config));
+    });
+    ALOGI("audio policy config load: xml %lld us, cache %lld us (%zu bytes)",
+            (long long)xmlUs, (long long)cacheUs, cache.size());
+    printf("audio policy config load: xml %lld us, cache %lld us (%zu bytes)\n",
+            (long long)xmlUs, (long long)cacheUs, cache.size());
+    // The cache skips the XML parsing and the string lookups, so it is well ahead of
+    // the parser, by far more than the timing noise over kIterations loads.
+    EXPECT_LT(cacheUs, xmlUs);
+}
+
+TEST(AudioPolicyConfigCacheTest, FallsBackToXml) {
+    const std::string kConfigFile = "/vendor/etc/audio_policy_configuration.xml";
+    if (access(kConfigFile.c_str(), R_OK) != 0) {
+        ALOGW("%s not available, skipping", kConfigFile.c_str());
+        return;
+    }
+    TemporaryFile cacheFile;
+    // The empty cache file is invalid: the XML is parsed and the cache is written.
+    AudioPolicyConfigHolder xmlConfig;
+    ASSERT_EQ(NO_ERROR, deserializeAudioPolicyFileCached(
+                    kConfigFile.c_str(), cacheFile.path, &xmlConfig.config));
+    std::string content;
+    ASSERT_TRUE(android::base::ReadFileToString(cacheFile.path, &content));
+    ASSERT_FALSE(content.empty());
+    AudioPolicyConfigHolder cachedConfig;
+    ASSERT_EQ(NO_ERROR, deserializeAudioPolicyFileCached(
+                    kConfigFile.c_str(), cacheFile.path, &cachedConfig.config));
+    ASSERT_EQ(xmlConfig.dump(), cachedConfig.dump());
+}
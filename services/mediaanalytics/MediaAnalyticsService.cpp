@@ -89,6 +89,13 @@ static constexpr nsecs_t kMaxRecordAgeNs =  28 * 3600 * (1000*1000*1000ll);
 // This also retains enough information to help with bugreports
 static constexpr int kMaxRecords    = 2000;
 
+// memory budget over all records, and the share of the records and of the
+// budget one key (e.g. "codec") may take, so a bursty producer cannot evict
+// everybody else.
+static constexpr size_t kMaxBytes = 4 * 1024 * 1024;
+static constexpr size_t kMaxRecordsPerKey = kMaxRecords / 2;
+static constexpr size_t kMaxBytesPerKey = kMaxBytes / 2;
+
 // max we expire in a single call, to constrain how long we hold the
 // mutex, which also constrains how long a client might wait.
 static constexpr int kMaxExpiredAtOnce = 50;
@@ -103,9 +110,9 @@ void MediaAnalyticsService::instantiate() {
 }
 
 MediaAnalyticsService::MediaAnalyticsService()
-        : mMaxRecords(kMaxRecords),
-          mMaxRecordAgeNs(kMaxRecordAgeNs),
-          mMaxRecordsExpiredAtOnce(kMaxExpiredAtOnce),
+        : mMaxRecordsExpiredAtOnce(kMaxExpiredAtOnce),
+          mStore({kMaxRecords, kMaxBytes, kMaxRecordsPerKey, kMaxBytesPerKey,
+                  kMaxRecordAgeNs}),
           mDumpProto(MediaAnalyticsItem::PROTO_V1),
           mDumpProtoDefault(MediaAnalyticsItem::PROTO_V1) {
 
@@ -113,9 +120,6 @@ MediaAnalyticsService::MediaAnalyticsService()
 
     mItemsSubmitted = 0;
     mItemsFinalized = 0;
-    mItemsDiscarded = 0;
-    mItemsDiscardedExpire = 0;
-    mItemsDiscardedCount = 0;
 
     mLastSessionID = 0;
     // recover any persistency we set up
@@ -124,14 +128,6 @@ MediaAnalyticsService::MediaAnalyticsService()
 
 MediaAnalyticsService::~MediaAnalyticsService() {
         ALOGD("MediaAnalyticsService destroyed");
-
-    while (mItems.size() > 0) {
-        MediaAnalyticsItem * oitem = *(mItems.begin());
-        mItems.erase(mItems.begin());
-        delete oitem;
-        mItemsDiscarded++;
-        mItemsDiscardedCount++;
-    }
 }
 
 
@@ -260,9 +256,13 @@ status_t MediaAnalyticsService::dump(int fd, const Vector<String16>& args)
     bool clear = false;
     String16 sinceOption("-since");
     nsecs_t ts_since = 0;
+    String16 untilOption("-until");
+    nsecs_t ts_until = 0;
     String16 helpOption("-help");
     String16 onlyOption("-only");
     std::string only;
+    String16 packageOption("-package");
+    std::string package;
     int n = args.size();
 
     for (int i = 0; i < n; i++) {
@@ -305,6 +305,27 @@ status_t MediaAnalyticsService::dump(int fd, const Vector<String16>& args)
             }
             // command line is milliseconds; internal units are nano-seconds
             ts_since *= 1000*1000;
+        } else if (args[i] == untilOption) {
+            i++;
+            if (i < n) {
+                String8 value(args[i]);
+                char *endp;
+                const char *p = value.string();
+                ts_until = strtoll(p, &endp, 10);
+                if (endp == p || *endp != '\0') {
+                    ts_until = 0;
+                }
+            } else {
+                ts_until = 0;
+            }
+            // command line is milliseconds; internal units are nano-seconds
+            ts_until *= 1000*1000;
+        } else if (args[i] == packageOption) {
+            i++;
+            if (i < n) {
+                String8 value(args[i]);
+                package = value.string();
+            }
         } else if (args[i] == onlyOption) {
             i++;
             if (i < n) {
@@ -317,7 +338,9 @@ status_t MediaAnalyticsService::dump(int fd, const Vector<String16>& args)
             result.append("-proto #     dump using protocol #");
             result.append("-clear       clears out saved records\n");
             result.append("-only X      process records for component X\n");
+            result.append("-package X   process records from package X\n");
             result.append("-since X     include records since X\n");
+            result.append("-until X     include records before X\n");
             result.append("             (X is milliseconds since the UNIX epoch)\n");
             write(fd, result.string(), result.size());
             return NO_ERROR;
@@ -325,7 +348,7 @@ status_t MediaAnalyticsService::dump(int fd, const Vector<String16>& args)
     }
 
     Mutex::Autolock _l(mLock);
-    // mutex between insertion and dumping the contents
+    // serializes dumps; insertion only contends with the shards being dumped
 
     mDumpProto = chosenProto;
 
@@ -335,17 +358,19 @@ status_t MediaAnalyticsService::dump(int fd, const Vector<String16>& args)
 
     dumpHeaders(result, ts_since);
 
-    dumpRecent(result, ts_since, only.c_str());
+    MediaAnalyticsStore::Query query;
+    query.key = only;
+    query.pkg = package;
+    query.since = ts_since;
+    if (ts_until != 0) {
+        query.until = ts_until;
+    }
+    dumpRecent(result, query);
 
 
     if (clear) {
         // remove everything from the finalized queue
-        while (mItems.size() > 0) {
-            MediaAnalyticsItem * oitem = *(mItems.begin());
-            mItems.erase(mItems.begin());
-            delete oitem;
-            mItemsDiscarded++;
-        }
+        mStore.clear();
 
         // shall we clear the summary data too?
 
@@ -377,10 +402,17 @@ void MediaAnalyticsService::dumpHeaders(String8 &result, nsecs_t ts_since)
             " Accepted: %8" PRId64 "\n",
         mItemsSubmitted, mItemsFinalized);
     result.append(buffer);
+    const int64_t discardedCount = mStore.discardedByCount();
+    const int64_t discardedExpire = mStore.discardedByExpiration();
     snprintf(buffer, SIZE,
         "Records Discarded: %8" PRId64
             " (by Count: %" PRId64 " by Expiration: %" PRId64 ")\n",
-         mItemsDiscarded, mItemsDiscardedCount, mItemsDiscardedExpire);
+         discardedCount + discardedExpire + mStore.discardedByClear(),
+         discardedCount, discardedExpire);
+    result.append(buffer);
+    snprintf(buffer, SIZE,
+        "Records Retained: %8zu (%zu bytes)\n",
+        mStore.records(), mStore.bytes());
     result.append(buffer);
     if (ts_since != 0) {
         snprintf(buffer, SIZE,
@@ -391,123 +423,48 @@ void MediaAnalyticsService::dumpHeaders(String8 &result, nsecs_t ts_since)
 }
 
 // the recent, detailed queues
-void MediaAnalyticsService::dumpRecent(String8 &result, nsecs_t ts_since, const char * only)
+void MediaAnalyticsService::dumpRecent(String8 &result,
+        const MediaAnalyticsStore::Query &query)
 {
     const size_t SIZE = 512;
     char buffer[SIZE];
 
-    if (only != NULL && *only == '\0') {
-        only = NULL;
-    }
-
     // show the recently recorded records
     snprintf(buffer, sizeof(buffer), "\nFinalized Metrics (oldest first):\n");
     result.append(buffer);
-    result.append(this->dumpQueue(ts_since, only));
+    result.append(this->dumpQueue(query));
 
     // show who is connected and injecting records?
     // talk about # records fed to the 'readers'
     // talk about # records we discarded, perhaps "discarded w/o reading" too
 }
 
-// caller has locked mLock...
 String8 MediaAnalyticsService::dumpQueue() {
-    return dumpQueue((nsecs_t) 0, NULL);
+    return dumpQueue(MediaAnalyticsStore::Query());
 }
 
-String8 MediaAnalyticsService::dumpQueue(nsecs_t ts_since, const char * only) {
+String8 MediaAnalyticsService::dumpQueue(const MediaAnalyticsStore::Query &query) {
     String8 result;
     int slot = 0;
 
-    if (mItems.empty()) {
-            result.append("empty\n");
-    } else {
-        List<MediaAnalyticsItem *>::iterator it = mItems.begin();
-        for (; it != mItems.end(); it++) {
-            nsecs_t when = (*it)->getTimestamp();
-            if (when < ts_since) {
-                continue;
-            }
-            if (only != NULL &&
-                strcmp(only, (*it)->getKey().c_str()) != 0) {
-                ALOGV("Omit '%s', it's not '%s'", (*it)->getKey().c_str(), only);
-                continue;
-            }
-            std::string entry = (*it)->toString(mDumpProto);
+    // only the shards of the selected key are locked, and those
+    // free of clock changes are searched by time.
+    mStore.forEach(query, [&](MediaAnalyticsItem *item) {
+            std::string entry = item->toString(mDumpProto);
             result.appendFormat("%5d: %s\n", slot, entry.c_str());
             slot++;
-        }
+        });
+    if (slot == 0 && mStore.records() == 0) {
+            result.append("empty\n");
     }
 
     return result;
 }
 
 //
-// Our Cheap in-core, non-persistent records management.
-
-
-// we hold mLock when we get here
-// if item != NULL, it's the item we just inserted
-// true == more items eligible to be recovered
-bool MediaAnalyticsService::expirations_l(MediaAnalyticsItem *item)
-{
-    bool more = false;
-    int handled = 0;
-
-    // keep removing old records the front until we're in-bounds (count)
-    // since we invoke this with each insertion, it should be 0/1 iterations.
-    if (mMaxRecords > 0) {
-        while (mItems.size() > (size_t) mMaxRecords) {
-            MediaAnalyticsItem * oitem = *(mItems.begin());
-            if (oitem == item) {
-                break;
-            }
-            if (handled >= mMaxRecordsExpiredAtOnce) {
-                // unlikely in this loop
-                more = true;
-                break;
-            }
-            handled++;
-            mItems.erase(mItems.begin());
-            delete oitem;
-            mItemsDiscarded++;
-            mItemsDiscardedCount++;
-        }
-    }
-
-    // keep removing old records the front until we're in-bounds (age)
-    // limited to mMaxRecordsExpiredAtOnce items per invocation.
-    if (mMaxRecordAgeNs > 0) {
-        nsecs_t now = systemTime(SYSTEM_TIME_REALTIME);
-        while (mItems.size() > 0) {
-            MediaAnalyticsItem * oitem = *(mItems.begin());
-            nsecs_t when = oitem->getTimestamp();
-            if (oitem == item) {
-                break;
-            }
-            // careful about timejumps too
-            if ((now > when) && (now-when) <= mMaxRecordAgeNs) {
-                // this (and the rest) are recent enough to keep
-                break;
-            }
-            if (handled >= mMaxRecordsExpiredAtOnce) {
-                // this represents "one too many"; tell caller there are
-                // more to be reclaimed.
-                more = true;
-                break;
-            }
-            handled++;
-            mItems.erase(mItems.begin());
-            delete oitem;
-            mItemsDiscarded++;
-            mItemsDiscardedExpire++;
-        }
-    }
+// Our Cheap in-core, non-persistent records management,
+// see MediaAnalyticsStore.
 
-    // we only indicate whether there's more to clean;
-    // caller chooses whether to schedule further cleanup.
-    return more;
-}
 
 // process expirations in bite sized chunks, allowing new insertions through
 // runs in a pthread specifically started for this (which then exits)
@@ -516,13 +473,7 @@ bool MediaAnalyticsService::processExpirations()
     bool more;
     do {
         sleep(1);
-        {
-            Mutex::Autolock _l(mLock);
-            more = expirations_l(NULL);
-            if (!more) {
-                break;
-            }
-        }
+        more = mStore.expire(systemTime(SYSTEM_TIME_REALTIME), mMaxRecordsExpiredAtOnce);
     } while (more);
     return true;        // value is for std::future thread synchronization
 }
@@ -530,18 +481,20 @@ bool MediaAnalyticsService::processExpirations()
 // insert appropriately into queue
 void MediaAnalyticsService::saveItem(MediaAnalyticsItem * item)
 {
+    // only locks the shard of the item's key
+    mStore.add(item);
 
-    Mutex::Autolock _l(mLock);
-    // mutex between insertion and dumping the contents
-
-    // we want to dump 'in FIFO order', so insert at the end
-    mItems.push_back(item);
-
-    // clean old stuff from the queue
-    bool more = expirations_l(item);
+    // clean old stuff from the queue, which locks every shard,
+    // so only once the oldest record of a key may be too old.
+    const nsecs_t now = systemTime(SYSTEM_TIME_REALTIME);
+    if (!mStore.expirationDue(now)) {
+        return;
+    }
+    bool more = mStore.expire(now, mMaxRecordsExpiredAtOnce);
 
     // consider scheduling some asynchronous cleaning, if not running
     if (more) {
+        Mutex::Autolock _l(mLock_expire);
         if (!mExpireFuture.valid()
             || mExpireFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
 
@@ -30,6 +30,8 @@
 
 #include <media/IMediaAnalyticsService.h>
 
+#include "MediaAnalyticsStore.h"
+
 namespace android {
 
 class MediaAnalyticsService : public BnMediaAnalyticsService
@@ -54,22 +56,15 @@ class MediaAnalyticsService : public BnMediaAnalyticsService
     // statistics about our analytics
     int64_t mItemsSubmitted;
     int64_t mItemsFinalized;
-    int64_t mItemsDiscarded;
-    int64_t mItemsDiscardedExpire;
-    int64_t mItemsDiscardedCount;
     MediaAnalyticsItem::SessionID_t mLastSessionID;
 
     // partitioned a bit so we don't over serialize
     mutable Mutex           mLock;
     mutable Mutex           mLock_ids;
     mutable Mutex           mLock_mappings;
+    mutable Mutex           mLock_expire;
 
-    // limit how many records we'll retain
-    // by count (in each queue (open, finalized))
-    int32_t mMaxRecords;
-    // by time (none older than this long agan
-    nsecs_t mMaxRecordAgeNs;
-    // max to expire per expirations_l() invocation
+    // max to expire per MediaAnalyticsStore::expire() invocation
     int32_t mMaxRecordsExpiredAtOnce;
     //
     // # of sets of summaries
@@ -81,22 +76,21 @@ class MediaAnalyticsService : public BnMediaAnalyticsService
     bool contentValid(MediaAnalyticsItem *item, bool isTrusted);
     bool rateLimited(MediaAnalyticsItem *);
 
-    // (oldest at front) so it prints nicely for dumpsys
-    List<MediaAnalyticsItem *> mItems;
+    // the retained records, limited by count, bytes and age
+    MediaAnalyticsStore mStore;
     void saveItem(MediaAnalyticsItem *);
 
-    bool expirations_l(MediaAnalyticsItem *);
-    std::future<bool> mExpireFuture;
+    std::future<bool> mExpireFuture;    // GUARDED_BY(mLock_expire)
 
     // support for generating output
     int mDumpProto;
     int mDumpProtoDefault;
     String8 dumpQueue();
-    String8 dumpQueue(nsecs_t, const char *only);
+    String8 dumpQueue(const MediaAnalyticsStore::Query &query);
 
     void dumpHeaders(String8 &result, nsecs_t ts_since);
     void dumpSummaries(String8 &result, nsecs_t ts_since, const char * only);
-    void dumpRecent(String8 &result, nsecs_t ts_since, const char * only);
+    void dumpRecent(String8 &result, const MediaAnalyticsStore::Query &query);
 
     // mapping uids to package names
     struct UidToPkgMap {
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaAnalyticsStore"
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "MediaAnalyticsStore.h"
+
+namespace android {
+
+MediaAnalyticsStore::MediaAnalyticsStore(const Limits &limits)
+    : mLimits(limits)
+{
+}
+
+MediaAnalyticsStore::~MediaAnalyticsStore()
+{
+    Mutex::Autolock _l(mLock_shards);
+    for (auto &entry : mShards) {
+        Shard *shard = entry.second.get();
+        Mutex::Autolock _sl(shard->lock);
+        while (!shard->items.empty()) {
+            removeOldest_l(shard);
+        }
+    }
+}
+
+// estimated memory held by a record, including the strings of its properties;
+// attribute names are shared with other records and not counted.
+size_t MediaAnalyticsStore::itemBytes(MediaAnalyticsItem *item)
+{
+    return sizeof(*item)
+            + item->mKey.capacity()
+            + item->mPkgName.capacity()
+            + item->mPropSize * sizeof(MediaAnalyticsItem::Prop)
+            + item->mArenaBytes;
+}
+
+MediaAnalyticsStore::Shard *MediaAnalyticsStore::getShard(const std::string &key, bool create)
+{
+    Mutex::Autolock _l(mLock_shards);
+    auto it = mShards.find(key);
+    if (it != mShards.end()) {
+        return it->second.get();
+    }
+    if (!create) {
+        return nullptr;
+    }
+    ALOGV("new shard for key '%s'", key.c_str());
+    return mShards.emplace(key, std::make_unique<Shard>()).first->second.get();
+}
+
+// the heaviest producer pays for exceeding the overall budget
+MediaAnalyticsStore::Shard *MediaAnalyticsStore::getLargestShard()
+{
+    Mutex::Autolock _l(mLock_shards);
+    Shard *largest = nullptr;
+    size_t largestBytes = 0;
+    for (auto &entry : mShards) {
+        const size_t bytes = entry.second->bytes;
+        if (bytes > largestBytes) {
+            largest = entry.second.get();
+            largestBytes = bytes;
+        }
+    }
+    return largest;
+}
+
+// caller holds shard->lock
+size_t MediaAnalyticsStore::removeOldest_l(Shard *shard)
+{
+    MediaAnalyticsItem *item = shard->items.front();
+    shard->items.pop_front();
+    if (!shard->items.empty() && item->getTimestamp() > shard->items.front()->getTimestamp()) {
+        shard->inversions--;
+    }
+
+    // records are in insertion order, so this is also the oldest of its package
+    auto pkg = shard->packages.find(item->getPkgName());
+    if (pkg != shard->packages.end()) {
+        pkg->second.pop_front();
+        if (pkg->second.empty()) {
+            shard->packages.erase(pkg);
+        }
+    }
+
+    const size_t bytes = itemBytes(item);
+    shard->bytes -= bytes;
+    mRecords--;
+    mBytes -= bytes;
+    delete item;
+    return bytes;
+}
+
+// caller holds shard->lock
+void MediaAnalyticsStore::updateNextExpiration_l(Shard *shard)
+{
+    if (mLimits.maxRecordAgeNs <= 0 || shard->items.empty()) {
+        return;
+    }
+    nsecs_t expirationNs;
+    if (__builtin_add_overflow(shard->items.front()->getTimestamp(), mLimits.maxRecordAgeNs,
+            &expirationNs)) {
+        expirationNs = INT64_MAX;
+    }
+    nsecs_t next = mNextExpirationNs;
+    while (expirationNs < next
+            && !mNextExpirationNs.compare_exchange_weak(next, expirationNs)) {
+    }
+}
+
+// caller surrenders ownership of 'item'
+void MediaAnalyticsStore::add(MediaAnalyticsItem *item)
+{
+    const size_t bytes = itemBytes(item);
+    Shard *shard = getShard(item->getKey(), true /* create */);
+    {
+        Mutex::Autolock _l(shard->lock);
+
+        // we want to dump 'in FIFO order', so insert at the end.
+        // Timestamps are usually in order too, which allows a binary search by time.
+        if (!shard->items.empty()
+                && item->getTimestamp() < shard->items.back()->getTimestamp()) {
+            shard->inversions++;
+        }
+        shard->items.push_back(item);
+        shard->packages[item->getPkgName()].push_back(item);
+        shard->bytes += bytes;
+        mRecords++;
+        mBytes += bytes;
+
+        // the quota of this key, which may remove the new record if it is too big alone
+        while (!shard->items.empty()
+                && ((mLimits.maxRecordsPerKey > 0
+                        && shard->items.size() > mLimits.maxRecordsPerKey)
+                    || (mLimits.maxBytesPerKey > 0
+                        && shard->bytes > mLimits.maxBytesPerKey))) {
+            removeOldest_l(shard);
+            mDiscardedByCount++;
+        }
+        updateNextExpiration_l(shard);
+    }
+    evictOverBudget();
+}
+
+// holds at most one shard lock at a time, so it cannot deadlock with forEach()
+void MediaAnalyticsStore::evictOverBudget()
+{
+    while ((mLimits.maxRecords > 0 && mRecords > mLimits.maxRecords)
+            || (mLimits.maxBytes > 0 && mBytes > mLimits.maxBytes)) {
+        Shard *shard = getLargestShard();
+        if (shard == nullptr) {
+            break;
+        }
+        Mutex::Autolock _l(shard->lock);
+        if (!shard->items.empty()) {
+            removeOldest_l(shard);
+            mDiscardedByCount++;
+            updateNextExpiration_l(shard);
+        }
+    }
+}
+
+bool MediaAnalyticsStore::expire(nsecs_t now, size_t maxCount)
+{
+    if (mLimits.maxRecordAgeNs <= 0) {
+        return false;
+    }
+    // recomputed from the oldest record of each shard below, while any add()
+    // meanwhile lowers it for its own shard.
+    mNextExpirationNs = INT64_MAX;
+    std::vector<Shard *> shards;
+    {
+        Mutex::Autolock _l(mLock_shards);
+        for (auto &entry : mShards) {
+            shards.push_back(entry.second.get());
+        }
+    }
+
+    size_t handled = 0;
+    for (Shard *shard : shards) {
+        Mutex::Autolock _l(shard->lock);
+        while (!shard->items.empty()) {
+            const nsecs_t when = shard->items.front()->getTimestamp();
+            // careful about timejumps too
+            if ((now > when) && (now - when) <= mLimits.maxRecordAgeNs) {
+                // this (and the rest) are recent enough to keep
+                break;
+            }
+            if (handled >= maxCount) {
+                // this represents "one too many"; tell caller there are
+                // more to be reclaimed.
+                mNextExpirationNs = INT64_MIN;
+                return true;
+            }
+            handled++;
+            removeOldest_l(shard);
+            mDiscardedByExpiration++;
+        }
+        updateNextExpiration_l(shard);
+    }
+    return false;
+}
+
+size_t MediaAnalyticsStore::forEach(
+        const Query &query, const std::function<void(MediaAnalyticsItem *)> &visitor)
+{
+    std::vector<Shard *> shards;
+    {
+        Mutex::Autolock _l(mLock_shards);
+        if (!query.key.empty()) {
+            auto it = mShards.find(query.key);
+            if (it != mShards.end()) {
+                shards.push_back(it->second.get());
+            }
+        } else {
+            for (auto &entry : mShards) {
+                shards.push_back(entry.second.get());
+            }
+        }
+    }
+
+    // Locked in map order; anyone else holds at most one shard lock.
+    struct Cursor {
+        const std::deque<MediaAnalyticsItem *> *items;
+        size_t next;
+        bool sorted;
+    };
+    std::vector<Cursor> cursors;
+    for (Shard *shard : shards) {
+        shard->lock.lock();
+        const std::deque<MediaAnalyticsItem *> *items = &shard->items;
+        bool sorted = shard->inversions == 0;
+        if (!query.pkg.empty()) {
+            auto pkg = shard->packages.find(query.pkg);
+            if (pkg == shard->packages.end()) {
+                continue;
+            }
+            items = &pkg->second;
+            sorted = false; // not tracked per package, which are short anyway
+        }
+        size_t next = 0;
+        if (sorted && query.since > 0) {
+            next = std::lower_bound(items->begin(), items->end(), query.since,
+                    [](MediaAnalyticsItem *item, nsecs_t since) {
+                        return item->getTimestamp() < since;
+                    }) - items->begin();
+        }
+        cursors.push_back({items, next, sorted});
+    }
+
+    // merge the shards by timestamp, so the output is oldest first as before
+    size_t visited = 0;
+    for (;;) {
+        Cursor *oldest = nullptr;
+        for (Cursor &cursor : cursors) {
+            if (cursor.next < cursor.items->size() && (oldest == nullptr
+                    || (*cursor.items)[cursor.next]->getTimestamp()
+                            < (*oldest->items)[oldest->next]->getTimestamp())) {
+                oldest = &cursor;
+            }
+        }
+        if (oldest == nullptr) {
+            break;
+        }
+        MediaAnalyticsItem *item = (*oldest->items)[oldest->next++];
+        const nsecs_t when = item->getTimestamp();
+        if (when >= query.until) {
+            if (oldest->sorted) {
+                oldest->next = oldest->items->size(); // and the rest of this shard
+            }
+            continue;
+        }
+        if (when < query.since) {
+            continue;
+        }
+        visitor(item);
+        visited++;
+    }
+
+    for (Shard *shard : shards) {
+        shard->lock.unlock();
+    }
+    return visited;
+}
+
+void MediaAnalyticsStore::clear()
+{
+    Mutex::Autolock _l(mLock_shards);
+    for (auto &entry : mShards) {
+        Shard *shard = entry.second.get();
+        Mutex::Autolock _sl(shard->lock);
+        while (!shard->items.empty()) {
+            removeOldest_l(shard);
+            mDiscardedByClear++;
+        }
+    }
+}
+
+} // namespace android
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_MEDIAANALYTICSSTORE_H
+#define ANDROID_MEDIAANALYTICSSTORE_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+
+#include <media/MediaAnalyticsItem.h>
+
+namespace android {
+
+// In-core storage of the finalized records of the MediaAnalyticsService.
+//
+// Records are sharded by key, so a bursty producer (e.g. codec or audiotrack)
+// only contends with, and evicts, its own records. Each shard has its own lock,
+// a record and byte quota, and keeps its records in arrival order
+// with an index by package name.
+//
+// Limits are enforced on insertion: first the quota of the key, then the
+// overall record and byte budget, which evicts the oldest records of the
+// key using the most memory.
+class MediaAnalyticsStore {
+ public:
+    struct Limits {
+        size_t maxRecords;          // over all keys (0 for no limit)
+        size_t maxBytes;            // over all keys (0 for no limit)
+        size_t maxRecordsPerKey;    // (0 for no limit)
+        size_t maxBytesPerKey;      // (0 for no limit)
+        nsecs_t maxRecordAgeNs;     // (0 for no limit)
+    };
+
+    // Selects records for dump(); empty strings match everything.
+    struct Query {
+        std::string key;
+        std::string pkg;
+        nsecs_t since = 0;          // inclusive
+        nsecs_t until = INT64_MAX;  // exclusive
+    };
+
+    explicit MediaAnalyticsStore(const Limits &limits);
+    ~MediaAnalyticsStore();
+
+    // caller surrenders ownership of 'item'
+    void add(MediaAnalyticsItem *item);
+
+    // removes up to maxCount records older than maxRecordAgeNs.
+    // true == more records are eligible to be expired
+    bool expire(nsecs_t now, size_t maxCount);
+
+    // true if expire() may have something to do, i.e. the oldest record of a key
+    // is older than maxRecordAgeNs. Lock free, for calling on every insertion.
+    bool expirationDue(nsecs_t now) const {
+        return mLimits.maxRecordAgeNs > 0 && now > mNextExpirationNs;
+    }
+
+    // calls visitor on the matching records, oldest first.
+    // Only the shards of the matching keys are locked, and only for the duration.
+    // returns the number of records visited
+    size_t forEach(const Query &query, const std::function<void(MediaAnalyticsItem *)> &visitor);
+
+    // removes all records
+    void clear();
+
+    size_t records() const { return mRecords; }
+    size_t bytes() const { return mBytes; }
+    int64_t discardedByCount() const { return mDiscardedByCount; }
+    int64_t discardedByExpiration() const { return mDiscardedByExpiration; }
+    int64_t discardedByClear() const { return mDiscardedByClear; }
+
+    // estimated memory held by a record
+    static size_t itemBytes(MediaAnalyticsItem *item);
+
+ private:
+    struct Shard {
+        mutable Mutex lock;
+        // in arrival order (oldest at front) so it prints nicely for dumpsys
+        std::deque<MediaAnalyticsItem *> items;                                 // GUARDED_BY(lock)
+        std::map<std::string, std::deque<MediaAnalyticsItem *>> packages;      // GUARDED_BY(lock)
+        // adjacent records out of timestamp order, e.g. after a clock change;
+        // while 0, items can be searched by time.
+        size_t inversions = 0;                                                  // GUARDED_BY(lock)
+        std::atomic<size_t> bytes{0};   // written with lock held
+    };
+
+    Shard *getShard(const std::string &key, bool create);
+    Shard *getLargestShard();
+
+    // returns the bytes removed
+    size_t removeOldest_l(Shard *shard);
+    // the oldest record of a shard changed
+    void updateNextExpiration_l(Shard *shard);
+    void evictOverBudget();
+
+    const Limits mLimits;
+
+    mutable Mutex mLock_shards;     // protects the map, shards are never removed
+    std::map<std::string, std::unique_ptr<Shard>> mShards;  // GUARDED_BY(mLock_shards)
+
+    std::atomic<size_t> mRecords{0};
+    std::atomic<size_t> mBytes{0};
+    std::atomic<int64_t> mDiscardedByCount{0};
+    std::atomic<int64_t> mDiscardedByExpiration{0};
+    std::atomic<int64_t> mDiscardedByClear{0};
+    // after this, the oldest record of some key may be too old
+    std::atomic<nsecs_t> mNextExpirationNs{INT64_MAX};
+};
+
+} // namespace android
+
+#endif // ANDROID_MEDIAANALYTICSSTORE_H
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaAnalyticsStore_test"
+#include <utils/Log.h>
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "MediaAnalyticsStore.h"
+
+namespace android {
+
+static constexpr nsecs_t kSecond = 1000000000ll;
+
+static MediaAnalyticsItem *newItem(const char *key, const char *pkg, nsecs_t when) {
+    MediaAnalyticsItem *item = MediaAnalyticsItem::create(key);
+    item->setPkgName(pkg);
+    item->setTimestamp(when);
+    item->setInt32("value", 1);
+    return item;
+}
+
+static std::vector<nsecs_t> timestamps(MediaAnalyticsStore &store,
+        const MediaAnalyticsStore::Query &query) {
+    std::vector<nsecs_t> result;
+    store.forEach(query, [&](MediaAnalyticsItem *item) {
+            result.push_back(item->getTimestamp());
+        });
+    return result;
+}
+
+TEST(MediaAnalyticsStoreTest, perKeyQuota) {
+    MediaAnalyticsStore store({0 /* maxRecords */, 0 /* maxBytes */,
+            10 /* maxRecordsPerKey */, 0 /* maxBytesPerKey */, 0 /* maxRecordAgeNs */});
+
+    for (int i = 0; i < 5; i++) {
+        store.add(newItem("audiotrack", "pkg", i * kSecond));
+    }
+    // a burst of codec records only evicts older codec records
+    for (int i = 0; i < 100; i++) {
+        store.add(newItem("codec", "pkg", (10 + i) * kSecond));
+    }
+    EXPECT_EQ(15u, store.records());
+    EXPECT_EQ(90, store.discardedByCount());
+
+    MediaAnalyticsStore::Query query;
+    query.key = "audiotrack";
+    EXPECT_EQ(5u, timestamps(store, query).size());
+    query.key = "codec";
+    const std::vector<nsecs_t> codec = timestamps(store, query);
+    ASSERT_EQ(10u, codec.size());
+    EXPECT_EQ(100 * kSecond, codec.front());
+}
+
+TEST(MediaAnalyticsStoreTest, byteBudgetEvictsLargestKey) {
+    MediaAnalyticsItem *item = newItem("codec", "pkg", 0);
+    const size_t itemBytes = MediaAnalyticsStore::itemBytes(item);
+    delete item;
+    MediaAnalyticsStore store({0 /* maxRecords */, 20 * itemBytes /* maxBytes */,
+            0 /* maxRecordsPerKey */, 0 /* maxBytesPerKey */, 0 /* maxRecordAgeNs */});
+
+    for (int i = 0; i < 5; i++) {
+        store.add(newItem("drm", "pkg", i * kSecond));
+    }
+    for (int i = 0; i < 100; i++) {
+        store.add(newItem("codec", "pkg", (10 + i) * kSecond));
+    }
+    EXPECT_LE(store.bytes(), 20 * itemBytes);
+
+    MediaAnalyticsStore::Query query;
+    query.key = "drm";
+    EXPECT_EQ(5u, timestamps(store, query).size());
+}
+
+TEST(MediaAnalyticsStoreTest, queries) {
+    MediaAnalyticsStore store({0, 0, 0, 0, 0});
+
+    for (int i = 0; i < 100; i++) {
+        store.add(newItem((i % 2) ? "codec" : "audiotrack",
+                (i % 5) ? "com.example.a" : "com.example.b", i * kSecond));
+    }
+
+    // all keys are merged, oldest first
+    MediaAnalyticsStore::Query query;
+    const std::vector<nsecs_t> all = timestamps(store, query);
+    ASSERT_EQ(100u, all.size());
+    for (size_t i = 0; i < all.size(); i++) {
+        EXPECT_EQ((nsecs_t) i * kSecond, all[i]);
+    }
+
+    query.since = 10 * kSecond;
+    query.until = 20 * kSecond;
+    EXPECT_EQ(10u, timestamps(store, query).size());
+
+    query.key = "codec";
+    const std::vector<nsecs_t> codec = timestamps(store, query);
+    ASSERT_EQ(5u, codec.size());
+    EXPECT_EQ(11 * kSecond, codec.front());
+
+    query.key = "";
+    query.pkg = "com.example.b";
+    EXPECT_EQ(2u, timestamps(store, query).size());
+
+    query.key = "drm";
+    query.pkg = "";
+    EXPECT_EQ(0u, timestamps(store, query).size());
+}
+
+TEST(MediaAnalyticsStoreTest, clockChange) {
+    MediaAnalyticsStore store({0, 0, 0, 0, 0});
+
+    // the clock is set back after the first 10 records
+    for (int i = 0; i < 20; i++) {
+        store.add(newItem("codec", "pkg", ((i < 10) ? 100 + i : i) * kSecond));
+    }
+
+    MediaAnalyticsStore::Query query;
+    query.key = "codec";
+    query.since = 15 * kSecond;
+    query.until = 105 * kSecond;
+    EXPECT_EQ(10u, timestamps(store, query).size());
+}
+
+TEST(MediaAnalyticsStoreTest, expire) {
+    MediaAnalyticsStore store({0, 0, 0, 0, 10 * kSecond /* maxRecordAgeNs */});
+
+    for (int i = 0; i < 100; i++) {
+        store.add(newItem((i % 2) ? "codec" : "audiotrack", "pkg", i * kSecond));
+    }
+    const nsecs_t now = 100 * kSecond;
+    EXPECT_TRUE(store.expire(now, 50));
+    EXPECT_FALSE(store.expire(now, 50));
+    EXPECT_EQ(10u, store.records());
+    EXPECT_EQ(90, store.discardedByExpiration());
+
+    store.clear();
+    EXPECT_EQ(0u, store.records());
+    EXPECT_EQ(0u, store.bytes());
+    EXPECT_EQ(10, store.discardedByClear());
+}
+
+TEST(MediaAnalyticsStoreTest, expirationDue) {
+    MediaAnalyticsStore store({0, 0, 0, 0, 10 * kSecond /* maxRecordAgeNs */});
+    EXPECT_FALSE(store.expirationDue(100 * kSecond));
+
+    for (int i = 0; i < 10; i++) {
+        store.add(newItem((i % 2) ? "codec" : "audiotrack", "pkg", (100 + i) * kSecond));
+    }
+    // due once the oldest record, of either key, is too old
+    EXPECT_FALSE(store.expirationDue(110 * kSecond));
+    EXPECT_TRUE(store.expirationDue(111 * kSecond));
+
+    // only partly expired: still due
+    EXPECT_TRUE(store.expire(113 * kSecond, 2));
+    EXPECT_TRUE(store.expirationDue(113 * kSecond));
+    EXPECT_FALSE(store.expire(113 * kSecond, 10));
+    EXPECT_EQ(7u, store.records());
+    EXPECT_FALSE(store.expirationDue(113 * kSecond));
+    EXPECT_TRUE(store.expirationDue(114 * kSecond));
+
+    // a record older than the rest of its key makes it due earlier
+    MediaAnalyticsStore empty({0, 0, 0, 0, 10 * kSecond});
+    empty.add(newItem("codec", "pkg", 200 * kSecond));
+    EXPECT_FALSE(empty.expirationDue(205 * kSecond));
+    empty.add(newItem("extractor", "pkg", 190 * kSecond));
+    EXPECT_TRUE(empty.expirationDue(205 * kSecond));
+
+    // never due without an age limit
+    MediaAnalyticsStore unlimited({0, 0, 0, 0, 0});
+    unlimited.add(newItem("codec", "pkg", 0));
+    EXPECT_FALSE(unlimited.expirationDue(INT64_MAX));
+}
+
+// insertion and dump cost with a service sized for 100k records
+TEST(MediaAnalyticsStoreTest, benchmark) {
+    static constexpr int kRecords = 100000;
+    static const char *kKeys[] = {
+        "audiopolicy", "audiorecord", "audiothread", "audiotrack", "codec",
+        "drm.vendor.Google.WidevineCDM", "extractor", "nuplayer", "recorder",
+    };
+    static constexpr size_t kNumKeys = sizeof(kKeys) / sizeof(kKeys[0]);
+    MediaAnalyticsStore store({kRecords, 0, 0, 0, 0});
+
+    std::vector<MediaAnalyticsItem *> items;
+    for (int i = 0; i < kRecords; i++) {
+        items.push_back(newItem(kKeys[i % kNumKeys],
+                (i % 7) ? "com.example.a" : "com.example.b", i * kSecond));
+    }
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (MediaAnalyticsItem *item : items) {
+        store.add(item);
+    }
+    const nsecs_t insertNs = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    ASSERT_EQ((size_t) kRecords, store.records());
+
+    MediaAnalyticsStore::Query query;
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    EXPECT_EQ((size_t) kRecords, store.forEach(query, [](MediaAnalyticsItem *) {}));
+    const nsecs_t dumpNs = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    // the last hour of one key
+    query.key = "codec";
+    query.since = (kRecords - 3600) * kSecond;
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    EXPECT_EQ(400u, store.forEach(query, [](MediaAnalyticsItem *) {}));
+    const nsecs_t queryNs = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    printf("%d records, %zu bytes: insert %.1f ns/record, dump %.1f ns/record,"
+            " key and time query %.1f us\n",
+            kRecords, store.bytes(), (double) insertNs / kRecords,
+            (double) dumpNs / kRecords, queryNs * 1e-3);
+}
+
+} // namespace android
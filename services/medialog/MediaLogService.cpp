@@ -22,6 +22,7 @@
 #include <binder/PermissionCache.h>
 #include <media/nblog/Merger.h>
 #include <media/nblog/NBLog.h>
+#include <media/nblog/TraceFile.h>
 #include <mediautils/ServiceUtilities.h>
 #include "MediaLogService.h"
 
@@ -107,7 +108,8 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
 
     if (args.size() > 0) {
         const String8 arg0(args[0]);
-        if (!strcmp(arg0.string(), "-r")) {
+        const bool trace = !strcmp(arg0.string(), "--trace");
+        if (!strcmp(arg0.string(), "-r") || trace) {
             // needed because mReaders is protected by mLock
             bool locked = dumpTryLock(mLock);
 
@@ -122,6 +124,12 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
                 return NO_ERROR;
             }
 
+            if (trace) {
+                // binary, for nblogdump: adb exec-out dumpsys media.log --trace > trace.nblog
+                dumpTrace(fd);
+                mLock.unlock();
+                return NO_ERROR;
+            }
             for (const auto &dumpReader : mDumpReaders) {
                 if (fd >= 0) {
                     dprintf(fd, "\n%s:\n", dumpReader->name().c_str());
@@ -138,6 +146,29 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
     return NO_ERROR;
 }
 
+// caller holds mLock
+void MediaLogService::dumpTrace(int fd)
+{
+    if (fd < 0) {
+        return;
+    }
+    NBLog::TraceWriter writer(fd);
+    for (const auto &dumpReader : mDumpReaders) {
+        const uint32_t thread = writer.addThread(dumpReader->name());
+        // does not consume: the merge thread has its own readers
+        std::unique_ptr<NBLog::Snapshot> snapshot = dumpReader->getSnapshot(false /*flush*/);
+        if (snapshot == nullptr) {
+            continue;
+        }
+        const uint8_t *begin = snapshot->begin();
+        const uint8_t *end = snapshot->end();
+        writer.addSnapshot(thread, begin, end - begin, snapshot->lost(), systemTime());
+    }
+    if (writer.status() != OK) {
+        ALOGW("%s: trace not written: %d", __func__, writer.status());
+    }
+}
+
 status_t MediaLogService::onTransact(uint32_t code, const Parcel& data, Parcel* reply,
         uint32_t flags)
 {
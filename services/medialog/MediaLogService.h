@@ -53,6 +53,8 @@ private:
     // Size of merge buffer, in bytes
     static const size_t kMergeBufferSize = 64 * 1024; // TODO determine good value for this
     static bool dumpTryLock(Mutex& mutex);
+    // writes the buffers of all the writers in the NBLog trace format, see TraceFile.h
+    void dumpTrace(int fd);
 
     Mutex               mLock;
 
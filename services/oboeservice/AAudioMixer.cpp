@@ -29,10 +29,88 @@
 #define AAUDIO_MIXER_ATRACE_ENABLED    1
 #endif
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON (true)
+#else
+#define USE_NEON (false)
+#endif
+
 using android::WrappingBuffer;
 using android::FifoBuffer;
 using android::fifo_frames_t;
 
+namespace {
+
+constexpr int32_t kBytesPerI24Packed = 3;
+
+// Scale integer samples to the float range [-1.0, 1.0).
+constexpr float kScaleI16 = 1.0f / (1 << 15);
+constexpr float kScaleI24 = 1.0f / (1 << 23);
+
+// Little endian packed 24-bit sample, sign extended.
+inline int32_t readI24(const uint8_t *source) {
+    uint32_t pad = ((uint32_t) source[2] << 24) | ((uint32_t) source[1] << 16)
+            | ((uint32_t) source[0] << 8);
+    return static_cast<int32_t>(pad) >> 8;
+}
+
+void mixFloat(float *destination, const float *source, int32_t numSamples, float gain) {
+    int32_t i = 0;
+#if USE_NEON
+    const float32x4_t gain4 = vdupq_n_f32(gain);
+    for (; i + 8 <= numSamples; i += 8) {
+        vst1q_f32(destination + i, vmlaq_f32(vld1q_f32(destination + i),
+                                             vld1q_f32(source + i), gain4));
+        vst1q_f32(destination + i + 4, vmlaq_f32(vld1q_f32(destination + i + 4),
+                                                 vld1q_f32(source + i + 4), gain4));
+    }
+#endif
+    // Without NEON this simple loop is vectorized by the compiler.
+    for (; i < numSamples; i++) {
+        destination[i] += source[i] * gain;
+    }
+}
+
+void mixI16(float *destination, const int16_t *source, int32_t numSamples, float scale) {
+    int32_t i = 0;
+#if USE_NEON
+    const float32x4_t scale4 = vdupq_n_f32(scale);
+    for (; i + 8 <= numSamples; i += 8) {
+        const int16x8_t samples = vld1q_s16(source + i);
+        const float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples)));
+        const float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples)));
+        vst1q_f32(destination + i, vmlaq_f32(vld1q_f32(destination + i), low, scale4));
+        vst1q_f32(destination + i + 4, vmlaq_f32(vld1q_f32(destination + i + 4), high, scale4));
+    }
+#endif
+    for (; i < numSamples; i++) {
+        destination[i] += source[i] * scale;
+    }
+}
+
+void mixI24(float *destination, const uint8_t *source, int32_t numSamples, float scale) {
+    for (int32_t i = 0; i < numSamples; i++) {
+        destination[i] += readI24(source) * scale;
+        source += kBytesPerI24Packed;
+    }
+}
+
+// Add a mono stream to every channel of the mix.
+template <int32_t kBytesPerSample, typename Reader>
+void mixMono(float *destination, const uint8_t *source, int32_t numFrames,
+             int32_t channelCount, float scale, Reader read) {
+    for (int32_t frame = 0; frame < numFrames; frame++) {
+        const float sample = read(source) * scale;
+        source += kBytesPerSample;
+        for (int32_t channel = 0; channel < channelCount; channel++) {
+            *destination++ += sample;
+        }
+    }
+}
+
+} // namespace
+
 AAudioMixer::~AAudioMixer() {
     delete[] mOutputBuffer;
 }
@@ -49,7 +127,19 @@ void AAudioMixer::clear() {
     memset(mOutputBuffer, 0, mBufferSizeInBytes);
 }
 
-int32_t AAudioMixer::mix(int streamIndex, FifoBuffer *fifo, bool allowUnderflow) {
+bool AAudioMixer::isFormatSupported(audio_format_t format) {
+    switch (format) {
+        case AUDIO_FORMAT_PCM_FLOAT:
+        case AUDIO_FORMAT_PCM_16_BIT:
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int32_t AAudioMixer::mix(int streamIndex, FifoBuffer *fifo, bool allowUnderflow,
+                         audio_format_t format, int32_t samplesPerFrame, float gain) {
     WrappingBuffer wrappingBuffer;
     float *destination = mOutputBuffer;
 
@@ -91,8 +181,8 @@ int32_t AAudioMixer::mix(int streamIndex, FifoBuffer *fifo, bool allowUnderflow)
             if (framesToMixFromPart > framesAvailableFromPart) {
                 framesToMixFromPart = framesAvailableFromPart;
             }
-            mixPart(destination, (float *)wrappingBuffer.data[partIndex],
-                    framesToMixFromPart);
+            mixPart(destination, (const uint8_t *)wrappingBuffer.data[partIndex],
+                    framesToMixFromPart, format, samplesPerFrame, gain);
 
             destination += framesToMixFromPart * mSamplesPerFrame;
             framesLeft -= framesToMixFromPart;
@@ -108,11 +198,43 @@ int32_t AAudioMixer::mix(int streamIndex, FifoBuffer *fifo, bool allowUnderflow)
     return (framesDesired - framesLeft); // framesRead
 }
 
-void AAudioMixer::mixPart(float *destination, float *source, int32_t numFrames) {
-    int32_t numSamples = numFrames * mSamplesPerFrame;
-    // TODO maybe optimize using SIMD
-    for (int sampleIndex = 0; sampleIndex < numSamples; sampleIndex++) {
-        *destination++ += *source++;
+void AAudioMixer::mixPart(float *destination, const uint8_t *source, int32_t numFrames,
+                          audio_format_t format, int32_t samplesPerFrame, float gain) {
+    // Other channel counts are rejected when the stream is opened.
+    if (samplesPerFrame == mSamplesPerFrame) {
+        int32_t numSamples = numFrames * mSamplesPerFrame;
+        switch (format) {
+            case AUDIO_FORMAT_PCM_FLOAT:
+                mixFloat(destination, (const float *) source, numSamples, gain);
+                break;
+            case AUDIO_FORMAT_PCM_16_BIT:
+                mixI16(destination, (const int16_t *) source, numSamples, gain * kScaleI16);
+                break;
+            case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+                mixI24(destination, source, numSamples, gain * kScaleI24);
+                break;
+            default:
+                break;
+        }
+    } else if (samplesPerFrame == 1) {
+        switch (format) {
+            case AUDIO_FORMAT_PCM_FLOAT:
+                mixMono<sizeof(float)>(destination, source, numFrames, mSamplesPerFrame, gain,
+                        [](const uint8_t *sample) { return *(const float *) sample; });
+                break;
+            case AUDIO_FORMAT_PCM_16_BIT:
+                mixMono<sizeof(int16_t)>(destination, source, numFrames, mSamplesPerFrame,
+                        gain * kScaleI16,
+                        [](const uint8_t *sample) { return (float) *(const int16_t *) sample; });
+                break;
+            case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+                mixMono<kBytesPerI24Packed>(destination, source, numFrames, mSamplesPerFrame,
+                        gain * kScaleI24,
+                        [](const uint8_t *sample) { return (float) readI24(sample); });
+                break;
+            default:
+                break;
+        }
     }
 }
 
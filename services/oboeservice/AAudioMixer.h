@@ -21,6 +21,7 @@
 
 #include <aaudio/AAudio.h>
 #include <fifo/FifoBuffer.h>
+#include <system/audio.h>
 
 class AAudioMixer {
 public:
@@ -36,16 +37,26 @@ public:
      * @param streamIndex for marking stream variables in systrace
      * @param fifo to read from
      * @param allowUnderflow if true then allow mixer to advance read index past the write index
+     * @param format of the data in the FIFO, see isFormatSupported()
+     * @param samplesPerFrame in the FIFO, either 1 or the same as the mixer
+     * @param gain to apply to this stream
      * @return frames read from this stream
      */
-    int32_t mix(int streamIndex, android::FifoBuffer *fifo, bool allowUnderflow);
+    int32_t mix(int streamIndex, android::FifoBuffer *fifo, bool allowUnderflow,
+                audio_format_t format, int32_t samplesPerFrame, float gain);
 
     float *getOutputBuffer();
 
     int32_t getFramesPerBurst() const { return mFramesPerBurst; }
 
+    /**
+     * @return true if the mixer can read this format directly from a client FIFO
+     */
+    static bool isFormatSupported(audio_format_t format);
+
 private:
-    void mixPart(float *destination, float *source, int32_t numFrames);
+    void mixPart(float *destination, const uint8_t *source, int32_t numFrames,
+                 audio_format_t format, int32_t samplesPerFrame, float gain);
 
     float   *mOutputBuffer = nullptr;
     int32_t  mSamplesPerFrame = 0;
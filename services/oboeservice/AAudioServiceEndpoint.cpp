@@ -131,8 +131,13 @@ bool AAudioServiceEndpoint::matches(const AAudioStreamConfiguration& configurati
         configuration.getSampleRate() != getSampleRate()) {
         return false;
     }
+    // The shared output mixer can add a mono stream to any channel count.
+    bool monoMixed = getSharingMode() == AAUDIO_SHARING_MODE_SHARED
+            && getDirection() == AAUDIO_DIRECTION_OUTPUT
+            && configuration.getSamplesPerFrame() == 1;
     if (configuration.getSamplesPerFrame() != AAUDIO_UNSPECIFIED &&
-        configuration.getSamplesPerFrame() != getSamplesPerFrame()) {
+        configuration.getSamplesPerFrame() != getSamplesPerFrame() &&
+        !monoMixed) {
         return false;
     }
     return true;
@@ -111,7 +111,11 @@ void *AAudioServiceEndpointPlay::callbackLoop() {
                         int64_t positionOffset = mmapFramesWritten - clientFramesRead;
                         streamShared->setTimestampPositionOffset(positionOffset);
 
-                        int32_t framesMixed = mMixer.mix(index, fifo, allowUnderflow);
+                        // The client applies its own volume ramp, so mix at unity gain.
+                        int32_t framesMixed = mMixer.mix(index, fifo, allowUnderflow,
+                                                         streamShared->getFormat(),
+                                                         streamShared->getSamplesPerFrame(),
+                                                         1.0f);
 
                         if (streamShared->isFlowing()) {
                             // Consider it an underflow if we got less than a burst
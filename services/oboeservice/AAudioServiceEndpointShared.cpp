@@ -72,6 +72,14 @@ aaudio_result_t AAudioServiceEndpointShared::open(const aaudio::AAudioStreamRequ
 
     builder.setBufferCapacity(DEFAULT_BUFFER_CAPACITY);
 
+    // The stream carries the mix, so it does not take the format of the first client.
+    builder.setFormat(AUDIO_FORMAT_PCM_FLOAT);
+    if (configuration.getDirection() == AAUDIO_DIRECTION_OUTPUT
+            && configuration.getSamplesPerFrame() == 1) {
+        // Let the mixer expand mono streams so that other streams can share the endpoint.
+        builder.setSamplesPerFrame(AAUDIO_UNSPECIFIED);
+    }
+
     result = mStreamInternal->open(builder);
 
     setSampleRate(mStreamInternal->getSampleRate());
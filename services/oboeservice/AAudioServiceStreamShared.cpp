@@ -30,6 +30,7 @@
 #include "AAudioServiceStreamBase.h"
 #include "AAudioServiceStreamShared.h"
 #include "AAudioEndpointManager.h"
+#include "AAudioMixer.h"
 #include "AAudioService.h"
 #include "AAudioServiceEndpoint.h"
 
@@ -132,6 +133,7 @@ aaudio_result_t AAudioServiceStreamShared::open(const aaudio::AAudioStreamReques
     }
 
     const AAudioStreamConfiguration &configurationInput = request.getConstantConfiguration();
+    const bool isOutput = configurationInput.getDirection() == AAUDIO_DIRECTION_OUTPUT;
 
     sp<AAudioServiceEndpoint> endpoint = mServiceEndpointWeak.promote();
     if (endpoint == nullptr) {
@@ -140,11 +142,14 @@ aaudio_result_t AAudioServiceStreamShared::open(const aaudio::AAudioStreamReques
     }
 
     // Is the request compatible with the shared endpoint?
+    // The output mixer can read other formats and mono data directly from the FIFO.
     setFormat(configurationInput.getFormat());
     if (getFormat() == AUDIO_FORMAT_DEFAULT) {
         setFormat(AUDIO_FORMAT_PCM_FLOAT);
-    } else if (getFormat() != AUDIO_FORMAT_PCM_FLOAT) {
-        ALOGD("%s() audio_format_t mAudioFormat = %d, need FLOAT", __func__, getFormat());
+    } else if (isOutput ? !AAudioMixer::isFormatSupported(getFormat())
+                        : getFormat() != AUDIO_FORMAT_PCM_FLOAT) {
+        ALOGD("%s() audio_format_t mAudioFormat = %d, not supported by the %s", __func__,
+              getFormat(), isOutput ? "mixer" : "capture endpoint");
         result = AAUDIO_ERROR_INVALID_FORMAT;
         goto error;
     }
@@ -162,7 +167,8 @@ aaudio_result_t AAudioServiceStreamShared::open(const aaudio::AAudioStreamReques
     setSamplesPerFrame(configurationInput.getSamplesPerFrame());
     if (getSamplesPerFrame() == AAUDIO_UNSPECIFIED) {
         setSamplesPerFrame(endpoint->getSamplesPerFrame());
-    } else if (getSamplesPerFrame() != endpoint->getSamplesPerFrame()) {
+    } else if (getSamplesPerFrame() != endpoint->getSamplesPerFrame()
+            && !(isOutput && getSamplesPerFrame() == 1)) {
         ALOGD("%s() mSamplesPerFrame = %d, need %d",
               __func__, getSamplesPerFrame(), endpoint->getSamplesPerFrame());
         result = AAUDIO_ERROR_OUT_OF_RANGE;
@@ -59,3 +59,26 @@ LOCAL_SHARED_LIBRARIES :=  \
 include $(BUILD_SHARED_LIBRARY)
 
 
+
+# AAudio mixer test and benchmark
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := test_aaudio_mixer
+
+LOCAL_C_INCLUDES := \
+    $(TOP)/frameworks/av/media/libaaudio/include \
+    $(TOP)/frameworks/av/media/libaaudio/src
+
+LOCAL_SRC_FILES := \
+    tests/test_aaudio_mixer.cpp \
+    AAudioMixer.cpp
+
+LOCAL_CFLAGS += -Wall -Werror
+
+LOCAL_SHARED_LIBRARIES := \
+    libaaudio \
+    libcutils \
+    libutils \
+    liblog
+
+include $(BUILD_NATIVE_TEST)
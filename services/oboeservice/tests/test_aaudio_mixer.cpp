@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Test and benchmark the AAudio service mixer.
+
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "AAudioMixer.h"
+
+using android::FifoBuffer;
+
+constexpr int32_t kFramesPerBurst = 192;
+constexpr int32_t kMixerChannels = 2;
+
+static int32_t bytesPerSample(audio_format_t format) {
+    return (format == AUDIO_FORMAT_PCM_24_BIT_PACKED) ? 3 : audio_bytes_per_sample(format);
+}
+
+// Write one burst of a constant value, in the format of the FIFO.
+static void writeBurst(FifoBuffer *fifo, audio_format_t format, int32_t channelCount,
+                       float value) {
+    const int32_t numSamples = kFramesPerBurst * channelCount;
+    std::vector<uint8_t> data(numSamples * bytesPerSample(format));
+    for (int32_t i = 0; i < numSamples; i++) {
+        switch (format) {
+            case AUDIO_FORMAT_PCM_FLOAT:
+                ((float *) data.data())[i] = value;
+                break;
+            case AUDIO_FORMAT_PCM_16_BIT:
+                ((int16_t *) data.data())[i] = (int16_t) (value * (1 << 15));
+                break;
+            case AUDIO_FORMAT_PCM_24_BIT_PACKED: {
+                int32_t sample = (int32_t) (value * (1 << 23));
+                data[i * 3] = sample & 0xFF;
+                data[i * 3 + 1] = (sample >> 8) & 0xFF;
+                data[i * 3 + 2] = (sample >> 16) & 0xFF;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    fifo->write(data.data(), kFramesPerBurst);
+}
+
+static void checkMix(audio_format_t format, int32_t channelCount) {
+    AAudioMixer mixer;
+    mixer.allocate(kMixerChannels, kFramesPerBurst);
+    mixer.clear();
+
+    FifoBuffer fifo1(channelCount * bytesPerSample(format), 4 * kFramesPerBurst);
+    FifoBuffer fifo2(channelCount * bytesPerSample(format), 4 * kFramesPerBurst);
+    writeBurst(&fifo1, format, channelCount, 0.25f);
+    writeBurst(&fifo2, format, channelCount, -0.5f);
+
+    ASSERT_EQ(kFramesPerBurst, mixer.mix(0, &fifo1, false, format, channelCount, 1.0f));
+    ASSERT_EQ(kFramesPerBurst, mixer.mix(1, &fifo2, false, format, channelCount, 0.25f));
+
+    const float *output = mixer.getOutputBuffer();
+    for (int32_t i = 0; i < kFramesPerBurst * kMixerChannels; i++) {
+        ASSERT_NEAR(0.125f, output[i], 0.0001f) << "sample " << i;
+    }
+}
+
+TEST(test_aaudio_mixer, mix_float) {
+    checkMix(AUDIO_FORMAT_PCM_FLOAT, kMixerChannels);
+}
+
+TEST(test_aaudio_mixer, mix_i16) {
+    checkMix(AUDIO_FORMAT_PCM_16_BIT, kMixerChannels);
+}
+
+TEST(test_aaudio_mixer, mix_i24) {
+    checkMix(AUDIO_FORMAT_PCM_24_BIT_PACKED, kMixerChannels);
+}
+
+TEST(test_aaudio_mixer, mix_mono) {
+    checkMix(AUDIO_FORMAT_PCM_FLOAT, 1);
+    checkMix(AUDIO_FORMAT_PCM_16_BIT, 1);
+    checkMix(AUDIO_FORMAT_PCM_24_BIT_PACKED, 1);
+}
+
+// Time the mix of one burst from 1 to 32 streams. Reports the time per stream.
+static void benchmarkMix(audio_format_t format, int32_t channelCount) {
+    constexpr int kNumBursts = 2000;
+    AAudioMixer mixer;
+    mixer.allocate(kMixerChannels, kFramesPerBurst);
+
+    for (int numStreams = 1; numStreams <= 32; numStreams *= 2) {
+        std::vector<std::unique_ptr<FifoBuffer>> fifos;
+        for (int i = 0; i < numStreams; i++) {
+            fifos.emplace_back(new FifoBuffer(channelCount * bytesPerSample(format),
+                                              2 * kFramesPerBurst));
+        }
+        std::chrono::nanoseconds elapsed{0};
+        for (int burst = 0; burst < kNumBursts; burst++) {
+            for (auto &fifo : fifos) {
+                writeBurst(fifo.get(), format, channelCount, 0.01f);
+            }
+            auto start = std::chrono::steady_clock::now();
+            mixer.clear();
+            for (int i = 0; i < numStreams; i++) {
+                mixer.mix(i, fifos[i].get(), true, format, channelCount, 1.0f);
+            }
+            elapsed += std::chrono::steady_clock::now() - start;
+        }
+        printf("format 0x%x, %d channel(s), %2d streams: %6.0f ns per stream per burst\n",
+               format, channelCount, numStreams,
+               (double) elapsed.count() / (kNumBursts * numStreams));
+    }
+}
+
+TEST(test_aaudio_mixer, benchmark) {
+    benchmarkMix(AUDIO_FORMAT_PCM_FLOAT, kMixerChannels);
+    benchmarkMix(AUDIO_FORMAT_PCM_16_BIT, kMixerChannels);
+    benchmarkMix(AUDIO_FORMAT_PCM_24_BIT_PACKED, kMixerChannels);
+    benchmarkMix(AUDIO_FORMAT_PCM_16_BIT, 1);
+}